@@ -0,0 +1,98 @@
+#ifndef LED_STRIP_CLIENT__FRAME_HPP_
+#define LED_STRIP_CLIENT__FRAME_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "led_strip_msgs/msg/led_strip.hpp"
+#include "led_strip_msgs/msg/led_strips.hpp"
+
+namespace led_strip_client
+{
+
+// A pixel as laid out in LedStrip.data: the driver reorders it for BGR strips.
+struct Rgb
+{
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+};
+static_assert(sizeof(Rgb) == 3, "Rgb must match the layout of LedStrip.data");
+
+// A view of pixels owned by a Frame, to render in place.
+template<typename T>
+class PixelSpan
+{
+public:
+  PixelSpan(T * data, size_t size)
+  : data_(data), size_(size) {}
+
+  T & operator[](size_t index) const {return data_[index];}
+  T * begin() const {return data_;}
+  T * end() const {return data_ + size_;}
+  T * data() const {return data_;}
+  size_t size() const {return size_;}
+
+  void fill(const T & value) const
+  {
+    for (T & pixel : *this) {
+      pixel = value;
+    }
+  }
+
+private:
+  T * data_;
+  size_t size_;
+};
+
+struct StripConfig
+{
+  // channel id, see LedStrip.id
+  uint8_t id;
+  uint16_t pixels;
+  uint8_t type = led_strip_msgs::msg::LedStrip::WS2812;
+  uint8_t color_order = led_strip_msgs::msg::LedStrip::RGB;
+};
+
+// A LedStrips message allocated once, rendered in place frame after frame.
+// It remembers what was last published, to detect frames that did not change.
+class Frame
+{
+public:
+  explicit Frame(const std::vector<StripConfig> & strips);
+
+  size_t number_of_strips() const {return message_.strips.size();}
+  // The pixels of the i-th strip of the configuration
+  PixelSpan<Rgb> pixels(size_t index);
+  PixelSpan<uint8_t> bytes(size_t index);
+  // Sets all pixels to black
+  void clear();
+  // See LedStrips.transition_ms
+  void set_transition_ms(uint16_t value) {message_.transition_ms = value;}
+
+  // Whether the frame differs from the last one published
+  bool changed() const;
+  // Makes the next frame count as changed, e.g. after the driver restarted
+  void invalidate() {has_published_ = false;}
+
+  const led_strip_msgs::msg::LedStrips & message() const {return message_;}
+
+private:
+  friend class FramePublisher;
+
+  // Stamps the next seq and returns the message to publish
+  const led_strip_msgs::msg::LedStrips & stamp(uint32_t seq);
+  // Keeps what was published for the change detection
+  void published();
+
+  led_strip_msgs::msg::LedStrips message_;
+  // The data of all strips, as last published
+  std::vector<uint8_t> published_data_;
+  uint16_t published_transition_ms_ = 0;
+  bool has_published_ = false;
+};
+
+}  // namespace led_strip_client
+
+#endif  // LED_STRIP_CLIENT__FRAME_HPP_
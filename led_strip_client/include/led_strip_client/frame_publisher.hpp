@@ -0,0 +1,78 @@
+#ifndef LED_STRIP_CLIENT__FRAME_PUBLISHER_HPP_
+#define LED_STRIP_CLIENT__FRAME_PUBLISHER_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "rclcpp/rclcpp.hpp"
+#include "led_strip_msgs/msg/led_strips.hpp"
+#include "led_strip_client/frame.hpp"
+
+namespace led_strip_client
+{
+
+struct PublisherOptions
+{
+  // Maximal frame rate, 0 for no limit
+  double max_rate = 0.0;
+  // Do not publish frames identical to the last one
+  bool skip_unchanged = true;
+  // A frame held back by the rate limit is published as soon as the rate
+  // allows, unless a newer one replaces it. Otherwise it is dropped.
+  bool coalesce = true;
+};
+
+enum class PublishResult
+{
+  published,
+  unchanged,
+  // held back by the rate limit, published later unless replaced
+  coalesced,
+  // held back by the rate limit, without coalescing
+  dropped,
+};
+
+struct PublisherStats
+{
+  uint32_t published = 0;
+  uint32_t unchanged = 0;
+  uint32_t coalesced = 0;
+  uint32_t dropped = 0;
+};
+
+// Publishes Frames on a LedStrips topic, numbering them with seq.
+// Publishing does not allocate: the message of the frame is published as is
+// (leave intra-process communication disabled, it would copy it).
+// The frame must outlive the publisher while it is held back, and is
+// published by a timer of the node: render and publish from the same executor.
+class FramePublisher
+{
+public:
+  FramePublisher(
+    rclcpp::Node & node, const std::string & topic, const rclcpp::QoS & qos,
+    const PublisherOptions & options = PublisherOptions());
+
+  PublishResult publish(Frame & frame);
+
+  const PublisherStats & stats() const {return stats_;}
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  void publish_now(Frame & frame, Clock::time_point now);
+  void on_timer();
+
+  PublisherOptions options_;
+  Clock::duration period_;
+  rclcpp::Publisher<led_strip_msgs::msg::LedStrips>::SharedPtr publisher_;
+  rclcpp::TimerBase::SharedPtr timer_;
+  Frame * pending_ = nullptr;
+  Clock::time_point last_published_at_;
+  uint32_t seq_ = 0;
+  PublisherStats stats_;
+};
+
+}  // namespace led_strip_client
+
+#endif  // LED_STRIP_CLIENT__FRAME_PUBLISHER_HPP_
@@ -0,0 +1,74 @@
+#include "led_strip_client/frame.hpp"
+
+#include <cstring>
+
+namespace led_strip_client
+{
+
+Frame::Frame(const std::vector<StripConfig> & strips)
+{
+  size_t size = 0;
+  message_.strips.resize(strips.size());
+  for (size_t i = 0; i < strips.size(); i++) {
+    auto & strip = message_.strips[i];
+    strip.id = strips[i].id;
+    strip.type = strips[i].type;
+    strip.color_order = strips[i].color_order;
+    strip.data.resize(3 * strips[i].pixels);
+    size += strip.data.size();
+  }
+  published_data_.resize(size);
+}
+
+PixelSpan<Rgb> Frame::pixels(size_t index)
+{
+  auto & data = message_.strips[index].data;
+  return PixelSpan<Rgb>(reinterpret_cast<Rgb *>(data.data()), data.size() / 3);
+}
+
+PixelSpan<uint8_t> Frame::bytes(size_t index)
+{
+  auto & data = message_.strips[index].data;
+  return PixelSpan<uint8_t>(data.data(), data.size());
+}
+
+void Frame::clear()
+{
+  for (auto & strip : message_.strips) {
+    memset(strip.data.data(), 0, strip.data.size());
+  }
+}
+
+bool Frame::changed() const
+{
+  if (!has_published_ || message_.transition_ms != published_transition_ms_) {
+    return true;
+  }
+  const uint8_t * published = published_data_.data();
+  for (const auto & strip : message_.strips) {
+    if (memcmp(strip.data.data(), published, strip.data.size())) {
+      return true;
+    }
+    published += strip.data.size();
+  }
+  return false;
+}
+
+const led_strip_msgs::msg::LedStrips & Frame::stamp(uint32_t seq)
+{
+  message_.seq = seq;
+  return message_;
+}
+
+void Frame::published()
+{
+  uint8_t * published = published_data_.data();
+  for (const auto & strip : message_.strips) {
+    memcpy(published, strip.data.data(), strip.data.size());
+    published += strip.data.size();
+  }
+  published_transition_ms_ = message_.transition_ms;
+  has_published_ = true;
+}
+
+}  // namespace led_strip_client
@@ -0,0 +1,90 @@
+#include "led_strip_client/frame_publisher.hpp"
+
+namespace led_strip_client
+{
+
+FramePublisher::FramePublisher(
+  rclcpp::Node & node, const std::string & topic, const rclcpp::QoS & qos,
+  const PublisherOptions & options)
+: options_(options),
+  period_(Clock::duration::zero())
+{
+  publisher_ = node.create_publisher<led_strip_msgs::msg::LedStrips>(topic, qos);
+  if (options_.max_rate > 0) {
+    period_ = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / options_.max_rate));
+    if (options_.coalesce) {
+      // Created once, then only reset: holding a frame back does not allocate
+      timer_ = node.create_wall_timer(period_, [this]() {on_timer();});
+      timer_->cancel();
+    }
+  }
+}
+
+PublishResult FramePublisher::publish(Frame & frame)
+{
+  if (options_.skip_unchanged && !frame.changed()) {
+    if (pending_ == &frame) {
+      // Back to what was published
+      pending_ = nullptr;
+    }
+    stats_.unchanged++;
+    return PublishResult::unchanged;
+  }
+  const auto now = Clock::now();
+  if (seq_ && now - last_published_at_ < period_) {
+    if (!options_.coalesce) {
+      stats_.dropped++;
+      return PublishResult::dropped;
+    }
+    if (pending_) {
+      // The pending frame is replaced by this one
+      stats_.coalesced++;
+    }
+    pending_ = &frame;
+    if (timer_->is_canceled()) {
+      timer_->reset();
+    }
+    return PublishResult::coalesced;
+  }
+  if (pending_ && pending_ != &frame) {
+    stats_.coalesced++;
+  }
+  pending_ = nullptr;
+  publish_now(frame, now);
+  return PublishResult::published;
+}
+
+void FramePublisher::publish_now(Frame & frame, Clock::time_point now)
+{
+  if (++seq_ == 0) {
+    // seq 0 disables the sequence check of the driver
+    seq_ = 1;
+  }
+  publisher_->publish(frame.stamp(seq_));
+  frame.published();
+  last_published_at_ = now;
+  stats_.published++;
+}
+
+void FramePublisher::on_timer()
+{
+  if (!pending_) {
+    timer_->cancel();
+    return;
+  }
+  const auto now = Clock::now();
+  if (now - last_published_at_ < period_) {
+    return;
+  }
+  Frame & frame = *pending_;
+  pending_ = nullptr;
+  if (options_.skip_unchanged && !frame.changed()) {
+    stats_.unchanged++;
+  } else {
+    publish_now(frame, now);
+  }
+  timer_->cancel();
+}
+
+}  // namespace led_strip_client
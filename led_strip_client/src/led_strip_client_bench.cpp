@@ -0,0 +1,172 @@
+// Measures the cost of publishing LedStrips per frame, and the heap
+// allocations per frame (glibc malloc, counted in this process: rclcpp, the
+// rmw and the DDS implementation included):
+// - hand-built: a new LedStrips per frame, as applications used to do;
+// - frame: a led_strip_client::Frame rendered in place;
+// - frame, static: the same when only every 4th frame changes;
+// - rate limited: frames rendered as fast as possible, published at `rate`.
+//
+// ros2 run led_strip_client led_strip_client_bench --ros-args
+//   -p strips:=8 -p pixels:=300 -p frames:=10000 -p rate:=60.0
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "led_strip_msgs/msg/led_strips.hpp"
+#include "led_strip_client/frame.hpp"
+#include "led_strip_client/frame_publisher.hpp"
+
+static std::atomic<size_t> allocations{0};
+
+extern "C" {
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t number, size_t size);
+extern void * __libc_realloc(void * pointer, size_t size);
+
+void * malloc(size_t size)
+{
+  allocations++;
+  return __libc_malloc(size);
+}
+
+void * calloc(size_t number, size_t size)
+{
+  allocations++;
+  return __libc_calloc(number, size);
+}
+
+void * realloc(void * pointer, size_t size)
+{
+  allocations++;
+  return __libc_realloc(pointer, size);
+}
+}
+
+using Clock = std::chrono::steady_clock;
+using led_strip_client::Rgb;
+
+// A dot chasing over a dim background
+static void render(Rgb * pixels, size_t size, size_t strip, size_t frame)
+{
+  for (size_t i = 0; i < size; i++) {
+    pixels[i] = {0, 0, 8};
+  }
+  pixels[(frame + 7 * strip) % size] = {255, 255, 255};
+}
+
+static void report(const char * name, size_t frames, Clock::duration duration, size_t allocated)
+{
+  const double s = std::chrono::duration<double>(duration).count();
+  printf(
+    "%-18s%.2f us/frame, %.0f fps, %.2f allocations/frame\n", name,
+    1e6 * s / frames, frames / s, static_cast<double>(allocated) / frames);
+}
+
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+  auto node = std::make_shared<rclcpp::Node>("led_strip_client_bench");
+  const auto strips = static_cast<size_t>(node->declare_parameter<int>("strips", 8));
+  const auto pixels = static_cast<size_t>(node->declare_parameter<int>("pixels", 300));
+  const auto frames = static_cast<size_t>(node->declare_parameter<int>("frames", 10000));
+  const auto rate = node->declare_parameter<double>("rate", 60.0);
+  const rclcpp::QoS qos = rclcpp::QoS(1).best_effort();
+
+  printf("frames            %zu of %zu x %zu pixels\n", frames, strips, pixels);
+
+  {
+    auto publisher = node->create_publisher<led_strip_msgs::msg::LedStrips>("led_strips", qos);
+    std::vector<Rgb> canvas(pixels);
+    const size_t allocated = allocations;
+    const auto start = Clock::now();
+    for (size_t frame = 0; frame < frames; frame++) {
+      led_strip_msgs::msg::LedStrips msg;
+      for (size_t i = 0; i < strips; i++) {
+        render(canvas.data(), pixels, i, frame);
+        led_strip_msgs::msg::LedStrip strip;
+        strip.id = i;
+        strip.type = led_strip_msgs::msg::LedStrip::WS2812;
+        const uint8_t * data = reinterpret_cast<const uint8_t *>(canvas.data());
+        strip.data.assign(data, data + 3 * pixels);
+        msg.strips.push_back(strip);
+      }
+      msg.seq = frame + 1;
+      publisher->publish(msg);
+    }
+    report("hand-built", frames, Clock::now() - start, allocations - allocated);
+  }
+
+  std::vector<led_strip_client::StripConfig> config;
+  for (size_t i = 0; i < strips; i++) {
+    config.push_back({static_cast<uint8_t>(i), static_cast<uint16_t>(pixels)});
+  }
+
+  {
+    led_strip_client::Frame frame(config);
+    led_strip_client::PublisherOptions options;
+    options.skip_unchanged = false;
+    led_strip_client::FramePublisher publisher(*node, "led_strips", qos, options);
+    const size_t allocated = allocations;
+    const auto start = Clock::now();
+    for (size_t n = 0; n < frames; n++) {
+      for (size_t i = 0; i < strips; i++) {
+        const auto span = frame.pixels(i);
+        render(span.data(), span.size(), i, n);
+      }
+      publisher.publish(frame);
+    }
+    report("frame", frames, Clock::now() - start, allocations - allocated);
+  }
+
+  {
+    led_strip_client::Frame frame(config);
+    led_strip_client::FramePublisher publisher(*node, "led_strips", qos);
+    const size_t allocated = allocations;
+    const auto start = Clock::now();
+    for (size_t n = 0; n < frames; n++) {
+      for (size_t i = 0; i < strips; i++) {
+        const auto span = frame.pixels(i);
+        render(span.data(), span.size(), i, n / 4);
+      }
+      publisher.publish(frame);
+    }
+    report("frame, static", frames, Clock::now() - start, allocations - allocated);
+    printf(
+      "                  %u published, %u unchanged\n",
+      publisher.stats().published, publisher.stats().unchanged);
+  }
+
+  {
+    led_strip_client::Frame frame(config);
+    led_strip_client::PublisherOptions options;
+    options.max_rate = rate;
+    led_strip_client::FramePublisher publisher(*node, "led_strips", qos, options);
+    rclcpp::executors::SingleThreadedExecutor executor;
+    executor.add_node(node);
+    const size_t allocated = allocations;
+    const auto start = Clock::now();
+    size_t n = 0;
+    for (; Clock::now() - start < std::chrono::seconds(1); n++) {
+      for (size_t i = 0; i < strips; i++) {
+        const auto span = frame.pixels(i);
+        render(span.data(), span.size(), i, n);
+      }
+      publisher.publish(frame);
+      executor.spin_some(std::chrono::nanoseconds(0));
+    }
+    const auto duration = Clock::now() - start;
+    report("rate limited", n, duration, allocations - allocated);
+    printf(
+      "                  %u published (%.1f fps), %u coalesced\n",
+      publisher.stats().published,
+      publisher.stats().published / std::chrono::duration<double>(duration).count(),
+      publisher.stats().coalesced);
+  }
+
+  rclcpp::shutdown();
+  return 0;
+}
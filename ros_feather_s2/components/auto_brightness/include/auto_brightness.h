@@ -0,0 +1,50 @@
+// Brightness following the ambient light: the sensor output is low-pass
+// filtered in the log domain, mapped to a level in [0, 1] through a curve
+// and the level changes only past a hysteresis.
+// The level is scaled by the application between its brightness limits.
+
+#ifndef AUTO_BRIGHTNESS_H
+#define AUTO_BRIGHTNESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+  // sensor outputs mapped to the level 0 and to the level 1
+  uint32_t dark_mv;
+  uint32_t bright_mv;
+  // level = x^gamma, x in [0, 1] being linear in log(output)
+  float gamma;
+  float time_constant_s;
+  // minimal change of the level, in [0, 1]
+  float hysteresis;
+} auto_brightness_config_t;
+
+// The configuration selected in menuconfig (with sdkconfig.h)
+#define AUTO_BRIGHTNESS_CONFIG_FROM_KCONFIG() {                                   \
+  .dark_mv = CONFIG_AUTO_BRIGHTNESS_DARK_MV,                                      \
+  .bright_mv = CONFIG_AUTO_BRIGHTNESS_BRIGHT_MV,                                  \
+  .gamma = CONFIG_AUTO_BRIGHTNESS_GAMMA_PERCENT / 100.0f,                         \
+  .time_constant_s = CONFIG_AUTO_BRIGHTNESS_TIME_CONSTANT_MS / 1000.0f,           \
+  .hysteresis = CONFIG_AUTO_BRIGHTNESS_HYSTERESIS_PERCENT / 100.0f,               \
+}
+
+typedef struct {
+  auto_brightness_config_t config;
+  float filtered;
+  float level;
+  bool started;
+} auto_brightness_t;
+
+void auto_brightness_init(auto_brightness_t *auto_brightness, const auto_brightness_config_t *config);
+
+// Filters a sample taken `dt_s` after the previous one.
+// Returns true if the level changed (always on the first sample).
+bool auto_brightness_update(auto_brightness_t *auto_brightness, uint32_t sample_mv, float dt_s);
+
+// The level scaled between `min` (in the dark) and `max` (in bright light)
+static inline float auto_brightness_scale(const auto_brightness_t *auto_brightness, float min, float max) {
+  return min + (max - min) * auto_brightness->level;
+}
+
+#endif /* end of include guard: AUTO_BRIGHTNESS_H */
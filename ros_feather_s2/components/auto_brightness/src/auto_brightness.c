@@ -0,0 +1,51 @@
+#include <math.h>
+
+#include "auto_brightness.h"
+
+void auto_brightness_init(auto_brightness_t *auto_brightness, const auto_brightness_config_t *config) {
+  auto_brightness->config = *config;
+  if (auto_brightness->config.dark_mv < 1) {
+    auto_brightness->config.dark_mv = 1;
+  }
+  if (auto_brightness->config.bright_mv <= auto_brightness->config.dark_mv) {
+    auto_brightness->config.bright_mv = auto_brightness->config.dark_mv + 1;
+  }
+  auto_brightness->filtered = 0;
+  auto_brightness->level = 0;
+  auto_brightness->started = false;
+}
+
+static float curve(const auto_brightness_config_t *config, float log_mv) {
+  const float log_dark = logf(config->dark_mv);
+  const float log_bright = logf(config->bright_mv);
+  float x = (log_mv - log_dark) / (log_bright - log_dark);
+  if (x <= 0) {
+    return 0;
+  }
+  if (x >= 1) {
+    return 1;
+  }
+  return powf(x, config->gamma);
+}
+
+bool auto_brightness_update(auto_brightness_t *auto_brightness, uint32_t sample_mv, float dt_s) {
+  const auto_brightness_config_t *config = &auto_brightness->config;
+  // The eye perceives light logarithmically: filter and map log(output)
+  const float log_mv = logf(sample_mv ? sample_mv : 1);
+  if (!auto_brightness->started) {
+    auto_brightness->filtered = log_mv;
+    auto_brightness->level = curve(config, log_mv);
+    auto_brightness->started = true;
+    return true;
+  }
+  const float alpha = dt_s > 0 ? dt_s / (config->time_constant_s + dt_s) : 1;
+  auto_brightness->filtered += alpha * (log_mv - auto_brightness->filtered);
+  const float target = curve(config, auto_brightness->filtered);
+  // The limits are always reached, whatever the hysteresis
+  if (fabsf(target - auto_brightness->level) > config->hysteresis ||
+      ((target == 0 || target == 1) && target != auto_brightness->level)) {
+    auto_brightness->level = target;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,15 @@
+// Timestamps of the boot phases, to measure the time to the first frame.
+//
+// The phases are logged together once the first frame is shown:
+//   I (1234) BOOT: app_main 312 ms, peripherals 415 ms (+103), ...
+
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+// Records the time since boot of `phase`, a string literal.
+// Can be called from any task.
+void boot_trace_mark(const char *phase);
+// Records the last phase and logs the trace, only the first time.
+void boot_trace_done(const char *phase);
+
+#endif /* end of include guard: BOOT_TRACE_H */
@@ -0,0 +1,58 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "boot_trace.h"
+
+#define MAX_PHASES 12
+
+static const char* TAG = "BOOT";
+
+typedef struct {
+  const char *name;
+  int64_t time_us;
+} phase_t;
+
+static phase_t phases[MAX_PHASES];
+static size_t number_of_phases = 0;
+static bool done = false;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+void boot_trace_mark(const char *phase) {
+  const int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&lock);
+  if (!done && number_of_phases < MAX_PHASES) {
+    phases[number_of_phases].name = phase;
+    phases[number_of_phases].time_us = now;
+    number_of_phases++;
+  }
+  portEXIT_CRITICAL(&lock);
+}
+
+void boot_trace_done(const char *phase) {
+  if (done) {
+    return;
+  }
+  boot_trace_mark(phase);
+  portENTER_CRITICAL(&lock);
+  done = true;
+  portEXIT_CRITICAL(&lock);
+
+  char line[32 * MAX_PHASES];
+  size_t size = 0;
+  for (size_t i = 0; i < number_of_phases && size < sizeof(line); i++) {
+    const int64_t ms = phases[i].time_us / 1000;
+    if (i == 0) {
+      size += snprintf(line + size, sizeof(line) - size, "%s %lld ms", phases[i].name, ms);
+    } else {
+      size += snprintf(line + size, sizeof(line) - size, ", %s %lld ms (+%lld)", phases[i].name, ms,
+                       ms - phases[i - 1].time_us / 1000);
+    }
+  }
+  ESP_LOGI(TAG, "%s", line);
+}
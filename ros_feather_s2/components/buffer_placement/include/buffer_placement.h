@@ -0,0 +1,29 @@
+// Where the buffers go:
+// - bulk storage (message data, frames, pixels), touched by the CPU only:
+//   the PSRAM with BUFFER_PLACEMENT_PSRAM, the internal RAM otherwise;
+// - DMA buffers: in the internal RAM, filled by the drivers from the bulk storage
+//   before a transfer.
+
+#ifndef BUFFER_PLACEMENT_H
+#define BUFFER_PLACEMENT_H
+
+#include <stddef.h>
+
+#include "sdkconfig.h"
+#include "esp_attr.h"
+
+#ifdef CONFIG_BUFFER_PLACEMENT_PSRAM
+// For static bulk buffers, zeroed at boot like .bss
+#define BULK_ATTR EXT_RAM_ATTR
+#else
+#define BULK_ATTR
+#endif
+
+// Zeroed bulk storage, in the internal RAM if the PSRAM is full. Free with free.
+void *bulk_calloc(size_t number, size_t size);
+// Zeroed DMA capable internal RAM. Free with free.
+void *dma_calloc(size_t size);
+// Logs the throughput of the copies and byte loops between internal RAM and PSRAM.
+void buffer_placement_bench(void);
+
+#endif /* end of include guard: BUFFER_PLACEMENT_H */
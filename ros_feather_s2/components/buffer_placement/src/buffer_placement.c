@@ -0,0 +1,84 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "buffer_placement.h"
+
+static const char* TAG = "BUFFERS";
+
+void *bulk_calloc(size_t number, size_t size) {
+#ifdef CONFIG_BUFFER_PLACEMENT_PSRAM
+  void *buffer = heap_caps_calloc(number, size, MALLOC_CAP_SPIRAM);
+  if (buffer) {
+    return buffer;
+  }
+  ESP_LOGW(TAG, "PSRAM full: %u bytes in internal RAM", number * size);
+#endif
+  return heap_caps_calloc(number, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+void *dma_calloc(size_t size) {
+  return heap_caps_calloc(1, size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+}
+
+// Larger than the data cache, not to measure the cache instead of the PSRAM
+#define BENCH_SIZE (32 * 1024)
+#define BENCH_REPEAT 16
+// The LED links, in bytes per second
+#define UART_LINK_RATE (2000000 / 10)
+#define WS2812_PIXEL_RATE (800000 / 8)
+
+typedef enum {
+  COPY,
+  // A read-modify-write per byte, as the encoders do
+  BYTE_LOOP
+} bench_kind_t;
+
+static float bench(bench_kind_t kind, uint8_t *destination, const uint8_t *source) {
+  const int64_t start = esp_timer_get_time();
+  for (size_t n = 0; n < BENCH_REPEAT; n++) {
+    if (kind == COPY) {
+      memcpy(destination, source, BENCH_SIZE);
+    } else {
+      for (size_t i = 0; i < BENCH_SIZE; i++) {
+        destination[i] = (source[i] * 13) >> 4;
+      }
+    }
+  }
+  const int64_t duration_us = esp_timer_get_time() - start;
+  // MB/s
+  return (float) BENCH_SIZE * BENCH_REPEAT / (duration_us ? duration_us : 1);
+}
+
+static void bench_pair(const char *name, uint8_t *destination, const uint8_t *source) {
+  const float copy = bench(COPY, destination, source);
+  const float loop = bench(BYTE_LOOP, destination, source);
+  ESP_LOGI(TAG, "%-18s copy %6.1f MB/s, byte loop %5.1f MB/s (%4.0fx UART link, %4.0fx WS2812)",
+           name, copy, loop, loop * 1e6f / UART_LINK_RATE, loop * 1e6f / WS2812_PIXEL_RATE);
+}
+
+void buffer_placement_bench(void) {
+  uint8_t *internal[2] = {
+    heap_caps_malloc(BENCH_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+    heap_caps_malloc(BENCH_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+  };
+  uint8_t *external = heap_caps_malloc(BENCH_SIZE, MALLOC_CAP_SPIRAM);
+  if (!internal[0] || !internal[1]) {
+    ESP_LOGW(TAG, "Not enough internal RAM for the bench");
+  } else {
+    memset(internal[0], 0x5A, BENCH_SIZE);
+    bench_pair("internal->internal", internal[1], internal[0]);
+    if (external) {
+      bench_pair("internal->PSRAM", external, internal[0]);
+      bench_pair("PSRAM->internal", internal[1], external);
+    } else {
+      ESP_LOGI(TAG, "No PSRAM");
+    }
+  }
+  free(internal[0]);
+  free(internal[1]);
+  free(external);
+}
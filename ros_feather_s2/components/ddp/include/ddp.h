@@ -0,0 +1,40 @@
+// Minimal receiver for the Distributed Display Protocol (DDP)
+// http://www.3waylabs.com/ddp/
+//
+// Pixel data pushed over plain UDP, without the XRCE-DDS serialization.
+
+#ifndef DDP_H
+#define DDP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define DDP_PORT 4048
+
+// Destination ids
+#define DDP_ID_DISPLAY 1
+#define DDP_ID_ALL 255
+
+// Called for every data packet addressed to `destination`.
+// `offset` is the byte offset of `data` in the destination buffer.
+typedef void (*ddp_data_callback_t)(uint8_t destination, uint32_t offset,
+                                    const uint8_t *data, size_t size, void *arg);
+// Called when a packet asks to display the data received so far.
+typedef void (*ddp_push_callback_t)(uint8_t destination, void *arg);
+
+typedef struct {
+  uint32_t packets;
+  uint32_t invalid_packets;
+  uint32_t pushes;
+  uint32_t bytes;
+} ddp_stats_t;
+
+// Starts a task that listens for DDP packets on `port`.
+// The callbacks are called from that task.
+esp_err_t ddp_start(uint16_t port, ddp_data_callback_t data_callback,
+                    ddp_push_callback_t push_callback, void *arg);
+void ddp_get_stats(ddp_stats_t *stats);
+
+#endif /* end of include guard: DDP_H */
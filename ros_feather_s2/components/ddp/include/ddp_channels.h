@@ -0,0 +1,45 @@
+// Frames of DDP data, per channel: destination DDP_ID_DISPLAY + i is channel i.
+//
+// The data of a frame is written in place, and its size is only known at the
+// push: the size of a channel is the end of the data received for it since the
+// previous push, so that a shorter frame does not keep the tail of a longer one.
+// Nothing here locks: the caller serializes the calls with the readers of the
+// buffers.
+
+#ifndef DDP_CHANNELS_H
+#define DDP_CHANNELS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Channel masks are 16 bits
+#define DDP_CHANNELS_MAX 16
+
+typedef struct {
+  // number_of_channels buffers of buffer_size bytes
+  uint8_t *buffers;
+  size_t number_of_channels;
+  size_t buffer_size;
+  // of the last pushed frame
+  size_t size[DDP_CHANNELS_MAX];
+  // of the frame being received
+  size_t received_size[DDP_CHANNELS_MAX];
+  uint16_t received_mask;
+} ddp_channels_t;
+
+void ddp_channels_init(ddp_channels_t *channels, uint8_t *buffers, size_t number_of_channels,
+                       size_t buffer_size);
+// Copies the data of a packet, clipped to the buffer. Returns false if it is
+// not for a channel.
+bool ddp_channels_write(ddp_channels_t *channels, uint8_t destination, uint32_t offset,
+                        const uint8_t *data, size_t size);
+// Ends the frame. Returns the mask of the channels that received data since the
+// previous push.
+uint16_t ddp_channels_push(ddp_channels_t *channels);
+// Data of the last pushed frame of a channel (and of the frame being received).
+static inline const uint8_t *ddp_channels_data(const ddp_channels_t *channels, size_t index) {
+  return channels->buffers + index * channels->buffer_size;
+}
+
+#endif /* end of include guard: DDP_CHANNELS_H */
@@ -0,0 +1,130 @@
+#include <errno.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+
+#include "lwip/sockets.h"
+
+#include "ddp.h"
+
+#define DDP_HEADER_SIZE 10
+#define DDP_TIMECODE_SIZE 4
+// 480 RGB pixels per packet, as suggested by the protocol
+#define DDP_MAX_DATA_SIZE 1440
+
+#define DDP_FLAGS_VERSION_MASK 0xC0
+#define DDP_FLAGS_VERSION_1 0x40
+#define DDP_FLAGS_TIMECODE 0x10
+#define DDP_FLAGS_STORAGE 0x08
+#define DDP_FLAGS_REPLY 0x04
+#define DDP_FLAGS_QUERY 0x02
+#define DDP_FLAGS_PUSH 0x01
+
+#define DDP_TASK_STACK 4096
+#define DDP_TASK_PRIO 5
+
+static const char* TAG = "DDP";
+
+static int sock = -1;
+static ddp_data_callback_t data_callback;
+static ddp_push_callback_t push_callback;
+static void *callback_arg;
+static ddp_stats_t stats;
+static uint8_t packet[DDP_HEADER_SIZE + DDP_TIMECODE_SIZE + DDP_MAX_DATA_SIZE];
+
+static inline uint32_t read_be32(const uint8_t *buffer) {
+  return ((uint32_t) buffer[0] << 24) | ((uint32_t) buffer[1] << 16) |
+         ((uint32_t) buffer[2] << 8) | buffer[3];
+}
+
+static inline uint16_t read_be16(const uint8_t *buffer) {
+  return ((uint16_t) buffer[0] << 8) | buffer[1];
+}
+
+static void handle_packet(const uint8_t *buffer, size_t size) {
+  if (size < DDP_HEADER_SIZE) {
+    stats.invalid_packets++;
+    return;
+  }
+  const uint8_t flags = buffer[0];
+  if ((flags & DDP_FLAGS_VERSION_MASK) != DDP_FLAGS_VERSION_1) {
+    stats.invalid_packets++;
+    return;
+  }
+  // We don't answer queries nor store configurations
+  if (flags & (DDP_FLAGS_QUERY | DDP_FLAGS_REPLY | DDP_FLAGS_STORAGE)) {
+    return;
+  }
+  const uint8_t destination = buffer[3];
+  const uint32_t offset = read_be32(buffer + 4);
+  const uint16_t length = read_be16(buffer + 8);
+  size_t header_size = DDP_HEADER_SIZE;
+  if (flags & DDP_FLAGS_TIMECODE) {
+    header_size += DDP_TIMECODE_SIZE;
+  }
+  if (size < header_size + length) {
+    stats.invalid_packets++;
+    return;
+  }
+  stats.packets++;
+  if (length) {
+    stats.bytes += length;
+    data_callback(destination, offset, buffer + header_size, length, callback_arg);
+  }
+  if (flags & DDP_FLAGS_PUSH) {
+    stats.pushes++;
+    push_callback(destination, callback_arg);
+  }
+}
+
+static void ddp_task(void * arg) {
+  while (1) {
+    int size = recv(sock, packet, sizeof(packet), 0);
+    if (size < 0) {
+      ESP_LOGE(TAG, "recv failed: errno %d", errno);
+      vTaskDelay(100 / portTICK_PERIOD_MS);
+      continue;
+    }
+    handle_packet(packet, size);
+  }
+}
+
+esp_err_t ddp_start(uint16_t port, ddp_data_callback_t _data_callback,
+                    ddp_push_callback_t _push_callback, void *arg) {
+  ESP_LOGI(TAG, "Initializing");
+  data_callback = _data_callback;
+  push_callback = _push_callback;
+  callback_arg = arg;
+  memset(&stats, 0, sizeof(stats));
+
+  sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+  if (sock < 0) {
+    ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+    return ESP_FAIL;
+  }
+  struct sockaddr_in address = {
+    .sin_family = AF_INET,
+    .sin_port = htons(port),
+    .sin_addr.s_addr = htonl(INADDR_ANY)
+  };
+  if (bind(sock, (struct sockaddr *) &address, sizeof(address)) < 0) {
+    ESP_LOGE(TAG, "Unable to bind port %d: errno %d", port, errno);
+    close(sock);
+    sock = -1;
+    return ESP_FAIL;
+  }
+  if (xTaskCreate(ddp_task, "ddp_task", DDP_TASK_STACK, NULL, DDP_TASK_PRIO, NULL) != pdPASS) {
+    close(sock);
+    sock = -1;
+    return ESP_ERR_NO_MEM;
+  }
+  ESP_LOGI(TAG, "Listening on UDP port %d", port);
+  return ESP_OK;
+}
+
+void ddp_get_stats(ddp_stats_t *_stats) {
+  *_stats = stats;
+}
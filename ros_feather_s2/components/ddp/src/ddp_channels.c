@@ -0,0 +1,43 @@
+#include <string.h>
+
+#include "ddp.h"
+#include "ddp_channels.h"
+
+void ddp_channels_init(ddp_channels_t *channels, uint8_t *buffers, size_t number_of_channels,
+                       size_t buffer_size) {
+  memset(channels, 0, sizeof(*channels));
+  channels->buffers = buffers;
+  channels->number_of_channels = number_of_channels < DDP_CHANNELS_MAX ? number_of_channels : DDP_CHANNELS_MAX;
+  channels->buffer_size = buffer_size;
+}
+
+bool ddp_channels_write(ddp_channels_t *channels, uint8_t destination, uint32_t offset,
+                        const uint8_t *data, size_t size) {
+  if (destination < DDP_ID_DISPLAY || destination >= DDP_ID_DISPLAY + channels->number_of_channels) {
+    return false;
+  }
+  const size_t index = destination - DDP_ID_DISPLAY;
+  if (offset >= channels->buffer_size) {
+    return true;
+  }
+  if (offset + size > channels->buffer_size) {
+    size = channels->buffer_size - offset;
+  }
+  memcpy(channels->buffers + index * channels->buffer_size + offset, data, size);
+  if (!(channels->received_mask & (1 << index)) || offset + size > channels->received_size[index]) {
+    channels->received_size[index] = offset + size;
+  }
+  channels->received_mask |= (1 << index);
+  return true;
+}
+
+uint16_t ddp_channels_push(ddp_channels_t *channels) {
+  const uint16_t mask = channels->received_mask;
+  for (size_t i = 0; i < channels->number_of_channels; i++) {
+    if (mask & (1 << i)) {
+      channels->size[i] = channels->received_size[i];
+    }
+  }
+  channels->received_mask = 0;
+  return mask;
+}
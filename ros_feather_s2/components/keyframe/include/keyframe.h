@@ -0,0 +1,38 @@
+// Transitions between keyframes, blended on the device at the output frame rate.
+//
+// A keyframe is shown `duration` after its reception: meanwhile the output is a
+// blend of the frame shown at the reception (`from`) and the keyframe (`to`).
+// Weights are fixed-point, from 0 (from) to KEYFRAME_WEIGHT_ONE (to).
+
+#ifndef KEYFRAME_H
+#define KEYFRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define KEYFRAME_WEIGHT_ONE 256
+
+typedef enum {
+  KEYFRAME_LINEAR,
+  // smoothstep, slow at the start and at the end
+  KEYFRAME_EASE_IN_OUT
+} keyframe_easing_t;
+
+typedef struct {
+  int64_t start_us;
+  int64_t duration_us;
+  keyframe_easing_t easing;
+  bool active;
+} keyframe_transition_t;
+
+// dst = from + (to - from) * weight / KEYFRAME_WEIGHT_ONE, for every byte.
+// dst may be from or to.
+void keyframe_blend(uint8_t *dst, const uint8_t *from, const uint8_t *to, size_t size, uint16_t weight);
+
+void keyframe_start(keyframe_transition_t *transition, int64_t now_us, uint32_t duration_ms,
+                    keyframe_easing_t easing);
+// Weight at `now_us`. The transition is no longer active once it returns KEYFRAME_WEIGHT_ONE.
+uint16_t keyframe_weight(keyframe_transition_t *transition, int64_t now_us);
+
+#endif /* end of include guard: KEYFRAME_H */
@@ -0,0 +1,55 @@
+#include <string.h>
+
+#include "keyframe.h"
+
+// Blends two bytes per 32-bit multiplication: the red/blue and green/alpha
+// lanes of a word are 16 bits wide, enough for 255 * KEYFRAME_WEIGHT_ONE.
+static inline uint32_t blend_word(uint32_t from, uint32_t to, uint32_t weight) {
+  const uint32_t inverse = KEYFRAME_WEIGHT_ONE - weight;
+  const uint32_t low = ((from & 0x00FF00FF) * inverse + (to & 0x00FF00FF) * weight) >> 8;
+  const uint32_t high = ((from >> 8) & 0x00FF00FF) * inverse + ((to >> 8) & 0x00FF00FF) * weight;
+  return (low & 0x00FF00FF) | (high & 0xFF00FF00);
+}
+
+void keyframe_blend(uint8_t *dst, const uint8_t *from, const uint8_t *to, size_t size, uint16_t weight) {
+  if (weight >= KEYFRAME_WEIGHT_ONE) {
+    memmove(dst, to, size);
+    return;
+  }
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    uint32_t a, b;
+    memcpy(&a, from + i, 4);
+    memcpy(&b, to + i, 4);
+    const uint32_t c = blend_word(a, b, weight);
+    memcpy(dst + i, &c, 4);
+  }
+  for (; i < size; i++) {
+    dst[i] = (from[i] * (KEYFRAME_WEIGHT_ONE - weight) + to[i] * weight) >> 8;
+  }
+}
+
+void keyframe_start(keyframe_transition_t *transition, int64_t now_us, uint32_t duration_ms,
+                    keyframe_easing_t easing) {
+  transition->start_us = now_us;
+  transition->duration_us = 1000LL * duration_ms;
+  transition->easing = easing;
+  transition->active = true;
+}
+
+uint16_t keyframe_weight(keyframe_transition_t *transition, int64_t now_us) {
+  const int64_t elapsed_us = now_us - transition->start_us;
+  if (!transition->active || elapsed_us >= transition->duration_us) {
+    transition->active = false;
+    return KEYFRAME_WEIGHT_ONE;
+  }
+  if (elapsed_us <= 0) {
+    return 0;
+  }
+  const uint32_t t = (uint32_t) (elapsed_us * KEYFRAME_WEIGHT_ONE / transition->duration_us);
+  if (transition->easing == KEYFRAME_EASE_IN_OUT) {
+    // 3 t^2 - 2 t^3
+    return (t * t * (3 * KEYFRAME_WEIGHT_ONE - 2 * t)) >> 16;
+  }
+  return t;
+}
@@ -0,0 +1,67 @@
+// Layers composited on the device, so that several publishers can each send
+// their own region of the same strip, with a priority, a per-pixel alpha and
+// a timeout.
+//
+// A stack holds the layers of one strip. A layer covers the region it was last
+// set to, and is transparent outside. The output is a base (what the other
+// sources of the strip show, black past its end) covered by the visible layers
+// from the lowest priority to the highest (by index on equal priorities), and
+// ends with the base or with the last region, whichever is longer. It only has
+// to be composited again when the base changes or the stack is dirty.
+
+#ifndef LAYERS_H
+#define LAYERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LAYERS_ALPHA_OPAQUE 255
+// Layers of a stack
+#define LAYERS_MAX 16
+
+typedef struct {
+  // 3 bytes per pixel of the strip
+  uint8_t *rgb;
+  // 1 byte per pixel of the strip, 0 transparent to LAYERS_ALPHA_OPAQUE
+  uint8_t *alpha;
+  // region that was set, in pixels
+  size_t begin;
+  size_t end;
+  uint8_t priority;
+  bool visible;
+  // all the region is opaque: copied instead of blended
+  bool opaque;
+  // 0 for no timeout
+  int64_t expires_us;
+} layer_t;
+
+typedef struct {
+  layer_t *layers;
+  size_t number_of_layers;
+  // pixels of the strip
+  size_t size;
+  bool dirty;
+} layer_stack_t;
+
+// `buffers` holds 4 * size bytes per layer, at most LAYERS_MAX layers.
+void layer_stack_init(layer_stack_t *stack, layer_t *layers, size_t number_of_layers,
+                      uint8_t *buffers, size_t size);
+// Sets a layer to `count` pixels from `offset`, clipped to the strip, and shows it.
+// `alpha` may be NULL for opaque pixels.
+void layer_set(layer_stack_t *stack, size_t index, uint8_t priority, size_t offset,
+               const uint8_t *rgb, const uint8_t *alpha, size_t count, int64_t expires_us);
+void layer_hide(layer_stack_t *stack, size_t index);
+// Hides the layers that expired at `now_us`, returns true if one did.
+bool layer_stack_expire(layer_stack_t *stack, int64_t now_us);
+bool layer_stack_visible(const layer_stack_t *stack);
+// Composites the visible layers over `base_pixels` pixels of `base` into `rgb`
+// (base may be rgb), and clears dirty. Returns the number of pixels composited:
+// the longest of the base and of the last region.
+size_t layer_stack_composite(layer_stack_t *stack, const uint8_t *base, size_t base_pixels, uint8_t *rgb);
+
+// dst = dst + (src - dst) * alpha / 255, per RGB pixel, within 1 and exact at 0
+// and 255.
+void layers_blend(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, size_t pixels);
+
+#endif /* end of include guard: LAYERS_H */
@@ -0,0 +1,129 @@
+#include <string.h>
+
+#include "layers.h"
+
+void layer_stack_init(layer_stack_t *stack, layer_t *layers, size_t number_of_layers,
+                      uint8_t *buffers, size_t size) {
+  stack->layers = layers;
+  stack->number_of_layers = number_of_layers;
+  stack->size = size;
+  stack->dirty = false;
+  for (size_t i = 0; i < number_of_layers; i++) {
+    layers[i] = (layer_t) {
+      .rgb = buffers + 4 * size * i,
+      .alpha = buffers + 4 * size * i + 3 * size,
+    };
+  }
+}
+
+void layer_set(layer_stack_t *stack, size_t index, uint8_t priority, size_t offset,
+               const uint8_t *rgb, const uint8_t *alpha, size_t count, int64_t expires_us) {
+  layer_t *layer = stack->layers + index;
+  const size_t begin = offset < stack->size ? offset : stack->size;
+  const size_t end = count < stack->size - begin ? begin + count : stack->size;
+  memcpy(layer->rgb + 3 * begin, rgb, 3 * (end - begin));
+  layer->opaque = true;
+  if (alpha) {
+    memcpy(layer->alpha + begin, alpha, end - begin);
+    for (size_t i = begin; i < end && layer->opaque; i++) {
+      layer->opaque = layer->alpha[i] == LAYERS_ALPHA_OPAQUE;
+    }
+  }
+  layer->begin = begin;
+  layer->end = end;
+  layer->priority = priority;
+  layer->visible = true;
+  layer->expires_us = expires_us;
+  stack->dirty = true;
+}
+
+void layer_hide(layer_stack_t *stack, size_t index) {
+  if (stack->layers[index].visible) {
+    stack->layers[index].visible = false;
+    stack->dirty = true;
+  }
+}
+
+bool layer_stack_expire(layer_stack_t *stack, int64_t now_us) {
+  bool expired = false;
+  for (size_t i = 0; i < stack->number_of_layers; i++) {
+    layer_t *layer = stack->layers + i;
+    if (layer->visible && layer->expires_us && now_us >= layer->expires_us) {
+      layer_hide(stack, i);
+      expired = true;
+    }
+  }
+  return expired;
+}
+
+bool layer_stack_visible(const layer_stack_t *stack) {
+  for (size_t i = 0; i < stack->number_of_layers; i++) {
+    if (stack->layers[i].visible) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void layers_blend(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, size_t pixels) {
+  for (size_t i = 0; i < pixels; i++, dst += 3, src += 3) {
+    const uint32_t a = alpha[i];
+    if (!a) {
+      continue;
+    }
+    // 0..255 -> 0..256, so that 255 is the source exactly, rounded
+    const uint32_t weight = a + (a >> 7);
+    const uint32_t inverse = 256 - weight;
+    dst[0] = (dst[0] * inverse + src[0] * weight + 128) >> 8;
+    dst[1] = (dst[1] * inverse + src[1] * weight + 128) >> 8;
+    dst[2] = (dst[2] * inverse + src[2] * weight + 128) >> 8;
+  }
+}
+
+size_t layer_stack_composite(layer_stack_t *stack, const uint8_t *base, size_t base_pixels, uint8_t *rgb) {
+  // Visible layers by priority, then index (insertion sort of a few layers)
+  size_t order[LAYERS_MAX];
+  size_t number_of_visible = 0;
+  size_t length = base_pixels;
+  for (size_t i = 0; i < stack->number_of_layers; i++) {
+    const layer_t *layer = stack->layers + i;
+    if (!layer->visible || layer->begin == layer->end) {
+      continue;
+    }
+    size_t j = number_of_visible++;
+    for (; j > 0 && stack->layers[order[j - 1]].priority > layer->priority; j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+    if (layer->end > length) {
+      length = layer->end;
+    }
+  }
+  // Layers below an opaque layer covering the output are not seen
+  size_t first = 0;
+  bool covered = false;
+  for (size_t j = 0; j < number_of_visible; j++) {
+    const layer_t *layer = stack->layers + order[j];
+    if (layer->opaque && layer->begin == 0 && layer->end == length) {
+      first = j;
+      covered = true;
+    }
+  }
+  if (!covered) {
+    if (base != rgb) {
+      memcpy(rgb, base, 3 * base_pixels);
+    }
+    memset(rgb + 3 * base_pixels, 0, 3 * (length - base_pixels));
+  }
+  for (size_t j = first; j < number_of_visible; j++) {
+    const layer_t *layer = stack->layers + order[j];
+    if (layer->opaque) {
+      memcpy(rgb + 3 * layer->begin, layer->rgb + 3 * layer->begin, 3 * (layer->end - layer->begin));
+    } else {
+      layers_blend(rgb + 3 * layer->begin, layer->rgb + 3 * layer->begin, layer->alpha + layer->begin,
+                   layer->end - layer->begin);
+    }
+  }
+  stack->dirty = false;
+  return length;
+}
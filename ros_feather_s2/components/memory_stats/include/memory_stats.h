@@ -0,0 +1,42 @@
+// Stack and heap usage, to size the task stacks and the static buffers:
+// - the stack high-water mark of every task, the bytes of its stack never used;
+// - for the internal, DMA capable and external (PSRAM) heaps, the free bytes,
+//   the minimum of the free bytes since boot and the largest free block.
+//
+// Requires FREERTOS_USE_TRACE_FACILITY. Call from one task at a time.
+
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+  char name[configMAX_TASK_NAME_LEN];
+  // bytes
+  uint32_t stack_high_water_mark;
+} memory_stats_task_t;
+
+typedef struct {
+  const char *name;
+  // MALLOC_CAP_*
+  uint32_t caps;
+  uint32_t free;
+  uint32_t minimum_free;
+  uint32_t largest_free_block;
+} memory_stats_heap_t;
+
+// The heaps that exist in this configuration
+#define MEMORY_STATS_MAX_HEAPS 3
+
+// Fills up to `capacity` tasks and returns their number,
+// 0 if there are more than MEMORY_STATS_MAX_TASKS tasks.
+size_t memory_stats_get_tasks(memory_stats_task_t *tasks, size_t capacity);
+// Fills up to `capacity` heaps and returns their number.
+size_t memory_stats_get_heaps(memory_stats_heap_t *heaps, size_t capacity);
+// Logs the tasks and the heaps.
+void memory_stats_log(void);
+
+#endif /* end of include guard: MEMORY_STATS_H */
@@ -0,0 +1,76 @@
+#include <string.h>
+
+#include "sdkconfig.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "memory_stats.h"
+
+#ifdef CONFIG_MEMORY_STATS_MAX_TASKS
+#define MEMORY_STATS_MAX_TASKS CONFIG_MEMORY_STATS_MAX_TASKS
+#else
+#define MEMORY_STATS_MAX_TASKS 24
+#endif
+
+static const char* TAG = "MEM";
+
+typedef struct {
+  const char *name;
+  uint32_t caps;
+} heap_t;
+
+static const heap_t heaps[] = {
+  {"internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT},
+  {"dma", MALLOC_CAP_DMA},
+#if defined(CONFIG_ESP32S2_SPIRAM_SUPPORT) || defined(CONFIG_SPIRAM)
+  {"spiram", MALLOC_CAP_SPIRAM},
+#endif
+};
+_Static_assert(sizeof(heaps) / sizeof(heaps[0]) <= MEMORY_STATS_MAX_HEAPS, "Too many heaps");
+
+// Too large for the stack of the callers
+static TaskStatus_t task_states[MEMORY_STATS_MAX_TASKS];
+
+size_t memory_stats_get_tasks(memory_stats_task_t *tasks, size_t capacity) {
+  const UBaseType_t number_of_tasks = uxTaskGetSystemState(task_states, MEMORY_STATS_MAX_TASKS, NULL);
+  if (!number_of_tasks) {
+    ESP_LOGW(TAG, "More than %d tasks: increase MEMORY_STATS_MAX_TASKS", MEMORY_STATS_MAX_TASKS);
+  }
+  size_t i = 0;
+  for (; i < number_of_tasks && i < capacity; i++) {
+    strlcpy(tasks[i].name, task_states[i].pcTaskName, sizeof(tasks[i].name));
+    // StackType_t is a byte on Xtensa
+    tasks[i].stack_high_water_mark = task_states[i].usStackHighWaterMark * sizeof(StackType_t);
+  }
+  return i;
+}
+
+size_t memory_stats_get_heaps(memory_stats_heap_t *output, size_t capacity) {
+  size_t i = 0;
+  for (; i < sizeof(heaps) / sizeof(heaps[0]) && i < capacity; i++) {
+    output[i].name = heaps[i].name;
+    output[i].caps = heaps[i].caps;
+    output[i].free = heap_caps_get_free_size(heaps[i].caps);
+    output[i].minimum_free = heap_caps_get_minimum_free_size(heaps[i].caps);
+    output[i].largest_free_block = heap_caps_get_largest_free_block(heaps[i].caps);
+  }
+  return i;
+}
+
+void memory_stats_log(void) {
+  static memory_stats_task_t tasks[MEMORY_STATS_MAX_TASKS];
+  const size_t number_of_tasks = memory_stats_get_tasks(tasks, MEMORY_STATS_MAX_TASKS);
+  for (size_t i = 0; i < number_of_tasks; i++) {
+    ESP_LOGI(TAG, "task %-16s stack never used %6u B", tasks[i].name, tasks[i].stack_high_water_mark);
+  }
+  memory_stats_heap_t heap_stats[MEMORY_STATS_MAX_HEAPS];
+  const size_t number_of_heaps = memory_stats_get_heaps(heap_stats, MEMORY_STATS_MAX_HEAPS);
+  for (size_t i = 0; i < number_of_heaps; i++) {
+    ESP_LOGI(TAG, "heap %-8s free %7u B, min free %7u B, largest block %7u B", heap_stats[i].name,
+             heap_stats[i].free, heap_stats[i].minimum_free, heap_stats[i].largest_free_block);
+  }
+}
@@ -0,0 +1,32 @@
+// Temporal deltas of pixel buffers: the XOR of a frame with a reference
+// (usually the last keyframe), run-length encoded.
+//
+// The delta is a sequence of tokens, each starting with a control byte c:
+// - c < 0x80: c + 1 bytes unchanged from the reference;
+// - c >= 0x80: c - 0x7f bytes follow, to XOR with the reference.
+// Bytes after the last token are unchanged: an identical frame is an empty delta.
+// A NULL reference is all zeros, the delta of a keyframe is then its content.
+
+#ifndef PIXEL_DELTA_H
+#define PIXEL_DELTA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Upper bound of the size of the delta of a buffer of `size` bytes
+#define PIXEL_DELTA_MAX_SIZE(size) ((size) + ((size) + 127) / 128)
+
+// Encodes `frame` against `reference` (may be NULL), both of `size` bytes.
+// Returns the size of the delta, or 0 if it does not fit in `capacity` bytes
+// (PIXEL_DELTA_MAX_SIZE(size) always does) and the frame is not identical.
+size_t pixel_delta_encode(uint8_t *delta, size_t capacity, const uint8_t *frame,
+                          const uint8_t *reference, size_t size);
+
+// Decodes `delta` against `reference` (may be NULL, or output) into `size` bytes.
+// Returns false if the delta is malformed or longer than `size`: output is then
+// partially written.
+bool pixel_delta_decode(uint8_t *output, const uint8_t *reference, size_t size,
+                        const uint8_t *delta, size_t delta_size);
+
+#endif /* end of include guard: PIXEL_DELTA_H */
@@ -0,0 +1,119 @@
+#include <string.h>
+
+#include "pixel_delta.h"
+
+#define MAX_TOKEN_SIZE 128
+// Shorter unchanged spans are cheaper to send as XOR bytes than to split a literal
+#define MIN_UNCHANGED_RUN 3
+
+static inline void copy_reference(uint8_t *output, const uint8_t *reference, size_t size) {
+  if (!reference) {
+    memset(output, 0, size);
+  } else if (output != reference) {
+    memcpy(output, reference, size);
+  }
+}
+
+// output = reference ^ bits, one word at a time
+static inline void xor_reference(uint8_t *output, const uint8_t *reference, const uint8_t *bits,
+                                 size_t size) {
+  if (!reference) {
+    memcpy(output, bits, size);
+    return;
+  }
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    uint32_t a, b;
+    memcpy(&a, reference + i, 4);
+    memcpy(&b, bits + i, 4);
+    a ^= b;
+    memcpy(output + i, &a, 4);
+  }
+  for (; i < size; i++) {
+    output[i] = reference[i] ^ bits[i];
+  }
+}
+
+static inline uint8_t reference_at(const uint8_t *reference, size_t i) {
+  return reference ? reference[i] : 0;
+}
+
+// Length of the span of unchanged bytes starting at `i`
+static size_t unchanged_run(const uint8_t *frame, const uint8_t *reference, size_t i, size_t size) {
+  const size_t start = i;
+  while (i < size && frame[i] == reference_at(reference, i)) {
+    i++;
+  }
+  return i - start;
+}
+
+size_t pixel_delta_encode(uint8_t *delta, size_t capacity, const uint8_t *frame,
+                          const uint8_t *reference, size_t size) {
+  size_t d = 0;
+  size_t i = 0;
+  while (i < size) {
+    size_t run = unchanged_run(frame, reference, i, size);
+    if (i + run == size) {
+      // Unchanged until the end
+      break;
+    }
+    for (; run > 0;) {
+      const size_t n = run < MAX_TOKEN_SIZE ? run : MAX_TOKEN_SIZE;
+      if (d + 1 > capacity) {
+        return 0;
+      }
+      delta[d++] = (uint8_t) (n - 1);
+      run -= n;
+      i += n;
+    }
+    // XOR bytes until the next span of MIN_UNCHANGED_RUN unchanged bytes
+    size_t end = i;
+    while (end < size && end - i < MAX_TOKEN_SIZE) {
+      const size_t same = unchanged_run(frame, reference, end, size);
+      if (same >= MIN_UNCHANGED_RUN || end + same == size) {
+        break;
+      }
+      end += same ? same : 1;
+    }
+    if (end - i > MAX_TOKEN_SIZE) {
+      end = i + MAX_TOKEN_SIZE;
+    }
+    const size_t n = end - i;
+    if (d + 1 + n > capacity) {
+      return 0;
+    }
+    delta[d++] = (uint8_t) (0x7f + n);
+    for (size_t j = 0; j < n; j++) {
+      delta[d++] = frame[i + j] ^ reference_at(reference, i + j);
+    }
+    i = end;
+  }
+  return d;
+}
+
+bool pixel_delta_decode(uint8_t *output, const uint8_t *reference, size_t size,
+                        const uint8_t *delta, size_t delta_size) {
+  size_t i = 0;
+  size_t d = 0;
+  while (d < delta_size) {
+    const uint8_t control = delta[d++];
+    if (control < 0x80) {
+      const size_t n = control + 1;
+      if (i + n > size) {
+        return false;
+      }
+      copy_reference(output + i, reference ? reference + i : NULL, n);
+      i += n;
+    } else {
+      const size_t n = control - 0x7f;
+      if (i + n > size || d + n > delta_size) {
+        return false;
+      }
+      xor_reference(output + i, reference ? reference + i : NULL, delta + d, n);
+      d += n;
+      i += n;
+    }
+  }
+  copy_reference(output + i, reference ? reference + i : NULL, size - i);
+  return true;
+}
@@ -0,0 +1,64 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "scene_store_file.h"
+#include "../src/scene_store_flash.h"
+
+static const char *path = "scenes.bin";
+// As the partition of ros_led_driver
+static size_t partition_size = 0x60000;
+static uint8_t *data = NULL;
+
+void scene_store_file_configure(const char *_path, size_t size) {
+  path = _path;
+  partition_size = size;
+}
+
+esp_err_t scene_store_flash_open(const uint8_t **mapped, size_t *size) {
+  const int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || ftruncate(fd, partition_size) < 0) {
+    close(fd);
+    return ESP_FAIL;
+  }
+  data = mmap(NULL, partition_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    data = NULL;
+    return ESP_ERR_NO_MEM;
+  }
+  // New bytes read as erased flash
+  if ((size_t) st.st_size < partition_size) {
+    memset(data + st.st_size, 0xff, partition_size - st.st_size);
+  }
+  *mapped = data;
+  *size = partition_size;
+  return ESP_OK;
+}
+
+esp_err_t scene_store_flash_erase(size_t offset, size_t size) {
+  if (offset % SCENE_STORE_SECTOR_SIZE || size % SCENE_STORE_SECTOR_SIZE || offset + size > partition_size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(data + offset, 0xff, size);
+  return ESP_OK;
+}
+
+esp_err_t scene_store_flash_write(size_t offset, const void *src, size_t size) {
+  if (offset + size > partition_size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const uint8_t *bytes = src;
+  for (size_t i = 0; i < size; i++) {
+    data[offset + i] &= bytes[i];
+  }
+  return ESP_OK;
+}
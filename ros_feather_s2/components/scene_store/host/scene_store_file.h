@@ -0,0 +1,12 @@
+// Host build of scene_store: the partition is a file, mapped with mmap.
+
+#ifndef SCENE_STORE_FILE_H
+#define SCENE_STORE_FILE_H
+
+#include <stddef.h>
+
+// To call before scene_store_init. The file is created or extended
+// (as erased flash) to `size` bytes.
+void scene_store_file_configure(const char *path, size_t size);
+
+#endif /* end of include guard: SCENE_STORE_FILE_H */
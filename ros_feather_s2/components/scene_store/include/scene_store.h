@@ -0,0 +1,40 @@
+// Scenes kept on the `scenes` flash partition, in slots of fixed size
+// indexed by id. The partition is memory-mapped: a recalled scene is read in
+// place, without copy to RAM.
+//
+// The content of a scene is up to the application. The host build
+// (host/scene_store_file.c) maps a file instead of the partition.
+
+#ifndef SCENE_STORE_H
+#define SCENE_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define SCENE_STORE_PARTITION_LABEL "scenes"
+#define SCENE_STORE_SECTOR_SIZE 4096
+// Before the content of a scene
+#define SCENE_STORE_HEADER_SIZE 8
+// Flash taken by a scene of at most max_scene_size bytes: the partition holds
+// its size divided by this. For the static checks of the partition size.
+#define SCENE_STORE_SLOT_SIZE(max_scene_size) \
+  ((SCENE_STORE_HEADER_SIZE + (max_scene_size) + SCENE_STORE_SECTOR_SIZE - 1) / SCENE_STORE_SECTOR_SIZE * SCENE_STORE_SECTOR_SIZE)
+
+// Maps the partition and divides it in slots of at least max_scene_size bytes.
+esp_err_t scene_store_init(size_t max_scene_size);
+// Number of slots, the ids are 0 to the number of slots - 1
+size_t scene_store_number_of_scenes();
+
+// A scene is written with begin, any number of append and end. Begin erases
+// the previous scene with the same id: until end, there is none.
+esp_err_t scene_store_begin(uint8_t id);
+esp_err_t scene_store_append(const void *data, size_t size);
+esp_err_t scene_store_end();
+
+// Returns the mapped content of scene `id` and sets its size, NULL if there is none.
+const uint8_t *scene_store_get(uint8_t id, size_t *size);
+esp_err_t scene_store_erase(uint8_t id);
+
+#endif /* end of include guard: SCENE_STORE_H */
@@ -0,0 +1,109 @@
+#include "scene_store.h"
+#include "scene_store_flash.h"
+
+// "SCN1"
+#define SCENE_MAGIC 0x314e4353
+#define MAX_NUMBER_OF_SCENES 256
+
+// At the start of a slot. Erased flash reads 0xff: the size is written
+// after the content and the magic last, so that only complete scenes are valid.
+typedef struct {
+  uint32_t magic;
+  uint32_t size;
+} scene_header_t;
+_Static_assert(sizeof(scene_header_t) == SCENE_STORE_HEADER_SIZE, "SCENE_STORE_HEADER_SIZE");
+
+static const uint8_t *mapped = NULL;
+static size_t partition_size = 0;
+static size_t slot_size = 0;
+static size_t number_of_scenes = 0;
+// The scene being written
+static int writing_id = -1;
+static size_t written = 0;
+
+static size_t slot_offset(uint8_t id) {
+  return (size_t) id * slot_size;
+}
+
+esp_err_t scene_store_init(size_t max_scene_size) {
+  if (!mapped) {
+    esp_err_t err = scene_store_flash_open(&mapped, &partition_size);
+    if (err != ESP_OK) {
+      mapped = NULL;
+      return err;
+    }
+  }
+  slot_size = SCENE_STORE_SLOT_SIZE(max_scene_size);
+  number_of_scenes = partition_size / slot_size;
+  if (number_of_scenes > MAX_NUMBER_OF_SCENES) {
+    number_of_scenes = MAX_NUMBER_OF_SCENES;
+  }
+  return number_of_scenes ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+size_t scene_store_number_of_scenes() {
+  return number_of_scenes;
+}
+
+esp_err_t scene_store_begin(uint8_t id) {
+  if (id >= number_of_scenes) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  writing_id = -1;
+  esp_err_t err = scene_store_flash_erase(slot_offset(id), slot_size);
+  if (err != ESP_OK) {
+    return err;
+  }
+  writing_id = id;
+  written = 0;
+  return ESP_OK;
+}
+
+esp_err_t scene_store_append(const void *data, size_t size) {
+  if (writing_id < 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (written + size > slot_size - sizeof(scene_header_t)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  esp_err_t err = scene_store_flash_write(
+      slot_offset(writing_id) + sizeof(scene_header_t) + written, data, size);
+  if (err == ESP_OK) {
+    written += size;
+  }
+  return err;
+}
+
+esp_err_t scene_store_end() {
+  if (writing_id < 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  const size_t offset = slot_offset(writing_id);
+  writing_id = -1;
+  const scene_header_t header = {.magic = SCENE_MAGIC, .size = written};
+  esp_err_t err = scene_store_flash_write(offset + offsetof(scene_header_t, size), &header.size, sizeof(header.size));
+  if (err != ESP_OK) {
+    return err;
+  }
+  return scene_store_flash_write(offset, &header.magic, sizeof(header.magic));
+}
+
+const uint8_t *scene_store_get(uint8_t id, size_t *size) {
+  if (id >= number_of_scenes) {
+    return NULL;
+  }
+  const uint8_t *slot = mapped + slot_offset(id);
+  const scene_header_t *header = (const scene_header_t *) slot;
+  if (header->magic != SCENE_MAGIC || header->size > slot_size - sizeof(scene_header_t)) {
+    return NULL;
+  }
+  *size = header->size;
+  return slot + sizeof(scene_header_t);
+}
+
+esp_err_t scene_store_erase(uint8_t id) {
+  if (id >= number_of_scenes) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return scene_store_flash_erase(slot_offset(id), slot_size);
+}
@@ -0,0 +1,19 @@
+// Access to the memory backing the scenes: the flash partition on the
+// device, a file on the host.
+
+#ifndef SCENE_STORE_FLASH_H
+#define SCENE_STORE_FLASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "scene_store.h"
+
+esp_err_t scene_store_flash_open(const uint8_t **mapped, size_t *size);
+// offset and size are multiples of SCENE_STORE_SECTOR_SIZE
+esp_err_t scene_store_flash_erase(size_t offset, size_t size);
+// Like NOR flash, writing can only clear bits of erased memory
+esp_err_t scene_store_flash_write(size_t offset, const void *data, size_t size);
+
+#endif /* end of include guard: SCENE_STORE_FLASH_H */
@@ -0,0 +1,36 @@
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#include "scene_store.h"
+#include "scene_store_flash.h"
+
+static const char *TAG = "SCENE_STORE";
+
+static const esp_partition_t *partition = NULL;
+static spi_flash_mmap_handle_t mmap_handle;
+
+esp_err_t scene_store_flash_open(const uint8_t **mapped, size_t *size) {
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                       SCENE_STORE_PARTITION_LABEL);
+  if (!partition) {
+    ESP_LOGE(TAG, "No %s partition in the partition table", SCENE_STORE_PARTITION_LABEL);
+    return ESP_ERR_NOT_FOUND;
+  }
+  esp_err_t err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA,
+                                     (const void **) mapped, &mmap_handle);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Cannot map the %s partition: %s", SCENE_STORE_PARTITION_LABEL, esp_err_to_name(err));
+    return err;
+  }
+  *size = partition->size;
+  return ESP_OK;
+}
+
+esp_err_t scene_store_flash_erase(size_t offset, size_t size) {
+  return esp_partition_erase_range(partition, offset, size);
+}
+
+// The cache of the mapped range is invalidated by the flash driver.
+esp_err_t scene_store_flash_write(size_t offset, const void *data, size_t size) {
+  return esp_partition_write(partition, offset, data, size);
+}
@@ -0,0 +1,18 @@
+// Finds the micro-ROS agent over UDP, trying first the address where it was
+// found last time (kept in NVS) before falling back to multicast discovery.
+// After a power cycle, the agent is usually back within one round trip.
+
+#ifndef UROS_AGENT_CACHE_H
+#define UROS_AGENT_CACHE_H
+
+#include <rmw/init_options.h>
+#include <rmw/ret_types.h>
+
+// Sets the agent address of `rmw_options` to the cached agent if it answers,
+// otherwise to a discovered agent, which is then cached.
+// Returns RMW_RET_ERROR if no agent is found.
+rmw_ret_t uros_agent_cache_find_agent(rmw_init_options_t * rmw_options);
+// Forgets the cached address.
+void uros_agent_cache_clear();
+
+#endif /* end of include guard: UROS_AGENT_CACHE_H */
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include <rmw_uros/options.h>
+#include <uxr/client/profile/discovery/discovery.h>
+#include <uxr/client/profile/transport/ip/ip.h>
+
+#include "uros_agent_cache.h"
+
+#define NVS_NAMESPACE "uros_agent"
+#define NVS_KEY_IP "ip"
+#define NVS_KEY_PORT "port"
+// The cached agent answers quickly or not at all
+#define CACHED_AGENT_ATTEMPTS 3
+#define CACHED_AGENT_PERIOD_MS 100
+#define DISCOVERY_ATTEMPTS 1
+#define DISCOVERY_PERIOD_MS 1000
+
+static const char* TAG = "UROS_AGENT";
+
+typedef struct {
+  char ip[16];
+  uint16_t port;
+  bool found;
+} agent_address_t;
+
+static bool nvs_ready() {
+  esp_err_t err = nvs_flash_init();
+  if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+    if (nvs_flash_erase() != ESP_OK) {
+      return false;
+    }
+    err = nvs_flash_init();
+  }
+  return err == ESP_OK;
+}
+
+static bool load(agent_address_t * address) {
+  nvs_handle_t handle;
+  if (!nvs_ready() || nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+    return false;
+  }
+  size_t size = sizeof(address->ip);
+  address->found = nvs_get_str(handle, NVS_KEY_IP, address->ip, &size) == ESP_OK &&
+                   nvs_get_u16(handle, NVS_KEY_PORT, &address->port) == ESP_OK;
+  nvs_close(handle);
+  return address->found;
+}
+
+static void store(const agent_address_t * address) {
+  nvs_handle_t handle;
+  if (!nvs_ready() || nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+    ESP_LOGW(TAG, "Cannot cache the agent address");
+    return;
+  }
+  if (nvs_set_str(handle, NVS_KEY_IP, address->ip) != ESP_OK ||
+      nvs_set_u16(handle, NVS_KEY_PORT, address->port) != ESP_OK ||
+      nvs_commit(handle) != ESP_OK) {
+    ESP_LOGW(TAG, "Cannot cache the agent address");
+  }
+  nvs_close(handle);
+}
+
+void uros_agent_cache_clear() {
+  nvs_handle_t handle;
+  if (!nvs_ready() || nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+    return;
+  }
+  nvs_erase_all(handle);
+  nvs_commit(handle);
+  nvs_close(handle);
+}
+
+// Stops at the first agent that answers
+static bool on_agent_found(const TransportLocator * locator, void * args) {
+  agent_address_t * address = (agent_address_t *) args;
+  uxrIpProtocol ip_protocol;
+  address->found = uxr_locator_to_ip(locator, address->ip, sizeof(address->ip), &address->port, &ip_protocol);
+  return address->found;
+}
+
+static rmw_ret_t set_address(const agent_address_t * address, rmw_init_options_t * rmw_options) {
+  char port[6];
+  snprintf(port, sizeof(port), "%u", address->port);
+  return rmw_uros_options_set_udp_address(address->ip, port, rmw_options);
+}
+
+rmw_ret_t uros_agent_cache_find_agent(rmw_init_options_t * rmw_options) {
+  agent_address_t cached = {0};
+  if (load(&cached)) {
+    TransportLocator locator;
+    agent_address_t answer = {0};
+    if (uxr_ip_to_locator(cached.ip, cached.port, UXR_IPv4, &locator)) {
+      uxr_discovery_agents(CACHED_AGENT_ATTEMPTS, CACHED_AGENT_PERIOD_MS, on_agent_found, &answer, &locator, 1);
+    }
+    if (answer.found) {
+      return set_address(&answer, rmw_options);
+    }
+    ESP_LOGI(TAG, "No agent at %s:%u, discovering", cached.ip, cached.port);
+  }
+
+  agent_address_t discovered = {0};
+  uxr_discovery_agents_default(DISCOVERY_ATTEMPTS, DISCOVERY_PERIOD_MS, on_agent_found, &discovered);
+  if (!discovered.found) {
+    return RMW_RET_ERROR;
+  }
+  ESP_LOGI(TAG, "Agent found at %s:%u", discovered.ip, discovered.port);
+  if (!cached.found || strcmp(cached.ip, discovered.ip) || cached.port != discovered.port) {
+    store(&discovered);
+  }
+  return set_address(&discovered, rmw_options);
+}
@@ -0,0 +1,39 @@
+// Keeps the micro-ROS entities of an app across restarts of the agent: creates
+// them, pings the agent while connected, and when it is lost, destroys them and
+// tries again with an exponential backoff. The app only provides its entities.
+
+#ifndef UROS_RECONNECT_H
+#define UROS_RECONNECT_H
+
+#include <stdbool.h>
+
+#include <rcl/types.h>
+
+// Timeout of a ping, also for the check of the agent before creating the entities
+#define UROS_RECONNECT_PING_TIMEOUT_MS 100
+
+typedef enum {
+  UROS_RECONNECT_WAITING_AGENT,
+  UROS_RECONNECT_AGENT_CONNECTED,
+  UROS_RECONNECT_AGENT_DISCONNECTED
+} uros_reconnect_state_t;
+
+typedef struct {
+  // Returns false if the agent is not there or an entity fails,
+  // then destroy_entities is called before the next attempt.
+  bool (*create_entities)(void);
+  // Safe to call on partially created entities.
+  void (*destroy_entities)(void);
+  // An iteration while connected: spins the executor and sleeps when idle.
+  // Returns the result of the spin.
+  rcl_ret_t (*spin)(void);
+  // Optional, at every iteration, also while the agent is away.
+  void (*tick)(void);
+  // Optional, when entering a state, e.g. for a status LED.
+  void (*state_changed)(uros_reconnect_state_t state);
+} uros_reconnect_config_t;
+
+// Runs the state machine, from the micro-ROS task. Does not return.
+void uros_reconnect_run(const uros_reconnect_config_t *config);
+
+#endif /* end of include guard: UROS_RECONNECT_H */
@@ -0,0 +1,88 @@
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <rmw_uros/options.h>
+
+#include "boot_trace.h"
+#include "uros_reconnect.h"
+
+#define AGENT_PING_PERIOD_MS 1000
+#define AGENT_PING_ATTEMPTS 3
+#define MAX_SPIN_FAILURES 10
+#define MIN_RECONNECT_BACKOFF_MS 100
+#define MAX_RECONNECT_BACKOFF_MS 5000
+
+static const char* TAG = "UROS";
+
+static int64_t elapsed_ms(int64_t since_us) {
+  return (esp_timer_get_time() - since_us) / 1000;
+}
+
+static void enter(const uros_reconnect_config_t *config, uros_reconnect_state_t *state,
+                  uros_reconnect_state_t next) {
+  *state = next;
+  if (config->state_changed) {
+    config->state_changed(next);
+  }
+}
+
+void uros_reconnect_run(const uros_reconnect_config_t *config) {
+  uros_reconnect_state_t state;
+  uint32_t backoff_ms = MIN_RECONNECT_BACKOFF_MS;
+  int64_t lost_at_us = esp_timer_get_time();
+  int64_t last_ping_us = 0;
+  unsigned spin_failures = 0;
+  bool first_connection = true;
+
+  enter(config, &state, UROS_RECONNECT_WAITING_AGENT);
+  while (1) {
+    if (config->tick) {
+      config->tick();
+    }
+    switch (state) {
+      case UROS_RECONNECT_WAITING_AGENT:
+        if (config->create_entities()) {
+          boot_trace_mark("entities");
+          ESP_LOGI(TAG, "%s agent in %lld ms", first_connection ? "Connected to" : "Reconnected to",
+                   elapsed_ms(lost_at_us));
+          first_connection = false;
+          backoff_ms = MIN_RECONNECT_BACKOFF_MS;
+          spin_failures = 0;
+          last_ping_us = esp_timer_get_time();
+          enter(config, &state, UROS_RECONNECT_AGENT_CONNECTED);
+        } else {
+          config->destroy_entities();
+          ESP_LOGW(TAG, "Micro-ROS agent not available, retrying in %u ms", backoff_ms);
+          vTaskDelay(backoff_ms / portTICK_PERIOD_MS);
+          backoff_ms = (2 * backoff_ms < MAX_RECONNECT_BACKOFF_MS) ? 2 * backoff_ms : MAX_RECONNECT_BACKOFF_MS;
+        }
+        break;
+      case UROS_RECONNECT_AGENT_CONNECTED:
+        if (config->spin() == RCL_RET_ERROR) {
+          spin_failures++;
+        } else {
+          spin_failures = 0;
+        }
+        // Repeated spin failures trigger a ping without waiting for the next period
+        if (spin_failures >= MAX_SPIN_FAILURES || elapsed_ms(last_ping_us) >= AGENT_PING_PERIOD_MS) {
+          last_ping_us = esp_timer_get_time();
+          spin_failures = 0;
+          if (rmw_uros_ping_agent(UROS_RECONNECT_PING_TIMEOUT_MS, AGENT_PING_ATTEMPTS) != RMW_RET_OK) {
+            enter(config, &state, UROS_RECONNECT_AGENT_DISCONNECTED);
+          }
+        }
+        break;
+      case UROS_RECONNECT_AGENT_DISCONNECTED:
+        ESP_LOGW(TAG, "Micro-ROS agent lost");
+        lost_at_us = esp_timer_get_time();
+        config->destroy_entities();
+        enter(config, &state, UROS_RECONNECT_WAITING_AGENT);
+        break;
+    }
+  }
+}
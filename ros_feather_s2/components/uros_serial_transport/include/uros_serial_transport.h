@@ -0,0 +1,34 @@
+// Custom micro-ROS transport over UART or USB CDC.
+//
+// The XRCE-DDS client frames the messages (HDLC-like, with CRC):
+// the transport only moves bytes, batching the writes.
+
+#ifndef UROS_SERIAL_TRANSPORT_H
+#define UROS_SERIAL_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <rmw/ret_types.h>
+
+struct uxrCustomTransport;
+
+typedef struct {
+  uint32_t bytes_written;
+  uint32_t bytes_read;
+  uint32_t batches;
+} uros_serial_transport_stats_t;
+
+// Registers the transport with micro-ROS. Call before initializing rcl.
+rmw_ret_t uros_serial_transport_init();
+void uros_serial_transport_get_stats(uros_serial_transport_stats_t *stats);
+
+bool uros_serial_transport_open(struct uxrCustomTransport * transport);
+bool uros_serial_transport_close(struct uxrCustomTransport * transport);
+size_t uros_serial_transport_write(struct uxrCustomTransport * transport, const uint8_t * buffer,
+                                   size_t size, uint8_t * error);
+size_t uros_serial_transport_read(struct uxrCustomTransport * transport, uint8_t * buffer,
+                                  size_t size, int timeout_ms, uint8_t * error);
+
+#endif /* end of include guard: UROS_SERIAL_TRANSPORT_H */
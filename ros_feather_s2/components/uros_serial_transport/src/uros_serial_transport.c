@@ -0,0 +1,212 @@
+#include <string.h>
+
+#include "sdkconfig.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+
+#ifdef CONFIG_UROS_SERIAL_TRANSPORT_USB_CDC
+#include "freertos/semphr.h"
+#include "tinyusb.h"
+#include "tusb_cdc_acm.h"
+#else
+#include "driver/uart.h"
+#endif
+
+#include <rmw_uros/options.h>
+#include <uxr/client/profile/transport/custom/custom_transport.h>
+
+#include "uros_serial_transport.h"
+
+#define TX_BATCH_SIZE CONFIG_UROS_SERIAL_TX_BATCH_SIZE
+#define RX_BUFFER_SIZE CONFIG_UROS_SERIAL_RX_BUFFER_SIZE
+// Wake up the reader after this many bytes or symbols of silence,
+// instead of the driver default (120 bytes, 10 symbols)
+#define UART_RX_FULL_THRESHOLD 64
+#define UART_RX_TIMEOUT_SYMBOLS 2
+
+static const char* TAG = "UROS_SERIAL";
+
+static uint8_t tx_batch[TX_BATCH_SIZE];
+static size_t tx_batch_size = 0;
+static uros_serial_transport_stats_t stats;
+
+#ifdef CONFIG_UROS_SERIAL_TRANSPORT_USB_CDC
+
+// The USB device stays installed when the transport is closed.
+static bool usb_installed = false;
+// Given by TinyUSB when data is received: the reader blocks on it
+static SemaphoreHandle_t usb_rx_ready;
+
+static void usb_rx_callback(int itf, cdcacm_event_t *event) {
+  xSemaphoreGive(usb_rx_ready);
+}
+
+static bool link_open() {
+  if (usb_installed) {
+    return true;
+  }
+  if (!usb_rx_ready && !(usb_rx_ready = xSemaphoreCreateBinary())) {
+    return false;
+  }
+  const tinyusb_config_t tusb_config = {};
+  if (tinyusb_driver_install(&tusb_config) != ESP_OK) {
+    return false;
+  }
+  const tinyusb_config_cdcacm_t acm_config = {
+    .usb_dev = TINYUSB_USBDEV_0,
+    .cdc_port = TINYUSB_CDC_ACM_0,
+    .rx_unread_buf_sz = RX_BUFFER_SIZE,
+    .callback_rx = usb_rx_callback,
+  };
+  usb_installed = tusb_cdc_acm_init(&acm_config) == ESP_OK;
+  return usb_installed;
+}
+
+static bool link_close() {
+  return true;
+}
+
+static size_t link_write(const uint8_t * buffer, size_t size) {
+  size_t written = tinyusb_cdcacm_write_queue(TINYUSB_CDC_ACM_0, buffer, size);
+  tinyusb_cdcacm_write_flush(TINYUSB_CDC_ACM_0, 0);
+  return written;
+}
+
+// Blocks until data is received or the timeout, as uart_read_bytes
+static size_t link_read(uint8_t * buffer, size_t size, int timeout_ms) {
+  const TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+  size_t read = 0;
+  while (1) {
+    if (tinyusb_cdcacm_read(TINYUSB_CDC_ACM_0, buffer, size, &read) == ESP_OK && read) {
+      return read;
+    }
+    const int32_t remaining = (int32_t) (deadline - xTaskGetTickCount());
+    if (remaining <= 0 || xSemaphoreTake(usb_rx_ready, remaining) != pdTRUE) {
+      return 0;
+    }
+  }
+}
+
+#else
+
+static bool link_open() {
+  const uart_port_t uart_number = CONFIG_UROS_SERIAL_UART_NUM;
+  uart_config_t uart_config = {
+      .baud_rate = CONFIG_UROS_SERIAL_UART_BAUD_RATE,
+      .data_bits = UART_DATA_8_BITS,
+      .parity    = UART_PARITY_DISABLE,
+      .stop_bits = UART_STOP_BITS_1,
+      .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+      .source_clk = UART_SCLK_APB,
+  };
+  int intr_alloc_flags = 0;
+#if CONFIG_UART_ISR_IN_IRAM
+  intr_alloc_flags = ESP_INTR_FLAG_IRAM;
+#endif
+  // The driver TX ring buffer lets us return before the batch is on the wire
+  if (uart_driver_install(uart_number, RX_BUFFER_SIZE, 2 * TX_BATCH_SIZE, 0, NULL, intr_alloc_flags) != ESP_OK ||
+      uart_param_config(uart_number, &uart_config) != ESP_OK ||
+      uart_set_pin(uart_number, CONFIG_UROS_SERIAL_UART_TX_GPIO, CONFIG_UROS_SERIAL_UART_RX_GPIO,
+                   UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) {
+    return false;
+  }
+  uart_set_rx_full_threshold(uart_number, UART_RX_FULL_THRESHOLD);
+  uart_set_rx_timeout(uart_number, UART_RX_TIMEOUT_SYMBOLS);
+  return true;
+}
+
+static bool link_close() {
+  return uart_driver_delete(CONFIG_UROS_SERIAL_UART_NUM) == ESP_OK;
+}
+
+static size_t link_write(const uint8_t * buffer, size_t size) {
+  const int written = uart_write_bytes(CONFIG_UROS_SERIAL_UART_NUM, (const char *) buffer, size);
+  return written < 0 ? 0 : written;
+}
+
+static size_t link_read(uint8_t * buffer, size_t size, int timeout_ms) {
+  const int read = uart_read_bytes(CONFIG_UROS_SERIAL_UART_NUM, buffer, size, pdMS_TO_TICKS(timeout_ms));
+  return read < 0 ? 0 : read;
+}
+
+#endif  // CONFIG_UROS_SERIAL_TRANSPORT_USB_CDC
+
+static bool flush() {
+  if (!tx_batch_size) {
+    return true;
+  }
+  const size_t written = link_write(tx_batch, tx_batch_size);
+  stats.batches++;
+  stats.bytes_written += written;
+  const bool ok = written == tx_batch_size;
+  tx_batch_size = 0;
+  return ok;
+}
+
+bool uros_serial_transport_open(struct uxrCustomTransport * transport) {
+  ESP_LOGI(TAG, "Initializing");
+  tx_batch_size = 0;
+  memset(&stats, 0, sizeof(stats));
+  if (!link_open()) {
+    ESP_LOGE(TAG, "Failed to open the serial link");
+    return false;
+  }
+  ESP_LOGI(TAG, "Initialized");
+  return true;
+}
+
+bool uros_serial_transport_close(struct uxrCustomTransport * transport) {
+  flush();
+  return link_close();
+}
+
+size_t uros_serial_transport_write(struct uxrCustomTransport * transport, const uint8_t * buffer,
+                                   size_t size, uint8_t * error) {
+  // Large writes (e.g., whole fragments) go straight to the driver
+  if (tx_batch_size + size > TX_BATCH_SIZE) {
+    if (!flush()) {
+      *error = 1;
+      return 0;
+    }
+    if (size > TX_BATCH_SIZE) {
+      const size_t written = link_write(buffer, size);
+      stats.batches++;
+      stats.bytes_written += written;
+      if (written != size) {
+        *error = 1;
+      }
+      return written;
+    }
+  }
+  memcpy(tx_batch + tx_batch_size, buffer, size);
+  tx_batch_size += size;
+  return size;
+}
+
+size_t uros_serial_transport_read(struct uxrCustomTransport * transport, uint8_t * buffer,
+                                  size_t size, int timeout_ms, uint8_t * error) {
+  // The client reads when it waits for an answer: send what is pending first.
+  if (!flush()) {
+    *error = 1;
+  }
+  const size_t read = link_read(buffer, size, timeout_ms);
+  stats.bytes_read += read;
+  return read;
+}
+
+rmw_ret_t uros_serial_transport_init() {
+  // framing = true: the client wraps the messages in HDLC-like frames
+  return rmw_uros_set_custom_transport(
+    true, NULL,
+    uros_serial_transport_open,
+    uros_serial_transport_close,
+    uros_serial_transport_write,
+    uros_serial_transport_read);
+}
+
+void uros_serial_transport_get_stats(uros_serial_transport_stats_t *_stats) {
+  *_stats = stats;
+}
@@ -0,0 +1,33 @@
+// Compile-time sizes derived from the capabilities selected in menuconfig
+
+#ifndef APP_CONFIG_H
+#define APP_CONFIG_H
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_EXPOSE_COMMAND
+#define NUMBER_OF_COMMAND_SUBSCRIPTIONS 1
+#define BRIGHTNESS_SERVICE
+#define NUMBER_OF_SERVICES 1
+#else
+#define NUMBER_OF_COMMAND_SUBSCRIPTIONS 0
+#define NUMBER_OF_SERVICES 0
+#endif
+
+// Drives the APA102 brightness
+#if defined(CONFIG_AUTO_BRIGHTNESS_ENABLE) && defined(CONFIG_EXPOSE_COMMAND)
+#define AUTO_BRIGHTNESS
+#endif
+
+#if defined(CONFIG_EXPOSE_TEMPERATURE) || defined(CONFIG_EXPOSE_ILLUMINANCE)
+#define SENSORS_TIMER
+#define NUMBER_OF_TIMERS 1
+#else
+#define NUMBER_OF_TIMERS 0
+#endif
+
+#define EXECUTOR_HANDLES (NUMBER_OF_COMMAND_SUBSCRIPTIONS + NUMBER_OF_SERVICES + NUMBER_OF_TIMERS)
+
+_Static_assert(EXECUTOR_HANDLES > 0, "Enable at least one capability");
+
+#endif /* end of include guard: APP_CONFIG_H */
@@ -4,65 +4,83 @@
 #include <time.h>
 
 #include "sdkconfig.h"
+#include "app_config.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include <rcl/rcl.h>
 #include <rcl/error_handling.h>
 #include <rclc/rclc.h>
 #include <rclc/executor.h>
 #include <rmw_uros/options.h>
+#include <rmw_microxrcedds_c/config.h>
 #include <uros_network_interfaces.h>
 #include "uxr/client/config.h"
-#include <std_msgs/msg/color_rgba.h>
-#include <std_msgs/msg/bool.h>
 #include <sensor_msgs/msg/illuminance.h>
 #include <sensor_msgs/msg/temperature.h>
+#include <led_strip_msgs/msg/board_command.h>
 #include <led_strip_msgs/srv/set_brightness.h>
 
 #include "apa102.h"
 #include "ldo_2.h"
 #include "blue_led.h"
+#ifdef RMW_UXRCE_TRANSPORT_CUSTOM
+#include "uros_serial_transport.h"
+#else
+#include "uros_agent_cache.h"
+#endif
+#include "boot_trace.h"
+#include "uros_reconnect.h"
 #include "ambient_light_sensor.h"
 #include "temperature_sensor.h"
+#ifdef AUTO_BRIGHTNESS
+#include "auto_brightness.h"
+#endif
 
 // ISSUES
-// - cannot use more than one subscriber
+// - cannot use more than one subscriber:
+//   the actuators share a single (multiplexed) command subscriber
 // - have no access to console: no usb + wifi/ros, no cable for uart
 // - adc1_get_raw((adc1_channel_t)channel) is crashing the program
 
-#define EXPOSE_APA102
-// #define EXPOSE_BLUE_LED
-#define EXPOSE_TEMPERATURE
-// #define EXPOSE_ILLUMINANCE
-#ifdef EXPOSE_APA102
-#define BRIGHTNESS_SERVICE
-#endif
-
-#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
+#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Retrying.\n",__LINE__,(int)temp_rc);return false;}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
 
-#ifdef EXPOSE_TEMPERATURE
+static const char* TAG = "FEATHERS2";
+
+rclc_support_t support;
+rcl_node_t node;
+#ifdef SENSORS_TIMER
+rcl_timer_t timer;
+#endif
+rclc_executor_t executor;
+static bool support_ready = false;
+
+#ifdef CONFIG_EXPOSE_TEMPERATURE
 rcl_publisher_t temperature_publisher;
 sensor_msgs__msg__Temperature temperature_msg;
 #endif
-#ifdef EXPOSE_ILLUMINANCE
+#ifdef CONFIG_EXPOSE_ILLUMINANCE
 rcl_publisher_t illuminance_publisher;
 sensor_msgs__msg__Illuminance illuminance_msg;
 #endif
-#ifdef EXPOSE_BLUE_LED
-rcl_subscription_t blue_led_subscriber;
-std_msgs__msg__Bool blue_led_msg;
+#ifdef CONFIG_EXPOSE_COMMAND
+rcl_subscription_t command_subscriber;
+led_strip_msgs__msg__BoardCommand command_msg;
 #endif
-#ifdef EXPOSE_APA102
-rcl_subscription_t apa102_subscriber;
-std_msgs__msg__ColorRGBA apa102_msg;
+#ifdef BRIGHTNESS_SERVICE
+rcl_service_t brightness_service;
+led_strip_msgs__srv__SetBrightness_Response brightness_res;
+led_strip_msgs__srv__SetBrightness_Request brightness_req;
 #endif
 
+#ifdef SENSORS_TIMER
 void timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 {
   RCLC_UNUSED(last_call_time);
@@ -70,7 +88,7 @@ void timer_callback(rcl_timer_t * timer, int64_t last_call_time)
   clock_gettime(CLOCK_REALTIME, &ts);
   if (timer != NULL) {
     // TODO(Jerome): add time stamps
-#ifdef EXPOSE_TEMPERATURE
+#ifdef CONFIG_EXPOSE_TEMPERATURE
     temperature_msg.temperature = (double) temperature_sensor_read();
     temperature_msg.header.stamp.sec = ts.tv_sec;
     temperature_msg.header.stamp.nanosec = ts.tv_nsec;
@@ -78,7 +96,7 @@ void timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 #endif
     // 2000 Lx/V is a reasonable value from the datasheet.
     // The actual value depends on the kind of light.
-#ifdef EXPOSE_ILLUMINANCE
+#ifdef CONFIG_EXPOSE_ILLUMINANCE
     illuminance_msg.illuminance = (double)(ambient_read() * 2.0);
     illuminance_msg.header.stamp.sec = ts.tv_sec;
     illuminance_msg.header.stamp.nanosec = ts.tv_nsec;
@@ -86,76 +104,149 @@ void timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 #endif
   }
 }
+#endif
 
-#ifdef EXPOSE_APA102
+#ifdef CONFIG_EXPOSE_COMMAND
 static float brightness = -1.0;
-void apa102_subscription_callback(const void * msgin)
+
+#ifdef AUTO_BRIGHTNESS
+// set_brightness sets the brightness in bright light
+static auto_brightness_t auto_brightness;
+static float min_brightness = 0.0;
+static float max_brightness = 1.0;
+static int64_t last_ambient_sample_us = 0;
+#endif
+
+static void apply_brightness(float value)
+{
+  brightness = value;
+  if(brightness > 1.0) {
+    brightness = 1.0;
+  }
+  if(brightness >= 0) {
+    uint8_t l = (uint8_t)(31 * brightness);
+    apa102_set_brightness(l);
+  }
+}
+
+static void set_brightness(float value)
 {
-  const std_msgs__msg__ColorRGBA * _msg = (const std_msgs__msg__ColorRGBA *)msgin;
-  uint8_t red = (uint8_t) (255 * _msg->r);
-  uint8_t green = (uint8_t) (255 * _msg->g);
-  uint8_t blue = (uint8_t ) (255 * _msg->b);
+#ifdef AUTO_BRIGHTNESS
+  max_brightness = value;
+  if (auto_brightness.started) {
+    value = auto_brightness_scale(&auto_brightness, min_brightness, max_brightness);
+  }
+#endif
+  apply_brightness(value);
+}
+
+#ifdef AUTO_BRIGHTNESS
+// Called from the micro-ROS task loop, samples at the sensor rate
+static void update_auto_brightness()
+{
+  const int64_t now_us = esp_timer_get_time();
+  if (now_us - last_ambient_sample_us < 1000LL * CONFIG_AUTO_BRIGHTNESS_PERIOD_MS) {
+    return;
+  }
+  const float dt_s = 1e-6f * (now_us - last_ambient_sample_us);
+  last_ambient_sample_us = now_us;
+  if (auto_brightness_update(&auto_brightness, ambient_read(), dt_s)) {
+    apply_brightness(auto_brightness_scale(&auto_brightness, min_brightness, max_brightness));
+  }
+}
+#endif
+
+static void apa102_command(const led_strip_msgs__msg__BoardCommand * command)
+{
+  const std_msgs__msg__ColorRGBA * color = &command->color;
+  uint8_t red = (uint8_t) (255 * color->r);
+  uint8_t green = (uint8_t) (255 * color->g);
+  uint8_t blue = (uint8_t ) (255 * color->b);
   uint8_t l;
   if((brightness >= 0) && (brightness <= 1)) {
     l = (uint8_t ) (31 * brightness);
   }
   else {
-    l = (uint8_t ) (31 * _msg->a);
+    l = (uint8_t ) (31 * color->a);
   }
 
   apa102_set_color(red, green, blue, l);
 }
+
+static void blue_led_command(const led_strip_msgs__msg__BoardCommand * command)
+{
+  blue_led_set(command->on);
+}
+
+static void brightness_command(const led_strip_msgs__msg__BoardCommand * command)
+{
+  set_brightness(command->brightness);
+}
+
+typedef void (*command_handler_t)(const led_strip_msgs__msg__BoardCommand *);
+
+// indexed by command type
+static const command_handler_t command_handlers[] = {
+  [led_strip_msgs__msg__BoardCommand__APA102] = apa102_command,
+  [led_strip_msgs__msg__BoardCommand__BLUE_LED] = blue_led_command,
+  [led_strip_msgs__msg__BoardCommand__BRIGHTNESS] = brightness_command,
+};
+
+#define NUMBER_OF_COMMANDS (sizeof(command_handlers) / sizeof(command_handlers[0]))
+
+void command_subscription_callback(const void * msgin)
+{
+  const led_strip_msgs__msg__BoardCommand * _msg = (const led_strip_msgs__msg__BoardCommand *)msgin;
+  if (_msg->type < NUMBER_OF_COMMANDS) {
+    command_handlers[_msg->type](_msg);
+  }
+  boot_trace_done("first command");
+}
 #endif
 
 #ifdef BRIGHTNESS_SERVICE
 void brightness_service_callback(const void * req, void * res){
   led_strip_msgs__srv__SetBrightness_Request * req_in = (led_strip_msgs__srv__SetBrightness_Request *) req;
   // led_strip_msgs__srv__SetBrightness_Response * res_in = (led_strip_msgs__srv__SetBrightness_Response *) res;
-  brightness = req_in->brightness;
-  if(brightness > 1.0) {
-    brightness = 1.0;
-  }
-  if(brightness >= 0) {
-    uint8_t l = (uint8_t)(31 * brightness);
-    apa102_set_brightness(l);
-  }
-}
+#ifdef AUTO_BRIGHTNESS
+  min_brightness = req_in->min_brightness;
 #endif
-
-#ifdef EXPOSE_BLUE_LED
-void blue_led_subscription_callback(const void * msgin)
-{
-  const std_msgs__msg__Bool * _msg = (const std_msgs__msg__Bool *)msgin;
-  uint8_t value = _msg->data & 1;
-  blue_led_set(value);
+  set_brightness(req_in->brightness);
 }
 #endif
 
-void micro_ros_task(void * arg)
+static bool create_entities()
 {
-
-  blue_led_set(1);
-
   rcl_allocator_t allocator = rcl_get_default_allocator();
-  rclc_support_t support;
   rcl_init_options_t init_options = rcl_get_zero_initialized_init_options();
   RCCHECK(rcl_init_options_init(&init_options, allocator));
   rmw_init_options_t* rmw_options = rcl_init_options_get_rmw_init_options(&init_options);
 
-  while(rmw_uros_discover_agent(rmw_options)) {
-    usleep(10000);
+#ifdef RMW_UXRCE_TRANSPORT_CUSTOM
+  // No discovery on a serial link: check that the agent is there
+  if (rmw_uros_ping_agent(UROS_RECONNECT_PING_TIMEOUT_MS, 1) != RMW_RET_OK) {
+#else
+  // Try the agent of the last session first
+  if (uros_agent_cache_find_agent(rmw_options) != RMW_RET_OK) {
+#endif
+    RCSOFTCHECK(rcl_init_options_fini(&init_options));
+    return false;
   }
+  boot_trace_mark("agent found");
 
   // create init_options
-  RCCHECK(rclc_support_init_with_options(&support, 0, NULL, &init_options, &allocator));
+  rcl_ret_t rc = rclc_support_init_with_options(&support, 0, NULL, &init_options, &allocator);
+  RCSOFTCHECK(rcl_init_options_fini(&init_options));
+  RCCHECK(rc);
+  support_ready = true;
 
   // create node
-  rcl_node_t node;
+  node = rcl_get_zero_initialized_node();
   RCCHECK(rclc_node_init_default(&node, "feathers2", "feathers2", &support));
-  unsigned handles = 0;
 
   // create publishers
-#ifdef EXPOSE_TEMPERATURE
+#ifdef CONFIG_EXPOSE_TEMPERATURE
+  temperature_publisher = rcl_get_zero_initialized_publisher();
   RCCHECK(rclc_publisher_init_default(
     &temperature_publisher, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(sensor_msgs, msg, Temperature),
     "temperature"));
@@ -165,7 +256,8 @@ void micro_ros_task(void * arg)
   temperature_msg.header.stamp.nanosec=0;
   temperature_msg.variance=0.0;
 #endif
-#ifdef EXPOSE_ILLUMINANCE
+#ifdef CONFIG_EXPOSE_ILLUMINANCE
+  illuminance_publisher = rcl_get_zero_initialized_publisher();
   RCCHECK(rclc_publisher_init_default(
     &illuminance_publisher, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(sensor_msgs, msg, Illuminance),
     "illuminance"));
@@ -177,96 +269,156 @@ void micro_ros_task(void * arg)
 #endif
 
   // create subscriber
-#ifdef EXPOSE_APA102
+#ifdef CONFIG_EXPOSE_COMMAND
+  command_subscriber = rcl_get_zero_initialized_subscription();
+#ifdef CONFIG_PIXEL_QOS_BEST_EFFORT
+  rmw_qos_profile_t pixel_qos = rmw_qos_profile_sensor_data;
+  pixel_qos.depth = 1;
+  RCCHECK(rclc_subscription_init(
+    &command_subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, BoardCommand), "command", &pixel_qos));
+#else
   RCCHECK(rclc_subscription_init_default(
-    &apa102_subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, ColorRGBA), "apa102"));
-    handles++;
+    &command_subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, BoardCommand), "command"));
 #endif
-#ifdef EXPOSE_BLUE_LED
-  RCCHECK(rclc_subscription_init_default(
-    &blue_led_subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Bool), "blue_led"));
-    handles++;
 #endif
 
   // create service
 #ifdef BRIGHTNESS_SERVICE
-  rcl_service_t brightness_service;
+  brightness_service = rcl_get_zero_initialized_service();
   RCCHECK(rclc_service_init_default(&brightness_service, &node, ROSIDL_GET_SRV_TYPE_SUPPORT(led_strip_msgs, srv, SetBrightness), "set_brightness"));
-  handles++;
 #endif
 
   // create timer,
-  rcl_timer_t timer;
-  const unsigned int timer_timeout = 1000;
-  RCCHECK(rclc_timer_init_default(&timer, &support, RCL_MS_TO_NS(timer_timeout), timer_callback));
-  handles++;
+#ifdef SENSORS_TIMER
+  timer = rcl_get_zero_initialized_timer();
+  RCCHECK(rclc_timer_init_default(&timer, &support, RCL_MS_TO_NS(CONFIG_SENSORS_PERIOD_MS), timer_callback));
+#endif
 
   // create executor
-  rclc_executor_t executor = rclc_executor_get_zero_initialized_executor();
-  RCCHECK(rclc_executor_init(&executor, &support.context, handles, &allocator));
-#ifdef EXPOSE_APA102
-  RCCHECK(rclc_executor_add_subscription(&executor, &apa102_subscriber, &apa102_msg, &apa102_subscription_callback, ON_NEW_DATA));
-#endif
-#ifdef EXPOSE_BLUE_LED
-  RCCHECK(rclc_executor_add_subscription(&executor, &blue_led_subscriber, &blue_led_msg, &blue_led_subscription_callback, ON_NEW_DATA));
+  executor = rclc_executor_get_zero_initialized_executor();
+  RCCHECK(rclc_executor_init(&executor, &support.context, EXECUTOR_HANDLES, &allocator));
+#ifdef CONFIG_EXPOSE_COMMAND
+  RCCHECK(rclc_executor_add_subscription(&executor, &command_subscriber, &command_msg, &command_subscription_callback, ON_NEW_DATA));
 #endif
 #ifdef BRIGHTNESS_SERVICE
-  led_strip_msgs__srv__SetBrightness_Response res;
-  led_strip_msgs__srv__SetBrightness_Request req;
-  RCCHECK(rclc_executor_add_service(&executor, &brightness_service, &req, &res, brightness_service_callback));
+  RCCHECK(rclc_executor_add_service(&executor, &brightness_service, &brightness_req, &brightness_res, brightness_service_callback));
 #endif
+#ifdef SENSORS_TIMER
   RCCHECK(rclc_executor_add_timer(&executor, &timer));
+#endif
+  return true;
+}
 
-  blue_led_set(0);
-  while(1){
-    rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
-    usleep(10000);
+// Safe to call on partially created entities.
+static void destroy_entities()
+{
+  if (!support_ready) {
+    return;
   }
+  // The agent is likely gone: don't wait for it to confirm the deletions.
+  rmw_context_t * rmw_context = rcl_context_get_rmw_context(&support.context);
+  (void) rmw_uros_set_context_entity_destroy_session_timeout(rmw_context, 0);
 
   // free resources
-  RCCHECK(rcl_timer_fini(&timer));
-#ifdef EXPOSE_TEMPERATURE
-  RCCHECK(rcl_publisher_fini(&temperature_publisher, &node));
+  RCSOFTCHECK(rclc_executor_fini(&executor));
+#ifdef SENSORS_TIMER
+  RCSOFTCHECK(rcl_timer_fini(&timer));
 #endif
-#ifdef EXPOSE_ILLUMINANCE
-  RCCHECK(rcl_publisher_fini(&illuminance_publisher, &node));
+#ifdef CONFIG_EXPOSE_TEMPERATURE
+  RCSOFTCHECK(rcl_publisher_fini(&temperature_publisher, &node));
 #endif
-#ifdef EXPOSE_APA102
-  RCCHECK(rcl_subscription_fini(&apa102_subscriber, &node));
+#ifdef CONFIG_EXPOSE_ILLUMINANCE
+  RCSOFTCHECK(rcl_publisher_fini(&illuminance_publisher, &node));
 #endif
-#ifdef EXPOSE_BLUE_LED
-  RCCHECK(rcl_subscription_fini(&blue_led_subscriber, &node));
+#ifdef CONFIG_EXPOSE_COMMAND
+  RCSOFTCHECK(rcl_subscription_fini(&command_subscriber, &node));
 #endif
 #ifdef BRIGHTNESS_SERVICE
-  RCCHECK(rcl_service_fini(&brightness_service, &node));
+  RCSOFTCHECK(rcl_service_fini(&brightness_service, &node));
 #endif
-  RCCHECK(rcl_node_fini(&node));
-  RCCHECK(rclc_support_fini(&support));
+  RCSOFTCHECK(rcl_node_fini(&node));
+  RCSOFTCHECK(rclc_support_fini(&support));
+  support_ready = false;
+}
 
-  vTaskDelete(NULL);
+// The blue LED is on while waiting for the agent, unless it belongs to
+// BLUE_LED commands. The LEDs keep their state while we reconnect.
+static void agent_state_changed(uros_reconnect_state_t state)
+{
+#ifdef CONFIG_EXPOSE_COMMAND
+  (void) state;
+#else
+  blue_led_set(state == UROS_RECONNECT_WAITING_AGENT);
+#endif
 }
 
+static rcl_ret_t spin()
+{
+  const rcl_ret_t rc = rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
+  usleep(10000);
+  return rc;
+}
 
-void app_main(void)
+void micro_ros_task(void * arg)
 {
+  const uros_reconnect_config_t config = {
+    .create_entities = create_entities,
+    .destroy_entities = destroy_entities,
+    .spin = spin,
+#ifdef AUTO_BRIGHTNESS
+    // Also while the agent is away, between reconnection attempts
+    .tick = update_auto_brightness,
+#endif
+    .state_changed = agent_state_changed,
+  };
+  uros_reconnect_run(&config);
+}
+
+
+// Runs while the network comes up
+static void init_peripherals_task(void * arg)
+{
+  SemaphoreHandle_t ready = (SemaphoreHandle_t) arg;
   ldo_2_init();
   ldo_2_enable(true);
   blue_led_init();
-#ifdef EXPOSE_APA102
+#ifdef CONFIG_EXPOSE_COMMAND
   apa102_init();
 #endif
-#ifdef EXPOSE_TEMPERATURE
+#ifdef CONFIG_EXPOSE_TEMPERATURE
   temperature_sensor_init();
 #endif
-#ifdef EXPOSE_ILLUMINANCE
+#if defined(CONFIG_EXPOSE_ILLUMINANCE) || defined(AUTO_BRIGHTNESS)
   ambient_init();
+#endif
+#ifdef AUTO_BRIGHTNESS
+  const auto_brightness_config_t auto_brightness_config = AUTO_BRIGHTNESS_CONFIG_FROM_KCONFIG();
+  auto_brightness_init(&auto_brightness, &auto_brightness_config);
 #endif
   vTaskDelay(100 / portTICK_PERIOD_MS);
+  boot_trace_mark("peripherals");
+  xSemaphoreGive(ready);
+  vTaskDelete(NULL);
+}
 
+void app_main(void)
+{
+  boot_trace_mark("app_main");
+  SemaphoreHandle_t peripherals_ready = xSemaphoreCreateBinary();
+  xTaskCreate(init_peripherals_task, "init_peripherals", 4096, peripherals_ready, 5, NULL);
+
+#ifdef RMW_UXRCE_TRANSPORT_CUSTOM
+  if (uros_serial_transport_init() != RMW_RET_OK) {
+    ESP_LOGE(TAG, "Failed to set the micro-ROS serial transport");
+  }
+#endif
 #ifdef UCLIENT_PROFILE_UDP
     // Start the networking if required
     ESP_ERROR_CHECK(uros_network_interface_initialize());
+    boot_trace_mark("network");
 #endif  // UCLIENT_PROFILE_UDP
+  xSemaphoreTake(peripherals_ready, portMAX_DELAY);
+  vSemaphoreDelete(peripherals_ready);
 
     //pin micro-ros task in APP_CPU to make PRO_CPU to deal with wifi:
   xTaskCreate(micro_ros_task, "uros_task", CONFIG_MICRO_ROS_APP_STACK, NULL,
@@ -0,0 +1,99 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "led_strip.h"
+
+/**
+* @brief Order of the LEDs inside a panel
+*
+*/
+typedef enum {
+    LED_LAYOUT_ROW_MAJOR,  /*!< Every row from left to right */
+    LED_LAYOUT_SERPENTINE, /*!< Even rows from left to right, odd rows from right to left */
+} led_layout_wiring_t;
+
+/**
+* @brief Clockwise rotation of the image on the panels
+*
+*/
+typedef enum {
+    LED_LAYOUT_ROTATION_0,
+    LED_LAYOUT_ROTATION_90,
+    LED_LAYOUT_ROTATION_180,
+    LED_LAYOUT_ROTATION_270,
+} led_layout_rotation_t;
+
+/**
+* @brief LED matrix layout configuration
+*
+* The matrix is made of tiles_x x tiles_y identical panels,
+* chained row by row, from the top-left one.
+*/
+typedef struct {
+    uint16_t panel_width;           /*!< LEDs per row of a panel */
+    uint16_t panel_height;          /*!< LEDs per column of a panel */
+    uint16_t tiles_x;               /*!< Panels per row */
+    uint16_t tiles_y;               /*!< Panels per column */
+    led_layout_wiring_t wiring;     /*!< Order of the LEDs inside a panel */
+    led_layout_rotation_t rotation; /*!< Rotation of the image */
+    bool mirror_x;                  /*!< Flip the image horizontally (before rotating it) */
+    bool mirror_y;                  /*!< Flip the image vertically (before rotating it) */
+} led_layout_config_t;
+
+/**
+* @brief LED matrix layout
+*
+*/
+typedef struct {
+    uint16_t width;  /*!< Width of the images */
+    uint16_t height; /*!< Height of the images */
+    uint16_t lut[0]; /*!< LED index of every image pixel, row-major */
+} led_layout_t;
+
+/**
+* @brief Create a layout, precomputing the LED index of every image pixel
+*
+* @param config: layout configuration
+* @return
+*      layout instance or NULL
+*/
+led_layout_t *led_layout_new(const led_layout_config_t *config);
+
+/**
+* @brief Free a layout
+*
+* @param layout: layout
+*/
+void led_layout_del(led_layout_t *layout);
+
+/**
+* @brief Copy an RGB image to a strip, through the layout
+*
+* @param layout: layout
+* @param strip: LED strip
+* @param rgb: image, row-major, 3 bytes (red, green, blue) per pixel
+* @param width: width of the image, clipped to the layout width
+* @param height: height of the image, clipped to the layout height
+* @param scale: scale applied to every color component, 256 for full brightness
+*
+* @return
+*      - ESP_OK: Copied the image successfully
+*      - ESP_ERR_INVALID_ARG: Copy failed because of invalid parameters
+*
+* @note:
+*      Pixels of the strip outside the image are not changed.
+*      Call refresh to flush the colors to the strip.
+*/
+esp_err_t led_layout_blit(const led_layout_t *layout, led_strip_t *strip, const uint8_t *rgb,
+                          uint16_t width, uint16_t height, uint32_t scale);
+
+#ifdef __cplusplus
+}
+#endif
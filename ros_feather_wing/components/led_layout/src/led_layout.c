@@ -0,0 +1,93 @@
+#include <stdlib.h>
+
+#include "esp_log.h"
+
+#include "led_layout.h"
+
+static const char *TAG = "led_layout";
+
+// Index of the LED at (x, y) on the physical matrix, from its top-left corner
+static uint16_t led_index(const led_layout_config_t *config, uint16_t x, uint16_t y)
+{
+    const uint16_t tile = (y / config->panel_height) * config->tiles_x + x / config->panel_width;
+    const uint16_t column = x % config->panel_width;
+    const uint16_t row = y % config->panel_height;
+    uint16_t index = tile * config->panel_width * config->panel_height + row * config->panel_width;
+    if (config->wiring == LED_LAYOUT_SERPENTINE && (row & 1)) {
+        index += config->panel_width - 1 - column;
+    } else {
+        index += column;
+    }
+    return index;
+}
+
+led_layout_t *led_layout_new(const led_layout_config_t *config)
+{
+    if (!config || !config->panel_width || !config->panel_height || !config->tiles_x || !config->tiles_y) {
+        ESP_LOGE(TAG, "invalid configuration");
+        return NULL;
+    }
+    // size of the matrix
+    const uint16_t matrix_width = config->panel_width * config->tiles_x;
+    const uint16_t matrix_height = config->panel_height * config->tiles_y;
+    const bool transposed = config->rotation == LED_LAYOUT_ROTATION_90 || config->rotation == LED_LAYOUT_ROTATION_270;
+    const uint16_t width = transposed ? matrix_height : matrix_width;
+    const uint16_t height = transposed ? matrix_width : matrix_height;
+
+    led_layout_t *layout = malloc(sizeof(led_layout_t) + width * height * sizeof(uint16_t));
+    if (!layout) {
+        ESP_LOGE(TAG, "request memory for layout failed");
+        return NULL;
+    }
+    layout->width = width;
+    layout->height = height;
+    uint16_t *lut = layout->lut;
+    for (uint16_t y = 0; y < height; y++) {
+        for (uint16_t x = 0; x < width; x++, lut++) {
+            const uint16_t ix = config->mirror_x ? width - 1 - x : x;
+            const uint16_t iy = config->mirror_y ? height - 1 - y : y;
+            switch (config->rotation) {
+            case LED_LAYOUT_ROTATION_90:
+                *lut = led_index(config, matrix_width - 1 - iy, ix);
+                break;
+            case LED_LAYOUT_ROTATION_180:
+                *lut = led_index(config, matrix_width - 1 - ix, matrix_height - 1 - iy);
+                break;
+            case LED_LAYOUT_ROTATION_270:
+                *lut = led_index(config, iy, matrix_height - 1 - ix);
+                break;
+            default:
+                *lut = led_index(config, ix, iy);
+            }
+        }
+    }
+    return layout;
+}
+
+void led_layout_del(led_layout_t *layout)
+{
+    free(layout);
+}
+
+esp_err_t led_layout_blit(const led_layout_t *layout, led_strip_t *strip, const uint8_t *rgb,
+                          uint16_t width, uint16_t height, uint32_t scale)
+{
+    if (!layout || !strip || !rgb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (height > layout->height) {
+        height = layout->height;
+    }
+    // Images as wide as the layout are copied in one pass
+    if (width == layout->width) {
+        return strip->set_pixels(strip, rgb, layout->lut, width * height, scale);
+    }
+    const uint16_t columns = width < layout->width ? width : layout->width;
+    for (uint16_t y = 0; y < height; y++) {
+        esp_err_t ret = strip->set_pixels(strip, rgb + 3 * y * width, layout->lut + y * layout->width, columns, scale);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
@@ -52,6 +52,21 @@ struct led_strip_s {
     */
     esp_err_t (*set_pixel)(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue);
 
+    /**
+    * @brief Set RGB for many pixels at once, through a lookup table
+    *
+    * @param strip: LED strip
+    * @param rgb: source colors, 3 bytes (red, green, blue) per pixel
+    * @param lut: index of the LED of each source pixel
+    * @param count: number of source pixels
+    * @param scale: scale applied to every color component, 256 for full brightness
+    *
+    * @return
+    *      - ESP_OK: Set RGB for the pixels successfully
+    *      - ESP_ERR_INVALID_ARG: Set RGB failed because of invalid parameters
+    */
+    esp_err_t (*set_pixels)(led_strip_t *strip, const uint8_t *rgb, const uint16_t *lut, uint32_t count, uint32_t scale);
+
     /**
     * @brief Refresh memory colors to LEDs
     *
@@ -121,6 +136,41 @@ typedef struct {
 */
 led_strip_t *led_strip_new_rmt_ws2812(const led_strip_config_t *config);
 
+/**
+* @brief SPI bytes per LED of the SPI driver: 4 SPI bits per WS2812 bit
+*
+*/
+#define WS2812_SPI_BYTES_PER_LED (12)
+
+/**
+* @brief SPI bytes to keep the line low during the 280 us reset, at 3.2 MHz
+*
+*/
+#define WS2812_SPI_RESET_BYTES (112)
+
+/**
+* @brief Size of the DMA buffer of a strip of `number` LEDs driven by SPI,
+*        to be used as max_transfer_sz of the SPI bus
+*
+*/
+#define LED_STRIP_SPI_BUFFER_SIZE(number) ((number) * WS2812_SPI_BYTES_PER_LED + WS2812_SPI_RESET_BYTES)
+
+/**
+* @brief Install a new ws2812 driver (based on SPI peripheral with DMA)
+*
+* The pixels are kept in bulk storage (PSRAM with BUFFER_PLACEMENT_PSRAM) and encoded
+* at refresh into an internal DMA buffer. The whole strip is sent in a single DMA
+* transfer, without refilling from an ISR: a gap between two transfers could latch
+* the LEDs in the middle of the frame.
+* The SPI bus has to be initialized with the data GPIO as MOSI, a DMA channel
+* and max_transfer_sz >= LED_STRIP_SPI_BUFFER_SIZE(max_leds).
+*
+* @param config: LED strip configuration, dev is the spi_host_device_t of the bus
+* @return
+*      LED strip instance or NULL
+*/
+led_strip_t *led_strip_new_spi_ws2812(const led_strip_config_t *config);
+
 #ifdef __cplusplus
 }
 #endif
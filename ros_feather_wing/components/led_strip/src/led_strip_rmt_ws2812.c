@@ -17,6 +17,7 @@
 #include "esp_log.h"
 #include "esp_attr.h"
 #include "led_strip.h"
+#include "buffer_placement.h"
 #include "driver/rmt.h"
 
 static const char *TAG = "ws2812";
@@ -31,10 +32,11 @@ static const char *TAG = "ws2812";
         }                                                                         \
     } while (0)
 
-#define WS2812_T0H_NS (350)
-#define WS2812_T0L_NS (1000)
-#define WS2812_T1H_NS (1000)
-#define WS2812_T1L_NS (350)
+// Nominal times of the WS2812B datasheet (+-150 ns), as checked by tools/ws2812_timing_check
+#define WS2812_T0H_NS (400)
+#define WS2812_T0L_NS (850)
+#define WS2812_T1H_NS (800)
+#define WS2812_T1L_NS (450)
 #define WS2812_RESET_US (280)
 
 static uint32_t ws2812_t0h_ticks = 0;
@@ -108,6 +110,24 @@ err:
     return ret;
 }
 
+static esp_err_t ws2812_set_pixels(led_strip_t *strip, const uint8_t *rgb, const uint16_t *lut, uint32_t count, uint32_t scale)
+{
+    esp_err_t ret = ESP_OK;
+    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    STRIP_CHECK(rgb && lut, "pixels and lookup table can't be null", err, ESP_ERR_INVALID_ARG);
+    for (uint32_t i = 0; i < count; i++, rgb += 3) {
+        STRIP_CHECK(lut[i] < ws2812->strip_len, "index out of the maximum number of leds", err, ESP_ERR_INVALID_ARG);
+        uint8_t *pixel = ws2812->buffer + lut[i] * 3;
+        // In thr order of GRB
+        pixel[0] = (rgb[1] * scale) >> 8;
+        pixel[1] = (rgb[0] * scale) >> 8;
+        pixel[2] = (rgb[2] * scale) >> 8;
+    }
+    return ESP_OK;
+err:
+    return ret;
+}
+
 static esp_err_t ws2812_refresh(led_strip_t *strip, uint32_t timeout_ms)
 {
     esp_err_t ret = ESP_OK;
@@ -139,9 +159,9 @@ led_strip_t *led_strip_new_rmt_ws2812(const led_strip_config_t *config)
     led_strip_t *ret = NULL;
     STRIP_CHECK(config, "configuration can't be null", err, NULL);
 
-    // 24 bits per led
+    // 24 bits per led, bulk storage read by the RMT translator
     uint32_t ws2812_size = sizeof(ws2812_t) + config->max_leds * 3;
-    ws2812_t *ws2812 = calloc(1, ws2812_size);
+    ws2812_t *ws2812 = bulk_calloc(1, ws2812_size);
     STRIP_CHECK(ws2812, "request memory for ws2812 failed", err, NULL);
 
     uint32_t counter_clk_hz = 0;
@@ -161,6 +181,7 @@ led_strip_t *led_strip_new_rmt_ws2812(const led_strip_config_t *config)
     ws2812->strip_len = config->max_leds;
 
     ws2812->parent.set_pixel = ws2812_set_pixel;
+    ws2812->parent.set_pixels = ws2812_set_pixels;
     ws2812->parent.refresh = ws2812_refresh;
     ws2812->parent.clear = ws2812_clear;
     ws2812->parent.del = ws2812_del;
@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/cdefs.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "led_strip.h"
+#include "buffer_placement.h"
+#include "driver/spi_master.h"
+
+static const char *TAG = "ws2812_spi";
+#define STRIP_CHECK(a, str, goto_tag, ret_value, ...)                             \
+    do                                                                            \
+    {                                                                             \
+        if (!(a))                                                                 \
+        {                                                                         \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            ret = ret_value;                                                      \
+            goto goto_tag;                                                        \
+        }                                                                         \
+    } while (0)
+
+/**
+* Every WS2812 bit is sent as 4 SPI bits of 312.5 ns:
+*  - 0: 1000, high during 312 ns then low during 938 ns
+*  - 1: 1110, high during 938 ns then low during 312 ns
+* within the tolerances of the WS2812 (T0H 400 ns, T1H 800 ns, +-150 ns, 1.25 us per bit).
+* One SPI byte encodes 2 WS2812 bits, one color component takes 4 SPI bytes.
+*/
+#define WS2812_SPI_CLOCK_HZ (3200000)
+
+/**
+* @brief SPI bytes of every pair of WS2812 bits, MSB first
+*/
+static const uint8_t ws2812_spi_symbols[4] = { 0x88, 0x8E, 0xE8, 0xEE };
+
+typedef struct {
+    led_strip_t parent;
+    spi_device_handle_t spi;
+    uint32_t strip_len;
+    // G, R, B per led, bulk storage
+    uint8_t *pixels;
+    // DMA buffer, WS2812_SPI_BYTES_PER_LED per led followed by the reset (low) bytes
+    uint8_t *buffer;
+} ws2812_spi_t;
+
+static inline void ws2812_spi_encode(uint8_t *dest, uint8_t value)
+{
+    dest[0] = ws2812_spi_symbols[(value >> 6) & 0x3];
+    dest[1] = ws2812_spi_symbols[(value >> 4) & 0x3];
+    dest[2] = ws2812_spi_symbols[(value >> 2) & 0x3];
+    dest[3] = ws2812_spi_symbols[value & 0x3];
+}
+
+static inline void ws2812_spi_store_pixel(uint8_t *dest, uint32_t red, uint32_t green, uint32_t blue)
+{
+    // In thr order of GRB
+    dest[0] = green & 0xFF;
+    dest[1] = red & 0xFF;
+    dest[2] = blue & 0xFF;
+}
+
+static esp_err_t ws2812_spi_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
+{
+    esp_err_t ret = ESP_OK;
+    ws2812_spi_t *ws2812 = __containerof(strip, ws2812_spi_t, parent);
+    STRIP_CHECK(index < ws2812->strip_len, "index out of the maximum number of leds", err, ESP_ERR_INVALID_ARG);
+    ws2812_spi_store_pixel(ws2812->pixels + index * 3, red, green, blue);
+    return ESP_OK;
+err:
+    return ret;
+}
+
+static esp_err_t ws2812_spi_set_pixels(led_strip_t *strip, const uint8_t *rgb, const uint16_t *lut, uint32_t count, uint32_t scale)
+{
+    esp_err_t ret = ESP_OK;
+    ws2812_spi_t *ws2812 = __containerof(strip, ws2812_spi_t, parent);
+    STRIP_CHECK(rgb && lut, "pixels and lookup table can't be null", err, ESP_ERR_INVALID_ARG);
+    for (uint32_t i = 0; i < count; i++, rgb += 3) {
+        STRIP_CHECK(lut[i] < ws2812->strip_len, "index out of the maximum number of leds", err, ESP_ERR_INVALID_ARG);
+        ws2812_spi_store_pixel(ws2812->pixels + lut[i] * 3,
+                               (rgb[0] * scale) >> 8, (rgb[1] * scale) >> 8, (rgb[2] * scale) >> 8);
+    }
+    return ESP_OK;
+err:
+    return ret;
+}
+
+static esp_err_t ws2812_spi_refresh(led_strip_t *strip, uint32_t timeout_ms)
+{
+    esp_err_t ret = ESP_OK;
+    ws2812_spi_t *ws2812 = __containerof(strip, ws2812_spi_t, parent);
+    for (uint32_t i = 0; i < 3 * ws2812->strip_len; i++) {
+        ws2812_spi_encode(ws2812->buffer + 4 * i, ws2812->pixels[i]);
+    }
+    spi_transaction_t transaction = {
+        .length = 8 * LED_STRIP_SPI_BUFFER_SIZE(ws2812->strip_len),
+        .tx_buffer = ws2812->buffer,
+    };
+    spi_transaction_t *result;
+    // One DMA transfer for the whole strip, the CPU is only notified at the end.
+    // Between two transfers, the line would stay low long enough for the LEDs to latch.
+    STRIP_CHECK(spi_device_queue_trans(ws2812->spi, &transaction, pdMS_TO_TICKS(timeout_ms)) == ESP_OK,
+                "queue SPI transaction failed", err, ESP_FAIL);
+    return spi_device_get_trans_result(ws2812->spi, &result, pdMS_TO_TICKS(timeout_ms));
+err:
+    return ret;
+}
+
+static esp_err_t ws2812_spi_clear(led_strip_t *strip, uint32_t timeout_ms)
+{
+    ws2812_spi_t *ws2812 = __containerof(strip, ws2812_spi_t, parent);
+    memset(ws2812->pixels, 0, ws2812->strip_len * 3);
+    return ws2812_spi_refresh(strip, timeout_ms);
+}
+
+static void ws2812_spi_free(ws2812_spi_t *ws2812)
+{
+    free(ws2812->pixels);
+    free(ws2812->buffer);
+    free(ws2812);
+}
+
+static esp_err_t ws2812_spi_del(led_strip_t *strip)
+{
+    ws2812_spi_t *ws2812 = __containerof(strip, ws2812_spi_t, parent);
+    spi_bus_remove_device(ws2812->spi);
+    ws2812_spi_free(ws2812);
+    return ESP_OK;
+}
+
+led_strip_t *led_strip_new_spi_ws2812(const led_strip_config_t *config)
+{
+    led_strip_t *ret = NULL;
+    ws2812_spi_t *ws2812 = NULL;
+    STRIP_CHECK(config, "configuration can't be null", err, NULL);
+
+    ws2812 = calloc(1, sizeof(ws2812_spi_t));
+    STRIP_CHECK(ws2812, "request memory for ws2812 failed", err, NULL);
+    ws2812->pixels = bulk_calloc(config->max_leds, 3);
+    STRIP_CHECK(ws2812->pixels, "request memory for ws2812 pixels failed", err, NULL);
+    // Zeroed: the reset bytes at the end stay low
+    ws2812->buffer = dma_calloc(LED_STRIP_SPI_BUFFER_SIZE(config->max_leds));
+    STRIP_CHECK(ws2812->buffer, "request DMA memory for ws2812 failed", err, NULL);
+
+    spi_device_interface_config_t device_config = {
+        .clock_speed_hz = WS2812_SPI_CLOCK_HZ,
+        .mode = 0,
+        .spics_io_num = -1,
+        .queue_size = 1,
+    };
+    STRIP_CHECK(spi_bus_add_device((spi_host_device_t)config->dev, &device_config, &ws2812->spi) == ESP_OK,
+                "add SPI device failed", err, NULL);
+    ws2812->strip_len = config->max_leds;
+
+    ws2812->parent.set_pixel = ws2812_spi_set_pixel;
+    ws2812->parent.set_pixels = ws2812_spi_set_pixels;
+    ws2812->parent.refresh = ws2812_spi_refresh;
+    ws2812->parent.clear = ws2812_spi_clear;
+    ws2812->parent.del = ws2812_spi_del;
+
+    return &ws2812->parent;
+err:
+    if (ws2812) {
+        ws2812_spi_free(ws2812);
+    }
+    return ret;
+}
@@ -0,0 +1,70 @@
+// Compile-time sizes derived from the configuration selected in menuconfig
+
+#ifndef APP_CONFIG_H
+#define APP_CONFIG_H
+
+#include "sdkconfig.h"
+
+#include <rmw_microxrcedds_c/config.h>
+#include "uxr/client/config.h"
+
+#define LED_NUMBER (CONFIG_LED_PANEL_WIDTH * CONFIG_LED_PANEL_HEIGHT * CONFIG_LED_TILES_X * CONFIG_LED_TILES_Y)
+// RGB
+#define STRIP_BUFFER_SIZE (3 * LED_NUMBER)
+// Bound of LedImage.data: 1024 pixels
+#define LED_IMAGE_MAX_DATA_SIZE 3072
+_Static_assert(STRIP_BUFFER_SIZE <= LED_IMAGE_MAX_DATA_SIZE, "At most 1024 LEDs (LedImage size)");
+// Upper bound of the CDR size of a LedImage of the panels:
+// encapsulation, width, height, data length, data, padding, transition_ms
+#define LED_IMAGE_MAX_SERIALIZED_SIZE (15 + STRIP_BUFFER_SIZE)
+// XRCE message, submessage and data headers
+#define XRCE_MESSAGE_OVERHEAD 32
+
+#if defined(UCLIENT_PROFILE_UDP) && defined(CONFIG_INPUT_IMAGE)
+#ifdef CONFIG_PIXEL_QOS_BEST_EFFORT
+_Static_assert(LED_IMAGE_MAX_SERIALIZED_SIZE + XRCE_MESSAGE_OVERHEAD <= UXR_CONFIG_UDP_TRANSPORT_MTU,
+               "Best effort LedImage must fit in one MTU: select PIXEL_QOS_RELIABLE, "
+               "increase UCLIENT_UDP_TRANSPORT_MTU or reduce the panels");
+#else
+_Static_assert(LED_IMAGE_MAX_SERIALIZED_SIZE + XRCE_MESSAGE_OVERHEAD <= UXR_CONFIG_UDP_TRANSPORT_MTU * RMW_UXRCE_STREAM_HISTORY,
+               "Reliable LedImage must fit in the input stream: increase UCLIENT_UDP_TRANSPORT_MTU "
+               "or RMW_UXRCE_STREAM_HISTORY or reduce the panels");
+#endif
+#endif
+// color or image subscription + set_brightness service
+// (+ store_scene and recall_scene services + scene subscription)
+#ifdef CONFIG_SCENE_STORE_ENABLE
+#define EXECUTOR_HANDLES 5
+#else
+#define EXECUTOR_HANDLES 2
+#endif
+
+#if defined(CONFIG_LED_ROTATION_90)
+#define LED_ROTATION LED_LAYOUT_ROTATION_90
+#elif defined(CONFIG_LED_ROTATION_180)
+#define LED_ROTATION LED_LAYOUT_ROTATION_180
+#elif defined(CONFIG_LED_ROTATION_270)
+#define LED_ROTATION LED_LAYOUT_ROTATION_270
+#else
+#define LED_ROTATION LED_LAYOUT_ROTATION_0
+#endif
+
+#ifdef CONFIG_LED_PANEL_SERPENTINE
+#define LED_WIRING LED_LAYOUT_SERPENTINE
+#else
+#define LED_WIRING LED_LAYOUT_ROW_MAJOR
+#endif
+
+#ifdef CONFIG_LED_MIRROR_X
+#define LED_MIRROR_X true
+#else
+#define LED_MIRROR_X false
+#endif
+
+#ifdef CONFIG_LED_MIRROR_Y
+#define LED_MIRROR_Y true
+#else
+#define LED_MIRROR_Y false
+#endif
+
+#endif /* end of include guard: APP_CONFIG_H */
@@ -2,3 +2,10 @@
 # Main Makefile. This is basically the same as a component makefile.
 #
 # (Uses default behaviour of compiling all source files in directory, adding 'include' to include path.)
+
+# Size of the scenes partition (hexadecimal or decimal), for the static check
+# of the scene size (SCENE_STORE_ENABLE)
+SCENES_PARTITION_SIZE := $(shell awk -F, '/^scenes,/ {gsub(/[ \t]/, "", $$5); print $$5}' $(PROJECT_PATH)/$(call dequote,$(CONFIG_PARTITION_TABLE_CUSTOM_FILENAME)))
+ifneq ($(SCENES_PARTITION_SIZE),)
+CFLAGS += -DSCENES_PARTITION_SIZE=$(SCENES_PARTITION_SIZE)
+endif
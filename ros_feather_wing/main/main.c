@@ -3,72 +3,414 @@
 #include <unistd.h>
 
 #include "sdkconfig.h"
+#include "app_config.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 
+#ifdef CONFIG_LED_STRIP_SPI
+#include "driver/spi_master.h"
+#else
 #include "driver/rmt.h"
+#endif
 
 #include <rcl/rcl.h>
 #include <rcl/error_handling.h>
 #include <rclc/rclc.h>
 #include <rclc/executor.h>
 #include <rmw_uros/options.h>
+#include <rmw_microxrcedds_c/config.h>
 
 #include <uros_network_interfaces.h>
 #include "uxr/client/config.h"
 
+#ifdef CONFIG_INPUT_IMAGE
+#include <led_strip_msgs/msg/led_image.h>
+#else
 #include <std_msgs/msg/color_rgba.h>
+#endif
 #include <led_strip_msgs/srv/set_brightness.h>
 
 #include "blue_led.h"
+#ifdef RMW_UXRCE_TRANSPORT_CUSTOM
+#include "uros_serial_transport.h"
+#else
+#include "uros_agent_cache.h"
+#endif
+#include "boot_trace.h"
+#include "uros_reconnect.h"
+#include "buffer_placement.h"
 #include "led_strip.h"
+#include "led_layout.h"
+#ifdef CONFIG_KEYFRAME_ENABLE
+#include "keyframe.h"
+#endif
+#ifdef CONFIG_DDP_ENABLE
+#include "ddp.h"
+#endif
+#ifdef CONFIG_SCENE_STORE_ENABLE
+#include <led_strip_msgs/msg/scene.h>
+#include <led_strip_msgs/srv/store_scene.h>
+#include <led_strip_msgs/srv/recall_scene.h>
+#include "scene_store.h"
+#endif
 
 static const char *TAG = "FEATHER_WING";
 
-#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){ESP_LOGE(TAG, "Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
+#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){ESP_LOGE(TAG, "Failed status on line %d: %d. Retrying.\n",__LINE__,(int)temp_rc);return false;}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){ESP_LOGE(TAG, "Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
 
-#define LED_NUMBER 32
-#define RMT_TX_GPIO 38
+#ifdef CONFIG_LED_STRIP_SPI
+#define LED_SPI_HOST SPI2_HOST
+#else
 #define RMT_TX_CHANNEL RMT_CHANNEL_0
-#define DEFAULT_BRIGHTNESS 0.1
+#endif
+#define DEFAULT_BRIGHTNESS (CONFIG_DEFAULT_BRIGHTNESS_PERCENT / 100.0)
 
 #define NODE_NAME "feather_wing"
-#define NODE_NS "led_0"
-
-
-
+#define NODE_NS CONFIG_NODE_NAMESPACE
+
+#ifdef CONFIG_INPUT_IMAGE
+#define INPUT_TYPE_SUPPORT ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, LedImage)
+#define INPUT_TOPIC "image"
+#else
+#define INPUT_TYPE_SUPPORT ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, ColorRGBA)
+#define INPUT_TOPIC "color"
+#endif
+
+static rclc_support_t support;
+static rcl_node_t node;
 static rcl_subscription_t subscriber;
+static rcl_service_t brightness_service;
+static rclc_executor_t executor;
+static bool support_ready = false;
+#ifdef CONFIG_INPUT_IMAGE
+static led_strip_msgs__msg__LedImage msg;
+// Any LedImage is received, then cropped to the layout
+static BULK_ATTR uint8_t msg_data[LED_IMAGE_MAX_DATA_SIZE];
+#else
 static std_msgs__msg__ColorRGBA msg;
+#endif
+static led_strip_msgs__srv__SetBrightness_Response res;
+static led_strip_msgs__srv__SetBrightness_Request req;
+
+typedef enum {
+  SOURCE_COLOR,
+  SOURCE_IMAGE,
+  SOURCE_DDP,
+  SOURCE_SCENE
+} source_t;
 
 static led_strip_t *strip;
+static led_layout_t *layout;
+// What the LEDs show, before applying the brightness
+static source_t source = SOURCE_COLOR;
 static float current_red;
 static float current_green;
 static float current_blue;
 static float brightness = DEFAULT_BRIGHTNESS;
+// Serializes the access to the strip between micro-ROS and DDP
+static SemaphoreHandle_t strip_mutex;
+
+#ifdef CONFIG_DDP_ENABLE
+// Last RGB image received through DDP, row-major
+static BULK_ATTR uint8_t ddp_buffer[STRIP_BUFFER_SIZE];
+#endif
+
+#ifdef CONFIG_SCENE_STORE_ENABLE
+// A scene is an image of the layout size, row-major, after this header
+typedef struct {
+  uint16_t width;
+  uint16_t height;
+} scene_header_t;
+#define SCENE_MAX_SIZE (sizeof(scene_header_t) + STRIP_BUFFER_SIZE)
+// SCENES_PARTITION_SIZE is read from partitions.csv by CMakeLists.txt
+#ifndef SCENES_PARTITION_SIZE
+#error "SCENE_STORE_ENABLE needs a scenes partition in partitions.csv"
+#endif
+_Static_assert(CONFIG_SCENE_STORE_MIN_SCENES * SCENE_STORE_SLOT_SIZE(SCENE_MAX_SIZE) <= SCENES_PARTITION_SIZE,
+               "The scenes partition of partitions.csv cannot hold SCENE_STORE_MIN_SCENES scenes: "
+               "grow it, or reduce the panels");
+
+static rcl_service_t store_scene_service;
+static rcl_service_t recall_scene_service;
+static rcl_subscription_t scene_subscriber;
+static led_strip_msgs__srv__StoreScene_Request store_scene_req;
+static led_strip_msgs__srv__StoreScene_Response store_scene_res;
+static led_strip_msgs__srv__RecallScene_Request recall_scene_req;
+static led_strip_msgs__srv__RecallScene_Response recall_scene_res;
+static led_strip_msgs__msg__Scene scene_msg;
+// The pixels of the recalled scene, in the mapped flash
+static const uint8_t *scene_pixels = NULL;
+static int shown_scene = -1;
+#endif
+
+#ifdef CONFIG_INPUT_IMAGE
+// Crops or pads the received image to the layout
+static void crop_image(uint8_t *image) {
+  const size_t row_size = 3 * layout->width;
+  const size_t msg_row_size = 3 * msg.width;
+  const size_t size = msg_row_size < row_size ? msg_row_size : row_size;
+  memset(image, 0, STRIP_BUFFER_SIZE);
+  for (size_t row = 0; row < layout->height && row < msg.height; row++) {
+    if ((row + 1) * msg_row_size > msg.data.size) {
+      break;
+    }
+    memcpy(image + row * row_size, msg.data.data + row * msg_row_size, size);
+  }
+}
+#endif
+
+#ifdef CONFIG_KEYFRAME_ENABLE
+#define KEYFRAME_PERIOD_MS (1000 / CONFIG_KEYFRAME_OUTPUT_FPS)
+#ifdef CONFIG_KEYFRAME_EASE_IN_OUT
+#define KEYFRAME_EASING KEYFRAME_EASE_IN_OUT
+#else
+#define KEYFRAME_EASING KEYFRAME_LINEAR
+#endif
+// Images of the layout size, row-major: the output is blended
+// from what was shown when the last keyframe arrived to the keyframe.
+static BULK_ATTR uint8_t keyframe_from[STRIP_BUFFER_SIZE];
+static BULK_ATTR uint8_t keyframe_to[STRIP_BUFFER_SIZE];
+static BULK_ATTR uint8_t keyframe_output[STRIP_BUFFER_SIZE];
+static keyframe_transition_t transition;
+
+// Must be called holding strip_mutex
+static void start_transition() {
+  if (source == SOURCE_IMAGE) {
+    memcpy(keyframe_from, keyframe_output, STRIP_BUFFER_SIZE);
+  }
+  crop_image(keyframe_to);
+  if (source == SOURCE_IMAGE) {
+    keyframe_start(&transition, esp_timer_get_time(), msg.transition_ms, KEYFRAME_EASING);
+  } else {
+    transition.active = false;
+  }
+}
+#endif
+
+// Must be called holding strip_mutex
+static void render() {
+  const uint32_t scale = (uint32_t) (256 * brightness);
+  switch (source) {
+    case SOURCE_COLOR: {
+      uint8_t red = (uint32_t) (255 * current_red * brightness);
+      uint8_t green = (uint32_t) (255 * current_green * brightness);
+      uint8_t blue = (uint32_t ) (255 * current_blue * brightness);
+      for (size_t i = 0; i < LED_NUMBER; i++) {
+        ESP_ERROR_CHECK(strip->set_pixel(strip, i, red, green, blue));
+      }
+      break;
+    }
+#ifdef CONFIG_INPUT_IMAGE
+    case SOURCE_IMAGE: {
+#ifdef CONFIG_KEYFRAME_ENABLE
+      const uint16_t weight = keyframe_weight(&transition, esp_timer_get_time());
+      keyframe_blend(keyframe_output, keyframe_from, keyframe_to, STRIP_BUFFER_SIZE, weight);
+      led_layout_blit(layout, strip, keyframe_output, layout->width, layout->height, scale);
+#else
+      if (!msg.width) {
+        break;
+      }
+      // Ignore the rows missing from the data
+      uint16_t height = msg.data.size / (3 * msg.width);
+      if (height > msg.height) {
+        height = msg.height;
+      }
+      led_layout_blit(layout, strip, msg.data.data, msg.width, height, scale);
+#endif
+      break;
+    }
+#endif
+#ifdef CONFIG_DDP_ENABLE
+    case SOURCE_DDP:
+      led_layout_blit(layout, strip, ddp_buffer, layout->width, layout->height, scale);
+      break;
+#endif
+#ifdef CONFIG_SCENE_STORE_ENABLE
+    case SOURCE_SCENE:
+      // From the flash to the strip
+      led_layout_blit(layout, strip, scene_pixels, layout->width, layout->height, scale);
+      break;
+#endif
+    default:
+      break;
+  }
+  if (strip->refresh(strip, 100) != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to refresh the strip");
+  }
+  boot_trace_done("first frame");
+}
+
+static void show(source_t _source) {
+  xSemaphoreTake(strip_mutex, portMAX_DELAY);
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  if (_source != SOURCE_SCENE) {
+    shown_scene = -1;
+  }
+#endif
+  source = _source;
+  render();
+  xSemaphoreGive(strip_mutex);
+}
+
+#ifdef CONFIG_DDP_ENABLE
+static void ddp_data_callback(uint8_t destination, uint32_t offset, const uint8_t *data, size_t size, void *arg) {
+  if (destination != DDP_ID_DISPLAY || offset >= sizeof(ddp_buffer)) {
+    return;
+  }
+  if (offset + size > sizeof(ddp_buffer)) {
+    size = sizeof(ddp_buffer) - offset;
+  }
+  // render() may be reading it from micro-ROS
+  xSemaphoreTake(strip_mutex, portMAX_DELAY);
+  memcpy(ddp_buffer + offset, data, size);
+  xSemaphoreGive(strip_mutex);
+}
 
-static void has_set_color() {
-  uint8_t red = (uint32_t) (255 * current_red * brightness);
-  uint8_t green = (uint32_t) (255 * current_green * brightness);
-  uint8_t blue = (uint32_t ) (255 * current_blue * brightness);
-  for (size_t i = 0; i < LED_NUMBER; i++) {
-    ESP_ERROR_CHECK(strip->set_pixel(strip, i, red, green, blue));
+static void ddp_push_callback(uint8_t destination, void *arg) {
+  show(SOURCE_DDP);
+}
+#endif
+
+#ifdef CONFIG_KEYFRAME_ENABLE
+// Renders the running transition, returns false if there is none
+static bool animate() {
+  xSemaphoreTake(strip_mutex, portMAX_DELAY);
+  const bool animating = transition.active && source == SOURCE_IMAGE;
+  if (animating) {
+    render();
   }
-  ESP_ERROR_CHECK(strip->refresh(strip, 100));
+  xSemaphoreGive(strip_mutex);
+  return animating;
 }
+#endif
 
 static void subscription_callback(const void * msgin) {
+#ifdef CONFIG_KEYFRAME_ENABLE
+  xSemaphoreTake(strip_mutex, portMAX_DELAY);
+  start_transition();
+  source = SOURCE_IMAGE;
+  render();
+  xSemaphoreGive(strip_mutex);
+#elif defined(CONFIG_INPUT_IMAGE)
+  show(SOURCE_IMAGE);
+#else
   const std_msgs__msg__ColorRGBA * _msg = (const std_msgs__msg__ColorRGBA *)msgin;
   current_red = _msg->r;
   current_green = _msg->g;
   current_blue = _msg->b;
-  has_set_color();
+  show(SOURCE_COLOR);
+#endif
+}
+
+#ifdef CONFIG_SCENE_STORE_ENABLE
+// Must be called holding strip_mutex.
+// Writes what the LEDs show (before brightness) to the open scene.
+static esp_err_t store_image() {
+  static BULK_ATTR uint8_t image[STRIP_BUFFER_SIZE];
+  switch (source) {
+    case SOURCE_COLOR: {
+      const uint8_t rgb[3] = {
+        (uint8_t) (255 * current_red), (uint8_t) (255 * current_green), (uint8_t) (255 * current_blue)
+      };
+      for (size_t i = 0; i < LED_NUMBER; i++) {
+        memcpy(image + 3 * i, rgb, 3);
+      }
+      break;
+    }
+#ifdef CONFIG_INPUT_IMAGE
+    case SOURCE_IMAGE:
+#ifdef CONFIG_KEYFRAME_ENABLE
+      return scene_store_append(keyframe_output, STRIP_BUFFER_SIZE);
+#else
+      crop_image(image);
+      break;
+#endif
+#endif
+#ifdef CONFIG_DDP_ENABLE
+    case SOURCE_DDP:
+      return scene_store_append(ddp_buffer, STRIP_BUFFER_SIZE);
+#endif
+    case SOURCE_SCENE:
+      // Flash to flash, through the bounce buffer of the flash driver
+      return scene_store_append(scene_pixels, STRIP_BUFFER_SIZE);
+    default:
+      return ESP_ERR_INVALID_STATE;
+  }
+  return scene_store_append(image, STRIP_BUFFER_SIZE);
+}
+
+static bool store_scene(uint8_t id) {
+  xSemaphoreTake(strip_mutex, portMAX_DELAY);
+  if (shown_scene == id) {
+    xSemaphoreGive(strip_mutex);
+    return true;
+  }
+  const scene_header_t header = {.width = layout->width, .height = layout->height};
+  esp_err_t err = scene_store_begin(id);
+  if (err == ESP_OK) {
+    err = scene_store_append(&header, sizeof(header));
+  }
+  if (err == ESP_OK) {
+    err = store_image();
+  }
+  if (err == ESP_OK) {
+    err = scene_store_end();
+  }
+  xSemaphoreGive(strip_mutex);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Cannot store scene %u: %s", id, esp_err_to_name(err));
+    return false;
+  }
+  return true;
+}
+
+static bool recall_scene(uint8_t id) {
+  size_t size;
+  const uint8_t *scene = scene_store_get(id, &size);
+  if (!scene || size != SCENE_MAX_SIZE) {
+    return false;
+  }
+  const scene_header_t *header = (const scene_header_t *) scene;
+  if (header->width != layout->width || header->height != layout->height) {
+    ESP_LOGW(TAG, "Scene %u is for a %ux%u layout", id, header->width, header->height);
+    return false;
+  }
+  xSemaphoreTake(strip_mutex, portMAX_DELAY);
+  scene_pixels = scene + sizeof(scene_header_t);
+  shown_scene = id;
+  source = SOURCE_SCENE;
+  render();
+  xSemaphoreGive(strip_mutex);
+  return true;
 }
 
+static void store_scene_service_callback(const void * req, void * res) {
+  const led_strip_msgs__srv__StoreScene_Request * req_in = (const led_strip_msgs__srv__StoreScene_Request *) req;
+  led_strip_msgs__srv__StoreScene_Response * res_out = (led_strip_msgs__srv__StoreScene_Response *) res;
+  res_out->success = store_scene(req_in->id);
+}
+
+static void recall_scene_service_callback(const void * req, void * res) {
+  const led_strip_msgs__srv__RecallScene_Request * req_in = (const led_strip_msgs__srv__RecallScene_Request *) req;
+  led_strip_msgs__srv__RecallScene_Response * res_out = (led_strip_msgs__srv__RecallScene_Response *) res;
+  res_out->success = recall_scene(req_in->id);
+}
+
+static void scene_callback(const void * msgin) {
+  const led_strip_msgs__msg__Scene * _msg = (const led_strip_msgs__msg__Scene *) msgin;
+  if (!recall_scene(_msg->id)) {
+    ESP_LOGW(TAG, "No scene %u", _msg->id);
+  }
+}
+#endif
+
 static void brightness_service_callback(const void * req, void * res){
   led_strip_msgs__srv__SetBrightness_Request * req_in = (led_strip_msgs__srv__SetBrightness_Request *) req;
   brightness = req_in->brightness;
@@ -77,66 +419,152 @@ static void brightness_service_callback(const void * req, void * res){
   } else if (brightness > 1.0) {
     brightness = 1.0;
   }
-  has_set_color();
+  show(source);
 }
 
-void micro_ros_task(void * arg) {
-  blue_led_set(1);
-
+static bool create_entities() {
   rcl_allocator_t allocator = rcl_get_default_allocator();
-  rclc_support_t support;
-
   rcl_init_options_t init_options = rcl_get_zero_initialized_init_options();
   RCCHECK(rcl_init_options_init(&init_options, allocator));
   rmw_init_options_t* rmw_options = rcl_init_options_get_rmw_init_options(&init_options);
-
-  while(rmw_uros_discover_agent(rmw_options) != RCL_RET_OK){
-    ESP_LOGW(TAG, "Micro-ROS agent not found\n");
-    usleep(100000);
+#ifdef RMW_UXRCE_TRANSPORT_CUSTOM
+  // No discovery on a serial link: check that the agent is there
+  if (rmw_uros_ping_agent(UROS_RECONNECT_PING_TIMEOUT_MS, 1) != RMW_RET_OK) {
+#else
+  // Try the agent of the last session first
+  if (uros_agent_cache_find_agent(rmw_options) != RMW_RET_OK) {
+#endif
+    RCSOFTCHECK(rcl_init_options_fini(&init_options));
+    return false;
   }
+  boot_trace_mark("agent found");
 
   // create init_options
-  RCCHECK(rclc_support_init_with_options(&support, 0, NULL, &init_options, &allocator));
+  rcl_ret_t rc = rclc_support_init_with_options(&support, 0, NULL, &init_options, &allocator);
+  RCSOFTCHECK(rcl_init_options_fini(&init_options));
+  RCCHECK(rc);
+  support_ready = true;
 
   // create node
-  rcl_node_t node;
+  node = rcl_get_zero_initialized_node();
   RCCHECK(rclc_node_init_default(&node, NODE_NAME, NODE_NS, &support));
 
   // create subscriber
+  subscriber = rcl_get_zero_initialized_subscription();
+#ifdef CONFIG_PIXEL_QOS_BEST_EFFORT
+  rmw_qos_profile_t pixel_qos = rmw_qos_profile_sensor_data;
+  pixel_qos.depth = 1;
+  RCCHECK(rclc_subscription_init(
+      &subscriber, &node, INPUT_TYPE_SUPPORT, INPUT_TOPIC, &pixel_qos));
+#else
   RCCHECK(rclc_subscription_init_default(
-      &subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, ColorRGBA), "color"));
+      &subscriber, &node, INPUT_TYPE_SUPPORT, INPUT_TOPIC));
+#endif
 
   // create service
-  rcl_service_t brightness_service;
+  brightness_service = rcl_get_zero_initialized_service();
   RCCHECK(rclc_service_init_default(&brightness_service, &node, ROSIDL_GET_SRV_TYPE_SUPPORT(led_strip_msgs, srv, SetBrightness), "set_brightness"));
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  store_scene_service = rcl_get_zero_initialized_service();
+  RCCHECK(rclc_service_init_default(&store_scene_service, &node, ROSIDL_GET_SRV_TYPE_SUPPORT(led_strip_msgs, srv, StoreScene), "store_scene"));
+  recall_scene_service = rcl_get_zero_initialized_service();
+  RCCHECK(rclc_service_init_default(&recall_scene_service, &node, ROSIDL_GET_SRV_TYPE_SUPPORT(led_strip_msgs, srv, RecallScene), "recall_scene"));
+  scene_subscriber = rcl_get_zero_initialized_subscription();
+  RCCHECK(rclc_subscription_init_default(
+      &scene_subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, Scene), "scene"));
+#endif
 
   // create executor
-  rclc_executor_t executor;
-  RCCHECK(rclc_executor_init(&executor, &support.context, 2, &allocator));
+  executor = rclc_executor_get_zero_initialized_executor();
+  RCCHECK(rclc_executor_init(&executor, &support.context, EXECUTOR_HANDLES, &allocator));
   RCCHECK(rclc_executor_add_subscription(&executor, &subscriber, &msg, &subscription_callback, ON_NEW_DATA));
-  led_strip_msgs__srv__SetBrightness_Response res;
-  led_strip_msgs__srv__SetBrightness_Request req;
   RCCHECK(rclc_executor_add_service(&executor, &brightness_service, &req, &res, brightness_service_callback));
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  RCCHECK(rclc_executor_add_service(&executor, &store_scene_service, &store_scene_req, &store_scene_res, store_scene_service_callback));
+  RCCHECK(rclc_executor_add_service(&executor, &recall_scene_service, &recall_scene_req, &recall_scene_res, recall_scene_service_callback));
+  RCCHECK(rclc_executor_add_subscription(&executor, &scene_subscriber, &scene_msg, &scene_callback, ON_NEW_DATA));
+#endif
+  return true;
+}
 
-  blue_led_set(0);
-  while(1){
-    rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
-    usleep(10000);
+// Safe to call on partially created entities.
+static void destroy_entities() {
+  if (!support_ready) {
+    return;
   }
+  // The agent is likely gone: don't wait for it to confirm the deletions.
+  rmw_context_t * rmw_context = rcl_context_get_rmw_context(&support.context);
+  (void) rmw_uros_set_context_entity_destroy_session_timeout(rmw_context, 0);
+
+  RCSOFTCHECK(rclc_executor_fini(&executor));
+  RCSOFTCHECK(rcl_service_fini(&brightness_service, &node));
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  RCSOFTCHECK(rcl_service_fini(&store_scene_service, &node));
+  RCSOFTCHECK(rcl_service_fini(&recall_scene_service, &node));
+  RCSOFTCHECK(rcl_subscription_fini(&scene_subscriber, &node));
+#endif
+  RCSOFTCHECK(rcl_subscription_fini(&subscriber, &node));
+  RCSOFTCHECK(rcl_node_fini(&node));
+  RCSOFTCHECK(rclc_support_fini(&support));
+  support_ready = false;
+}
 
-  // free resources
-  RCCHECK(rcl_service_fini(&brightness_service, &node));
-  RCCHECK(rcl_subscription_fini(&subscriber, &node));
-  RCCHECK(rcl_node_fini(&node));
+// The blue LED is on while waiting for the agent.
+// The matrix keeps displaying the last color while we reconnect.
+static void agent_state_changed(uros_reconnect_state_t state) {
+  blue_led_set(state == UROS_RECONNECT_WAITING_AGENT);
+}
 
-  vTaskDelete(NULL);
+static rcl_ret_t spin() {
+#ifdef CONFIG_KEYFRAME_ENABLE
+  // Render the transition at the output frame rate
+  const bool animating = animate();
+  const int64_t spin_timeout = animating ? RCL_MS_TO_NS(KEYFRAME_PERIOD_MS) : RCL_MS_TO_NS(100);
+#else
+  const bool animating = false;
+  const int64_t spin_timeout = RCL_MS_TO_NS(100);
+#endif
+  const rcl_ret_t rc = rclc_executor_spin_some(&executor, spin_timeout);
+  if (!animating) {
+    usleep(10000);
+  }
+  return rc;
 }
 
-void app_main(void) {
+void micro_ros_task(void * arg) {
+  const uros_reconnect_config_t config = {
+    .create_entities = create_entities,
+    .destroy_entities = destroy_entities,
+    .spin = spin,
+    .state_changed = agent_state_changed,
+  };
+  uros_reconnect_run(&config);
+}
+
+// Runs while the network comes up. Sets peripherals_ok if the strip and
+// the layout are ready: nothing can be shown without them.
+static bool peripherals_ok = false;
 
+static void init_peripherals_task(void * arg) {
+  SemaphoreHandle_t ready = (SemaphoreHandle_t) arg;
   blue_led_init();
+#ifdef CONFIG_LED_STRIP_SPI
+  spi_bus_config_t bus_config = {
+    .mosi_io_num = CONFIG_RMT_TX_GPIO,
+    .miso_io_num = -1,
+    .sclk_io_num = -1,
+    .quadwp_io_num = -1,
+    .quadhd_io_num = -1,
+    .max_transfer_sz = LED_STRIP_SPI_BUFFER_SIZE(LED_NUMBER),
+  };
+  // On the ESP32-S2, the DMA channel of a SPI host is the host id
+  ESP_ERROR_CHECK(spi_bus_initialize(LED_SPI_HOST, &bus_config, LED_SPI_HOST));
 
-  rmt_config_t config = RMT_DEFAULT_CONFIG_TX(RMT_TX_GPIO, RMT_TX_CHANNEL);
+  // initialize ws2812 driver
+  led_strip_config_t strip_config = LED_STRIP_DEFAULT_CONFIG(LED_NUMBER, (led_strip_dev_t)LED_SPI_HOST);
+  strip = led_strip_new_spi_ws2812(&strip_config);
+#else
+  rmt_config_t config = RMT_DEFAULT_CONFIG_TX(CONFIG_RMT_TX_GPIO, RMT_TX_CHANNEL);
   config.clk_div = 2;
 
   ESP_ERROR_CHECK(rmt_config(&config));
@@ -145,15 +573,75 @@ void app_main(void) {
   // initialize ws2812 driver
   led_strip_config_t strip_config = LED_STRIP_DEFAULT_CONFIG(LED_NUMBER, (led_strip_dev_t)config.channel);
   strip = led_strip_new_rmt_ws2812(&strip_config);
+#endif
   if (!strip) {
     ESP_LOGE(TAG, "initialization of WS2812 driver failed");
+    goto done;
   }
   ESP_ERROR_CHECK(strip->clear(strip, 100));
 
+  led_layout_config_t layout_config = {
+    .panel_width = CONFIG_LED_PANEL_WIDTH,
+    .panel_height = CONFIG_LED_PANEL_HEIGHT,
+    .tiles_x = CONFIG_LED_TILES_X,
+    .tiles_y = CONFIG_LED_TILES_Y,
+    .wiring = LED_WIRING,
+    .rotation = LED_ROTATION,
+    .mirror_x = LED_MIRROR_X,
+    .mirror_y = LED_MIRROR_Y
+  };
+  layout = led_layout_new(&layout_config);
+  // render() and the scenes use it
+  if (!layout) {
+    ESP_LOGE(TAG, "initialization of the LED layout failed");
+    goto done;
+  }
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  if (scene_store_init(SCENE_MAX_SIZE) != ESP_OK) {
+    ESP_LOGE(TAG, "No scene store: add a scenes partition to the partition table");
+  }
+#endif
+  peripherals_ok = true;
+  boot_trace_mark("peripherals");
+#ifdef CONFIG_BUFFER_PLACEMENT_BENCH
+  buffer_placement_bench();
+#endif
+done:
+  xSemaphoreGive(ready);
+  vTaskDelete(NULL);
+}
+
+void app_main(void) {
+
+  boot_trace_mark("app_main");
+  strip_mutex = xSemaphoreCreateMutex();
+  SemaphoreHandle_t peripherals_ready = xSemaphoreCreateBinary();
+  xTaskCreate(init_peripherals_task, "init_peripherals", 4096, peripherals_ready, 5, NULL);
+#ifdef CONFIG_INPUT_IMAGE
+  msg.data.data = msg_data;
+  msg.data.capacity = LED_IMAGE_MAX_DATA_SIZE;
+  msg.data.size = 0;
+#endif
+
+#ifdef RMW_UXRCE_TRANSPORT_CUSTOM
+  if (uros_serial_transport_init() != RMW_RET_OK) {
+    ESP_LOGE(TAG, "Failed to set the micro-ROS serial transport");
+  }
+#endif
 #ifdef UCLIENT_PROFILE_UDP
     // Start the networking if required
     ESP_ERROR_CHECK(uros_network_interface_initialize());
+    boot_trace_mark("network");
 #endif  // UCLIENT_PROFILE_UDP
+  // The strip and the layout have to be ready before DDP or micro-ROS show frames
+  xSemaphoreTake(peripherals_ready, portMAX_DELAY);
+  vSemaphoreDelete(peripherals_ready);
+  if (!peripherals_ok) {
+    return;
+  }
+#if defined(UCLIENT_PROFILE_UDP) && defined(CONFIG_DDP_ENABLE)
+  ESP_ERROR_CHECK(ddp_start(CONFIG_DDP_UDP_PORT, ddp_data_callback, ddp_push_callback, NULL));
+#endif
 
     //pin micro-ros task in APP_CPU to make PRO_CPU to deal with wifi:
   xTaskCreate(micro_ros_task, "uros_task", CONFIG_MICRO_ROS_APP_STACK, NULL,
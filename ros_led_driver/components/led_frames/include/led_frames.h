@@ -0,0 +1,209 @@
+// What ros_led_driver shows, whatever the source of the pixels: the sequence
+// check of the received frames, the frame waiting for the link, keyframe
+// transitions, deltas, layers over the last frame, and the strips written to
+// the Serial LED Driver Pro boards with the per channel settings.
+//
+// The host tools (tools/led_replay, tools/led_node_sim) build the same code.
+// Nothing here blocks, locks or reads the clock: the caller serializes the
+// calls (with output_mutex on the device) and passes the time.
+
+#ifndef LED_FRAMES_H
+#define LED_FRAMES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "keyframe.h"
+#include "layers.h"
+#include "serial_led_driver_pro.h"
+
+// Channel masks are 16 bits: LedStrip.id 8 * k + c is channel c of output k
+#define LED_FRAMES_MAX_CHANNELS 16
+// A frame older than this is considered to come from a restarted publisher
+#define LED_FRAMES_MAX_LATE_FRAMES 16
+
+// A strip as in LedStrip: type 0 is APA102, WS2812 otherwise;
+// color order 0 is RGB, BGR otherwise.
+typedef struct {
+  uint8_t id;
+  uint8_t type;
+  uint8_t color_order;
+  const uint8_t *data;
+  size_t size;
+} led_frames_strip_t;
+
+// A strip of a LedStripsDelta
+typedef struct {
+  uint8_t id;
+  uint8_t type;
+  uint8_t color_order;
+  // of the decoded strip
+  size_t size;
+  const uint8_t *delta;
+  size_t delta_size;
+} led_frames_delta_t;
+
+// A strip of a LedLayer
+typedef struct {
+  uint8_t id;
+  uint8_t type;
+  uint8_t color_order;
+  size_t offset;
+  const uint8_t *rgb;
+  size_t size;
+  // NULL for an opaque region
+  const uint8_t *alpha;
+  size_t alpha_size;
+} led_frames_layer_strip_t;
+
+typedef struct {
+  // at most LED_FRAMES_MAX_CHANNELS
+  size_t number_of_channels;
+  size_t max_strip_length;
+  keyframe_easing_t easing;
+  // per layer stack, with layers
+  size_t layers_count;
+  // initial settings of the channels, at full brightness
+  uint32_t apa102_frequency;
+  uint16_t apa102_clock_mask;
+} led_frames_config_t;
+
+// Buffers of number_of_channels * 3 * max_strip_length bytes, unless noted.
+// Those of a feature not in use are NULL.
+typedef struct {
+  // 2 slots: the frame being received, and the last accepted frame. A late
+  // frame is received (then rejected) without overwriting the frame shown.
+  uint8_t *frames;
+  // keyframes: the output, and what it showed when the keyframe arrived
+  uint8_t *keyframe_output;
+  uint8_t *keyframe_from;
+  // deltas: the strips of the keyframe
+  uint8_t *delta_references;
+  // layers: number_of_channels * layers_count layers of 4 * max_strip_length bytes,
+  // the last frame of every channel and the composited output
+  layer_t *layers;
+  uint8_t *layer_buffers;
+  uint8_t *layer_bases;
+  uint8_t *layers_output;
+} led_frames_buffers_t;
+
+typedef struct {
+  led_frames_config_t config;
+  led_frames_buffers_t buffers;
+  size_t strip_buffer_size;
+
+  // Settings of the channels, written with every frame. They are copied by
+  // led_frames_begin_write: the outputs read the copy.
+  uint8_t brightness[LED_FRAMES_MAX_CHANNELS];
+  uint32_t apa102_frequencies[LED_FRAMES_MAX_CHANNELS];
+  uint16_t apa102_clock_mask;
+  // LedStrip type and color order last written to each channel
+  uint8_t channel_types[LED_FRAMES_MAX_CHANNELS];
+  uint8_t channel_color_orders[LED_FRAMES_MAX_CHANNELS];
+
+  // Sequence check and statistics, as in DriverStats
+  uint32_t last_seq;
+  uint32_t dropped_frames;
+  uint32_t coalesced_frames;
+  uint32_t keyframe_seq;
+
+  // The slot of buffers.frames that receives the next frame
+  size_t receive_slot;
+  // The last accepted frame, in the other slot
+  led_frames_strip_t frame[LED_FRAMES_MAX_CHANNELS];
+  size_t frame_number_of_strips;
+  uint32_t seq;
+  bool has_frame;
+  // waiting for the link
+  bool pending;
+  // received and not rendered yet
+  bool new_frame;
+
+  // Keyframes: per strip of the keyframe, a blend from keyframe_from to the
+  // strip of the frame
+  keyframe_transition_t transition;
+  led_frames_strip_t keyframe[LED_FRAMES_MAX_CHANNELS];
+  const uint8_t *keyframe_to[LED_FRAMES_MAX_CHANNELS];
+  size_t keyframe_number_of_strips;
+  size_t keyframe_output_size[LED_FRAMES_MAX_CHANNELS];
+
+  // Deltas: 0 if the channel is not in the keyframe
+  size_t delta_reference_size[LED_FRAMES_MAX_CHANNELS];
+
+  // Layers, per channel
+  layer_stack_t layer_stacks[LED_FRAMES_MAX_CHANNELS];
+  size_t layer_base_size[LED_FRAMES_MAX_CHANNELS];
+  // bytes last written
+  size_t layers_output_size[LED_FRAMES_MAX_CHANNELS];
+
+  // The strips being written, and the settings they are written with
+  const led_frames_strip_t *write_strips;
+  size_t write_number_of_strips;
+  uint8_t write_brightness[LED_FRAMES_MAX_CHANNELS];
+  uint32_t write_apa102_frequencies[LED_FRAMES_MAX_CHANNELS];
+  uint16_t write_apa102_clock_mask;
+} led_frames_t;
+
+void led_frames_init(led_frames_t *frames, const led_frames_config_t *config,
+                     const led_frames_buffers_t *buffers);
+
+// Returns false if the frame is late and has to be dropped.
+bool led_frames_check_sequence(led_frames_t *frames, uint32_t seq);
+
+// Buffer of strip `index` of the next frame: a frame is received (deserialized,
+// decoded or copied) there, then passed to led_frames_take or led_frames_receive.
+// The buffers change when a frame is taken.
+uint8_t *led_frames_receive_buffer(led_frames_t *frames, size_t index);
+// Takes a frame whose sequence is checked, with strip i in
+// led_frames_receive_buffer(frames, i). It is pending until rendered, and
+// replaces (coalesces) a pending frame. The next frame is received in the
+// other slot.
+void led_frames_take(led_frames_t *frames, uint32_t seq, uint16_t transition_ms,
+                     const led_frames_strip_t *strips, size_t number_of_strips, int64_t now_us);
+// Checks the sequence, then takes the frame. Returns false if it is dropped.
+bool led_frames_receive(led_frames_t *frames, uint32_t seq, uint16_t transition_ms,
+                        const led_frames_strip_t *strips, size_t number_of_strips, int64_t now_us);
+// Checks the sequence, decodes a LedStripsDelta against the keyframe, then
+// takes it. Returns false if it is dropped: late, or its keyframe was lost.
+// A late keyframe leaves the references untouched.
+// The invalid strips are skipped and counted in `invalid_strips`.
+bool led_frames_receive_delta(led_frames_t *frames, uint32_t seq, uint32_t keyframe_seq,
+                              uint16_t transition_ms, const led_frames_delta_t *strips,
+                              size_t number_of_strips, int64_t now_us, size_t *invalid_strips);
+// A frame whose sequence is checked was written without being taken: the
+// pending frame is dropped, and there is no last frame anymore.
+void led_frames_written_directly(led_frames_t *frames);
+
+// Fills `strips` with what the last frame shows at `now_us`, returns their
+// number. The frame stays pending until the end of its transition.
+size_t led_frames_render(led_frames_t *frames, int64_t now_us, led_frames_strip_t *strips);
+// The last frame, as last rendered. Returns the number of strips.
+size_t led_frames_last(const led_frames_t *frames, led_frames_strip_t *strips);
+// Renders the last frame again, e.g., with a new brightness.
+void led_frames_show_again(led_frames_t *frames);
+// Another source replaced the last frame: it is not pending anymore.
+void led_frames_cancel(led_frames_t *frames);
+
+// Sets `layer` on the strips, visible until `expires_us` (0 for ever). An empty
+// strip hides the layer. Returns false if there is no such layer.
+// The invalid strips are skipped and counted in `invalid_strips`.
+bool led_frames_set_layer(led_frames_t *frames, uint8_t layer, uint8_t priority, int64_t expires_us,
+                          const led_frames_layer_strip_t *strips, size_t number_of_strips,
+                          size_t *invalid_strips);
+// Hides the expired layers, returns the mask of the channels to write again.
+uint16_t led_frames_layers_dirty(led_frames_t *frames, int64_t now_us);
+// Fills `strips` with the last frame of the channels of `channel_mask`, to be
+// written again under their layers. Returns their number.
+size_t led_frames_layer_strips(led_frames_t *frames, uint16_t channel_mask, led_frames_strip_t *strips);
+// Marks the channels shown by their layers only to be written again.
+void led_frames_redraw_layers(led_frames_t *frames);
+
+// Sets the strips to write to the outputs with the current settings, then
+// led_frames_write_output writes those of an output and draws, and returns the
+// number of bytes written. The outputs can be written concurrently, and only
+// touch the state of their own channels.
+void led_frames_begin_write(led_frames_t *frames, const led_frames_strip_t *strips, size_t number_of_strips);
+size_t led_frames_write_output(led_frames_t *frames, size_t index, pb_driver_t *driver);
+
+#endif /* end of include guard: LED_FRAMES_H */
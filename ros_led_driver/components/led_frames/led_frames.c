@@ -0,0 +1,353 @@
+#include <string.h>
+
+#include "led_frames.h"
+#include "pixel_delta.h"
+
+static uint8_t *channel_buffer(const led_frames_t *frames, uint8_t *buffers, size_t channel) {
+  return buffers + channel * frames->strip_buffer_size;
+}
+
+void led_frames_init(led_frames_t *frames, const led_frames_config_t *config,
+                     const led_frames_buffers_t *buffers) {
+  memset(frames, 0, sizeof(*frames));
+  frames->config = *config;
+  if (frames->config.number_of_channels > LED_FRAMES_MAX_CHANNELS) {
+    frames->config.number_of_channels = LED_FRAMES_MAX_CHANNELS;
+  }
+  frames->buffers = *buffers;
+  frames->strip_buffer_size = 3 * config->max_strip_length;
+  const size_t number_of_channels = frames->config.number_of_channels;
+  memset(frames->brightness, 0x1F, number_of_channels);
+  // WS2812, RGB
+  memset(frames->channel_types, 1, number_of_channels);
+  for (size_t i = 0; i < number_of_channels; i++) {
+    frames->apa102_frequencies[i] = config->apa102_frequency;
+    if (buffers->layers) {
+      layer_stack_init(frames->layer_stacks + i, buffers->layers + i * config->layers_count,
+                       config->layers_count,
+                       buffers->layer_buffers + i * config->layers_count * 4 * config->max_strip_length,
+                       config->max_strip_length);
+    }
+  }
+  frames->apa102_clock_mask = config->apa102_clock_mask;
+}
+
+static bool is_late(const led_frames_t *frames, uint32_t seq) {
+  const int32_t gap = (int32_t) (seq - frames->last_seq);
+  return seq && frames->last_seq && gap <= 0 && gap > -LED_FRAMES_MAX_LATE_FRAMES;
+}
+
+bool led_frames_check_sequence(led_frames_t *frames, uint32_t seq) {
+  if (!seq) {
+    return true;
+  }
+  if (is_late(frames, seq)) {
+    frames->dropped_frames++;
+    return false;
+  }
+  if (frames->last_seq) {
+    const int32_t gap = (int32_t) (seq - frames->last_seq);
+    if (gap > 1) {
+      frames->dropped_frames += gap - 1;
+    }
+  }
+  frames->last_seq = seq;
+  return true;
+}
+
+uint8_t *led_frames_receive_buffer(led_frames_t *frames, size_t index) {
+  const size_t slot_size = frames->config.number_of_channels * frames->strip_buffer_size;
+  return channel_buffer(frames, frames->buffers.frames + frames->receive_slot * slot_size, index);
+}
+
+// The output of every channel of the keyframe blends from what it shows now
+// (black for new pixels) to the keyframe.
+static void start_transition(led_frames_t *frames, uint16_t transition_ms, int64_t now_us) {
+  frames->keyframe_number_of_strips = 0;
+  for (size_t i = 0; i < frames->frame_number_of_strips; i++) {
+    const led_frames_strip_t *strip = frames->frame + i;
+    const uint8_t id = strip->id;
+    if (id >= frames->config.number_of_channels) {
+      continue;
+    }
+    uint8_t *from = channel_buffer(frames, frames->buffers.keyframe_from, id);
+    uint8_t *output = channel_buffer(frames, frames->buffers.keyframe_output, id);
+    const size_t output_size = frames->keyframe_output_size[id];
+    memcpy(from, output, output_size);
+    if (strip->size > output_size) {
+      memset(from + output_size, 0, strip->size - output_size);
+    }
+    frames->keyframe_output_size[id] = strip->size;
+    const size_t j = frames->keyframe_number_of_strips++;
+    frames->keyframe[j] = (led_frames_strip_t) {id, strip->type, strip->color_order, output, strip->size};
+    frames->keyframe_to[j] = strip->data;
+  }
+  keyframe_start(&frames->transition, now_us, transition_ms, frames->config.easing);
+}
+
+void led_frames_take(led_frames_t *frames, uint32_t seq, uint16_t transition_ms,
+                     const led_frames_strip_t *strips, size_t number_of_strips, int64_t now_us) {
+  if (frames->new_frame) {
+    frames->coalesced_frames++;
+  }
+  if (number_of_strips > frames->config.number_of_channels) {
+    number_of_strips = frames->config.number_of_channels;
+  }
+  memcpy(frames->frame, strips, number_of_strips * sizeof(*strips));
+  frames->frame_number_of_strips = number_of_strips;
+  frames->receive_slot ^= 1;
+  frames->seq = seq;
+  frames->has_frame = true;
+  frames->new_frame = true;
+  frames->pending = true;
+  if (frames->buffers.keyframe_output) {
+    start_transition(frames, transition_ms, now_us);
+  }
+}
+
+bool led_frames_receive(led_frames_t *frames, uint32_t seq, uint16_t transition_ms,
+                        const led_frames_strip_t *strips, size_t number_of_strips, int64_t now_us) {
+  if (!led_frames_check_sequence(frames, seq)) {
+    return false;
+  }
+  led_frames_take(frames, seq, transition_ms, strips, number_of_strips, now_us);
+  return true;
+}
+
+bool led_frames_receive_delta(led_frames_t *frames, uint32_t seq, uint32_t keyframe_seq,
+                              uint16_t transition_ms, const led_frames_delta_t *strips,
+                              size_t number_of_strips, int64_t now_us, size_t *invalid_strips) {
+  *invalid_strips = 0;
+  if (is_late(frames, seq)) {
+    frames->dropped_frames++;
+    return false;
+  }
+  const bool is_keyframe = seq == keyframe_seq;
+  if (is_keyframe) {
+    memset(frames->delta_reference_size, 0, sizeof(frames->delta_reference_size));
+    frames->keyframe_seq = keyframe_seq;
+  } else if (!frames->keyframe_seq || keyframe_seq != frames->keyframe_seq) {
+    return false;
+  }
+  led_frames_strip_t decoded[LED_FRAMES_MAX_CHANNELS];
+  size_t number_of_decoded = 0;
+  for (size_t i = 0; i < number_of_strips && number_of_decoded < frames->config.number_of_channels; i++) {
+    const led_frames_delta_t *strip = strips + i;
+    const uint8_t id = strip->id;
+    if (id >= frames->config.number_of_channels || strip->size > frames->strip_buffer_size ||
+        (!is_keyframe && strip->size != frames->delta_reference_size[id])) {
+      (*invalid_strips)++;
+      continue;
+    }
+    uint8_t *data = led_frames_receive_buffer(frames, number_of_decoded);
+    uint8_t *reference = channel_buffer(frames, frames->buffers.delta_references, id);
+    if (!pixel_delta_decode(data, is_keyframe ? NULL : reference, strip->size, strip->delta, strip->delta_size)) {
+      (*invalid_strips)++;
+      continue;
+    }
+    if (is_keyframe) {
+      memcpy(reference, data, strip->size);
+      frames->delta_reference_size[id] = strip->size;
+    }
+    decoded[number_of_decoded++] = (led_frames_strip_t) {id, strip->type, strip->color_order, data, strip->size};
+  }
+  return led_frames_receive(frames, seq, transition_ms, decoded, number_of_decoded, now_us);
+}
+
+void led_frames_written_directly(led_frames_t *frames) {
+  if (frames->new_frame) {
+    frames->coalesced_frames++;
+  }
+  frames->pending = false;
+  frames->new_frame = false;
+  // The pixels were not kept
+  frames->has_frame = false;
+}
+
+size_t led_frames_last(const led_frames_t *frames, led_frames_strip_t *strips) {
+  if (!frames->has_frame) {
+    return 0;
+  }
+  if (frames->buffers.keyframe_output) {
+    memcpy(strips, frames->keyframe, frames->keyframe_number_of_strips * sizeof(*strips));
+    return frames->keyframe_number_of_strips;
+  }
+  memcpy(strips, frames->frame, frames->frame_number_of_strips * sizeof(*strips));
+  return frames->frame_number_of_strips;
+}
+
+size_t led_frames_render(led_frames_t *frames, int64_t now_us, led_frames_strip_t *strips) {
+  frames->pending = false;
+  frames->new_frame = false;
+  if (frames->buffers.keyframe_output) {
+    const uint16_t weight = keyframe_weight(&frames->transition, now_us);
+    for (size_t i = 0; i < frames->keyframe_number_of_strips; i++) {
+      const led_frames_strip_t *strip = frames->keyframe + i;
+      keyframe_blend(channel_buffer(frames, frames->buffers.keyframe_output, strip->id),
+                     channel_buffer(frames, frames->buffers.keyframe_from, strip->id),
+                     frames->keyframe_to[i], strip->size, weight);
+    }
+    // Keep rendering until the end of the transition
+    frames->pending = frames->transition.active;
+  }
+  return led_frames_last(frames, strips);
+}
+
+void led_frames_show_again(led_frames_t *frames) {
+  frames->pending = frames->has_frame;
+}
+
+void led_frames_cancel(led_frames_t *frames) {
+  frames->pending = false;
+  frames->new_frame = false;
+}
+
+bool led_frames_set_layer(led_frames_t *frames, uint8_t layer, uint8_t priority, int64_t expires_us,
+                          const led_frames_layer_strip_t *strips, size_t number_of_strips,
+                          size_t *invalid_strips) {
+  *invalid_strips = 0;
+  if (layer >= frames->config.layers_count) {
+    return false;
+  }
+  for (size_t i = 0; i < number_of_strips; i++) {
+    const led_frames_layer_strip_t *strip = strips + i;
+    const uint8_t id = strip->id;
+    const size_t count = strip->size / 3;
+    if (id >= frames->config.number_of_channels || (strip->alpha && strip->alpha_size < count)) {
+      (*invalid_strips)++;
+      continue;
+    }
+    if (!count) {
+      layer_hide(frames->layer_stacks + id, layer);
+      continue;
+    }
+    if (!frames->layer_base_size[id]) {
+      frames->channel_types[id] = strip->type;
+      frames->channel_color_orders[id] = strip->color_order;
+    }
+    layer_set(frames->layer_stacks + id, layer, priority, strip->offset, strip->rgb, strip->alpha,
+              count, expires_us);
+  }
+  return true;
+}
+
+uint16_t led_frames_layers_dirty(led_frames_t *frames, int64_t now_us) {
+  uint16_t channel_mask = 0;
+  if (!frames->buffers.layers) {
+    return 0;
+  }
+  for (size_t i = 0; i < frames->config.number_of_channels; i++) {
+    layer_stack_expire(frames->layer_stacks + i, now_us);
+    if (frames->layer_stacks[i].dirty) {
+      channel_mask |= (1 << i);
+    }
+  }
+  return channel_mask;
+}
+
+size_t led_frames_layer_strips(led_frames_t *frames, uint16_t channel_mask, led_frames_strip_t *strips) {
+  size_t number_of_strips = 0;
+  for (size_t i = 0; i < frames->config.number_of_channels; i++) {
+    if (!(channel_mask & (1 << i))) {
+      continue;
+    }
+    if (!frames->layer_base_size[i] && !frames->layers_output_size[i] &&
+        !layer_stack_visible(frames->layer_stacks + i)) {
+      // Nothing shown on the channel yet
+      frames->layer_stacks[i].dirty = false;
+      continue;
+    }
+    strips[number_of_strips++] = (led_frames_strip_t) {
+      i, frames->channel_types[i], frames->channel_color_orders[i],
+      channel_buffer(frames, frames->buffers.layer_bases, i), frames->layer_base_size[i]};
+  }
+  return number_of_strips;
+}
+
+void led_frames_redraw_layers(led_frames_t *frames) {
+  if (!frames->buffers.layers) {
+    return;
+  }
+  for (size_t i = 0; i < frames->config.number_of_channels; i++) {
+    if (layer_stack_visible(frames->layer_stacks + i)) {
+      frames->layer_stacks[i].dirty = true;
+    }
+  }
+}
+
+// Keeps the strip as the base of its channel, and returns what the channel
+// shows: the base covered by the visible layers.
+static led_frames_strip_t composite_layers(led_frames_t *frames, const led_frames_strip_t *strip) {
+  const uint8_t id = strip->id;
+  uint8_t *base = channel_buffer(frames, frames->buffers.layer_bases, id);
+  uint8_t *output = channel_buffer(frames, frames->buffers.layers_output, id);
+  if (strip->data != base) {
+    const size_t size = strip->size < frames->strip_buffer_size ? strip->size : frames->strip_buffer_size;
+    memcpy(base, strip->data, size);
+    frames->layer_base_size[id] = size;
+  }
+  layer_stack_t *stack = frames->layer_stacks + id;
+  const size_t base_size = frames->layer_base_size[id];
+  if (!layer_stack_visible(stack) && frames->layers_output_size[id] <= base_size) {
+    stack->dirty = false;
+    frames->layers_output_size[id] = base_size;
+    return (led_frames_strip_t) {id, strip->type, strip->color_order, base, base_size};
+  }
+  const size_t size = 3 * layer_stack_composite(stack, base, base_size / 3, output);
+  size_t written = size;
+  if (size < frames->layers_output_size[id]) {
+    // Black where the layers ended before
+    memset(output + size, 0, frames->layers_output_size[id] - size);
+    written = frames->layers_output_size[id];
+  }
+  frames->layers_output_size[id] = size;
+  return (led_frames_strip_t) {id, strip->type, strip->color_order, output, written};
+}
+
+void led_frames_begin_write(led_frames_t *frames, const led_frames_strip_t *strips, size_t number_of_strips) {
+  frames->write_strips = strips;
+  frames->write_number_of_strips = number_of_strips;
+  memcpy(frames->write_brightness, frames->brightness, sizeof(frames->brightness));
+  memcpy(frames->write_apa102_frequencies, frames->apa102_frequencies, sizeof(frames->apa102_frequencies));
+  frames->write_apa102_clock_mask = frames->apa102_clock_mask;
+  for (size_t i = 0; i < number_of_strips; i++) {
+    const led_frames_strip_t *strip = strips + i;
+    if (strip->id < frames->config.number_of_channels && !(frames->apa102_clock_mask & (1 << strip->id))) {
+      frames->channel_types[strip->id] = strip->type;
+      frames->channel_color_orders[strip->id] = strip->color_order;
+    }
+  }
+}
+
+size_t led_frames_write_output(led_frames_t *frames, size_t index, pb_driver_t *driver) {
+  size_t size = pb_draw_size();
+  for (size_t i = 0; i < frames->write_number_of_strips; i++) {
+    const led_frames_strip_t *strip = frames->write_strips + i;
+    const uint8_t id = strip->id;
+    if (id >= frames->config.number_of_channels || id / PB_NUMBER_OF_CHANNELS != index ||
+        (frames->write_apa102_clock_mask & (1 << id))) {
+      continue;
+    }
+    led_frames_strip_t composited;
+    if (frames->buffers.layers) {
+      composited = composite_layers(frames, strip);
+      strip = &composited;
+    }
+    const channel_type_t type = strip->type == 0 ? CHANNEL_APA102_DATA : CHANNEL_WS2812;
+    const uint16_t number_of_pixels = strip->size / 3;
+    pb_set_channel(driver, id % PB_NUMBER_OF_CHANNELS, type, strip->color_order == 0 ? RGB : BGR,
+                   number_of_pixels, strip->data, frames->write_apa102_frequencies[id], frames->write_brightness[id]);
+    size += pb_channel_size(type, number_of_pixels);
+  }
+  // A few bytes per clock channel: the board is configured again after a reset
+  for (size_t id = index * PB_NUMBER_OF_CHANNELS;
+       id < (index + 1) * PB_NUMBER_OF_CHANNELS && id < frames->config.number_of_channels; id++) {
+    if (frames->write_apa102_clock_mask & (1 << id)) {
+      pb_set_channel(driver, id % PB_NUMBER_OF_CHANNELS, CHANNEL_APA102_CLOCK, RGB, 0, NULL,
+                     frames->write_apa102_frequencies[id], 0);
+      size += pb_channel_size(CHANNEL_APA102_CLOCK, 0);
+    }
+  }
+  pb_draw(driver);
+  return size;
+}
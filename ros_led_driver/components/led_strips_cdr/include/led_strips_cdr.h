@@ -0,0 +1,44 @@
+// Walks a CDR serialized LedStrips in place, instead of deserializing it into
+// a led_strip_msgs__msg__LedStrips: the pixels of every strip are handed out
+// as spans of the buffer rmw takes the message from.
+//
+// Create the subscription with led_strips_cdr_type_support(handler). When the
+// executor takes a message, the handler is called with the frame while the
+// buffer is valid, and the message pointer given to
+// rclc_executor_add_subscription, which the handler can fill for the
+// subscription callback.
+
+#ifndef LED_STRIPS_CDR_H
+#define LED_STRIPS_CDR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <rosidl_runtime_c/message_type_support_struct.h>
+#include <ucdr/microcdr.h>
+
+typedef struct {
+  uint8_t color_order;
+  uint8_t type;
+  uint8_t id;
+  const uint8_t *data;
+  uint32_t size;
+} led_strips_cdr_strip_t;
+
+typedef struct {
+  uint32_t seq;
+  uint16_t transition_ms;
+  // Strips not read yet with led_strips_cdr_next_strip
+  uint32_t number_of_strips;
+  // Position of the next strip in the buffer
+  ucdrBuffer strips;
+} led_strips_cdr_frame_t;
+
+typedef void (*led_strips_cdr_handler_t)(led_strips_cdr_frame_t *frame, void *message);
+
+// Type support of led_strip_msgs/LedStrips whose deserialization calls `handler`
+const rosidl_message_type_support_t *led_strips_cdr_type_support(led_strips_cdr_handler_t handler);
+// Returns false after the last strip
+bool led_strips_cdr_next_strip(led_strips_cdr_frame_t *frame, led_strips_cdr_strip_t *strip);
+
+#endif /* end of include guard: LED_STRIPS_CDR_H */
@@ -0,0 +1,73 @@
+#include "led_strips_cdr.h"
+
+#include <rosidl_typesupport_microxrcedds_c/identifier.h>
+#include <rosidl_typesupport_microxrcedds_c/message_type_support.h>
+#include <led_strip_msgs/msg/led_strips.h>
+
+// LedStrips.strips is bounded to 16: the caller keeps those of its channels
+#define MAX_NUMBER_OF_STRIPS 16
+
+static led_strips_cdr_handler_t handler = NULL;
+static message_type_support_callbacks_t callbacks;
+static rosidl_message_type_support_t type_support;
+
+static bool read_strip(ucdrBuffer *cdr, led_strips_cdr_strip_t *strip) {
+  ucdr_deserialize_uint8_t(cdr, &strip->color_order);
+  ucdr_deserialize_uint8_t(cdr, &strip->type);
+  ucdr_deserialize_uint8_t(cdr, &strip->id);
+  ucdr_deserialize_uint32_t(cdr, &strip->size);
+  if (cdr->error || ucdr_buffer_remaining(cdr) < strip->size) {
+    return false;
+  }
+  strip->data = cdr->iterator;
+  ucdr_advance_buffer(cdr, strip->size);
+  return true;
+}
+
+// Only the strip headers are read: seq and transition_ms follow the strips.
+static bool deserialize(ucdrBuffer *cdr, void *message) {
+  led_strips_cdr_frame_t frame;
+  ucdr_deserialize_uint32_t(cdr, &frame.number_of_strips);
+  if (cdr->error || frame.number_of_strips > MAX_NUMBER_OF_STRIPS) {
+    return false;
+  }
+  frame.strips = *cdr;
+  led_strips_cdr_strip_t strip;
+  for (uint32_t i = 0; i < frame.number_of_strips; i++) {
+    if (!read_strip(cdr, &strip)) {
+      return false;
+    }
+  }
+  ucdr_deserialize_uint32_t(cdr, &frame.seq);
+  ucdr_deserialize_uint16_t(cdr, &frame.transition_ms);
+  if (cdr->error) {
+    return false;
+  }
+  handler(&frame, message);
+  return true;
+}
+
+const rosidl_message_type_support_t *led_strips_cdr_type_support(led_strips_cdr_handler_t _handler) {
+  // Same type (name, serialization, sizes) as the generated type support,
+  // except for the deserialization.
+  const rosidl_message_type_support_t *generated = get_message_typesupport_handle(
+      ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, LedStrips),
+      ROSIDL_TYPESUPPORT_MICROXRCEDDS_C__IDENTIFIER_VALUE);
+  if (!generated) {
+    return NULL;
+  }
+  handler = _handler;
+  callbacks = *(const message_type_support_callbacks_t *) generated->data;
+  callbacks.cdr_deserialize = deserialize;
+  type_support = *generated;
+  type_support.data = &callbacks;
+  return &type_support;
+}
+
+bool led_strips_cdr_next_strip(led_strips_cdr_frame_t *frame, led_strips_cdr_strip_t *strip) {
+  if (!frame->number_of_strips) {
+    return false;
+  }
+  frame->number_of_strips--;
+  return read_strip(&frame->strips, strip);
+}
@@ -0,0 +1,62 @@
+#include "frame_pacer.h"
+
+#define BITS_PER_BYTE 10
+
+void frame_pacer_init(frame_pacer_t *pacer, uint32_t baud_rate, uint32_t target_fps,
+                      size_t tx_buffer_size, int64_t now_us) {
+  pacer->baud_rate = baud_rate;
+  pacer->min_period_us = target_fps ? 1000000LL / target_fps : 0;
+  pacer->max_backlog_us = frame_pacer_wire_time_us(pacer, tx_buffer_size);
+  pacer->link_free_at_us = now_us;
+  pacer->last_frame_at_us = now_us - pacer->min_period_us;
+  pacer->window_start_us = now_us;
+  pacer->window_busy_us = 0;
+  pacer->window_frames = 0;
+}
+
+int64_t frame_pacer_wire_time_us(const frame_pacer_t *pacer, size_t size) {
+  return (int64_t) size * BITS_PER_BYTE * 1000000LL / pacer->baud_rate;
+}
+
+int64_t frame_pacer_wait_us(const frame_pacer_t *pacer, int64_t now_us) {
+  int64_t wait_us = pacer->last_frame_at_us + pacer->min_period_us - now_us;
+  const int64_t backlog_wait_us = pacer->link_free_at_us - pacer->max_backlog_us - now_us;
+  if (backlog_wait_us > wait_us) {
+    wait_us = backlog_wait_us;
+  }
+  return wait_us > 0 ? wait_us : 0;
+}
+
+void frame_pacer_sent(frame_pacer_t *pacer, size_t size, int64_t now_us) {
+  const int64_t wire_time_us = frame_pacer_wire_time_us(pacer, size);
+  if (pacer->link_free_at_us < now_us) {
+    pacer->link_free_at_us = now_us;
+  }
+  pacer->link_free_at_us += wire_time_us;
+  pacer->last_frame_at_us = now_us;
+  pacer->window_busy_us += wire_time_us;
+  pacer->window_frames++;
+}
+
+void frame_pacer_get_stats(frame_pacer_t *pacer, int64_t now_us, frame_pacer_stats_t *stats) {
+  const int64_t window_us = now_us - pacer->window_start_us;
+  if (window_us <= 0) {
+    stats->fps = 0;
+    stats->link_utilization = 0;
+    return;
+  }
+  // The frames still on the wire are accounted in the next window
+  int64_t busy_us = pacer->window_busy_us;
+  const int64_t pending_us = pacer->link_free_at_us - now_us;
+  if (pending_us > 0) {
+    busy_us -= pending_us;
+  }
+  stats->fps = 1e6f * pacer->window_frames / window_us;
+  stats->link_utilization = busy_us > 0 ? (float) busy_us / window_us : 0;
+  if (stats->link_utilization > 1) {
+    stats->link_utilization = 1;
+  }
+  pacer->window_start_us = now_us;
+  pacer->window_busy_us = pending_us > 0 ? pending_us : 0;
+  pacer->window_frames = 0;
+}
@@ -0,0 +1,52 @@
+// Paces the frames sent to the Serial LED Driver Pro.
+//
+// The UART link is the bottleneck: at 2 Mbaud a frame of 8 strips of 1000
+// RGB pixels needs about 120 ms on the wire. The pacer estimates when the
+// bytes already written leave the UART, so that the caller can hold back a
+// frame (and replace it by a newer one) instead of blocking in
+// `uart_write_bytes`.
+//
+// Times are in microseconds, passed by the caller (e.g. `esp_timer_get_time()`).
+// The pacer is not thread safe.
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  uint32_t baud_rate;
+  // 0 to send as fast as the link allows
+  int64_t min_period_us;
+  // wire time we accept to have queued in the UART driver
+  int64_t max_backlog_us;
+  // estimated time when the last written byte leaves the UART
+  int64_t link_free_at_us;
+  int64_t last_frame_at_us;
+  // current statistics window
+  int64_t window_start_us;
+  int64_t window_busy_us;
+  uint32_t window_frames;
+} frame_pacer_t;
+
+typedef struct {
+  // frames sent per second
+  float fps;
+  // fraction of the time the link was transmitting, in [0, 1]
+  float link_utilization;
+} frame_pacer_stats_t;
+
+// `tx_buffer_size` is the size of the UART driver TX ring.
+void frame_pacer_init(frame_pacer_t *pacer, uint32_t baud_rate, uint32_t target_fps,
+                      size_t tx_buffer_size, int64_t now_us);
+// Time to wait before the next frame can be sent, 0 if it can be sent now.
+int64_t frame_pacer_wait_us(const frame_pacer_t *pacer, int64_t now_us);
+// Accounts for a frame of `size` bytes written to the link at `now_us`.
+void frame_pacer_sent(frame_pacer_t *pacer, size_t size, int64_t now_us);
+// Wire time of `size` bytes (8N1: 10 bits per byte).
+int64_t frame_pacer_wire_time_us(const frame_pacer_t *pacer, size_t size);
+// Statistics since the last call.
+void frame_pacer_get_stats(frame_pacer_t *pacer, int64_t now_us, frame_pacer_stats_t *stats);
+
+#endif /* end of include guard: FRAME_PACER_H */
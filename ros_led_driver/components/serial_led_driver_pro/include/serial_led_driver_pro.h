@@ -5,8 +5,15 @@
 #ifndef SERIAL_LED_DRIVER_PRO_H
 #define SERIAL_LED_DRIVER_PRO_H
 
+#include "stddef.h"
 #include "stdint.h"
 
+#define PB_BAUD_RATE (2000000L)
+// Size of the UART driver TX ring: writes return as long as it has room
+#define PB_TX_BUFFER_SIZE (4096)
+// Channels of a board
+#define PB_NUMBER_OF_CHANNELS 8
+
 typedef enum {
   CHANNEL_WS2812 = 1,
   CHANNEL_DRAW_ALL,
@@ -25,11 +32,21 @@ typedef union {
 extern const color_orders_t RGB;
 extern const color_orders_t BGR;
 
-void pb_init(uint8_t _uart_number, uint8_t tx_pin);
-void pb_set_channel(uint8_t channel_id, channel_type_t channel_type,
+// A Serial LED Driver Pro board on its own UART.
+// Drivers on different UARTs can be written from different tasks;
+// a driver is not thread safe.
+typedef struct {
+  uint8_t uart_number;
+} pb_driver_t;
+
+void pb_init(pb_driver_t *driver, uint8_t uart_number, uint8_t tx_pin);
+void pb_set_channel(pb_driver_t *driver, uint8_t channel_id, channel_type_t channel_type,
                     color_orders_t color_orders, uint16_t number_of_pixels,
                     const uint8_t *buffer, uint32_t frequency,
                     uint8_t brightness);
-void pb_draw();
+void pb_draw(pb_driver_t *driver);
+// Number of bytes written on the link by pb_set_channel and pb_draw
+size_t pb_channel_size(channel_type_t channel_type, uint16_t number_of_pixels);
+size_t pb_draw_size();
 
 #endif /* end of include guard: SERIAL_LED_DRIVER_PRO_H */
@@ -2,22 +2,19 @@
 #include "driver/uart.h"
 #include "serial_led_driver_pro.h"
 
-#define BAUD_RATE (2000000L)
 #define BUF_SIZE (1024)
 #define FRAME_HEADER_MAGIC ("UPXL")
 
 const color_orders_t RGB = {{.redi=0, .greeni=1, .bluei=2, .whitei=3}};
 const color_orders_t BGR = {{.redi=2, .greeni=1, .bluei=0, .whitei=3}};
 
-static uint8_t uart_number;
-
-static void write(const uint8_t *buffer, size_t size) {
-    uart_write_bytes(uart_number, (const char *) buffer, size);
+static void write(pb_driver_t *driver, const uint8_t *buffer, size_t size) {
+    uart_write_bytes(driver->uart_number, (const char *) buffer, size);
 }
 
-void pb_init(uint8_t _uart_number, uint8_t tx_pin) {
+void pb_init(pb_driver_t *driver, uint8_t uart_number, uint8_t tx_pin) {
   uart_config_t uart_config = {
-      .baud_rate = BAUD_RATE,
+      .baud_rate = PB_BAUD_RATE,
       .data_bits = UART_DATA_8_BITS,
       .parity    = UART_PARITY_DISABLE,
       .stop_bits = UART_STOP_BITS_1,
@@ -29,8 +26,8 @@ void pb_init(uint8_t _uart_number, uint8_t tx_pin) {
 #if CONFIG_UART_ISR_IN_IRAM
   intr_alloc_flags = ESP_INTR_FLAG_IRAM;
 #endif
-  uart_number = _uart_number;
-  ESP_ERROR_CHECK(uart_driver_install(uart_number, BUF_SIZE * 2, 0, 0, NULL, intr_alloc_flags));
+  driver->uart_number = uart_number;
+  ESP_ERROR_CHECK(uart_driver_install(uart_number, BUF_SIZE * 2, PB_TX_BUFFER_SIZE, 0, NULL, intr_alloc_flags));
   ESP_ERROR_CHECK(uart_param_config(uart_number, &uart_config));
   ESP_ERROR_CHECK(uart_set_pin(uart_number, tx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
 }
@@ -91,7 +88,7 @@ static uint32_t crc_update(uint32_t crc, const void *data, size_t data_len) {
 // We consider only RGB inputs
 static const uint8_t num_elements = 3;
 
-void pb_set_channel(uint8_t channel_id, channel_type_t channel_type, color_orders_t color_orders,
+void pb_set_channel(pb_driver_t *driver, uint8_t channel_id, channel_type_t channel_type, color_orders_t color_orders,
                     uint16_t number_of_pixels, const uint8_t *buffer,
                     uint32_t frequency, uint8_t brightness) {
     pb_frame_header_t frameHeader;
@@ -100,7 +97,7 @@ void pb_set_channel(uint8_t channel_id, channel_type_t channel_type, color_order
     uint32_t crc = 0xffffffff;
     frameHeader.channel = channel_id;
     frameHeader.recordType = channel_type;
-    write((uint8_t *) &frameHeader, sizeof(frameHeader));
+    write(driver, (uint8_t *) &frameHeader, sizeof(frameHeader));
     crc = crc_update(crc, &frameHeader, sizeof(frameHeader));
 
     switch (channel_type) {
@@ -110,7 +107,7 @@ void pb_set_channel(uint8_t channel_id, channel_type_t channel_type, color_order
             pb_ws2812_channel_t.numElements = num_elements;
             pb_ws2812_channel_t.pixels = number_of_pixels;
             pb_ws2812_channel_t.colorOrders = color_orders.color_orders;
-            write((uint8_t *) &pb_ws2812_channel_t, sizeof(pb_ws2812_channel_t));
+            write(driver, (uint8_t *) &pb_ws2812_channel_t, sizeof(pb_ws2812_channel_t));
             crc = crc_update(crc, &pb_ws2812_channel_t, sizeof(pb_ws2812_channel_t));
             break;
         }
@@ -119,7 +116,7 @@ void pb_set_channel(uint8_t channel_id, channel_type_t channel_type, color_order
             pb_apa102_data_channel_t.pixels = number_of_pixels;
             pb_apa102_data_channel_t.frequency = frequency;
             pb_apa102_data_channel_t.colorOrders = color_orders.color_orders;
-            write((uint8_t *) &pb_apa102_data_channel_t, sizeof(pb_apa102_data_channel_t));
+            write(driver, (uint8_t *) &pb_apa102_data_channel_t, sizeof(pb_apa102_data_channel_t));
             crc = crc_update(crc, &pb_apa102_data_channel_t, sizeof(pb_apa102_data_channel_t));
             brightness = brightness & 0x1F;
             break;
@@ -127,7 +124,7 @@ void pb_set_channel(uint8_t channel_id, channel_type_t channel_type, color_order
         case CHANNEL_APA102_CLOCK: {
             pb_apa102_clock_channel_t pb_apa102_clock_channel_t;
             pb_apa102_clock_channel_t.frequency = frequency;
-            write((uint8_t *) &pb_apa102_clock_channel_t, sizeof(pb_apa102_clock_channel_t));
+            write(driver, (uint8_t *) &pb_apa102_clock_channel_t, sizeof(pb_apa102_clock_channel_t));
             crc = crc_update(crc, &pb_apa102_clock_channel_t, sizeof(pb_apa102_clock_channel_t));
             number_of_pixels = 0;  // make sure we don't send pixel data, even if misconfigured
             break;
@@ -138,24 +135,42 @@ void pb_set_channel(uint8_t channel_id, channel_type_t channel_type, color_order
 
     for (int i = 0; i < number_of_pixels; i++, buffer+=num_elements) {
         crc = crc_update(crc, buffer, num_elements);
-        write(buffer, num_elements);
+        write(driver, buffer, num_elements);
         if(channel_type == CHANNEL_APA102_DATA){
           crc = crc_update(crc, (const uint8_t *)&brightness, 1);
-          write((const uint8_t *)&brightness, 1);
+          write(driver, (const uint8_t *)&brightness, 1);
         }
     }
     crc = crc ^0xffffffff;
-    write((uint8_t *) &crc, 4);
+    write(driver, (uint8_t *) &crc, 4);
 }
 
-void pb_draw() {
+void pb_draw(pb_driver_t *driver) {
     pb_frame_header_t frameHeader;
     memcpy(frameHeader.magic, FRAME_HEADER_MAGIC, 4);
     uint32_t crc = 0xffffffff;
     frameHeader.channel = 0xff;
     frameHeader.recordType = CHANNEL_DRAW_ALL;
-    write((uint8_t *) &frameHeader, sizeof(frameHeader));
+    write(driver, (uint8_t *) &frameHeader, sizeof(frameHeader));
     crc = crc_update(crc, &frameHeader, sizeof(frameHeader));
     crc = crc ^0xffffffff;
-    write((uint8_t *) &crc, 4);
+    write(driver, (uint8_t *) &crc, 4);
+}
+
+size_t pb_channel_size(channel_type_t channel_type, uint16_t number_of_pixels) {
+    const size_t size = sizeof(pb_frame_header_t) + 4;
+    switch (channel_type) {
+        case CHANNEL_WS2812:
+            return size + sizeof(pb_ws2812_channel_t) + number_of_pixels * num_elements;
+        case CHANNEL_APA102_DATA:
+            return size + sizeof(pb_apa102_data_channel_t) + number_of_pixels * (num_elements + 1);
+        case CHANNEL_APA102_CLOCK:
+            return size + sizeof(pb_apa102_clock_channel_t);
+        default:
+            return size;
+    }
+}
+
+size_t pb_draw_size() {
+    return sizeof(pb_frame_header_t) + 4;
 }
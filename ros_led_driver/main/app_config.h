@@ -0,0 +1,121 @@
+// Compile-time sizes derived from the configuration selected in menuconfig
+
+#ifndef APP_CONFIG_H
+#define APP_CONFIG_H
+
+#include "sdkconfig.h"
+
+#include <rmw_microxrcedds_c/config.h>
+#include "uxr/client/config.h"
+#include "serial_led_driver_pro.h"
+
+#define MAX_NUMBER_OF_CHANNELS CONFIG_MAX_NUMBER_OF_CHANNELS
+#define MAX_STRIP_LENGTH CONFIG_MAX_STRIP_LENGTH
+#ifndef CONFIG_BUFFER_PLACEMENT_PSRAM
+_Static_assert(MAX_STRIP_LENGTH <= 1000, "Beyond 1000 pixels per channel, enable BUFFER_PLACEMENT_PSRAM");
+#endif
+// LedStrip.id 8 * k + c is channel c of the Serial LED Driver Pro on output k
+#define NUMBER_OF_OUTPUTS CONFIG_LED_DRIVER_NUMBER_OF_OUTPUTS
+#define CHANNELS_PER_OUTPUT PB_NUMBER_OF_CHANNELS
+// Channel masks, bit i for LedStrip.id i
+#define ALL_CHANNELS 0xFFFF
+// RGB
+#define STRIP_BUFFER_SIZE (3 * MAX_STRIP_LENGTH)
+
+// led_strips subscription + set_brightness and configure_channels services + stats timer
+// (+ store_scene and recall_scene services + scene subscription)
+// (+ led_strips_delta subscription)
+// (+ led_layers subscription)
+// (+ memory_stats timer and dump_memory service)
+#ifdef CONFIG_SCENE_STORE_ENABLE
+#define SCENE_EXECUTOR_HANDLES 3
+#else
+#define SCENE_EXECUTOR_HANDLES 0
+#endif
+#ifdef CONFIG_DELTA_ENABLE
+#define DELTA_EXECUTOR_HANDLES 1
+#else
+#define DELTA_EXECUTOR_HANDLES 0
+#endif
+#ifdef CONFIG_LAYERS_ENABLE
+#define LAYERS_EXECUTOR_HANDLES 1
+#define LAYERS_COUNT CONFIG_LAYERS_COUNT
+#else
+#define LAYERS_EXECUTOR_HANDLES 0
+#endif
+#ifdef CONFIG_MEMORY_STATS_ENABLE
+#define MEMORY_STATS_EXECUTOR_HANDLES 2
+// MemoryStats.tasks is bounded to 32
+#define MEMORY_STATS_MAX_TASKS CONFIG_MEMORY_STATS_MAX_TASKS
+#else
+#define MEMORY_STATS_EXECUTOR_HANDLES 0
+#endif
+#define EXECUTOR_HANDLES (4 + SCENE_EXECUTOR_HANDLES + DELTA_EXECUTOR_HANDLES + LAYERS_EXECUTOR_HANDLES + \
+                          MEMORY_STATS_EXECUTOR_HANDLES)
+
+// Upper bound of the CDR size of a LedStrips message:
+// encapsulation, sequence length, seq and transition_ms + per strip
+// (3 uint8, padding, data length, data, padding)
+#define LED_STRIP_MAX_SERIALIZED_SIZE (STRIP_BUFFER_SIZE + 11)
+#define LED_STRIPS_MAX_SERIALIZED_SIZE (14 + MAX_NUMBER_OF_CHANNELS * LED_STRIP_MAX_SERIALIZED_SIZE)
+// Worst case of a LedStripDelta (see pixel_delta.h)
+#define DELTA_BUFFER_SIZE (STRIP_BUFFER_SIZE + (STRIP_BUFFER_SIZE + 127) / 128)
+// Same for LedStripsDelta, with keyframe_seq and a uint16 size per strip
+#define LED_STRIPS_DELTA_MAX_SERIALIZED_SIZE (18 + MAX_NUMBER_OF_CHANNELS * (DELTA_BUFFER_SIZE + 15))
+// Same for LedLayer: layer, priority, timeout_ms + per strip
+// (3 uint8, offset, padding, data length, data, padding, alpha length, alpha)
+#define LED_LAYER_MAX_SERIALIZED_SIZE (16 + MAX_NUMBER_OF_CHANNELS * (STRIP_BUFFER_SIZE + MAX_STRIP_LENGTH + 19))
+// XRCE message, submessage and data headers
+#define XRCE_MESSAGE_OVERHEAD 32
+
+#ifdef UCLIENT_PROFILE_UDP
+#ifdef CONFIG_PIXEL_QOS_BEST_EFFORT
+_Static_assert(LED_STRIPS_MAX_SERIALIZED_SIZE + XRCE_MESSAGE_OVERHEAD <= UXR_CONFIG_UDP_TRANSPORT_MTU,
+               "Best effort LedStrips must fit in one MTU: increase UCLIENT_UDP_TRANSPORT_MTU "
+               "in app-colcon.meta or reduce MAX_STRIP_LENGTH / MAX_NUMBER_OF_CHANNELS");
+#else
+_Static_assert(LED_STRIPS_MAX_SERIALIZED_SIZE + XRCE_MESSAGE_OVERHEAD <= UXR_CONFIG_UDP_TRANSPORT_MTU * RMW_UXRCE_STREAM_HISTORY,
+               "Reliable LedStrips must fit in the input stream: increase UCLIENT_UDP_TRANSPORT_MTU "
+               "or RMW_UXRCE_STREAM_HISTORY in app-colcon.meta or reduce MAX_STRIP_LENGTH / MAX_NUMBER_OF_CHANNELS");
+#endif
+#ifdef CONFIG_DELTA_ENABLE
+#ifdef CONFIG_PIXEL_QOS_BEST_EFFORT
+_Static_assert(LED_STRIPS_DELTA_MAX_SERIALIZED_SIZE + XRCE_MESSAGE_OVERHEAD <= UXR_CONFIG_UDP_TRANSPORT_MTU,
+               "Best effort LedStripsDelta must fit in one MTU: increase UCLIENT_UDP_TRANSPORT_MTU "
+               "in app-colcon.meta or reduce MAX_STRIP_LENGTH / MAX_NUMBER_OF_CHANNELS");
+#else
+_Static_assert(LED_STRIPS_DELTA_MAX_SERIALIZED_SIZE + XRCE_MESSAGE_OVERHEAD <= UXR_CONFIG_UDP_TRANSPORT_MTU * RMW_UXRCE_STREAM_HISTORY,
+               "Reliable LedStripsDelta must fit in the input stream: increase UCLIENT_UDP_TRANSPORT_MTU "
+               "or RMW_UXRCE_STREAM_HISTORY in app-colcon.meta or reduce MAX_STRIP_LENGTH / MAX_NUMBER_OF_CHANNELS");
+#endif
+#endif  // CONFIG_DELTA_ENABLE
+#ifdef CONFIG_LAYERS_ENABLE
+// led_layers is reliable: a lost layer update would stay on the strips
+_Static_assert(LED_LAYER_MAX_SERIALIZED_SIZE + XRCE_MESSAGE_OVERHEAD <= UXR_CONFIG_UDP_TRANSPORT_MTU * RMW_UXRCE_STREAM_HISTORY,
+               "LedLayer must fit in the input stream: increase UCLIENT_UDP_TRANSPORT_MTU "
+               "or RMW_UXRCE_STREAM_HISTORY in app-colcon.meta or reduce MAX_STRIP_LENGTH / MAX_NUMBER_OF_CHANNELS");
+#endif
+#endif  // UCLIENT_PROFILE_UDP
+
+_Static_assert(MAX_NUMBER_OF_CHANNELS <= NUMBER_OF_OUTPUTS * CHANNELS_PER_OUTPUT,
+               "Each Serial LED Driver Pro has 8 channels: increase LED_DRIVER_NUMBER_OF_OUTPUTS "
+               "or reduce MAX_NUMBER_OF_CHANNELS");
+// Every UART gets its own driver: a shared one would abort at boot in uart_driver_install.
+#if defined(RMW_UXRCE_TRANSPORT_CUSTOM) && defined(CONFIG_UROS_SERIAL_TRANSPORT_UART)
+#if CONFIG_UROS_SERIAL_UART_NUM == CONFIG_LED_DRIVER_UART_NUM
+#error "The micro-ROS serial transport and the Serial LED Driver Pro share a UART"
+#endif
+#endif
+// LED_DRIVER_UART_1_NUM is only defined with two outputs
+#if NUMBER_OF_OUTPUTS > 1
+#if CONFIG_LED_DRIVER_UART_NUM == CONFIG_LED_DRIVER_UART_1_NUM
+#error "The two Serial LED Driver Pro are on the same UART"
+#endif
+#if defined(RMW_UXRCE_TRANSPORT_CUSTOM) && defined(CONFIG_UROS_SERIAL_TRANSPORT_UART)
+#if CONFIG_UROS_SERIAL_UART_NUM == CONFIG_LED_DRIVER_UART_1_NUM
+#error "The micro-ROS serial transport and the second Serial LED Driver Pro share a UART"
+#endif
+#endif
+#endif
+
+#endif /* end of include guard: APP_CONFIG_H */
@@ -3,12 +3,15 @@
 #include <unistd.h>
 
 #include "sdkconfig.h"
+#include "app_config.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 
 #include <rcl/rcl.h>
 #include <rcl/error_handling.h>
@@ -20,64 +23,806 @@
 
 // #include <std_msgs/msg/color_rgba.h>
 #include <led_strip_msgs/srv/set_brightness.h>
+#include <led_strip_msgs/srv/configure_channels.h>
 #include <led_strip_msgs/msg/led_strips.h>
+#include <led_strip_msgs/msg/driver_stats.h>
+#ifdef CONFIG_ECHO_SHOWN_FRAMES
+#include <std_msgs/msg/u_int32.h>
+#endif
 
 #include "serial_led_driver_pro.h"
+#include "frame_pacer.h"
+#include "led_frames.h"
 #include "ldo_2.h"
 #include "apa102.h"
 #include "blue_led.h"
-
-// #define TEST_ON_APA102
-#define ALIVE_ON_APA102
+#ifdef RMW_UXRCE_TRANSPORT_CUSTOM
+#include "uros_serial_transport.h"
+#else
+#include "uros_agent_cache.h"
+#endif
+#include "boot_trace.h"
+#include "uros_reconnect.h"
+#include "buffer_placement.h"
+#ifdef CONFIG_DDP_ENABLE
+#include "ddp.h"
+#include "ddp_channels.h"
+#endif
+#ifdef CONFIG_SERIALIZED_TAKE
+#include "led_strips_cdr.h"
+#endif
+#ifdef CONFIG_SCENE_STORE_ENABLE
+#include <led_strip_msgs/msg/scene.h>
+#include <led_strip_msgs/srv/store_scene.h>
+#include <led_strip_msgs/srv/recall_scene.h>
+#include "scene_store.h"
+#endif
+#ifdef CONFIG_DELTA_ENABLE
+#include <led_strip_msgs/msg/led_strips_delta.h>
+#endif
+#ifdef CONFIG_LAYERS_ENABLE
+#include <led_strip_msgs/msg/led_layer.h>
+#endif
+#ifdef CONFIG_AUTO_BRIGHTNESS_ENABLE
+#include "ambient_light_sensor.h"
+#include "auto_brightness.h"
+#endif
+#ifdef CONFIG_MEMORY_STATS_ENABLE
+#include <led_strip_msgs/msg/memory_stats.h>
+#include <led_strip_msgs/srv/dump_memory.h>
+#include "memory_stats.h"
+#endif
 
 static const char *TAG = "uROS";
 
 #define NODE_NAME "led_driver_pro"
 #define NODE_NS ""
-#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){ESP_LOGE(TAG, "Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);apa102_set_color(1, 0, 0, 1); vTaskDelay(1000 / portTICK_PERIOD_MS); vTaskDelete(NULL);}}
+#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){ESP_LOGE(TAG, "Failed status on line %d: %d. Retrying.\n",__LINE__,(int)temp_rc);apa102_set_color(1, 0, 0, 1); return false;}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){ESP_LOGE(TAG, "Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
 
-const uint8_t UART_NUMBER = 0;
-const uint8_t UART_IO_TX = 43;
-#define FREQUENCY 1000000L
-#define MAX_NUMBER_OF_CHANNELS 8
-#define MAX_STRIP_LENGTH 1000
+#define FREQUENCY CONFIG_APA102_FREQUENCY
+// Datasheets of APA102 and clones give 20 MHz at most
+#define MAX_APA102_FREQUENCY 20000000
 #define DEFAULT_BRIGHTNESS 0x1
+#define STATS_PERIOD_MS 1000
 
+static rclc_support_t support;
+static rcl_node_t node;
 static rcl_subscription_t subscriber;
-static uint8_t brightness[MAX_NUMBER_OF_CHANNELS];
-static const led_strip_msgs__msg__LedStrips * last_msg = NULL;
+static rcl_service_t set_brightness_service;
+static rcl_service_t configure_channels_service;
+static rcl_publisher_t stats_publisher;
+static rcl_timer_t stats_timer;
+#ifdef CONFIG_ECHO_SHOWN_FRAMES
+static rcl_publisher_t shown_frames_publisher;
+static std_msgs__msg__UInt32 shown_frame_msg;
+#endif
+#ifdef CONFIG_MEMORY_STATS_ENABLE
+static rcl_publisher_t memory_stats_publisher;
+static rcl_timer_t memory_stats_timer;
+static rcl_service_t dump_memory_service;
+static led_strip_msgs__srv__DumpMemory_Request dump_memory_req;
+// Its stats are also the message published on memory_stats
+static led_strip_msgs__srv__DumpMemory_Response dump_memory_res;
+static led_strip_msgs__msg__TaskStack memory_stats_tasks[MEMORY_STATS_MAX_TASKS];
+static char memory_stats_task_names[MEMORY_STATS_MAX_TASKS][configMAX_TASK_NAME_LEN];
+static led_strip_msgs__msg__HeapStats memory_stats_heaps[MEMORY_STATS_MAX_HEAPS];
+static char memory_stats_heap_names[MEMORY_STATS_MAX_HEAPS][16];
+#endif
+static rclc_executor_t executor;
+static bool support_ready = false;
+static led_strip_msgs__msg__LedStrips msg;
+static led_strip_msgs__srv__SetBrightness_Response res;
+static led_strip_msgs__srv__SetBrightness_Request req;
+static led_strip_msgs__srv__ConfigureChannels_Request configure_channels_req;
+static led_strip_msgs__srv__ConfigureChannels_Response configure_channels_res;
+#ifdef CONFIG_AUTO_BRIGHTNESS_ENABLE
+// Per channel limits of the automatic brightness, set by set_brightness
+static float min_brightness[MAX_NUMBER_OF_CHANNELS];
+static float max_brightness[MAX_NUMBER_OF_CHANNELS];
+static auto_brightness_t auto_brightness;
+static int64_t last_ambient_sample_us = 0;
+#endif
+static led_strip_msgs__msg__DriverStats stats_msg;
+// Serializes the access to the UARTs (and to the pacers) between micro-ROS and DDP
+static SemaphoreHandle_t output_mutex;
 
-void set_colors(const led_strip_msgs__msg__LedStrips * msg) {
-  blue_led_set(1);
-  for (size_t i = 0; i < msg->strips.size; i++) {
-    const led_strip_msgs__msg__LedStrip * strip_msg = msg->strips.data + i;
-    uint8_t channel_id = strip_msg->id;
-    channel_type_t type = (strip_msg->type == 0) ? CHANNEL_APA102_DATA : CHANNEL_WS2812;
-#ifdef TEST_ON_APA102
-    if(channel_id==0 && strip_msg->data.size >= 3) {
-      const uint8_t * rgb = (const uint8_t *) strip_msg->data.data;
-      apa102_set_color(rgb[0], rgb[1], rgb[2], brightness[channel_id]);
+// What the strips show, whatever the source (see led_frames.h).
+// The settings of the channels are read by the outputs: modified with output_mutex.
+static led_frames_t frames;
+// The frame being received (the buffers of msg) and the last accepted frame
+static BULK_ATTR uint8_t frame_buffers[2 * MAX_NUMBER_OF_CHANNELS][STRIP_BUFFER_SIZE];
+
+// A Serial LED Driver Pro board on its own UART.
+// Frames are written to the UART only as fast as the link drains them.
+// Meanwhile, a newer message replaces the pending one.
+typedef struct {
+  pb_driver_t driver;
+  frame_pacer_t pacer;
+  // bytes written for the current frame
+  size_t frame_size;
+} output_t;
+static output_t outputs[NUMBER_OF_OUTPUTS];
+
+#if NUMBER_OF_OUTPUTS > 1
+// uart_write_bytes blocks while the TX ring is full: the outputs after the
+// first are written by their own task, so that all the UARTs drain at once.
+static TaskHandle_t output_tasks[NUMBER_OF_OUTPUTS];
+static SemaphoreHandle_t outputs_written;
+#endif
+
+#ifdef CONFIG_SCENE_STORE_ENABLE
+// A scene is a sequence of strips: this header, then the pixels padded to 4 bytes
+typedef struct {
+  uint8_t id;
+  uint8_t type;
+  uint8_t color_order;
+  uint8_t reserved;
+  uint32_t size;
+} scene_strip_t;
+#define SCENE_MAX_SIZE (MAX_NUMBER_OF_CHANNELS * (sizeof(scene_strip_t) + STRIP_BUFFER_SIZE + 3))
+// SCENES_PARTITION_SIZE is read from partitions.csv by CMakeLists.txt
+#ifndef SCENES_PARTITION_SIZE
+#error "SCENE_STORE_ENABLE needs a scenes partition in partitions.csv"
+#endif
+_Static_assert(CONFIG_SCENE_STORE_MIN_SCENES * SCENE_STORE_SLOT_SIZE(SCENE_MAX_SIZE) <= SCENES_PARTITION_SIZE,
+               "The scenes partition of partitions.csv cannot hold SCENE_STORE_MIN_SCENES scenes: "
+               "grow it, or reduce MAX_NUMBER_OF_CHANNELS or MAX_STRIP_LENGTH");
+
+static rcl_service_t store_scene_service;
+static rcl_service_t recall_scene_service;
+static rcl_subscription_t scene_subscriber;
+static led_strip_msgs__srv__StoreScene_Request store_scene_req;
+static led_strip_msgs__srv__StoreScene_Response store_scene_res;
+static led_strip_msgs__srv__RecallScene_Request recall_scene_req;
+static led_strip_msgs__srv__RecallScene_Response recall_scene_res;
+static led_strip_msgs__msg__Scene scene_msg;
+// The recalled scene the LEDs show, -1 if none
+static int shown_scene = -1;
+#endif
+
+#ifdef CONFIG_SERIALIZED_TAKE
+// What the executor receives instead of a LedStrips: the frame is already
+// written to the driver, or copied to the frame buffers to wait for the link.
+typedef struct {
+  uint32_t seq;
+  bool shown;
+} serialized_take_t;
+static serialized_take_t serialized_take;
+#endif
+
+#ifdef CONFIG_KEYFRAME_ENABLE
+#ifdef CONFIG_KEYFRAME_EASE_IN_OUT
+#define KEYFRAME_EASING KEYFRAME_EASE_IN_OUT
+#else
+#define KEYFRAME_EASING KEYFRAME_LINEAR
+#endif
+// What is sent to the driver: per channel, a blend from what was shown when
+// the last keyframe arrived (keyframe_from) to the keyframe.
+// Frames are rendered at the rate of the pacer during a transition.
+static BULK_ATTR uint8_t keyframe_output[MAX_NUMBER_OF_CHANNELS][STRIP_BUFFER_SIZE];
+static BULK_ATTR uint8_t keyframe_from[MAX_NUMBER_OF_CHANNELS][STRIP_BUFFER_SIZE];
+#endif
+
+#ifdef CONFIG_DDP_ENABLE
+// DDP destination DDP_ID_DISPLAY + i is channel i, under output_mutex.
+// Type and color order of a channel are the last written to it.
+static BULK_ATTR uint8_t ddp_buffers[MAX_NUMBER_OF_CHANNELS][STRIP_BUFFER_SIZE];
+static ddp_channels_t ddp_channels;
+static bool ddp_is_last = false;
+#endif
+
+#ifdef CONFIG_DELTA_ENABLE
+// Deltas are decoded against the strips of the last keyframe, per channel,
+// then shown as a LedStrips.
+static rcl_subscription_t delta_subscriber;
+static led_strip_msgs__msg__LedStripsDelta delta_msg;
+static led_strip_msgs__msg__LedStripDelta delta_msg_strips[MAX_NUMBER_OF_CHANNELS];
+static BULK_ATTR uint8_t delta_msg_strips_data[MAX_NUMBER_OF_CHANNELS][DELTA_BUFFER_SIZE];
+static BULK_ATTR uint8_t delta_references[MAX_NUMBER_OF_CHANNELS][STRIP_BUFFER_SIZE];
+#endif
+
+#ifdef CONFIG_LAYERS_ENABLE
+// Per channel, a stack of LAYERS_COUNT layers of MAX_STRIP_LENGTH pixels,
+// composited into layers_output over the last strip written by the other
+// sources (layer_bases), when either changes or a layer expires.
+static rcl_subscription_t layers_subscriber;
+static led_strip_msgs__msg__LedLayer layer_msg;
+static led_strip_msgs__msg__LedLayerStrip layer_msg_strips[MAX_NUMBER_OF_CHANNELS];
+static BULK_ATTR uint8_t layer_msg_strips_data[MAX_NUMBER_OF_CHANNELS][STRIP_BUFFER_SIZE];
+static BULK_ATTR uint8_t layer_msg_strips_alpha[MAX_NUMBER_OF_CHANNELS][MAX_STRIP_LENGTH];
+static layer_t layers[MAX_NUMBER_OF_CHANNELS][LAYERS_COUNT];
+static BULK_ATTR uint8_t layer_buffers[MAX_NUMBER_OF_CHANNELS][LAYERS_COUNT * 4 * MAX_STRIP_LENGTH];
+static BULK_ATTR uint8_t layer_bases[MAX_NUMBER_OF_CHANNELS][STRIP_BUFFER_SIZE];
+static BULK_ATTR uint8_t layers_output[MAX_NUMBER_OF_CHANNELS][STRIP_BUFFER_SIZE];
+#endif
+
+static void init_frames() {
+  const led_frames_config_t config = {
+    .number_of_channels = MAX_NUMBER_OF_CHANNELS,
+    .max_strip_length = MAX_STRIP_LENGTH,
+#ifdef CONFIG_KEYFRAME_ENABLE
+    .easing = KEYFRAME_EASING,
+#endif
+#ifdef CONFIG_LAYERS_ENABLE
+    .layers_count = LAYERS_COUNT,
+#endif
+    .apa102_frequency = FREQUENCY,
+    .apa102_clock_mask = CONFIG_APA102_CLOCK_CHANNELS,
+  };
+  const led_frames_buffers_t buffers = {
+    .frames = frame_buffers[0],
+#ifdef CONFIG_KEYFRAME_ENABLE
+    .keyframe_output = keyframe_output[0],
+    .keyframe_from = keyframe_from[0],
+#endif
+#ifdef CONFIG_DELTA_ENABLE
+    .delta_references = delta_references[0],
+#endif
+#ifdef CONFIG_LAYERS_ENABLE
+    .layers = layers[0],
+    .layer_buffers = layer_buffers[0],
+    .layer_bases = layer_bases[0],
+    .layers_output = layers_output[0],
+#endif
+  };
+  led_frames_init(&frames, &config, &buffers);
+#ifdef CONFIG_DDP_ENABLE
+  ddp_channels_init(&ddp_channels, ddp_buffers[0], MAX_NUMBER_OF_CHANNELS, STRIP_BUFFER_SIZE);
+#endif
+}
+
+// Writes the strips of the frame that belong to an output, then draws
+static void write_output(size_t index) {
+  output_t * output = outputs + index;
+#ifdef CONFIG_TEST_ON_APA102
+  for (size_t i = 0; i < frames.write_number_of_strips && index == 0; i++) {
+    const led_frames_strip_t * strip = frames.write_strips + i;
+    if (strip->id == 0 && strip->size >= 3) {
+      apa102_set_color(strip->data[0], strip->data[1], strip->data[2], frames.write_brightness[0]);
     }
+  }
+  output->frame_size = 0;
 #else
-    pb_set_channel(
-        channel_id, type, strip_msg->color_order == 0 ? RGB : BGR,
-        strip_msg->data.size, (const uint8_t *) strip_msg->data.data,
-        FREQUENCY, brightness[channel_id]);
+  output->frame_size = led_frames_write_output(&frames, index, &output->driver);
+#endif
+}
+
+#if NUMBER_OF_OUTPUTS > 1
+static void output_task(void * arg) {
+  const size_t index = (size_t) arg;
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    write_output(index);
+    xSemaphoreGive(outputs_written);
+  }
+}
+#endif
+
+// Time to wait before all the outputs can take a frame
+static int64_t outputs_wait_us(int64_t now_us) {
+  int64_t wait_us = 0;
+  for (size_t i = 0; i < NUMBER_OF_OUTPUTS; i++) {
+    const int64_t output_wait_us = frame_pacer_wait_us(&outputs[i].pacer, now_us);
+    if (output_wait_us > wait_us) {
+      wait_us = output_wait_us;
+    }
+  }
+  return wait_us;
+}
+
+// Writes the strips to all the outputs at once and returns when they are written.
+// Called with output_mutex.
+static void write_frame(const led_frames_strip_t * strips, size_t number_of_strips) {
+  led_frames_begin_write(&frames, strips, number_of_strips);
+#ifdef CONFIG_DDP_ENABLE
+  ddp_is_last = false;
+#endif
+#if NUMBER_OF_OUTPUTS > 1
+  for (size_t i = 1; i < NUMBER_OF_OUTPUTS; i++) {
+    xTaskNotifyGive(output_tasks[i]);
+  }
 #endif
+  write_output(0);
+#if NUMBER_OF_OUTPUTS > 1
+  for (size_t i = 1; i < NUMBER_OF_OUTPUTS; i++) {
+    xSemaphoreTake(outputs_written, portMAX_DELAY);
   }
-#ifndef TEST_ON_APA102
-  pb_draw();
 #endif
+  const int64_t now_us = esp_timer_get_time();
+  for (size_t i = 0; i < NUMBER_OF_OUTPUTS; i++) {
+    frame_pacer_sent(&outputs[i].pacer, outputs[i].frame_size, now_us);
+  }
+}
+
+static void begin_frame() {
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  blue_led_set(1);
+}
+
+static void end_frame() {
   blue_led_set(0);
+  xSemaphoreGive(output_mutex);
+  boot_trace_done("first frame");
+}
+
+#ifdef CONFIG_DDP_ENABLE
+static void ddp_data_callback(uint8_t destination, uint32_t offset, const uint8_t *data, size_t size, void *arg) {
+  // The buffers are read by show_again and store_scene from micro-ROS
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  ddp_channels_write(&ddp_channels, destination, offset, data, size);
+  xSemaphoreGive(output_mutex);
+}
+
+// Called with output_mutex
+static void ddp_draw(uint16_t channel_mask) {
+  led_frames_strip_t strips[MAX_NUMBER_OF_CHANNELS];
+  size_t number_of_strips = 0;
+  for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS; i++) {
+    if (channel_mask & (1 << i)) {
+      strips[number_of_strips++] = (led_frames_strip_t) {
+        i, frames.channel_types[i], frames.channel_color_orders[i], ddp_buffers[i], ddp_channels.size[i]};
+    }
+  }
+  write_frame(strips, number_of_strips);
+  ddp_is_last = true;
+}
+
+// Pushes all channels that received data, independently of the destination.
+static void ddp_push_callback(uint8_t destination, void *arg) {
+  // Waiting here applies back pressure on the sender: the buffers are not
+  // modified before the next packet is read.
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  if (!ddp_channels.received_mask) {
+    xSemaphoreGive(output_mutex);
+    return;
+  }
+  int64_t wait_us;
+  while ((wait_us = outputs_wait_us(esp_timer_get_time())) > 0) {
+    xSemaphoreGive(output_mutex);
+    usleep(wait_us);
+    xSemaphoreTake(output_mutex, portMAX_DELAY);
+  }
+  blue_led_set(1);
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  shown_scene = -1;
+#endif
+  ddp_draw(ddp_channels_push(&ddp_channels));
+  blue_led_set(0);
+  xSemaphoreGive(output_mutex);
+}
+#endif
+
+// Shows the last received frame if the link can take it.
+// Returns the time to wait before the next try, 0 if nothing is pending.
+static int64_t show_pending_frame() {
+  if (!frames.pending) {
+    return 0;
+  }
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  const int64_t wait_us = outputs_wait_us(esp_timer_get_time());
+  if (wait_us > 0) {
+    xSemaphoreGive(output_mutex);
+    return wait_us;
+  }
+  blue_led_set(1);
+  led_frames_strip_t strips[MAX_NUMBER_OF_CHANNELS];
+  const size_t number_of_strips = led_frames_render(&frames, esp_timer_get_time(), strips);
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  shown_scene = -1;
+#endif
+  write_frame(strips, number_of_strips);
+  end_frame();
+#ifdef CONFIG_ECHO_SHOWN_FRAMES
+  if (frames.seq) {
+    shown_frame_msg.data = frames.seq;
+    RCSOFTCHECK(rcl_publish(&shown_frames_publisher, &shown_frame_msg, NULL));
+  }
+#endif
+  return 0;
+}
+
+// rclc deserializes every LedStrips in msg, late or not: its strips point to
+// the slot of the frame buffers that is not shown.
+static void set_message_buffers() {
+  for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS; i++) {
+    msg.strips.data[i].data.data = led_frames_receive_buffer(&frames, i);
+  }
 }
 
 void subscription_callback(const void * msgin) {
-  last_msg = (const led_strip_msgs__msg__LedStrips *)msgin;
-  set_colors(last_msg);
+  const led_strip_msgs__msg__LedStrips * strips_msg = (const led_strip_msgs__msg__LedStrips *)msgin;
+  // The pixels are in the frame buffers
+  led_frames_strip_t strips[MAX_NUMBER_OF_CHANNELS];
+  size_t number_of_strips = 0;
+  for (size_t i = 0; i < strips_msg->strips.size && number_of_strips < MAX_NUMBER_OF_CHANNELS; i++) {
+    const led_strip_msgs__msg__LedStrip * strip_msg = strips_msg->strips.data + i;
+    strips[number_of_strips++] = (led_frames_strip_t) {
+      strip_msg->id, strip_msg->type, strip_msg->color_order, strip_msg->data.data, strip_msg->data.size};
+  }
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  const bool received = led_frames_receive(&frames, strips_msg->seq, strips_msg->transition_ms,
+                                           strips, number_of_strips, esp_timer_get_time());
+  xSemaphoreGive(output_mutex);
+  if (received) {
+    set_message_buffers();
+    show_pending_frame();
+  }
+}
+
+#ifdef CONFIG_SERIALIZED_TAKE
+// Called by rmw while it takes a LedStrips, with the pixels in its buffer.
+// If the link is free, they go straight to the driver.
+static void take_serialized_frame(led_strips_cdr_frame_t * frame, void * message) {
+  serialized_take_t * take = (serialized_take_t *) message;
+  take->seq = frame->seq;
+  take->shown = false;
+  if (!led_frames_check_sequence(&frames, frame->seq)) {
+    return;
+  }
+  led_strips_cdr_strip_t strip;
+  led_frames_strip_t strips[MAX_NUMBER_OF_CHANNELS];
+  size_t number_of_strips = 0;
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  const bool link_free = outputs_wait_us(esp_timer_get_time()) == 0;
+  xSemaphoreGive(output_mutex);
+  if (link_free) {
+    while (number_of_strips < MAX_NUMBER_OF_CHANNELS && led_strips_cdr_next_strip(frame, &strip)) {
+      strips[number_of_strips++] = (led_frames_strip_t) {strip.id, strip.type, strip.color_order, strip.data, strip.size};
+    }
+    begin_frame();
+#ifdef CONFIG_SCENE_STORE_ENABLE
+    shown_scene = -1;
+#endif
+    write_frame(strips, number_of_strips);
+    // The pixels are gone with the rmw buffer
+    led_frames_written_directly(&frames);
+    end_frame();
+    take->shown = true;
+    return;
+  }
+  // Keep the frame until the link can take it
+  while (number_of_strips < MAX_NUMBER_OF_CHANNELS && led_strips_cdr_next_strip(frame, &strip)) {
+    uint8_t * data = led_frames_receive_buffer(&frames, number_of_strips);
+    const size_t size = strip.size < STRIP_BUFFER_SIZE ? strip.size : STRIP_BUFFER_SIZE;
+    memcpy(data, strip.data, size);
+    strips[number_of_strips++] = (led_frames_strip_t) {strip.id, strip.type, strip.color_order, data, size};
+  }
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  led_frames_take(&frames, frame->seq, frame->transition_ms, strips, number_of_strips, esp_timer_get_time());
+  xSemaphoreGive(output_mutex);
+}
+
+void serialized_subscription_callback(const void * msgin) {
+  const serialized_take_t * take = (const serialized_take_t *) msgin;
+#ifdef CONFIG_ECHO_SHOWN_FRAMES
+  if (take->shown && take->seq) {
+    shown_frame_msg.data = take->seq;
+    RCSOFTCHECK(rcl_publish(&shown_frames_publisher, &shown_frame_msg, NULL));
+  }
+#else
+  RCLC_UNUSED(take);
+#endif
+}
+#endif
+
+#ifdef CONFIG_DELTA_ENABLE
+// A delta missing its keyframe is dropped, and counted as such by the
+// sequence check when the next frame is shown.
+static void delta_subscription_callback(const void * msgin) {
+  const led_strip_msgs__msg__LedStripsDelta * _msg = (const led_strip_msgs__msg__LedStripsDelta *) msgin;
+  led_frames_delta_t strips[MAX_NUMBER_OF_CHANNELS];
+  size_t number_of_strips = 0;
+  for (size_t i = 0; i < _msg->strips.size && number_of_strips < MAX_NUMBER_OF_CHANNELS; i++) {
+    const led_strip_msgs__msg__LedStripDelta * strip_delta = _msg->strips.data + i;
+    strips[number_of_strips++] = (led_frames_delta_t) {
+      strip_delta->id, strip_delta->type, strip_delta->color_order, strip_delta->size,
+      strip_delta->data.data, strip_delta->data.size};
+  }
+  size_t invalid_strips;
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  const bool received = led_frames_receive_delta(&frames, _msg->seq, _msg->keyframe_seq, _msg->transition_ms,
+                                                 strips, number_of_strips, esp_timer_get_time(), &invalid_strips);
+  xSemaphoreGive(output_mutex);
+  if (invalid_strips) {
+    ESP_LOGW(TAG, "%u invalid strips in delta %u", (unsigned) invalid_strips, _msg->seq);
+  }
+  if (received) {
+    show_pending_frame();
+  }
+}
+
+static void init_delta_message() {
+  delta_msg.strips.capacity = MAX_NUMBER_OF_CHANNELS;
+  delta_msg.strips.size = 0;
+  delta_msg.strips.data = delta_msg_strips;
+  for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS; i++) {
+    delta_msg.strips.data[i].data.capacity = DELTA_BUFFER_SIZE;
+    delta_msg.strips.data[i].data.size = 0;
+    delta_msg.strips.data[i].data.data = delta_msg_strips_data[i];
+  }
+}
+#endif
+
+#ifdef CONFIG_LAYERS_ENABLE
+// Writes the channels whose layers changed or expired again, over their base,
+// if the link can take them.
+// Returns the time to wait before the next try, 0 if nothing is pending.
+static int64_t show_layers() {
+  const int64_t now_us = esp_timer_get_time();
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  const uint16_t dirty_mask = led_frames_layers_dirty(&frames, now_us);
+  if (!dirty_mask) {
+    xSemaphoreGive(output_mutex);
+    return 0;
+  }
+  const int64_t wait_us = outputs_wait_us(now_us);
+  if (wait_us > 0) {
+    xSemaphoreGive(output_mutex);
+    return wait_us;
+  }
+  blue_led_set(1);
+  led_frames_strip_t strips[MAX_NUMBER_OF_CHANNELS];
+  const size_t number_of_strips = led_frames_layer_strips(&frames, dirty_mask, strips);
+  write_frame(strips, number_of_strips);
+  end_frame();
+  return 0;
 }
 
-static void set_brightness(uint8_t channel_mask, float value) {
+static void layer_callback(const void * msgin) {
+  const led_strip_msgs__msg__LedLayer * _msg = (const led_strip_msgs__msg__LedLayer *) msgin;
+  led_frames_layer_strip_t strips[MAX_NUMBER_OF_CHANNELS];
+  size_t number_of_strips = 0;
+  for (size_t i = 0; i < _msg->strips.size && number_of_strips < MAX_NUMBER_OF_CHANNELS; i++) {
+    const led_strip_msgs__msg__LedLayerStrip * strip_msg = _msg->strips.data + i;
+    strips[number_of_strips++] = (led_frames_layer_strip_t) {
+      strip_msg->id, strip_msg->type, strip_msg->color_order, strip_msg->offset,
+      strip_msg->data.data, strip_msg->data.size,
+      strip_msg->alpha.size ? strip_msg->alpha.data : NULL, strip_msg->alpha.size};
+  }
+  const int64_t expires_us = _msg->timeout_ms ? esp_timer_get_time() + 1000LL * _msg->timeout_ms : 0;
+  size_t invalid_strips;
+  // The DDP task composites the layers too
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  const bool set = led_frames_set_layer(&frames, _msg->layer, _msg->priority, expires_us,
+                                        strips, number_of_strips, &invalid_strips);
+  xSemaphoreGive(output_mutex);
+  if (!set) {
+    ESP_LOGW(TAG, "No layer %u", _msg->layer);
+    return;
+  }
+  if (invalid_strips) {
+    ESP_LOGW(TAG, "%u invalid strips in layer %u", (unsigned) invalid_strips, _msg->layer);
+  }
+  show_layers();
+}
+
+static void init_layer_message() {
+  layer_msg.strips.capacity = MAX_NUMBER_OF_CHANNELS;
+  layer_msg.strips.size = 0;
+  layer_msg.strips.data = layer_msg_strips;
+  for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS; i++) {
+    layer_msg_strips[i].data.capacity = STRIP_BUFFER_SIZE;
+    layer_msg_strips[i].data.size = 0;
+    layer_msg_strips[i].data.data = layer_msg_strips_data[i];
+    layer_msg_strips[i].alpha.capacity = MAX_STRIP_LENGTH;
+    layer_msg_strips[i].alpha.size = 0;
+    layer_msg_strips[i].alpha.data = layer_msg_strips_alpha[i];
+  }
+}
+#endif
+
+static void stats_timer_callback(rcl_timer_t * timer, int64_t last_call_time) {
+  RCLC_UNUSED(last_call_time);
+  if (timer != NULL) {
+    // The frames go to all the outputs: report the busiest link
+    frame_pacer_stats_t stats[NUMBER_OF_OUTPUTS];
+    xSemaphoreTake(output_mutex, portMAX_DELAY);
+    const int64_t now_us = esp_timer_get_time();
+    for (size_t i = 0; i < NUMBER_OF_OUTPUTS; i++) {
+      frame_pacer_get_stats(&outputs[i].pacer, now_us, stats + i);
+    }
+    stats_msg.dropped_frames = frames.dropped_frames;
+    stats_msg.coalesced_frames = frames.coalesced_frames;
+    stats_msg.keyframe_seq = frames.keyframe_seq;
+    xSemaphoreGive(output_mutex);
+    stats_msg.fps = stats[0].fps;
+    stats_msg.link_utilization = 0;
+    for (size_t i = 0; i < NUMBER_OF_OUTPUTS; i++) {
+      if (stats[i].link_utilization > stats_msg.link_utilization) {
+        stats_msg.link_utilization = stats[i].link_utilization;
+      }
+    }
+    RCSOFTCHECK(rcl_publish(&stats_publisher, &stats_msg, NULL));
+  }
+}
+
+#ifdef CONFIG_MEMORY_STATS_ENABLE
+static void init_memory_stats_message() {
+  led_strip_msgs__msg__MemoryStats * stats = &dump_memory_res.stats;
+  stats->tasks.data = memory_stats_tasks;
+  stats->tasks.capacity = MEMORY_STATS_MAX_TASKS;
+  stats->tasks.size = 0;
+  for (size_t i = 0; i < MEMORY_STATS_MAX_TASKS; i++) {
+    stats->tasks.data[i].name.data = memory_stats_task_names[i];
+    stats->tasks.data[i].name.capacity = configMAX_TASK_NAME_LEN;
+    stats->tasks.data[i].name.size = 0;
+  }
+  stats->heaps.data = memory_stats_heaps;
+  stats->heaps.capacity = MEMORY_STATS_MAX_HEAPS;
+  stats->heaps.size = 0;
+  for (size_t i = 0; i < MEMORY_STATS_MAX_HEAPS; i++) {
+    stats->heaps.data[i].name.data = memory_stats_heap_names[i];
+    stats->heaps.data[i].name.capacity = sizeof(memory_stats_heap_names[i]);
+    stats->heaps.data[i].name.size = 0;
+  }
+}
+
+static void set_string(rosidl_runtime_c__String * string, const char * value) {
+  strlcpy(string->data, value, string->capacity);
+  string->size = strlen(string->data);
+}
+
+static void sample_memory_stats() {
+  static memory_stats_task_t tasks[MEMORY_STATS_MAX_TASKS];
+  memory_stats_heap_t heaps[MEMORY_STATS_MAX_HEAPS];
+  led_strip_msgs__msg__MemoryStats * stats = &dump_memory_res.stats;
+  stats->tasks.size = memory_stats_get_tasks(tasks, MEMORY_STATS_MAX_TASKS);
+  for (size_t i = 0; i < stats->tasks.size; i++) {
+    set_string(&stats->tasks.data[i].name, tasks[i].name);
+    stats->tasks.data[i].stack_high_water_mark = tasks[i].stack_high_water_mark;
+  }
+  stats->heaps.size = memory_stats_get_heaps(heaps, MEMORY_STATS_MAX_HEAPS);
+  for (size_t i = 0; i < stats->heaps.size; i++) {
+    led_strip_msgs__msg__HeapStats * heap = stats->heaps.data + i;
+    set_string(&heap->name, heaps[i].name);
+    heap->caps = heaps[i].caps;
+    heap->free = heaps[i].free;
+    heap->minimum_free = heaps[i].minimum_free;
+    heap->largest_free_block = heaps[i].largest_free_block;
+  }
+}
+
+static void memory_stats_timer_callback(rcl_timer_t * timer, int64_t last_call_time) {
+  RCLC_UNUSED(last_call_time);
+  if (timer != NULL) {
+    sample_memory_stats();
+    RCSOFTCHECK(rcl_publish(&memory_stats_publisher, &dump_memory_res.stats, NULL));
+  }
+}
+
+static void dump_memory_service_callback(const void * req, void * res) {
+  RCLC_UNUSED(req);
+  RCLC_UNUSED(res);
+  sample_memory_stats();
+  memory_stats_log();
+}
+#endif
+
+#ifdef CONFIG_SCENE_STORE_ENABLE
+static esp_err_t store_strip(uint8_t channel_id, uint8_t type, uint8_t color_order,
+                             const uint8_t * data, size_t size) {
+  static const uint8_t padding[3] = {0};
+  const scene_strip_t header = {
+    .id = channel_id, .type = type, .color_order = color_order, .size = size
+  };
+  esp_err_t err = scene_store_append(&header, sizeof(header));
+  if (err == ESP_OK) {
+    err = scene_store_append(data, size);
+  }
+  if (err == ESP_OK && size % 4) {
+    err = scene_store_append(padding, 4 - size % 4);
+  }
+  return err;
+}
+
+// Stores what the LEDs show: the last frame, DDP data or scene.
+static bool store_scene(uint8_t id) {
+  if (shown_scene == id) {
+    return true;
+  }
+  size_t scene_size = 0;
+  const uint8_t * scene = shown_scene >= 0 ? scene_store_get(shown_scene, &scene_size) : NULL;
+#ifdef CONFIG_DDP_ENABLE
+  const bool from_ddp = ddp_is_last;
+#else
+  const bool from_ddp = false;
+#endif
+  led_frames_strip_t strips[MAX_NUMBER_OF_CHANNELS];
+  const size_t number_of_strips = led_frames_last(&frames, strips);
+  if (!scene && !from_ddp && !number_of_strips) {
+    return false;
+  }
+  esp_err_t err = scene_store_begin(id);
+  if (scene) {
+    // Flash to flash, through the bounce buffer of the flash driver
+    if (err == ESP_OK) {
+      err = scene_store_append(scene, scene_size);
+    }
+  } else if (from_ddp) {
+#ifdef CONFIG_DDP_ENABLE
+    for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS && err == ESP_OK; i++) {
+      if (ddp_channels.size[i]) {
+        err = store_strip(i, frames.channel_types[i], frames.channel_color_orders[i],
+                          ddp_buffers[i], ddp_channels.size[i]);
+      }
+    }
+#endif
+  } else {
+    for (size_t i = 0; i < number_of_strips && err == ESP_OK; i++) {
+      err = store_strip(strips[i].id, strips[i].type, strips[i].color_order, strips[i].data, strips[i].size);
+    }
+  }
+  if (err == ESP_OK) {
+    err = scene_store_end();
+  }
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Cannot store scene %u: %s", id, esp_err_to_name(err));
+    return false;
+  }
+  return true;
+}
+
+// Writes the strips of scene `id` from flash to the driver
+static bool recall_scene(uint8_t id) {
+  size_t scene_size;
+  const uint8_t * scene = scene_store_get(id, &scene_size);
+  if (!scene) {
+    return false;
+  }
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  int64_t wait_us;
+  while ((wait_us = outputs_wait_us(esp_timer_get_time())) > 0) {
+    xSemaphoreGive(output_mutex);
+    usleep(wait_us);
+    xSemaphoreTake(output_mutex, portMAX_DELAY);
+  }
+  blue_led_set(1);
+  led_frames_strip_t strips[MAX_NUMBER_OF_CHANNELS];
+  size_t number_of_strips = 0;
+  for (size_t offset = 0; offset + sizeof(scene_strip_t) <= scene_size && number_of_strips < MAX_NUMBER_OF_CHANNELS;) {
+    const scene_strip_t * strip = (const scene_strip_t *) (scene + offset);
+    offset += sizeof(scene_strip_t);
+    if (strip->size > scene_size - offset) {
+      break;
+    }
+    strips[number_of_strips++] = (led_frames_strip_t) {strip->id, strip->type, strip->color_order, scene + offset, strip->size};
+    offset += (strip->size + 3) & ~3;
+  }
+  write_frame(strips, number_of_strips);
+  // The scene replaces the frame waiting for the link
+  led_frames_cancel(&frames);
+  shown_scene = id;
+  end_frame();
+  return true;
+}
+
+static void store_scene_service_callback(const void * req, void * res) {
+  const led_strip_msgs__srv__StoreScene_Request * req_in = (const led_strip_msgs__srv__StoreScene_Request *) req;
+  led_strip_msgs__srv__StoreScene_Response * res_out = (led_strip_msgs__srv__StoreScene_Response *) res;
+  // What is shown does not change while it is written to the flash
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  res_out->success = store_scene(req_in->id);
+  xSemaphoreGive(output_mutex);
+}
+
+static void recall_scene_service_callback(const void * req, void * res) {
+  const led_strip_msgs__srv__RecallScene_Request * req_in = (const led_strip_msgs__srv__RecallScene_Request *) req;
+  led_strip_msgs__srv__RecallScene_Response * res_out = (led_strip_msgs__srv__RecallScene_Response *) res;
+  res_out->success = recall_scene(req_in->id);
+}
+
+static void scene_callback(const void * msgin) {
+  const led_strip_msgs__msg__Scene * _msg = (const led_strip_msgs__msg__Scene *) msgin;
+  if (!recall_scene(_msg->id)) {
+    ESP_LOGW(TAG, "No scene %u", _msg->id);
+  }
+}
+#endif
+
+// Returns true if the brightness of a channel changed.
+// The next frame written has the new brightness.
+static bool set_brightness(uint16_t channel_mask, float value) {
   uint8_t i_value;
   if (value < 0) {
     i_value = 0x0;
@@ -86,88 +831,366 @@ static void set_brightness(uint8_t channel_mask, float value) {
   } else {
     i_value = (uint8_t) (31 * value);
   }
+  bool changed = false;
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
   for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS; i++) {
     if(channel_mask & (1 << i)) {
-      brightness[i] = i_value;
+      changed |= frames.brightness[i] != i_value;
+      frames.brightness[i] = i_value;
+    }
+  }
+  xSemaphoreGive(output_mutex);
+  return changed;
+}
+
+// Shows the last frame again, e.g., with a new brightness
+static void show_again() {
+#ifdef CONFIG_LAYERS_ENABLE
+  // Channels shown by the layers only are written again by the next show_layers
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  led_frames_redraw_layers(&frames);
+  xSemaphoreGive(output_mutex);
+#endif
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  if (shown_scene >= 0) {
+    recall_scene(shown_scene);
+    return;
+  }
+#endif
+#ifdef CONFIG_DDP_ENABLE
+  if (ddp_is_last) {
+    xSemaphoreTake(output_mutex, portMAX_DELAY);
+    uint16_t channel_mask = 0;
+    for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS; i++) {
+      if (ddp_channels.size[i]) {
+        channel_mask |= (1 << i);
+      }
     }
+    ddp_draw(channel_mask);
+    xSemaphoreGive(output_mutex);
+    return;
   }
+#endif
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  led_frames_show_again(&frames);
+  xSemaphoreGive(output_mutex);
+  show_pending_frame();
 }
 
+#ifdef CONFIG_AUTO_BRIGHTNESS_ENABLE
+static bool apply_auto_brightness(uint16_t channel_mask) {
+  bool changed = false;
+  for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS; i++) {
+    if (channel_mask & (1 << i)) {
+      changed |= set_brightness(1 << i, auto_brightness.started ?
+        auto_brightness_scale(&auto_brightness, min_brightness[i], max_brightness[i]) : max_brightness[i]);
+    }
+  }
+  return changed;
+}
+
+static void set_brightness_limits(uint16_t channel_mask, float min, float max) {
+  for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS; i++) {
+    if (channel_mask & (1 << i)) {
+      min_brightness[i] = min;
+      max_brightness[i] = max;
+    }
+  }
+  apply_auto_brightness(channel_mask);
+}
+
+// Called from the micro-ROS task loop, samples at the sensor rate
+static void update_auto_brightness() {
+  const int64_t now_us = esp_timer_get_time();
+  if (now_us - last_ambient_sample_us < 1000LL * CONFIG_AUTO_BRIGHTNESS_PERIOD_MS) {
+    return;
+  }
+  const float dt_s = 1e-6f * (now_us - last_ambient_sample_us);
+  last_ambient_sample_us = now_us;
+  // Redraw only when the 5 bit brightness of a channel changes
+  if (auto_brightness_update(&auto_brightness, ambient_read(), dt_s) && apply_auto_brightness(ALL_CHANNELS)) {
+    show_again();
+  }
+}
+#endif
+
 void set_brightness_service_callback(const void * req, void * res){
   led_strip_msgs__srv__SetBrightness_Request * req_in = (led_strip_msgs__srv__SetBrightness_Request *) req;
+#ifdef CONFIG_AUTO_BRIGHTNESS_ENABLE
+  set_brightness_limits(req_in->channel_index_mask, req_in->min_brightness, req_in->brightness);
+#else
   set_brightness(req_in->channel_index_mask, req_in->brightness);
-  if(last_msg) {
-    set_colors(last_msg);
+#endif
+  show_again();
+}
+
+static void configure_channels_service_callback(const void * req, void * res) {
+  const led_strip_msgs__srv__ConfigureChannels_Request * req_in = (const led_strip_msgs__srv__ConfigureChannels_Request *) req;
+  led_strip_msgs__srv__ConfigureChannels_Response * res_out = (led_strip_msgs__srv__ConfigureChannels_Response *) res;
+  const uint32_t frequency = req_in->apa102_frequency ? req_in->apa102_frequency : FREQUENCY;
+  res_out->success = frequency <= MAX_APA102_FREQUENCY;
+  if (!res_out->success) {
+    ESP_LOGW(TAG, "APA102 frequency %u Hz is above %u Hz", frequency, MAX_APA102_FREQUENCY);
+    return;
+  }
+  xSemaphoreTake(output_mutex, portMAX_DELAY);
+  for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS; i++) {
+    if (req_in->channel_index_mask & (1 << i)) {
+      frames.apa102_frequencies[i] = frequency;
+      if (req_in->apa102_clock) {
+        frames.apa102_clock_mask |= (1 << i);
+      } else {
+        frames.apa102_clock_mask &= ~(1 << i);
+      }
+    }
   }
+  xSemaphoreGive(output_mutex);
+  show_again();
 }
 
-void micro_ros_task(void * arg)
-{
-  apa102_set_color(0, 0, 32, 1);
+// We have to allocate the message ourself.
+// It is statically sized for the configured strips and kept across reconnections.
+// The pixels are deserialized in the frame buffers.
+static led_strip_msgs__msg__LedStrip msg_strips[MAX_NUMBER_OF_CHANNELS];
+
+static void init_message() {
+  msg.strips.capacity = MAX_NUMBER_OF_CHANNELS;
+  msg.strips.size = 0;
+  msg.strips.data = msg_strips;
+
+  for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS; i++) {
+    msg.strips.data[i].data.capacity = STRIP_BUFFER_SIZE;
+    msg.strips.data[i].data.size = 0;
+  }
+  set_message_buffers();
+}
+
+static bool create_entities() {
   rcl_allocator_t allocator = rcl_get_default_allocator();
-  rclc_support_t support;
   rcl_init_options_t init_options = rcl_get_zero_initialized_init_options();
   RCCHECK(rcl_init_options_init(&init_options, allocator));
   rmw_init_options_t* rmw_options = rcl_init_options_get_rmw_init_options(&init_options);
-  while(rmw_uros_discover_agent(rmw_options) != RCL_RET_OK) {
-    usleep(100000);
+#ifdef RMW_UXRCE_TRANSPORT_CUSTOM
+  // No discovery on a serial link: check that the agent is there
+  if (rmw_uros_ping_agent(UROS_RECONNECT_PING_TIMEOUT_MS, 1) != RMW_RET_OK) {
+#else
+  // Try the agent of the last session first
+  if (uros_agent_cache_find_agent(rmw_options) != RMW_RET_OK) {
+#endif
+    RCSOFTCHECK(rcl_init_options_fini(&init_options));
+    return false;
   }
+  boot_trace_mark("agent found");
 
   // create init_options
-  RCCHECK(rclc_support_init_with_options(&support, 0, NULL, &init_options, &allocator));
+  apa102_set_color(0, 32, 32, 1);
+  rcl_ret_t rc = rclc_support_init_with_options(&support, 0, NULL, &init_options, &allocator);
+  RCSOFTCHECK(rcl_init_options_fini(&init_options));
+  RCCHECK(rc);
+  support_ready = true;
+
   // create node
-  rcl_node_t node;
+  node = rcl_get_zero_initialized_node();
   RCCHECK(rclc_node_init_default(&node, NODE_NAME, NODE_NS, &support));
 
   // create subscriber
+  subscriber = rcl_get_zero_initialized_subscription();
+#ifdef CONFIG_SERIALIZED_TAKE
+  const rosidl_message_type_support_t * led_strips_type_support = led_strips_cdr_type_support(take_serialized_frame);
+#else
+  const rosidl_message_type_support_t * led_strips_type_support = ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, LedStrips);
+#endif
+#ifdef CONFIG_PIXEL_QOS_BEST_EFFORT
+  rmw_qos_profile_t pixel_qos = rmw_qos_profile_sensor_data;
+  pixel_qos.depth = 1;
+  RCCHECK(rclc_subscription_init(
+    &subscriber, &node, led_strips_type_support, "led_strips", &pixel_qos));
+#else
   RCCHECK(rclc_subscription_init_default(
-    &subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, LedStrips),
-    "led_strips"));
-
-  // We have to allocate the message ourself.
-  // TODO(jerome): can we use a convenience function?
-  led_strip_msgs__msg__LedStrips msg;
-  msg.strips.capacity = 8;
-  msg.strips.data = malloc(8 * sizeof(led_strip_msgs__msg__LedStrip));
+    &subscriber, &node, led_strips_type_support, "led_strips"));
+#endif
+#ifdef CONFIG_DELTA_ENABLE
+  delta_subscriber = rcl_get_zero_initialized_subscription();
+#ifdef CONFIG_PIXEL_QOS_BEST_EFFORT
+  RCCHECK(rclc_subscription_init(
+    &delta_subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, LedStripsDelta),
+    "led_strips_delta", &pixel_qos));
+#else
+  RCCHECK(rclc_subscription_init_default(
+    &delta_subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, LedStripsDelta),
+    "led_strips_delta"));
+#endif
+#endif
+#ifdef CONFIG_LAYERS_ENABLE
+  // Reliable whatever PIXEL_QOS: a lost update would stay on the strips
+  layers_subscriber = rcl_get_zero_initialized_subscription();
+  RCCHECK(rclc_subscription_init_default(
+    &layers_subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, LedLayer), "led_layers"));
+#endif
 
-  for (size_t i = 0; i < MAX_NUMBER_OF_CHANNELS; i++) {
-    msg.strips.data[i].data.capacity = MAX_STRIP_LENGTH * 3;
-    msg.strips.data[i].data.data = malloc(MAX_STRIP_LENGTH * 3);
-  }
+  // create publisher
+  stats_publisher = rcl_get_zero_initialized_publisher();
+  RCCHECK(rclc_publisher_init_best_effort(
+    &stats_publisher, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, DriverStats),
+    "driver_stats"));
+  stats_timer = rcl_get_zero_initialized_timer();
+  RCCHECK(rclc_timer_init_default(&stats_timer, &support, RCL_MS_TO_NS(STATS_PERIOD_MS), stats_timer_callback));
+#ifdef CONFIG_ECHO_SHOWN_FRAMES
+  shown_frames_publisher = rcl_get_zero_initialized_publisher();
+  RCCHECK(rclc_publisher_init_best_effort(
+    &shown_frames_publisher, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, UInt32),
+    "shown_frames"));
+#endif
+#ifdef CONFIG_MEMORY_STATS_ENABLE
+  memory_stats_publisher = rcl_get_zero_initialized_publisher();
+  RCCHECK(rclc_publisher_init_best_effort(
+    &memory_stats_publisher, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, MemoryStats),
+    "memory_stats"));
+  memory_stats_timer = rcl_get_zero_initialized_timer();
+  RCCHECK(rclc_timer_init_default(&memory_stats_timer, &support, RCL_MS_TO_NS(CONFIG_MEMORY_STATS_PERIOD_MS), memory_stats_timer_callback));
+#endif
 
-  apa102_set_color(0, 32, 32, 1);
-  // // create service
-  rcl_service_t set_brightness_service;
+  // create service
+  set_brightness_service = rcl_get_zero_initialized_service();
   RCCHECK(rclc_service_init_default(&set_brightness_service, &node, ROSIDL_GET_SRV_TYPE_SUPPORT(led_strip_msgs, srv, SetBrightness), "set_brightness"));
+  configure_channels_service = rcl_get_zero_initialized_service();
+  RCCHECK(rclc_service_init_default(&configure_channels_service, &node, ROSIDL_GET_SRV_TYPE_SUPPORT(led_strip_msgs, srv, ConfigureChannels), "configure_channels"));
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  store_scene_service = rcl_get_zero_initialized_service();
+  RCCHECK(rclc_service_init_default(&store_scene_service, &node, ROSIDL_GET_SRV_TYPE_SUPPORT(led_strip_msgs, srv, StoreScene), "store_scene"));
+  recall_scene_service = rcl_get_zero_initialized_service();
+  RCCHECK(rclc_service_init_default(&recall_scene_service, &node, ROSIDL_GET_SRV_TYPE_SUPPORT(led_strip_msgs, srv, RecallScene), "recall_scene"));
+  scene_subscriber = rcl_get_zero_initialized_subscription();
+  RCCHECK(rclc_subscription_init_default(
+    &scene_subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, Scene), "scene"));
+#endif
+#ifdef CONFIG_MEMORY_STATS_ENABLE
+  dump_memory_service = rcl_get_zero_initialized_service();
+  RCCHECK(rclc_service_init_default(&dump_memory_service, &node, ROSIDL_GET_SRV_TYPE_SUPPORT(led_strip_msgs, srv, DumpMemory), "dump_memory"));
+#endif
 
   // create executor
-  rclc_executor_t executor;
-  RCCHECK(rclc_executor_init(&executor, &support.context, 2, &allocator));
+  executor = rclc_executor_get_zero_initialized_executor();
+  RCCHECK(rclc_executor_init(&executor, &support.context, EXECUTOR_HANDLES, &allocator));
+#ifdef CONFIG_SERIALIZED_TAKE
+  RCCHECK(rclc_executor_add_subscription(&executor, &subscriber, &serialized_take, &serialized_subscription_callback, ON_NEW_DATA));
+#else
   RCCHECK(rclc_executor_add_subscription(&executor, &subscriber, &msg, &subscription_callback, ON_NEW_DATA));
-  led_strip_msgs__srv__SetBrightness_Response res;
-  led_strip_msgs__srv__SetBrightness_Request req;
+#endif
   RCCHECK(rclc_executor_add_service(&executor, &set_brightness_service, &req, &res, set_brightness_service_callback));
+  RCCHECK(rclc_executor_add_service(&executor, &configure_channels_service, &configure_channels_req, &configure_channels_res, configure_channels_service_callback));
+  RCCHECK(rclc_executor_add_timer(&executor, &stats_timer));
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  RCCHECK(rclc_executor_add_service(&executor, &store_scene_service, &store_scene_req, &store_scene_res, store_scene_service_callback));
+  RCCHECK(rclc_executor_add_service(&executor, &recall_scene_service, &recall_scene_req, &recall_scene_res, recall_scene_service_callback));
+  RCCHECK(rclc_executor_add_subscription(&executor, &scene_subscriber, &scene_msg, &scene_callback, ON_NEW_DATA));
+#endif
+#ifdef CONFIG_DELTA_ENABLE
+  RCCHECK(rclc_executor_add_subscription(&executor, &delta_subscriber, &delta_msg, &delta_subscription_callback, ON_NEW_DATA));
+#endif
+#ifdef CONFIG_LAYERS_ENABLE
+  RCCHECK(rclc_executor_add_subscription(&executor, &layers_subscriber, &layer_msg, &layer_callback, ON_NEW_DATA));
+#endif
+#ifdef CONFIG_MEMORY_STATS_ENABLE
+  RCCHECK(rclc_executor_add_timer(&executor, &memory_stats_timer));
+  RCCHECK(rclc_executor_add_service(&executor, &dump_memory_service, &dump_memory_req, &dump_memory_res, dump_memory_service_callback));
+#endif
+  return true;
+}
+
+// Safe to call on partially created entities.
+static void destroy_entities() {
+  if (!support_ready) {
+    return;
+  }
+  // The agent is likely gone: don't wait for it to confirm the deletions.
+  rmw_context_t * rmw_context = rcl_context_get_rmw_context(&support.context);
+  (void) rmw_uros_set_context_entity_destroy_session_timeout(rmw_context, 0);
 
-  apa102_set_color(0, 32, 0, 1);
-#ifdef ALIVE_ON_APA102
-  bool on = true;
+  RCSOFTCHECK(rclc_executor_fini(&executor));
+  RCSOFTCHECK(rcl_timer_fini(&stats_timer));
+  RCSOFTCHECK(rcl_publisher_fini(&stats_publisher, &node));
+#ifdef CONFIG_ECHO_SHOWN_FRAMES
+  RCSOFTCHECK(rcl_publisher_fini(&shown_frames_publisher, &node));
 #endif
-  while(1){
-    rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
-    usleep(10000);
-#ifdef ALIVE_ON_APA102
-    on = !on;
-    apa102_set_color(0, on * 32, 0, 0x1);
+#ifdef CONFIG_MEMORY_STATS_ENABLE
+  RCSOFTCHECK(rcl_timer_fini(&memory_stats_timer));
+  RCSOFTCHECK(rcl_publisher_fini(&memory_stats_publisher, &node));
+  RCSOFTCHECK(rcl_service_fini(&dump_memory_service, &node));
+#endif
+  RCSOFTCHECK(rcl_service_fini(&set_brightness_service, &node));
+  RCSOFTCHECK(rcl_service_fini(&configure_channels_service, &node));
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  RCSOFTCHECK(rcl_service_fini(&store_scene_service, &node));
+  RCSOFTCHECK(rcl_service_fini(&recall_scene_service, &node));
+  RCSOFTCHECK(rcl_subscription_fini(&scene_subscriber, &node));
+#endif
+#ifdef CONFIG_DELTA_ENABLE
+  RCSOFTCHECK(rcl_subscription_fini(&delta_subscriber, &node));
+#endif
+#ifdef CONFIG_LAYERS_ENABLE
+  RCSOFTCHECK(rcl_subscription_fini(&layers_subscriber, &node));
+#endif
+  RCSOFTCHECK(rcl_subscription_fini(&subscriber, &node));
+  RCSOFTCHECK(rcl_node_fini(&node));
+  RCSOFTCHECK(rclc_support_fini(&support));
+  support_ready = false;
+}
+
+// Time until the next layer expires, from the last tick
+static int64_t layers_wait_us = 0;
+
+// At every iteration, also while the agent is away
+static void tick() {
+#ifdef CONFIG_AUTO_BRIGHTNESS_ENABLE
+  update_auto_brightness();
+#endif
+#ifdef CONFIG_LAYERS_ENABLE
+  // Layers time out while the agent is away too
+  layers_wait_us = show_layers();
 #endif
+}
+
+// The APA102 is blue while waiting for the agent, green when connected and
+// red when it is lost. The strips keep displaying the last frame while we reconnect.
+static void agent_state_changed(uros_reconnect_state_t state) {
+  switch (state) {
+    case UROS_RECONNECT_WAITING_AGENT: apa102_set_color(0, 0, 32, 1); break;
+    case UROS_RECONNECT_AGENT_CONNECTED: apa102_set_color(0, 32, 0, 1); break;
+    case UROS_RECONNECT_AGENT_DISCONNECTED: apa102_set_color(32, 0, 0, 1); break;
   }
-  apa102_set_color(0, 32, 32, 1);
+}
 
-  // free resources
-  RCCHECK(rcl_service_fini(&set_brightness_service, &node));
-  RCCHECK(rcl_subscription_fini(&subscriber, &node));
-  RCCHECK(rcl_node_fini(&node));
+static rcl_ret_t spin() {
+#ifdef CONFIG_ALIVE_ON_APA102
+  static bool on = true;
+#endif
+  // Do not wait for new messages longer than for the link to take the pending frame
+  int64_t wait_us = show_pending_frame();
+  if (layers_wait_us && (!wait_us || layers_wait_us < wait_us)) {
+    wait_us = layers_wait_us;
+  }
+  const rcl_ret_t rc = rclc_executor_spin_some(&executor, wait_us ? RCL_US_TO_NS(wait_us) : RCL_MS_TO_NS(100));
+  if (!frames.pending && !layers_wait_us) {
+    usleep(10000);
+  }
+#ifdef CONFIG_ALIVE_ON_APA102
+  on = !on;
+  apa102_set_color(0, on * 32, 0, 0x1);
+#endif
+  return rc;
+}
 
-  vTaskDelete(NULL);
+void micro_ros_task(void * arg)
+{
+  const uros_reconnect_config_t config = {
+    .create_entities = create_entities,
+    .destroy_entities = destroy_entities,
+    .spin = spin,
+    .tick = tick,
+    .state_changed = agent_state_changed,
+  };
+  uros_reconnect_run(&config);
 }
 
 
@@ -181,21 +1204,83 @@ void micro_ros_task(void * arg)
 //   }
 // }
 
-void app_main(void)
+// Runs while the network comes up
+static void init_peripherals_task(void * arg)
 {
+  SemaphoreHandle_t ready = (SemaphoreHandle_t) arg;
   ldo_2_init();
   ldo_2_enable(true);
   apa102_init();
   blue_led_init();
-  set_brightness(0xFF, DEFAULT_BRIGHTNESS);
-  pb_init(UART_NUMBER, UART_IO_TX);
+#ifdef CONFIG_AUTO_BRIGHTNESS_ENABLE
+  ambient_init();
+#endif
+  pb_init(&outputs[0].driver, CONFIG_LED_DRIVER_UART_NUM, CONFIG_LED_DRIVER_UART_TX_GPIO);
+#if NUMBER_OF_OUTPUTS > 1
+  pb_init(&outputs[1].driver, CONFIG_LED_DRIVER_UART_1_NUM, CONFIG_LED_DRIVER_UART_1_TX_GPIO);
+#endif
+  boot_trace_mark("peripherals");
+#ifdef CONFIG_BUFFER_PLACEMENT_BENCH
+  buffer_placement_bench();
+#endif
+  xSemaphoreGive(ready);
+  vTaskDelete(NULL);
+}
+
+void app_main(void)
+{
+  boot_trace_mark("app_main");
+  init_frames();
+  output_mutex = xSemaphoreCreateMutex();
+  SemaphoreHandle_t peripherals_ready = xSemaphoreCreateBinary();
+  xTaskCreate(init_peripherals_task, "init_peripherals", 4096, peripherals_ready, 5, NULL);
+#ifdef CONFIG_AUTO_BRIGHTNESS_ENABLE
+  const auto_brightness_config_t auto_brightness_config = AUTO_BRIGHTNESS_CONFIG_FROM_KCONFIG();
+  auto_brightness_init(&auto_brightness, &auto_brightness_config);
+  set_brightness_limits(ALL_CHANNELS, 0, DEFAULT_BRIGHTNESS);
+#else
+  set_brightness(ALL_CHANNELS, DEFAULT_BRIGHTNESS);
+#endif
+  init_message();
+#ifdef CONFIG_DELTA_ENABLE
+  init_delta_message();
+#endif
+#ifdef CONFIG_MEMORY_STATS_ENABLE
+  init_memory_stats_message();
+#endif
+#ifdef CONFIG_SCENE_STORE_ENABLE
+  if (scene_store_init(SCENE_MAX_SIZE) != ESP_OK) {
+    ESP_LOGE(TAG, "No scene store: add a scenes partition to the partition table");
+  }
+#endif
+  for (size_t i = 0; i < NUMBER_OF_OUTPUTS; i++) {
+    frame_pacer_init(&outputs[i].pacer, PB_BAUD_RATE, CONFIG_LED_DRIVER_TARGET_FPS, PB_TX_BUFFER_SIZE, esp_timer_get_time());
+  }
+#if NUMBER_OF_OUTPUTS > 1
+  outputs_written = xSemaphoreCreateCounting(NUMBER_OF_OUTPUTS - 1, 0);
+  for (size_t i = 1; i < NUMBER_OF_OUTPUTS; i++) {
+    xTaskCreate(output_task, "output", 4096, (void *) i, CONFIG_MICRO_ROS_APP_TASK_PRIO, &output_tasks[i]);
+  }
+#endif
+#ifdef RMW_UXRCE_TRANSPORT_CUSTOM
+  if (uros_serial_transport_init() != RMW_RET_OK) {
+    ESP_LOGE(TAG, "Failed to set the micro-ROS serial transport");
+  }
+#endif
 #ifdef UCLIENT_PROFILE_UDP
     // Start the networking if required
     ESP_ERROR_CHECK(uros_network_interface_initialize());
+    boot_trace_mark("network");
 #endif  // UCLIENT_PROFILE_UDP
+  // The driver has to be ready before DDP or micro-ROS send frames
+  xSemaphoreTake(peripherals_ready, portMAX_DELAY);
+  vSemaphoreDelete(peripherals_ready);
+#if defined(UCLIENT_PROFILE_UDP) && defined(CONFIG_DDP_ENABLE)
+  ESP_ERROR_CHECK(ddp_start(CONFIG_DDP_UDP_PORT, ddp_data_callback, ddp_push_callback, NULL));
+#endif
 
     //pin micro-ros task in APP_CPU to make PRO_CPU to deal with wifi:
-  xTaskCreate(micro_ros_task, "uros_task", 30000, NULL, CONFIG_MICRO_ROS_APP_TASK_PRIO, NULL);
+  xTaskCreate(micro_ros_task, "uros_task", CONFIG_MICRO_ROS_APP_STACK, NULL, CONFIG_MICRO_ROS_APP_TASK_PRIO, NULL);
 
   // xTaskCreate(alive_task, "alive_task", 1000, NULL, 1, NULL);
 
@@ -0,0 +1,310 @@
+// Checks the ddp component on the host: the receiver task of ddp.c on a
+// loopback UDP socket, and the frames assembled by ddp_channels as
+// ros_led_driver does (under a mutex, as output_mutex).
+//
+// 1. frames split in packets, shorter frames, timecodes, clipped data;
+// 2. invalid packets, queries and unknown destinations are ignored;
+// 3. with --listen SECONDS, receives what tools/ddp_send.py sends to
+//    127.0.0.1 and reports the throughput through ddp.c.
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ddp.h"
+#include "ddp_channels.h"
+
+#define DDP_HEADER_SIZE 10
+#define DDP_TIMECODE_SIZE 4
+#define DDP_MAX_DATA_SIZE 1440
+#define DDP_FLAGS_VERSION_1 0x40
+#define DDP_FLAGS_TIMECODE 0x10
+#define DDP_FLAGS_QUERY 0x02
+#define DDP_FLAGS_PUSH 0x01
+#define DDP_DATA_TYPE_RGB8 0x0B
+
+#define MAX_CHANNELS DDP_CHANNELS_MAX
+#define MAX_PIXELS 4000
+#define PUSH_TIMEOUT_MS 1000
+
+static uint16_t port = DDP_PORT;
+static size_t number_of_channels = 8;
+static size_t pixels = 1000;
+
+static uint8_t buffers[MAX_CHANNELS * 3 * MAX_PIXELS];
+static ddp_channels_t channels;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pushed = PTHREAD_COND_INITIALIZER;
+static uint32_t pushes = 0;
+static uint16_t pushed_mask = 0;
+static uint64_t pushed_bytes = 0;
+
+static int sock = -1;
+static struct sockaddr_in address;
+static uint8_t expected[MAX_CHANNELS][3 * MAX_PIXELS];
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void data_callback(uint8_t destination, uint32_t offset, const uint8_t *data, size_t size, void *arg) {
+  pthread_mutex_lock(&mutex);
+  ddp_channels_write(&channels, destination, offset, data, size);
+  pthread_mutex_unlock(&mutex);
+}
+
+static void push_callback(uint8_t destination, void *arg) {
+  pthread_mutex_lock(&mutex);
+  pushed_mask = ddp_channels_push(&channels);
+  for (size_t i = 0; i < channels.number_of_channels; i++) {
+    if (pushed_mask & (1 << i)) {
+      pushed_bytes += channels.size[i];
+    }
+  }
+  pushes++;
+  pthread_cond_signal(&pushed);
+  pthread_mutex_unlock(&mutex);
+}
+
+// Sends the header with `length`, then `size` bytes of `data` (with the
+// timecode if any)
+static void send_packet(uint8_t flags, uint8_t destination, uint32_t offset,
+                        const uint8_t *data, uint16_t length, size_t size) {
+  uint8_t packet[DDP_HEADER_SIZE + DDP_TIMECODE_SIZE + DDP_MAX_DATA_SIZE] = {
+    flags, 0, DDP_DATA_TYPE_RGB8, destination,
+    offset >> 24, offset >> 16, offset >> 8, offset,
+    length >> 8, length,
+  };
+  if (size) {
+    memcpy(packet + DDP_HEADER_SIZE, data, size);
+  }
+  if (sendto(sock, packet, DDP_HEADER_SIZE + size, 0, (struct sockaddr *) &address, sizeof(address)) < 0) {
+    fprintf(stderr, "sendto failed: %s\n", strerror(errno));
+  }
+}
+
+static void send_frame(size_t channel, const uint8_t *data, size_t size, bool push) {
+  for (size_t offset = 0; offset < size; offset += DDP_MAX_DATA_SIZE) {
+    const size_t length = size - offset < DDP_MAX_DATA_SIZE ? size - offset : DDP_MAX_DATA_SIZE;
+    const bool last = offset + length >= size;
+    send_packet(DDP_FLAGS_VERSION_1 | (push && last ? DDP_FLAGS_PUSH : 0), DDP_ID_DISPLAY + channel,
+                offset, data + offset, length, length);
+  }
+}
+
+static void send_push(void) {
+  send_packet(DDP_FLAGS_VERSION_1 | DDP_FLAGS_PUSH, DDP_ID_DISPLAY, 0, NULL, 0, 0);
+}
+
+// Waits for the push number `count`, returns the mask of the channels pushed,
+// or -1 on timeout. The mutex is held on return, as when drawing.
+static int wait_push(uint32_t count) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += 1000000L * PUSH_TIMEOUT_MS;
+  deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+  deadline.tv_nsec %= 1000000000L;
+  pthread_mutex_lock(&mutex);
+  while (pushes < count) {
+    if (pthread_cond_timedwait(&pushed, &mutex, &deadline) == ETIMEDOUT) {
+      return -1;
+    }
+  }
+  return pushed_mask;
+}
+
+static void random_bytes(uint8_t *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    data[i] = rand() & 0xFF;
+  }
+}
+
+static bool check_channel(size_t index, size_t size) {
+  if (channels.size[index] != size) {
+    fprintf(stderr, "channel %zu: %zu bytes, expected %zu\n", index, channels.size[index], size);
+    return false;
+  }
+  if (memcmp(ddp_channels_data(&channels, index), expected[index], size)) {
+    fprintf(stderr, "channel %zu: data differs\n", index);
+    return false;
+  }
+  return true;
+}
+
+static bool report(const char *name, bool ok) {
+  printf("%-18s%s\n", name, ok ? "passed" : "FAILED");
+  return ok;
+}
+
+// Every channel, split in packets, pushed by the last packet
+static bool check_frame(uint32_t *count) {
+  const size_t size = 3 * pixels;
+  for (size_t i = 0; i < number_of_channels; i++) {
+    random_bytes(expected[i], size);
+    send_frame(i, expected[i], size, i == number_of_channels - 1);
+  }
+  const int mask = wait_push(++*count);
+  bool ok = mask == (int) ((1u << number_of_channels) - 1);
+  for (size_t i = 0; ok && i < number_of_channels; i++) {
+    ok = check_channel(i, size);
+  }
+  pthread_mutex_unlock(&mutex);
+  return report("frame", ok);
+}
+
+// A shorter frame on channel 0 does not keep the tail of the previous one, and
+// the other channels keep their frame
+static bool check_shorter_frame(uint32_t *count) {
+  const size_t size = 3 * (pixels / 3);
+  random_bytes(expected[0], size);
+  send_frame(0, expected[0], size, true);
+  const int mask = wait_push(++*count);
+  bool ok = mask == 1 && check_channel(0, size);
+  for (size_t i = 1; ok && i < number_of_channels; i++) {
+    ok = check_channel(i, 3 * pixels);
+  }
+  pthread_mutex_unlock(&mutex);
+  return report("shorter frame", ok);
+}
+
+// The data follows the timecode
+static bool check_timecode(uint32_t *count) {
+  const size_t last = number_of_channels - 1;
+  uint8_t packet[DDP_TIMECODE_SIZE + 9];
+  random_bytes(packet, sizeof(packet));
+  memcpy(expected[last], packet + DDP_TIMECODE_SIZE, 9);
+  send_packet(DDP_FLAGS_VERSION_1 | DDP_FLAGS_TIMECODE | DDP_FLAGS_PUSH, DDP_ID_DISPLAY + last, 0,
+              packet, 9, sizeof(packet));
+  const int mask = wait_push(++*count);
+  const bool ok = mask == (1 << last) && check_channel(last, 9);
+  pthread_mutex_unlock(&mutex);
+  return report("timecode", ok);
+}
+
+// Data past the buffer is clipped
+static bool check_clipped(uint32_t *count) {
+  const size_t size = 3 * pixels;
+  uint8_t data[6];
+  random_bytes(data, sizeof(data));
+  memcpy(expected[0] + size - 3, data, 3);
+  send_frame(0, expected[0], size - 3, false);
+  send_packet(DDP_FLAGS_VERSION_1 | DDP_FLAGS_PUSH, DDP_ID_DISPLAY, size - 3, data, sizeof(data), sizeof(data));
+  const int mask = wait_push(++*count);
+  const bool ok = mask == 1 && check_channel(0, size);
+  pthread_mutex_unlock(&mutex);
+  return report("clipped", ok);
+}
+
+// Packets of another version, shorter than their header or length, queries and
+// destinations that are not a channel write nothing
+static bool check_ignored(uint32_t *count) {
+  ddp_stats_t before, after;
+  ddp_get_stats(&before);
+  uint8_t data[30];
+  random_bytes(data, sizeof(data));
+  send_packet(0x80, DDP_ID_DISPLAY, 0, data, sizeof(data), sizeof(data));
+  send_packet(DDP_FLAGS_VERSION_1, DDP_ID_DISPLAY, 0, data, sizeof(data), sizeof(data) - 1);
+  send_packet(DDP_FLAGS_VERSION_1, DDP_ID_DISPLAY, 0, data, 0, 0);
+  if (sendto(sock, data, DDP_HEADER_SIZE - 1, 0, (struct sockaddr *) &address, sizeof(address)) < 0) {
+    fprintf(stderr, "sendto failed: %s\n", strerror(errno));
+  }
+  send_packet(DDP_FLAGS_VERSION_1 | DDP_FLAGS_QUERY, DDP_ID_DISPLAY, 0, data, sizeof(data), sizeof(data));
+  send_packet(DDP_FLAGS_VERSION_1, DDP_ID_DISPLAY + number_of_channels, 0, data, sizeof(data), sizeof(data));
+  send_packet(DDP_FLAGS_VERSION_1, DDP_ID_ALL, 0, data, sizeof(data), sizeof(data));
+  send_push();
+  const int mask = wait_push(++*count);
+  bool ok = mask == 0;
+  for (size_t i = 0; ok && i < number_of_channels; i++) {
+    ok = check_channel(i, channels.size[i]);
+  }
+  pthread_mutex_unlock(&mutex);
+  ddp_get_stats(&after);
+  if (after.invalid_packets - before.invalid_packets != 3) {
+    fprintf(stderr, "%u invalid packets, expected 3\n", after.invalid_packets - before.invalid_packets);
+    ok = false;
+  }
+  return report("ignored", ok);
+}
+
+static int listen_for(double duration) {
+  ddp_stats_t stats;
+  const double start = now_s();
+  printf("listening on 127.0.0.1:%u for %.0f s\n", port, duration);
+  fflush(stdout);
+  while (now_s() - start < duration) {
+    usleep(100000);
+  }
+  ddp_get_stats(&stats);
+  pthread_mutex_lock(&mutex);
+  const uint32_t frames = pushes;
+  const uint64_t bytes = pushed_bytes;
+  pthread_mutex_unlock(&mutex);
+  printf("packets           %u (%u invalid)\n", stats.packets, stats.invalid_packets);
+  printf("frames            %u\n", frames);
+  printf("pushed            %.1f Mbit/s\n", 8 * bytes / duration / 1e6);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  static const struct option long_options[] = {
+    {"port", required_argument, NULL, 'P'},
+    {"channels", required_argument, NULL, 'c'},
+    {"pixels", required_argument, NULL, 'p'},
+    {"listen", required_argument, NULL, 'l'},
+    {NULL, 0, NULL, 0},
+  };
+  double listen_duration = 0;
+  int c;
+  while ((c = getopt_long(argc, argv, "P:c:p:l:", long_options, NULL)) != -1) {
+    switch (c) {
+      case 'P': port = atoi(optarg); break;
+      case 'c': number_of_channels = strtoul(optarg, NULL, 0); break;
+      case 'p': pixels = strtoul(optarg, NULL, 0); break;
+      case 'l': listen_duration = atof(optarg); break;
+      default:
+        number_of_channels = 0;
+        break;
+    }
+  }
+  if (!number_of_channels || number_of_channels > MAX_CHANNELS || pixels < 3 || pixels > MAX_PIXELS) {
+    fprintf(stderr, "Usage: %s [--port %u] [--channels 1..%d] [--pixels 3..%d] [--listen SECONDS]\n",
+            argv[0], DDP_PORT, MAX_CHANNELS, MAX_PIXELS);
+    return 1;
+  }
+  ddp_channels_init(&channels, buffers, number_of_channels, 3 * pixels);
+  if (ddp_start(port, data_callback, push_callback, NULL) != ESP_OK) {
+    return 1;
+  }
+  if (listen_duration > 0) {
+    return listen_for(listen_duration);
+  }
+
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  address = (struct sockaddr_in) {
+    .sin_family = AF_INET,
+    .sin_port = htons(port),
+    .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  uint32_t count = 0;
+  bool ok = check_frame(&count);
+  ok = check_shorter_frame(&count) && ok;
+  ok = check_timecode(&count) && ok;
+  ok = check_clipped(&count) && ok;
+  ok = check_ignored(&count) && ok;
+  close(sock);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+// Host replacement of the ESP-IDF error codes used by the ddp component, the
+// micro-ROS serial transport and the LED strip drivers.
+
+#ifndef HOST_ESP_ERR_H
+#define HOST_ESP_ERR_H
+
+// As the ESP-IDF header
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_TIMEOUT 0x107
+
+#endif /* end of include guard: HOST_ESP_ERR_H */
@@ -0,0 +1,40 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "freertos/task.h"
+
+typedef struct {
+  TaskFunction_t task;
+  void *arg;
+} task_start_t;
+
+static void *run_task(void *arg) {
+  task_start_t start = *(task_start_t *) arg;
+  free(arg);
+  start.task(start.arg);
+  return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack_depth,
+                       void *arg, uint32_t priority, TaskHandle_t *handle) {
+  task_start_t *start = malloc(sizeof(task_start_t));
+  if (!start) {
+    return pdFAIL;
+  }
+  *start = (task_start_t) {task, arg};
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, run_task, start)) {
+    free(start);
+    return pdFAIL;
+  }
+  pthread_detach(thread);
+  if (handle) {
+    *handle = NULL;
+  }
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  usleep(1000 * ticks * portTICK_PERIOD_MS);
+}
@@ -0,0 +1,20 @@
+// Host replacement of the FreeRTOS tasks used by the ddp component and the
+// micro-ROS serial transport (tools/uros_serial_check): a task is a detached
+// thread, a tick a millisecond.
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+
+typedef void (*TaskFunction_t)(void *);
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdPASS 1
+#define pdFAIL 0
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms) / portTICK_PERIOD_MS)
+
+#endif /* end of include guard: HOST_FREERTOS_H */
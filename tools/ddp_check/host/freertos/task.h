@@ -0,0 +1,10 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack_depth,
+                       void *arg, uint32_t priority, TaskHandle_t *handle);
+void vTaskDelay(TickType_t ticks);
+
+#endif /* end of include guard: HOST_FREERTOS_TASK_H */
@@ -0,0 +1,11 @@
+// Host replacement of lwIP: the BSD sockets of the host.
+
+#ifndef HOST_LWIP_SOCKETS_H
+#define HOST_LWIP_SOCKETS_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#endif /* end of include guard: HOST_LWIP_SOCKETS_H */
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+Push pixels to a board over raw UDP using DDP (http://www.3waylabs.com/ddp/).
+
+Examples:
+    # rainbow on channel 0 and 1, 300 pixels each, at 60 fps
+    ./ddp_send.py 192.168.1.145 --channels 2 --pixels 300 --fps 60
+    # measure the loopback throughput of the sockets (no board needed)
+    ./ddp_send.py --loopback --pixels 1000 --channels 8 --fps 0 --duration 5
+    # through the receiver of the boards (ddp.c), built on the host by tools/ddp_check
+    ./build/ddp_check/ddp_check --listen 6 --channels 8 --pixels 1000 &
+    ./ddp_send.py --pixels 1000 --channels 8 --fps 0 --duration 5
+"""
+
+import argparse
+import colorsys
+import socket
+import struct
+import threading
+import time
+
+DDP_PORT = 4048
+DDP_ID_DISPLAY = 1
+DDP_FLAGS_VERSION_1 = 0x40
+DDP_FLAGS_PUSH = 0x01
+DDP_DATA_TYPE_RGB8 = 0x0B
+# 480 RGB pixels per packet, as suggested by the protocol
+DDP_MAX_DATA_SIZE = 1440
+DDP_HEADER = struct.Struct('!BBBBIH')
+
+
+def packets(frame, channel, sequence, push):
+    """Split the RGB bytes of a channel in DDP packets"""
+    destination = DDP_ID_DISPLAY + channel
+    for offset in range(0, len(frame), DDP_MAX_DATA_SIZE):
+        data = frame[offset:offset + DDP_MAX_DATA_SIZE]
+        last = offset + DDP_MAX_DATA_SIZE >= len(frame)
+        flags = DDP_FLAGS_VERSION_1 | (DDP_FLAGS_PUSH if (push and last) else 0)
+        yield DDP_HEADER.pack(flags, sequence & 0x0F, DDP_DATA_TYPE_RGB8, destination,
+                              offset, len(data)) + data
+
+
+def rainbow(pixels, phase):
+    frame = bytearray(3 * pixels)
+    for i in range(pixels):
+        r, g, b = colorsys.hsv_to_rgb((i / pixels + phase) % 1.0, 1.0, 1.0)
+        frame[3 * i:3 * i + 3] = bytes((int(255 * r), int(255 * g), int(255 * b)))
+    return bytes(frame)
+
+
+def receive(sock, stats, stop):
+    sock.settimeout(0.1)
+    while not stop.is_set():
+        try:
+            packet = sock.recv(2048)
+        except socket.timeout:
+            continue
+        flags, _, _, _, _, length = DDP_HEADER.unpack_from(packet)
+        stats['packets'] += 1
+        stats['bytes'] += length
+        if flags & DDP_FLAGS_PUSH:
+            stats['frames'] += 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('host', nargs='?', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=DDP_PORT)
+    parser.add_argument('--channels', type=int, default=1, help='number of channels (DDP ids 1..)')
+    parser.add_argument('--pixels', type=int, default=32, help='pixels per channel')
+    parser.add_argument('--fps', type=float, default=30.0, help='target frame rate, 0 for as fast as possible')
+    parser.add_argument('--duration', type=float, default=0.0, help='seconds to run, 0 for ever')
+    parser.add_argument('--loopback', action='store_true', help='receive the packets locally (not through ddp.c) and report the throughput')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    stop = threading.Event()
+    stats = {'packets': 0, 'bytes': 0, 'frames': 0}
+    if args.loopback:
+        args.host = '127.0.0.1'
+        receiver = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        receiver.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 22)
+        receiver.bind((args.host, args.port))
+        thread = threading.Thread(target=receive, args=(receiver, stats, stop))
+        thread.start()
+
+    # Precompute a cycle of frames to measure the transport, not the rendering
+    frames = [rainbow(args.pixels, phase / 60.0) for phase in range(60)]
+    period = 1.0 / args.fps if args.fps > 0 else 0.0
+    start = time.monotonic()
+    sent = 0
+    try:
+        while not args.duration or time.monotonic() - start < args.duration:
+            frame = frames[sent % len(frames)]
+            for channel in range(args.channels):
+                push = channel == args.channels - 1
+                for packet in packets(frame, channel, sent, push):
+                    sock.sendto(packet, (args.host, args.port))
+            sent += 1
+            if period:
+                delay = start + sent * period - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+    except KeyboardInterrupt:
+        pass
+    elapsed = time.monotonic() - start
+    pixels = sent * args.channels * args.pixels
+    print(f'sent {sent} frames in {elapsed:.2f} s: {sent / elapsed:.1f} fps, {pixels / elapsed:.0f} pixels/s')
+    if args.loopback:
+        time.sleep(0.2)
+        stop.set()
+        thread.join()
+        print(f"received {stats['frames']} frames ({stats['packets']} packets): "
+              f"{stats['frames'] / elapsed:.1f} fps, {8 * stats['bytes'] / elapsed / 1e6:.1f} Mbit/s, "
+              f"lost {sent - stats['frames']} frames")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,83 @@
+// Checks the keyframe blend kernel against a per byte reference and
+// measures its cost per RGB pixel.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "keyframe.h"
+
+// 8 strips of 1000 RGB pixels
+#define NUMBER_OF_PIXELS 8000
+#define SIZE (3 * NUMBER_OF_PIXELS)
+#define REPETITIONS 2000
+
+static uint8_t from[SIZE];
+static uint8_t to[SIZE];
+static uint8_t dst[SIZE];
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static int check(void) {
+  for (uint16_t weight = 0; weight <= KEYFRAME_WEIGHT_ONE; weight++) {
+    // Odd offset and size to cover the unaligned and tail bytes
+    keyframe_blend(dst + 1, from + 1, to + 1, SIZE - 2, weight);
+    for (size_t i = 1; i < SIZE - 1; i++) {
+      const uint8_t expected = (from[i] * (KEYFRAME_WEIGHT_ONE - weight) + to[i] * weight) >> 8;
+      if (dst[i] != expected) {
+        fprintf(stderr, "weight %u, byte %zu: %u instead of %u\n", weight, i, dst[i], expected);
+        return 1;
+      }
+    }
+  }
+  keyframe_transition_t transition;
+  for (int easing = KEYFRAME_LINEAR; easing <= KEYFRAME_EASE_IN_OUT; easing++) {
+    keyframe_start(&transition, 0, 100, easing);
+    uint16_t last = 0;
+    for (int64_t t = 0; t <= 100000; t += 1000) {
+      const uint16_t weight = keyframe_weight(&transition, t);
+      if (weight < last || weight > KEYFRAME_WEIGHT_ONE) {
+        fprintf(stderr, "easing %d: weight %u at %lld us after %u\n", easing, weight, (long long) t, last);
+        return 1;
+      }
+      last = weight;
+    }
+    if (last != KEYFRAME_WEIGHT_ONE || transition.active) {
+      fprintf(stderr, "easing %d: transition not completed\n", easing);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(void) {
+  srand(1);
+  for (size_t i = 0; i < SIZE; i++) {
+    from[i] = rand();
+    to[i] = rand();
+  }
+  if (check()) {
+    return 1;
+  }
+  printf("blend matches the reference for all weights\n");
+
+  const double start = now_s();
+  for (int i = 0; i < REPETITIONS; i++) {
+    keyframe_blend(dst, from, to, SIZE, (i * 7) % KEYFRAME_WEIGHT_ONE);
+  }
+  const double elapsed = now_s() - start;
+  unsigned checksum = 0;
+  for (size_t i = 0; i < SIZE; i++) {
+    checksum += dst[i];
+  }
+  printf("%.2f ns per pixel, %.1f Mpixels/s (checksum %u)\n",
+         1e9 * elapsed / REPETITIONS / NUMBER_OF_PIXELS,
+         1e-6 * REPETITIONS * NUMBER_OF_PIXELS / elapsed, checksum);
+  return 0;
+}
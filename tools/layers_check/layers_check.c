@@ -0,0 +1,239 @@
+// Checks the layers component on the host and measures its cost.
+//
+// 1. the blend kernel against the exact blend, for every (dst, src, alpha);
+// 2. random stacks (regions, priorities, alpha, timeouts) over random bases,
+//    composited by layer_stack_composite and by a straightforward per-pixel
+//    reference;
+// 3. the time to composite a strip, for a few typical stacks.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "layers.h"
+
+#define MAX_PIXELS 4000
+#define NUMBER_OF_LAYERS 4
+
+static int pixels = 1000;
+static uint32_t stacks = 2000;
+
+static layer_t layers[NUMBER_OF_LAYERS];
+static uint8_t buffers[NUMBER_OF_LAYERS * 4 * MAX_PIXELS];
+static uint8_t base[3 * MAX_PIXELS];
+static uint8_t output[3 * MAX_PIXELS];
+static uint8_t expected[3 * MAX_PIXELS];
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static uint8_t random_byte(void) {
+  return rand() & 0xFF;
+}
+
+// The kernel is within 1 of the exact blend, and exact at alpha 0 and 255
+static int check_blend(void) {
+  int errors = 0;
+  for (int a = 0; a < 256; a++) {
+    for (int s = 0; s < 256; s++) {
+      for (int d = 0; d < 256; d++) {
+        uint8_t dst[3] = {d, d, d};
+        const uint8_t src[3] = {s, s, s};
+        const uint8_t alpha = a;
+        layers_blend(dst, src, &alpha, 1);
+        const double exact = d + (s - d) * a / 255.0;
+        const bool ok = a == 0 ? dst[0] == d : a == 255 ? dst[0] == s : fabs(dst[0] - exact) <= 1.0;
+        if (!ok) {
+          if (errors++ < 5) {
+            fprintf(stderr, "blend d %d s %d a %d: %d, expected %.2f\n", d, s, a, dst[0], exact);
+          }
+        }
+      }
+    }
+  }
+  return errors;
+}
+
+// Per pixel: the base, then the visible layers covering it, by priority then
+// index. Returns the end of the base or of the last visible region.
+static size_t reference_composite(const layer_stack_t *stack, size_t base_pixels, uint8_t *rgb) {
+  size_t length = base_pixels;
+  for (size_t i = 0; i < stack->number_of_layers; i++) {
+    const layer_t *layer = stack->layers + i;
+    if (layer->visible && layer->begin < layer->end && layer->end > length) {
+      length = layer->end;
+    }
+  }
+  memset(rgb, 0, 3 * length);
+  memcpy(rgb, base, 3 * base_pixels);
+  for (size_t p = 0; p < length; p++) {
+    bool done[NUMBER_OF_LAYERS] = {false};
+    for (size_t n = 0; n < stack->number_of_layers; n++) {
+      int lowest = -1;
+      for (size_t i = 0; i < stack->number_of_layers; i++) {
+        const layer_t *layer = stack->layers + i;
+        if (!done[i] && (lowest < 0 || layer->priority < stack->layers[lowest].priority)) {
+          lowest = i;
+        }
+      }
+      done[lowest] = true;
+      const layer_t *layer = stack->layers + lowest;
+      if (layer->visible && p >= layer->begin && p < layer->end) {
+        const uint8_t alpha = layer->opaque ? LAYERS_ALPHA_OPAQUE : layer->alpha[p];
+        layers_blend(rgb + 3 * p, layer->rgb + 3 * p, &alpha, 1);
+      }
+    }
+  }
+  return length;
+}
+
+static int check_stacks(void) {
+  static uint8_t rgb[3 * MAX_PIXELS];
+  static uint8_t alpha[MAX_PIXELS];
+  layer_stack_t stack;
+  layer_stack_init(&stack, layers, NUMBER_OF_LAYERS, buffers, pixels);
+  int errors = 0;
+  int64_t now_us = 0;
+  for (uint32_t n = 0; n < stacks; n++) {
+    // Update a few layers: new content, hidden, or left to expire
+    const int updates = 1 + rand() % NUMBER_OF_LAYERS;
+    for (int u = 0; u < updates; u++) {
+      const size_t index = rand() % NUMBER_OF_LAYERS;
+      const int action = rand() % 8;
+      if (action == 0) {
+        layer_hide(&stack, index);
+        continue;
+      }
+      // Regions may be empty, full or past the end of the strip
+      const size_t offset = rand() % (pixels + 10);
+      const size_t count = action == 1 ? pixels : rand() % (pixels + 10);
+      for (size_t i = 0; i < 3 * (size_t) pixels; i++) {
+        rgb[i] = random_byte();
+      }
+      const int alpha_kind = rand() % 3;
+      for (size_t i = 0; i < (size_t) pixels; i++) {
+        // mask, opaque or translucent
+        alpha[i] = alpha_kind == 0 ? (rand() % 2) * 255 : alpha_kind == 1 ? 255 : random_byte();
+      }
+      const int64_t expires_us = rand() % 2 ? now_us + 1 + rand() % 5000 : 0;
+      layer_set(&stack, index, rand() % 4, offset, rgb, alpha_kind == 1 && rand() % 2 ? NULL : alpha,
+                count, expires_us);
+    }
+    now_us += rand() % 2000;
+    const bool expired = layer_stack_expire(&stack, now_us);
+    if (expired && !stack.dirty) {
+      errors++;
+    }
+    // No base, or a frame of any length
+    const size_t base_pixels = rand() % 4 ? rand() % (pixels + 1) : 0;
+    for (size_t i = 0; i < 3 * base_pixels; i++) {
+      base[i] = random_byte();
+    }
+    // Composited in place half of the time
+    const bool in_place = rand() % 2;
+    if (in_place) {
+      memcpy(output, base, 3 * base_pixels);
+    }
+    const size_t length = layer_stack_composite(&stack, in_place ? output : base, base_pixels, output);
+    if (length != reference_composite(&stack, base_pixels, expected) || memcmp(output, expected, 3 * length)) {
+      if (errors++ < 5) {
+        fprintf(stderr, "stack %u: composite differs from the reference\n", n);
+      }
+    }
+    if (stack.dirty) {
+      errors++;
+    }
+  }
+  return errors;
+}
+
+static void fill_layer(layer_stack_t *stack, size_t index, uint8_t priority, size_t offset, size_t count,
+                       uint8_t alpha_value) {
+  static uint8_t rgb[3 * MAX_PIXELS];
+  static uint8_t alpha[MAX_PIXELS];
+  for (size_t i = 0; i < 3 * count; i++) {
+    rgb[i] = random_byte();
+  }
+  memset(alpha, alpha_value, count);
+  layer_set(stack, index, priority, offset, rgb, alpha_value == 255 ? NULL : alpha, count, 0);
+}
+
+static void bench(const char *name, layer_stack_t *stack) {
+  const int repeat = 2000;
+  const double start = now_s();
+  for (int i = 0; i < repeat; i++) {
+    stack->dirty = true;
+    layer_stack_composite(stack, base, pixels, output);
+  }
+  const double duration = (now_s() - start) / repeat;
+  printf("%-17s %.1f us per strip, %.2f ns per pixel\n", name, 1e6 * duration, 1e9 * duration / pixels);
+}
+
+static void run_benches(void) {
+  layer_stack_t stack;
+  layer_stack_init(&stack, layers, NUMBER_OF_LAYERS, buffers, pixels);
+  for (size_t i = 0; i < 3 * (size_t) pixels; i++) {
+    base[i] = random_byte();
+  }
+  bench("frame", &stack);
+  // A status indicator on the first 10 pixels of the frame, an alarm over a quarter of the strip
+  fill_layer(&stack, 1, 1, 0, 10, 255);
+  fill_layer(&stack, 2, 2, pixels / 2, pixels / 4, 128);
+  bench("+ status, alarm", &stack);
+  for (size_t i = 0; i < NUMBER_OF_LAYERS; i++) {
+    fill_layer(&stack, i, i, 0, pixels, 100);
+  }
+  bench("4 translucent", &stack);
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -p, --pixels N  pixels per strip (default %d, at most %d)\n"
+          "  -n, --stacks N  random stacks to check (default %u)\n"
+          "  -r, --seed N    random seed (default 1)\n",
+          name, pixels, MAX_PIXELS, stacks);
+}
+
+int main(int argc, char **argv) {
+  unsigned seed = 1;
+  static const struct option long_options[] = {
+    {"pixels", required_argument, NULL, 'p'},
+    {"stacks", required_argument, NULL, 'n'},
+    {"seed", required_argument, NULL, 'r'},
+    {NULL, 0, NULL, 0},
+  };
+  int c;
+  while ((c = getopt_long(argc, argv, "p:n:r:", long_options, NULL)) != -1) {
+    switch (c) {
+      case 'p': pixels = atoi(optarg); break;
+      case 'n': stacks = atoi(optarg); break;
+      case 'r': seed = atoi(optarg); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (optind != argc || pixels < 1 || pixels > MAX_PIXELS) {
+    usage(argv[0]);
+    return 1;
+  }
+  srand(seed);
+
+  const int blend_errors = check_blend();
+  printf("blend             %s\n", blend_errors ? "FAILED" : "passed");
+  const int stack_errors = check_stacks();
+  printf("stacks            %u %s\n", stacks, stack_errors ? "FAILED" : "passed");
+  if (blend_errors || stack_errors) {
+    return 1;
+  }
+  run_benches();
+  return 0;
+}
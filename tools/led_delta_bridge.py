@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""
+Republish LedStrips as LedStripsDelta for a driver built with DELTA_ENABLE:
+every strip is sent as the run-length encoded XOR with the last keyframe
+(see ros_feather_s2/components/pixel_delta/include/pixel_delta.h).
+
+A keyframe is sent every --keyframe-period frames, and as soon as the keyframe
+acknowledged by the driver in DriverStats.keyframe_seq lags behind the last one
+sent for longer than --ack-timeout.
+
+Examples:
+    # publishers write to led_strips_full, the driver reads led_strips_delta
+    ./led_delta_bridge.py --input led_strips_full --output led_strips_delta
+    # a namespaced driver
+    ./led_delta_bridge.py --output /led_0/led_strips_delta --stats /led_0/driver_stats
+"""
+
+import argparse
+import time
+
+import numpy as np
+
+MAX_TOKEN_SIZE = 128
+# as MIN_UNCHANGED_RUN in pixel_delta.c
+MIN_UNCHANGED_RUN = 3
+
+
+def encode(frame, reference=None):
+    """Delta of the uint8 array frame against reference (None for zeros)"""
+    changes = frame if reference is None else np.bitwise_xor(frame, reference)
+    changed = np.flatnonzero(changes)
+    if not changed.size:
+        return b''
+    # Spans of changed bytes separated by at least MIN_UNCHANGED_RUN unchanged bytes
+    breaks = np.flatnonzero(np.diff(changed) > MIN_UNCHANGED_RUN) + 1
+    starts = changed[np.concatenate(([0], breaks))]
+    ends = changed[np.concatenate((breaks - 1, [changed.size - 1]))] + 1
+    delta = bytearray()
+    position = 0
+    for start, end in zip(starts.tolist(), ends.tolist()):
+        run = start - position
+        while run > 0:
+            n = min(run, MAX_TOKEN_SIZE)
+            delta.append(n - 1)
+            run -= n
+        for i in range(start, end, MAX_TOKEN_SIZE):
+            n = min(end - i, MAX_TOKEN_SIZE)
+            delta.append(0x7f + n)
+            delta += changes[i:i + n].tobytes()
+        position = end
+    return bytes(delta)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--input', default='led_strips_full', help='LedStrips topic to encode')
+    parser.add_argument('--output', default='led_strips_delta', help='LedStripsDelta topic of the driver')
+    parser.add_argument('--stats', default='driver_stats', help='DriverStats topic of the driver')
+    parser.add_argument('--keyframe-period', type=int, default=120, help='frames between keyframes')
+    parser.add_argument('--ack-timeout', type=float, default=2.0,
+                        help='seconds to wait for a keyframe to be acknowledged before sending another')
+    parser.add_argument('--best-effort', action='store_true', help='publish best effort (PIXEL_QOS_BEST_EFFORT)')
+    args = parser.parse_args()
+
+    import rclpy
+    from rclpy.qos import QoSProfile, qos_profile_sensor_data
+    from led_strip_msgs.msg import DriverStats, LedStripDelta, LedStrips, LedStripsDelta
+
+    class Bridge:
+
+        def __init__(self, node):
+            self.seq = 0
+            self.keyframe_seq = 0
+            self.keyframe_sent_at = 0
+            self.acknowledged = 0
+            self.keyframe = {}
+            self.raw_bytes = 0
+            self.delta_bytes = 0
+            qos = QoSProfile(depth=1) if not args.best_effort else qos_profile_sensor_data
+            self.publisher = node.create_publisher(LedStripsDelta, args.output, qos)
+            node.create_subscription(LedStrips, args.input, self.on_frame, 10)
+            node.create_subscription(DriverStats, args.stats, self.on_stats, qos_profile_sensor_data)
+
+        def on_stats(self, msg):
+            self.acknowledged = msg.keyframe_seq
+
+        def needs_keyframe(self, strips):
+            if not self.keyframe_seq or self.seq - self.keyframe_seq >= args.keyframe_period:
+                return True
+            if self.acknowledged != self.keyframe_seq and \
+                    time.monotonic() - self.keyframe_sent_at > args.ack_timeout:
+                return True
+            # A new strip, or a strip of another size, is not in the keyframe
+            return any(self.keyframe.get(s.id, np.empty(0)).size != len(s.data) for s in strips)
+
+        def on_frame(self, msg):
+            # seq is never 0: 0 would not be a valid keyframe_seq
+            self.seq = msg.seq if msg.seq else self.seq + 1
+            is_keyframe = self.needs_keyframe(msg.strips)
+            if is_keyframe:
+                self.keyframe_seq = self.seq
+                self.keyframe_sent_at = time.monotonic()
+                self.keyframe = {}
+            out = LedStripsDelta(seq=self.seq, keyframe_seq=self.keyframe_seq,
+                                 transition_ms=msg.transition_ms)
+            for strip in msg.strips:
+                data = np.frombuffer(bytes(strip.data), dtype=np.uint8)
+                if is_keyframe:
+                    self.keyframe[strip.id] = data
+                    delta = encode(data)
+                else:
+                    delta = encode(data, self.keyframe[strip.id])
+                out.strips.append(LedStripDelta(color_order=strip.color_order, type=strip.type,
+                                                id=strip.id, size=data.size, data=delta))
+                self.raw_bytes += data.size
+                self.delta_bytes += len(delta)
+            self.publisher.publish(out)
+
+    rclpy.init()
+    node = rclpy.create_node('led_delta_bridge')
+    bridge = Bridge(node)
+    try:
+        rclpy.spin(node)
+    except KeyboardInterrupt:
+        pass
+    if bridge.delta_bytes:
+        print(f'{bridge.raw_bytes / bridge.delta_bytes:.1f}x less pixel data')
+    node.destroy_node()
+    rclpy.shutdown()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,50 @@
+// Host replacement of the ESP-IDF RMT driver used by led_strip_rmt_ws2812.c.
+// The counter runs at 40 MHz, as configured by ros_feather_wing (clk_div 2).
+// rmt_write_sample translates the samples in blocks of RMT_BLOCK_ITEMS items,
+// as the ISR refills the RMT memory, and keeps the items of the last write.
+
+#ifndef HOST_DRIVER_RMT_H
+#define HOST_DRIVER_RMT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#define RMT_COUNTER_CLOCK_HZ 40000000
+#define RMT_BLOCK_ITEMS 64
+
+typedef enum {
+  RMT_CHANNEL_0,
+  RMT_CHANNEL_1,
+  RMT_CHANNEL_2,
+  RMT_CHANNEL_3,
+  RMT_CHANNEL_MAX
+} rmt_channel_t;
+
+typedef struct {
+  union {
+    struct {
+      uint32_t duration0 : 15;
+      uint32_t level0 : 1;
+      uint32_t duration1 : 15;
+      uint32_t level1 : 1;
+    };
+    uint32_t val;
+  };
+} rmt_item32_t;
+
+typedef void (*sample_to_rmt_t)(const void *src, rmt_item32_t *dest, size_t src_size,
+                                size_t wanted_num, size_t *translated_size, size_t *item_num);
+
+esp_err_t rmt_get_counter_clock(rmt_channel_t channel, uint32_t *clock_hz);
+esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t fn);
+esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *src, size_t src_size, bool wait_tx_done);
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time);
+
+// The items of the last rmt_write_sample of `channel`
+const rmt_item32_t *host_rmt_items(rmt_channel_t channel, size_t *number);
+
+#endif /* end of include guard: HOST_DRIVER_RMT_H */
@@ -0,0 +1,9 @@
+// Host replacement of the ESP-IDF placement attributes: no IRAM nor PSRAM.
+
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+#define IRAM_ATTR
+#define EXT_RAM_ATTR
+
+#endif /* end of include guard: HOST_ESP_ATTR_H */
@@ -0,0 +1,66 @@
+#include <stdlib.h>
+
+#include "driver/rmt.h"
+
+typedef struct {
+  sample_to_rmt_t translator;
+  rmt_item32_t *items;
+  size_t number_of_items;
+  size_t capacity;
+} host_rmt_channel_t;
+
+static host_rmt_channel_t channels[RMT_CHANNEL_MAX];
+
+esp_err_t rmt_get_counter_clock(rmt_channel_t channel, uint32_t *clock_hz) {
+  if (channel >= RMT_CHANNEL_MAX || !clock_hz) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *clock_hz = RMT_COUNTER_CLOCK_HZ;
+  return ESP_OK;
+}
+
+esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t fn) {
+  if (channel >= RMT_CHANNEL_MAX || !fn) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  channels[channel].translator = fn;
+  return ESP_OK;
+}
+
+esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *src, size_t src_size, bool wait_tx_done) {
+  if (channel >= RMT_CHANNEL_MAX || !channels[channel].translator) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  host_rmt_channel_t *rmt = &channels[channel];
+  rmt->number_of_items = 0;
+  while (src_size) {
+    if (rmt->number_of_items + RMT_BLOCK_ITEMS > rmt->capacity) {
+      rmt_item32_t *items = realloc(rmt->items, 2 * (rmt->capacity + RMT_BLOCK_ITEMS) * sizeof(rmt_item32_t));
+      if (!items) {
+        return ESP_ERR_NO_MEM;
+      }
+      rmt->items = items;
+      rmt->capacity = 2 * (rmt->capacity + RMT_BLOCK_ITEMS);
+    }
+    size_t translated_size = 0;
+    size_t item_num = 0;
+    rmt->translator(src, rmt->items + rmt->number_of_items, src_size, RMT_BLOCK_ITEMS,
+                    &translated_size, &item_num);
+    if (!translated_size) {
+      return ESP_FAIL;
+    }
+    src += translated_size;
+    src_size -= translated_size;
+    rmt->number_of_items += item_num;
+  }
+  return ESP_OK;
+}
+
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time) {
+  return channel < RMT_CHANNEL_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+const rmt_item32_t *host_rmt_items(rmt_channel_t channel, size_t *number) {
+  *number = channels[channel].number_of_items;
+  return channels[channel].items;
+}
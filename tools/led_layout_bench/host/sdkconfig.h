@@ -0,0 +1,6 @@
+// Host configuration of the buffer_placement component: internal RAM only
+
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+#endif /* end of include guard: HOST_SDKCONFIG_H */
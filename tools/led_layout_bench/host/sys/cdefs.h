@@ -0,0 +1,12 @@
+// The newlib sys/cdefs.h of ESP-IDF also defines __containerof.
+
+#ifndef HOST_SYS_CDEFS_H
+#define HOST_SYS_CDEFS_H
+
+#include_next <sys/cdefs.h>
+
+#include <stddef.h>
+
+#define __containerof(ptr, type, member) ((type *) ((char *) (ptr) - offsetof(type, member)))
+
+#endif /* end of include guard: HOST_SYS_CDEFS_H */
@@ -0,0 +1,249 @@
+// Checks the led_layout lookup tables of ros_feather_wing against a reference
+// that walks the LEDs in wiring order, for all the wirings, rotations, mirrors
+// and tilings of the matrices from 8x4 to 64x16. The images are blitted through
+// the host build of the RMT WS2812 driver, and the bits it sends are decoded.
+//
+// Then measures, per matrix size, the time to build the table, and the cost per
+// pixel of a blit against computing the LED index of every pixel at every frame.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver/rmt.h"
+#include "led_layout.h"
+#include "led_strip.h"
+
+#define REPETITIONS 20000
+#define BENCH_SCALE 128
+
+typedef struct {
+  uint16_t width;
+  uint16_t height;
+} size2d_t;
+
+static const size2d_t sizes[] = {{8, 4}, {16, 8}, {32, 8}, {32, 16}, {64, 16}};
+#define NUMBER_OF_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static uint8_t image[3 * 64 * 16];
+static uint16_t expected_lut[64 * 16];
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static bool report(const char *name, bool ok) {
+  printf("%-18s%s\n", name, ok ? "passed" : "FAILED");
+  return ok;
+}
+
+// Position on the matrix of LED `index`, walking the panels in wiring order
+static void led_position(const led_layout_config_t *config, uint32_t index, uint16_t *mx, uint16_t *my) {
+  const uint32_t panel_size = config->panel_width * config->panel_height;
+  const uint32_t tile = index / panel_size;
+  const uint16_t row = (index % panel_size) / config->panel_width;
+  uint16_t column = index % config->panel_width;
+  if (config->wiring == LED_LAYOUT_SERPENTINE && (row & 1)) {
+    column = config->panel_width - 1 - column;
+  }
+  *mx = (tile % config->tiles_x) * config->panel_width + column;
+  *my = (tile / config->tiles_x) * config->panel_height + row;
+}
+
+// Image pixel shown at (mx, my) on the matrix: the inverse of the clockwise
+// rotation, then of the mirrors
+static uint32_t image_pixel(const led_layout_config_t *config, uint16_t width, uint16_t height,
+                            uint16_t mx, uint16_t my) {
+  const uint16_t matrix_width = config->panel_width * config->tiles_x;
+  const uint16_t matrix_height = config->panel_height * config->tiles_y;
+  uint16_t x, y;
+  switch (config->rotation) {
+    case LED_LAYOUT_ROTATION_90: x = my; y = matrix_width - 1 - mx; break;
+    case LED_LAYOUT_ROTATION_180: x = matrix_width - 1 - mx; y = matrix_height - 1 - my; break;
+    case LED_LAYOUT_ROTATION_270: x = matrix_height - 1 - my; y = mx; break;
+    default: x = mx; y = my;
+  }
+  if (config->mirror_x) {
+    x = width - 1 - x;
+  }
+  if (config->mirror_y) {
+    y = height - 1 - y;
+  }
+  return y * width + x;
+}
+
+// What the driver computed before the tables: the LED of image pixel (x, y),
+// through the tiles, the wiring and the rotation
+static uint32_t led_of_pixel(const led_layout_config_t *config, uint16_t width, uint16_t height,
+                             uint16_t x, uint16_t y) {
+  const uint16_t matrix_width = config->panel_width * config->tiles_x;
+  const uint16_t matrix_height = config->panel_height * config->tiles_y;
+  const uint16_t ix = config->mirror_x ? width - 1 - x : x;
+  const uint16_t iy = config->mirror_y ? height - 1 - y : y;
+  uint16_t mx, my;
+  switch (config->rotation) {
+    case LED_LAYOUT_ROTATION_90: mx = matrix_width - 1 - iy; my = ix; break;
+    case LED_LAYOUT_ROTATION_180: mx = matrix_width - 1 - ix; my = matrix_height - 1 - iy; break;
+    case LED_LAYOUT_ROTATION_270: mx = iy; my = matrix_height - 1 - ix; break;
+    default: mx = ix; my = iy;
+  }
+  const uint32_t tile = (my / config->panel_height) * config->tiles_x + mx / config->panel_width;
+  const uint16_t row = my % config->panel_height;
+  uint16_t column = mx % config->panel_width;
+  if (config->wiring == LED_LAYOUT_SERPENTINE && (row & 1)) {
+    column = config->panel_width - 1 - column;
+  }
+  return tile * config->panel_width * config->panel_height + row * config->panel_width + column;
+}
+
+// Decodes the GRB bytes sent by the RMT driver: a 1 has the longer high time
+static bool sent_bytes(uint8_t *bytes, size_t size) {
+  size_t number_of_items;
+  const rmt_item32_t *items = host_rmt_items(RMT_CHANNEL_0, &number_of_items);
+  if (number_of_items != 8 * size) {
+    fprintf(stderr, "%zu RMT items for %zu bytes\n", number_of_items, size);
+    return false;
+  }
+  const uint32_t threshold = RMT_COUNTER_CLOCK_HZ / 1000000 * 675 / 1000;
+  for (size_t i = 0; i < size; i++, items += 8) {
+    bytes[i] = 0;
+    for (int bit = 0; bit < 8; bit++) {
+      bytes[i] = (bytes[i] << 1) | (items[bit].duration0 > threshold);
+    }
+  }
+  return true;
+}
+
+static bool check_layout(const led_layout_config_t *config, led_strip_t *strip, uint8_t *sent) {
+  led_layout_t *layout = led_layout_new(config);
+  if (!layout) {
+    return false;
+  }
+  const uint32_t number_of_leds = config->panel_width * config->panel_height * config->tiles_x * config->tiles_y;
+  bool ok = (uint32_t) layout->width * layout->height == number_of_leds;
+  for (uint32_t led = 0; ok && led < number_of_leds; led++) {
+    uint16_t mx, my;
+    led_position(config, led, &mx, &my);
+    expected_lut[image_pixel(config, layout->width, layout->height, mx, my)] = led;
+  }
+  for (uint32_t i = 0; ok && i < number_of_leds; i++) {
+    ok = layout->lut[i] == expected_lut[i];
+  }
+  // Through the driver, at full brightness
+  ok = ok && led_layout_blit(layout, strip, image, layout->width, layout->height, 256) == ESP_OK &&
+       strip->refresh(strip, 100) == ESP_OK && sent_bytes(sent, 3 * number_of_leds);
+  for (uint32_t i = 0; ok && i < number_of_leds; i++) {
+    const uint8_t *rgb = image + 3 * i;
+    const uint8_t *grb = sent + 3 * expected_lut[i];
+    ok = grb[0] == rgb[1] && grb[1] == rgb[0] && grb[2] == rgb[2];
+  }
+  if (!ok) {
+    fprintf(stderr, "%ux%u panels, %ux%u tiles, wiring %d, rotation %d, mirror %d %d\n",
+            config->panel_width, config->panel_height, config->tiles_x, config->tiles_y,
+            config->wiring, config->rotation, config->mirror_x, config->mirror_y);
+  }
+  led_layout_del(layout);
+  return ok;
+}
+
+// Every layout of the matrix, as one panel or as tiles of 8x4 panels
+static bool check_size(size2d_t size) {
+  led_strip_config_t strip_config = LED_STRIP_DEFAULT_CONFIG(size.width * size.height, (led_strip_dev_t) RMT_CHANNEL_0);
+  led_strip_t *strip = led_strip_new_rmt_ws2812(&strip_config);
+  uint8_t *sent = malloc(3 * size.width * size.height);
+  bool ok = strip && sent;
+  for (int tiled = 0; ok && tiled < 2; tiled++) {
+    led_layout_config_t config = {
+      .panel_width = tiled ? 8 : size.width,
+      .panel_height = tiled ? 4 : size.height,
+      .tiles_x = tiled ? size.width / 8 : 1,
+      .tiles_y = tiled ? size.height / 4 : 1,
+    };
+    for (int variant = 0; ok && variant < 32; variant++) {
+      config.wiring = variant & 1 ? LED_LAYOUT_SERPENTINE : LED_LAYOUT_ROW_MAJOR;
+      config.rotation = (led_layout_rotation_t) ((variant >> 1) & 3);
+      config.mirror_x = variant & 8;
+      config.mirror_y = variant & 16;
+      ok = check_layout(&config, strip, sent);
+    }
+  }
+  free(sent);
+  if (strip) {
+    strip->del(strip);
+  }
+  return ok;
+}
+
+// A serpentine matrix rotated by 90 degrees and mirrored: the longest index computation
+static void bench_size(size2d_t size) {
+  const led_layout_config_t config = {
+    .panel_width = size.width,
+    .panel_height = size.height,
+    .tiles_x = 1,
+    .tiles_y = 1,
+    .wiring = LED_LAYOUT_SERPENTINE,
+    .rotation = LED_LAYOUT_ROTATION_90,
+    .mirror_x = true,
+  };
+  const uint32_t number_of_leds = size.width * size.height;
+  led_strip_config_t strip_config = LED_STRIP_DEFAULT_CONFIG(number_of_leds, (led_strip_dev_t) RMT_CHANNEL_0);
+  led_strip_t *strip = led_strip_new_rmt_ws2812(&strip_config);
+
+  double start = now_s();
+  led_layout_t *layout = NULL;
+  for (int i = 0; i < 100; i++) {
+    led_layout_del(layout);
+    layout = led_layout_new(&config);
+  }
+  const double build_s = (now_s() - start) / 100;
+
+  start = now_s();
+  for (int i = 0; i < REPETITIONS; i++) {
+    led_layout_blit(layout, strip, image, layout->width, layout->height, BENCH_SCALE);
+  }
+  const double blit_s = (now_s() - start) / REPETITIONS;
+
+  start = now_s();
+  for (int i = 0; i < REPETITIONS; i++) {
+    const uint8_t *rgb = image;
+    for (uint16_t y = 0; y < layout->height; y++) {
+      for (uint16_t x = 0; x < layout->width; x++, rgb += 3) {
+        strip->set_pixel(strip, led_of_pixel(&config, layout->width, layout->height, x, y),
+                         (rgb[0] * BENCH_SCALE) >> 8, (rgb[1] * BENCH_SCALE) >> 8, (rgb[2] * BENCH_SCALE) >> 8);
+      }
+    }
+  }
+  const double per_pixel_s = (now_s() - start) / REPETITIONS;
+
+  printf("%2ux%-5u %8.2f %9zu %10.2f %12.2f\n", size.width, size.height, 1e6 * build_s,
+         number_of_leds * sizeof(uint16_t), 1e9 * blit_s / number_of_leds, 1e9 * per_pixel_s / number_of_leds);
+  led_layout_del(layout);
+  strip->del(strip);
+}
+
+int main(void) {
+  srand(1);
+  for (size_t i = 0; i < sizeof(image); i++) {
+    image[i] = rand();
+  }
+  bool ok = true;
+  for (size_t i = 0; i < NUMBER_OF_SIZES; i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "layouts %ux%u", sizes[i].width, sizes[i].height);
+    ok = report(name, check_size(sizes[i])) && ok;
+  }
+  if (!ok) {
+    return 1;
+  }
+  printf("\nmatrix   lut (us) lut bytes blit ns/px index ns/px\n");
+  for (size_t i = 0; i < NUMBER_OF_SIZES; i++) {
+    bench_size(sizes[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,184 @@
+// Publishes LedStrips frames at a fixed rate and measures what the LED driver
+// makes of them:
+// - sustained frame rate and loss, from the seq echoed on `shown_frames`
+//   (ros_led_driver with ECHO_SHOWN_FRAMES) and from `driver_stats`;
+// - latency from publication to echo (p50, p99, max).
+//
+// ros2 run led_load_generator led_load_generator --ros-args \
+//   -p strips:=8 -p pixels:=300 -p rate:=60.0 -p duration:=10.0 -p best_effort:=true
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "std_msgs/msg/u_int32.hpp"
+#include "led_strip_msgs/msg/driver_stats.hpp"
+#include "led_strip_msgs/msg/led_strips.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+class LoadGenerator : public rclcpp::Node
+{
+public:
+  LoadGenerator()
+  : Node("led_load_generator")
+  {
+    const auto strips = declare_parameter<int>("strips", 8);
+    const auto pixels = declare_parameter<int>("pixels", 300);
+    const auto type = declare_parameter<int>("type", led_strip_msgs::msg::LedStrip::WS2812);
+    rate_ = declare_parameter<double>("rate", 30.0);
+    duration_ = declare_parameter<double>("duration", 10.0);
+    const auto best_effort = declare_parameter<bool>("best_effort", false);
+
+    frame_.strips.resize(strips);
+    for (int i = 0; i < strips; i++) {
+      frame_.strips[i].id = i;
+      frame_.strips[i].type = type;
+      frame_.strips[i].data.resize(3 * pixels);
+    }
+    number_of_frames_ = static_cast<size_t>(rate_ * duration_);
+    sent_at_.resize(number_of_frames_ + 1);
+    shown_at_.resize(number_of_frames_ + 1);
+
+    rclcpp::QoS qos = best_effort ? rclcpp::QoS(1).best_effort() : rclcpp::QoS(10);
+    publisher_ = create_publisher<led_strip_msgs::msg::LedStrips>("led_strips", qos);
+    shown_frames_subscription_ = create_subscription<std_msgs::msg::UInt32>(
+      "shown_frames", rclcpp::SensorDataQoS(),
+      [this](std_msgs::msg::UInt32::UniquePtr msg) {on_shown_frame(msg->data);});
+    stats_subscription_ = create_subscription<led_strip_msgs::msg::DriverStats>(
+      "driver_stats", rclcpp::SensorDataQoS(),
+      [this](led_strip_msgs::msg::DriverStats::UniquePtr msg) {on_stats(*msg);});
+
+    RCLCPP_INFO(
+      get_logger(), "Publishing %zu frames of %d x %d pixels at %.1f fps (%s)",
+      number_of_frames_, strips, pixels, rate_, best_effort ? "best effort" : "reliable");
+    start_ = Clock::now();
+    timer_ = create_wall_timer(
+      std::chrono::duration<double>(1.0 / rate_), [this]() {publish();});
+  }
+
+private:
+  void publish()
+  {
+    if (seq_ >= number_of_frames_) {
+      timer_->cancel();
+      // Wait for the last echoes and statistics
+      done_timer_ = create_wall_timer(2s, [this]() {report(); rclcpp::shutdown();});
+      return;
+    }
+    seq_++;
+    // Change the content of every frame
+    for (auto & strip : frame_.strips) {
+      std::fill(strip.data.begin(), strip.data.end(), static_cast<uint8_t>(seq_));
+    }
+    frame_.seq = seq_;
+    sent_at_[seq_] = Clock::now();
+    publisher_->publish(frame_);
+  }
+
+  void on_shown_frame(uint32_t seq)
+  {
+    if (seq == 0 || seq > seq_ || shown_at_[seq] != Clock::time_point()) {
+      return;
+    }
+    shown_at_[seq] = Clock::now();
+    shown_++;
+  }
+
+  void on_stats(const led_strip_msgs::msg::DriverStats & msg)
+  {
+    if (!has_stats_) {
+      first_stats_ = msg;
+      has_stats_ = true;
+    }
+    last_stats_ = msg;
+    if (msg.fps > 0) {
+      driver_fps_.push_back(msg.fps);
+      link_utilization_.push_back(msg.link_utilization);
+    }
+  }
+
+  static double percentile(std::vector<double> values, double p)
+  {
+    if (values.empty()) {
+      return 0;
+    }
+    const size_t index = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+  }
+
+  void report()
+  {
+    std::vector<double> latencies_ms;
+    Clock::time_point first_shown, last_shown;
+    for (size_t seq = 1; seq <= seq_; seq++) {
+      if (shown_at_[seq] == Clock::time_point()) {
+        continue;
+      }
+      if (first_shown == Clock::time_point()) {
+        first_shown = shown_at_[seq];
+      }
+      last_shown = shown_at_[seq];
+      latencies_ms.push_back(
+        std::chrono::duration<double, std::milli>(shown_at_[seq] - sent_at_[seq]).count());
+    }
+    const double sent_s = std::chrono::duration<double>(sent_at_[seq_] - start_).count();
+    const double shown_s = std::chrono::duration<double>(last_shown - first_shown).count();
+
+    printf("sent              %u frames in %.2f s (%.1f fps)\n", seq_, sent_s, sent_s > 0 ? seq_ / sent_s : 0);
+    if (shown_) {
+      printf("shown             %u frames (%.1f fps sustained)\n", shown_,
+        shown_s > 0 ? (shown_ - 1) / shown_s : 0);
+      printf("loss              %.1f %%\n", 100.0 * (seq_ - shown_) / seq_);
+      printf(
+        "latency           p50 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+        percentile(latencies_ms, 0.5), percentile(latencies_ms, 0.99),
+        *std::max_element(latencies_ms.begin(), latencies_ms.end()));
+    } else {
+      printf("shown             no echo on shown_frames (enable ECHO_SHOWN_FRAMES)\n");
+    }
+    if (has_stats_) {
+      printf(
+        "driver            %.1f fps (median), link utilisation %.0f %% (median)\n",
+        percentile(driver_fps_, 0.5), 100 * percentile(link_utilization_, 0.5));
+      printf(
+        "driver counters   %u dropped or late, %u coalesced\n",
+        last_stats_.dropped_frames - first_stats_.dropped_frames,
+        last_stats_.coalesced_frames - first_stats_.coalesced_frames);
+    } else {
+      printf("driver            no driver_stats received\n");
+    }
+  }
+
+  double rate_;
+  double duration_;
+  size_t number_of_frames_;
+  uint32_t seq_ = 0;
+  uint32_t shown_ = 0;
+  led_strip_msgs::msg::LedStrips frame_;
+  Clock::time_point start_;
+  std::vector<Clock::time_point> sent_at_;
+  std::vector<Clock::time_point> shown_at_;
+  bool has_stats_ = false;
+  led_strip_msgs::msg::DriverStats first_stats_;
+  led_strip_msgs::msg::DriverStats last_stats_;
+  std::vector<double> driver_fps_;
+  std::vector<double> link_utilization_;
+  rclcpp::Publisher<led_strip_msgs::msg::LedStrips>::SharedPtr publisher_;
+  rclcpp::Subscription<std_msgs::msg::UInt32>::SharedPtr shown_frames_subscription_;
+  rclcpp::Subscription<led_strip_msgs::msg::DriverStats>::SharedPtr stats_subscription_;
+  rclcpp::TimerBase::SharedPtr timer_;
+  rclcpp::TimerBase::SharedPtr done_timer_;
+};
+
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<LoadGenerator>());
+  return 0;
+}
@@ -0,0 +1,404 @@
+// Host build of the micro-ROS side of ros_led_driver, to run many simulated
+// boards against one agent (see tools/led_scale.py).
+//
+// Same entities and reconnection state machine as ros_led_driver/main/main.c,
+// and the same frame logic, built from components/led_frames, with the frame
+// pacers. The drivers are the UART stub of tools/led_replay. Every node
+// subscribes to the shared `/led_strips` and echoes the seq of the frames
+// written to the drivers on `shown_frames` (as with ECHO_SHOWN_FRAMES).
+//
+// led_strips is reliable, as by default on the board: micro-ROS does not
+// fragment best effort messages, so a frame larger than the MTU would never
+// arrive. The largest LedStrips has to fit in the input stream: build with
+// colcon.meta.
+//
+// led_node_sim [--ip 127.0.0.1] [--port 8888] [--index 0] [--channels 8] [--pixels 1000]
+//   node `led_driver_pro` in namespace `led_<index>`
+
+#define _DEFAULT_SOURCE
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rcl/rcl.h>
+#include <rcl/error_handling.h>
+#include <rclc/rclc.h>
+#include <rclc/executor.h>
+#include <rmw_uros/options.h>
+#include <rmw_microxrcedds_c/config.h>
+#include "uxr/client/config.h"
+
+#include <led_strip_msgs/srv/set_brightness.h>
+#include <led_strip_msgs/msg/led_strips.h>
+#include <led_strip_msgs/msg/driver_stats.h>
+#include <std_msgs/msg/u_int32.h>
+
+#include "serial_led_driver_pro.h"
+#include "frame_pacer.h"
+#include "led_frames.h"
+
+#define NODE_NAME "led_driver_pro"
+#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){fprintf(stderr, "[%s] Failed status on line %d: %d. Retrying.\n", node_ns, __LINE__, (int)temp_rc); return false;}}
+#define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){fprintf(stderr, "[%s] Failed status on line %d: %d. Continuing.\n", node_ns, __LINE__, (int)temp_rc);}}
+
+// As the defaults of ros_led_driver
+#define DEFAULT_NUMBER_OF_CHANNELS 8
+#define DEFAULT_STRIP_LENGTH 1000
+#define MAX_NUMBER_OF_OUTPUTS (LED_FRAMES_MAX_CHANNELS / PB_NUMBER_OF_CHANNELS)
+#define EXECUTOR_HANDLES 3
+#define FREQUENCY 1000000
+#define DEFAULT_BRIGHTNESS 0x1
+#define TARGET_FPS 60
+#define STATS_PERIOD_MS 1000
+// As in ros_led_driver/main/app_config.h
+#define LED_STRIPS_MAX_SERIALIZED_SIZE(channels, length) (14 + (channels) * (3 * (length) + 11))
+#define XRCE_MESSAGE_OVERHEAD 32
+
+#define AGENT_PING_PERIOD_MS 1000
+#define AGENT_PING_TIMEOUT_MS 100
+#define AGENT_PING_ATTEMPTS 3
+#define MAX_SPIN_FAILURES 10
+#define MIN_RECONNECT_BACKOFF_MS 100
+#define MAX_RECONNECT_BACKOFF_MS 5000
+
+typedef enum {
+  WAITING_AGENT,
+  AGENT_CONNECTED,
+  AGENT_DISCONNECTED
+} agent_state_t;
+
+static const char *agent_ip = "127.0.0.1";
+static const char *agent_port = "8888";
+static unsigned index_ = 0;
+static size_t number_of_channels = DEFAULT_NUMBER_OF_CHANNELS;
+static size_t max_strip_length = DEFAULT_STRIP_LENGTH;
+static size_t number_of_outputs;
+static char node_ns[16];
+
+static rclc_support_t support;
+static rcl_node_t node;
+static rcl_subscription_t subscriber;
+static rcl_service_t set_brightness_service;
+static rcl_publisher_t stats_publisher;
+static rcl_publisher_t shown_frames_publisher;
+static rcl_timer_t stats_timer;
+static rclc_executor_t executor;
+static bool support_ready = false;
+static led_strip_msgs__msg__LedStrips msg;
+static led_strip_msgs__msg__LedStrip msg_strips[LED_FRAMES_MAX_CHANNELS];
+static led_strip_msgs__srv__SetBrightness_Response res;
+static led_strip_msgs__srv__SetBrightness_Request req;
+static led_strip_msgs__msg__DriverStats stats_msg;
+static std_msgs__msg__UInt32 shown_frame_msg;
+static led_frames_t frames;
+static pb_driver_t drivers[MAX_NUMBER_OF_OUTPUTS];
+static frame_pacer_t pacers[MAX_NUMBER_OF_OUTPUTS];
+
+static int64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t elapsed_ms(int64_t since_us) {
+  return (now_us() - since_us) / 1000;
+}
+
+static int64_t outputs_wait_us(int64_t now_us) {
+  int64_t wait_us = 0;
+  for (size_t i = 0; i < number_of_outputs; i++) {
+    const int64_t output_wait_us = frame_pacer_wait_us(pacers + i, now_us);
+    if (output_wait_us > wait_us) {
+      wait_us = output_wait_us;
+    }
+  }
+  return wait_us;
+}
+
+static void write_frame(const led_frames_strip_t * strips, size_t number_of_strips) {
+  led_frames_begin_write(&frames, strips, number_of_strips);
+  for (size_t i = 0; i < number_of_outputs; i++) {
+    const size_t size = led_frames_write_output(&frames, i, drivers + i);
+    frame_pacer_sent(pacers + i, size, now_us());
+  }
+}
+
+static int64_t show_pending_frame() {
+  if (!frames.pending) {
+    return 0;
+  }
+  const int64_t wait_us = outputs_wait_us(now_us());
+  if (wait_us > 0) {
+    return wait_us;
+  }
+  led_frames_strip_t strips[LED_FRAMES_MAX_CHANNELS];
+  const size_t number_of_strips = led_frames_render(&frames, now_us(), strips);
+  write_frame(strips, number_of_strips);
+  if (frames.seq) {
+    shown_frame_msg.data = frames.seq;
+    RCSOFTCHECK(rcl_publish(&shown_frames_publisher, &shown_frame_msg, NULL));
+  }
+  return 0;
+}
+
+// rclc deserializes every LedStrips in msg, late or not: its strips point to
+// the slot of the frame buffers that is not shown.
+static void set_message_buffers() {
+  for (size_t i = 0; i < number_of_channels; i++) {
+    msg.strips.data[i].data.data = led_frames_receive_buffer(&frames, i);
+  }
+}
+
+static void subscription_callback(const void * msgin) {
+  const led_strip_msgs__msg__LedStrips * strips_msg = (const led_strip_msgs__msg__LedStrips *)msgin;
+  // The pixels are in the frame buffers
+  led_frames_strip_t strips[LED_FRAMES_MAX_CHANNELS];
+  size_t number_of_strips = 0;
+  for (size_t i = 0; i < strips_msg->strips.size && number_of_strips < number_of_channels; i++) {
+    const led_strip_msgs__msg__LedStrip * strip_msg = strips_msg->strips.data + i;
+    strips[number_of_strips++] = (led_frames_strip_t) {
+      strip_msg->id, strip_msg->type, strip_msg->color_order, strip_msg->data.data, strip_msg->data.size};
+  }
+  if (led_frames_receive(&frames, strips_msg->seq, strips_msg->transition_ms,
+                         strips, number_of_strips, now_us())) {
+    set_message_buffers();
+    show_pending_frame();
+  }
+}
+
+static void stats_timer_callback(rcl_timer_t * timer, int64_t last_call_time) {
+  RCLC_UNUSED(last_call_time);
+  if (timer != NULL) {
+    // The frames go to all the outputs: report the busiest link
+    frame_pacer_stats_t stats[MAX_NUMBER_OF_OUTPUTS];
+    for (size_t i = 0; i < number_of_outputs; i++) {
+      frame_pacer_get_stats(pacers + i, now_us(), stats + i);
+    }
+    stats_msg.dropped_frames = frames.dropped_frames;
+    stats_msg.coalesced_frames = frames.coalesced_frames;
+    stats_msg.fps = stats[0].fps;
+    stats_msg.link_utilization = 0;
+    for (size_t i = 0; i < number_of_outputs; i++) {
+      if (stats[i].link_utilization > stats_msg.link_utilization) {
+        stats_msg.link_utilization = stats[i].link_utilization;
+      }
+    }
+    RCSOFTCHECK(rcl_publish(&stats_publisher, &stats_msg, NULL));
+  }
+}
+
+static void set_brightness(uint16_t channel_mask, float value) {
+  const uint8_t i_value = value < 0 ? 0 : (value > 1.0 ? 0x1F : (uint8_t) (31 * value));
+  for (size_t i = 0; i < number_of_channels; i++) {
+    if (channel_mask & (1 << i)) {
+      frames.brightness[i] = i_value;
+    }
+  }
+}
+
+static void set_brightness_service_callback(const void * req, void * res) {
+  RCLC_UNUSED(res);
+  const led_strip_msgs__srv__SetBrightness_Request * req_in = req;
+  set_brightness(req_in->channel_index_mask, req_in->brightness);
+  led_frames_show_again(&frames);
+  show_pending_frame();
+}
+
+static bool init_frames() {
+  const led_frames_config_t config = {
+    .number_of_channels = number_of_channels,
+    .max_strip_length = max_strip_length,
+    .apa102_frequency = FREQUENCY,
+  };
+  const led_frames_buffers_t buffers = {
+    .frames = calloc(2 * number_of_channels, 3 * max_strip_length),
+  };
+  if (!buffers.frames) {
+    return false;
+  }
+  led_frames_init(&frames, &config, &buffers);
+  set_brightness(0xFFFF, DEFAULT_BRIGHTNESS);
+  return true;
+}
+
+static void init_message() {
+  msg.strips.capacity = number_of_channels;
+  msg.strips.size = 0;
+  msg.strips.data = msg_strips;
+  for (size_t i = 0; i < number_of_channels; i++) {
+    msg.strips.data[i].data.capacity = 3 * max_strip_length;
+    msg.strips.data[i].data.size = 0;
+  }
+  set_message_buffers();
+}
+
+static bool create_entities() {
+  rcl_allocator_t allocator = rcl_get_default_allocator();
+  rcl_init_options_t init_options = rcl_get_zero_initialized_init_options();
+  RCCHECK(rcl_init_options_init(&init_options, allocator));
+  rmw_init_options_t* rmw_options = rcl_init_options_get_rmw_init_options(&init_options);
+  // One XRCE session per simulated board
+  RCSOFTCHECK(rmw_uros_options_set_client_key(0x4c454400 + index_, rmw_options));
+  RCSOFTCHECK(rmw_uros_options_set_udp_address(agent_ip, agent_port, rmw_options));
+  rcl_ret_t rc = rclc_support_init_with_options(&support, 0, NULL, &init_options, &allocator);
+  RCSOFTCHECK(rcl_init_options_fini(&init_options));
+  RCCHECK(rc);
+  support_ready = true;
+
+  node = rcl_get_zero_initialized_node();
+  RCCHECK(rclc_node_init_default(&node, NODE_NAME, node_ns, &support));
+
+  subscriber = rcl_get_zero_initialized_subscription();
+  RCCHECK(rclc_subscription_init_default(
+    &subscriber, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, LedStrips),
+    "/led_strips"));
+  stats_publisher = rcl_get_zero_initialized_publisher();
+  RCCHECK(rclc_publisher_init_best_effort(
+    &stats_publisher, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(led_strip_msgs, msg, DriverStats),
+    "driver_stats"));
+  shown_frames_publisher = rcl_get_zero_initialized_publisher();
+  RCCHECK(rclc_publisher_init_best_effort(
+    &shown_frames_publisher, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, UInt32),
+    "shown_frames"));
+  stats_timer = rcl_get_zero_initialized_timer();
+  RCCHECK(rclc_timer_init_default(&stats_timer, &support, RCL_MS_TO_NS(STATS_PERIOD_MS), stats_timer_callback));
+  set_brightness_service = rcl_get_zero_initialized_service();
+  RCCHECK(rclc_service_init_default(&set_brightness_service, &node, ROSIDL_GET_SRV_TYPE_SUPPORT(led_strip_msgs, srv, SetBrightness), "set_brightness"));
+
+  executor = rclc_executor_get_zero_initialized_executor();
+  RCCHECK(rclc_executor_init(&executor, &support.context, EXECUTOR_HANDLES, &allocator));
+  RCCHECK(rclc_executor_add_subscription(&executor, &subscriber, &msg, &subscription_callback, ON_NEW_DATA));
+  RCCHECK(rclc_executor_add_service(&executor, &set_brightness_service, &req, &res, set_brightness_service_callback));
+  RCCHECK(rclc_executor_add_timer(&executor, &stats_timer));
+  return true;
+}
+
+static void destroy_entities() {
+  if (!support_ready) {
+    return;
+  }
+  rmw_context_t * rmw_context = rcl_context_get_rmw_context(&support.context);
+  (void) rmw_uros_set_context_entity_destroy_session_timeout(rmw_context, 0);
+
+  RCSOFTCHECK(rclc_executor_fini(&executor));
+  RCSOFTCHECK(rcl_timer_fini(&stats_timer));
+  RCSOFTCHECK(rcl_publisher_fini(&stats_publisher, &node));
+  RCSOFTCHECK(rcl_publisher_fini(&shown_frames_publisher, &node));
+  RCSOFTCHECK(rcl_service_fini(&set_brightness_service, &node));
+  RCSOFTCHECK(rcl_subscription_fini(&subscriber, &node));
+  RCSOFTCHECK(rcl_node_fini(&node));
+  RCSOFTCHECK(rclc_support_fini(&support));
+  support_ready = false;
+}
+
+// Same state machine as ros_feather_s2/components/uros_reconnect, which needs
+// ESP-IDF. Connections are logged on stdout ("<ns> connected <ms>") for
+// tools/led_scale.py.
+static void micro_ros_loop() {
+  agent_state_t state = WAITING_AGENT;
+  uint32_t backoff_ms = MIN_RECONNECT_BACKOFF_MS;
+  int64_t lost_at_us = now_us();
+  int64_t last_ping_us = 0;
+  unsigned spin_failures = 0;
+
+  while (1) {
+    switch (state) {
+      case WAITING_AGENT:
+        if (create_entities()) {
+          printf("%s connected %lld\n", node_ns, (long long) elapsed_ms(lost_at_us));
+          fflush(stdout);
+          backoff_ms = MIN_RECONNECT_BACKOFF_MS;
+          spin_failures = 0;
+          last_ping_us = now_us();
+          state = AGENT_CONNECTED;
+        } else {
+          destroy_entities();
+          usleep(1000 * backoff_ms);
+          backoff_ms = (2 * backoff_ms < MAX_RECONNECT_BACKOFF_MS) ? 2 * backoff_ms : MAX_RECONNECT_BACKOFF_MS;
+        }
+        break;
+      case AGENT_CONNECTED: {
+        const int64_t wait_us = show_pending_frame();
+        if (rclc_executor_spin_some(&executor, wait_us ? RCL_US_TO_NS(wait_us) : RCL_MS_TO_NS(100)) == RCL_RET_ERROR) {
+          spin_failures++;
+        } else {
+          spin_failures = 0;
+        }
+        if (spin_failures >= MAX_SPIN_FAILURES || elapsed_ms(last_ping_us) >= AGENT_PING_PERIOD_MS) {
+          last_ping_us = now_us();
+          spin_failures = 0;
+          if (rmw_uros_ping_agent(AGENT_PING_TIMEOUT_MS, AGENT_PING_ATTEMPTS) != RMW_RET_OK) {
+            state = AGENT_DISCONNECTED;
+            break;
+          }
+        }
+        if (!frames.pending) {
+          usleep(10000);
+        }
+        break;
+      }
+      case AGENT_DISCONNECTED:
+        printf("%s disconnected\n", node_ns);
+        fflush(stdout);
+        lost_at_us = now_us();
+        destroy_entities();
+        state = WAITING_AGENT;
+        break;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  static const struct option long_options[] = {
+    {"ip", required_argument, NULL, 'i'},
+    {"port", required_argument, NULL, 'p'},
+    {"index", required_argument, NULL, 'n'},
+    {"channels", required_argument, NULL, 'c'},
+    {"pixels", required_argument, NULL, 'l'},
+    {NULL, 0, NULL, 0},
+  };
+  int c;
+  bool usage = false;
+  while ((c = getopt_long(argc, argv, "i:p:n:c:l:", long_options, NULL)) != -1) {
+    switch (c) {
+      case 'i': agent_ip = optarg; break;
+      case 'p': agent_port = optarg; break;
+      case 'n': index_ = atoi(optarg); break;
+      case 'c': number_of_channels = strtoul(optarg, NULL, 0); break;
+      case 'l': max_strip_length = strtoul(optarg, NULL, 0); break;
+      default: usage = true; break;
+    }
+  }
+  if (usage || !number_of_channels || number_of_channels > LED_FRAMES_MAX_CHANNELS ||
+      !max_strip_length || max_strip_length > UINT16_MAX) {
+    fprintf(stderr, "Usage: %s [--ip IP] [--port PORT] [--index N] [--channels 1..%d] [--pixels N]\n",
+            argv[0], LED_FRAMES_MAX_CHANNELS);
+    return 1;
+  }
+  snprintf(node_ns, sizeof(node_ns), "led_%u", index_);
+  // The static check of app_config.h, with the options
+  const size_t max_message_size = LED_STRIPS_MAX_SERIALIZED_SIZE(number_of_channels, max_strip_length)
+                                  + XRCE_MESSAGE_OVERHEAD;
+  const size_t input_stream_size = (size_t) UXR_CONFIG_UDP_TRANSPORT_MTU * RMW_UXRCE_STREAM_HISTORY;
+  if (max_message_size > input_stream_size) {
+    fprintf(stderr, "[%s] LedStrips of %zu bytes do not fit in the input stream (%zu bytes): "
+            "build micro-ROS with tools/led_node_sim/colcon.meta\n", node_ns, max_message_size, input_stream_size);
+    return 1;
+  }
+  if (!init_frames()) {
+    fprintf(stderr, "[%s] Cannot allocate the frame buffers\n", node_ns);
+    return 1;
+  }
+  init_message();
+  number_of_outputs = (number_of_channels + PB_NUMBER_OF_CHANNELS - 1) / PB_NUMBER_OF_CHANNELS;
+  for (size_t i = 0; i < number_of_outputs; i++) {
+    pb_init(drivers + i, i, 0);
+    frame_pacer_init(pacers + i, PB_BAUD_RATE, TARGET_FPS, PB_TX_BUFFER_SIZE, now_us());
+  }
+  micro_ros_loop();
+  return 0;
+}
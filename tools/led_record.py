@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""
+Record the led_strips / color traffic to a capture file, to be replayed with
+tools/led_replay (see tools/led_replay/capture_format.h for the format).
+
+Examples:
+    # record led_strips and color until Ctrl-C
+    ./led_record.py capture.bin
+    # record only the color topic of a namespaced feather wing
+    ./led_record.py capture.bin --no-led-strips --color /led_0/color
+    # write a synthetic capture (8 strips of 1000 pixels, 100 fps, 10 s), no ROS needed
+    ./led_record.py capture.bin --synthetic --strips 8 --pixels 1000 --fps 100 --duration 10
+    # with a late (reordered) frame every 10 frames, as seen on a lossy network
+    ./led_record.py capture.bin --synthetic --late 10
+"""
+
+import argparse
+import colorsys
+import struct
+import time
+
+CAPTURE_MAGIC = b'LSRC'
+CAPTURE_VERSION = 1
+CAPTURE_TOPIC_LED_STRIPS = 0
+CAPTURE_TOPIC_COLOR = 1
+WS2812 = 1
+
+HEADER = struct.Struct('<4sHHHHIQQ')
+RECORD = struct.Struct('<QIBBH')
+STRIP = struct.Struct('<BBBBHH')
+
+
+class CaptureWriter:
+
+    def __init__(self, path, max_strips, max_pixels):
+        self.max_strips = max_strips
+        self.max_strip_size = (3 * max_pixels + 3) // 4 * 4
+        self.record_size = RECORD.size + max_strips * (STRIP.size + self.max_strip_size)
+        self.file = open(path, 'wb')
+        self.start_ns = None
+        self.records = 0
+
+    def write_header(self, start_ns):
+        self.start_ns = start_ns
+        self.file.write(HEADER.pack(CAPTURE_MAGIC, CAPTURE_VERSION, self.max_strips,
+                                    self.max_strip_size, 0, self.record_size, start_ns, 0))
+
+    def write(self, stamp_ns, topic, strips, seq=0, transition_ms=0):
+        """strips is a list of (id, type, color_order, data)"""
+        if self.start_ns is None:
+            self.write_header(stamp_ns)
+        strips = strips[:self.max_strips]
+        record = bytearray(self.record_size)
+        RECORD.pack_into(record, 0, stamp_ns - self.start_ns, seq, topic, len(strips), transition_ms)
+        offset = RECORD.size
+        for channel, led_type, color_order, data in strips:
+            data = bytes(data[:self.max_strip_size])
+            STRIP.pack_into(record, offset, channel, led_type, color_order, 0, len(data), 0)
+            record[offset + STRIP.size:offset + STRIP.size + len(data)] = data
+            offset += STRIP.size + self.max_strip_size
+        self.file.write(record)
+        self.records += 1
+
+    def close(self):
+        # An empty capture is still a capture
+        if self.start_ns is None:
+            self.write_header(time.time_ns())
+        self.file.close()
+
+
+def to_byte(value):
+    return max(0, min(255, int(255 * value)))
+
+
+def record_ros(writer, args):
+    import rclpy
+    from led_strip_msgs.msg import LedStrips
+    from std_msgs.msg import ColorRGBA
+
+    def led_strips_callback(msg):
+        strips = [(s.id, s.type, s.color_order, s.data) for s in msg.strips]
+        writer.write(time.time_ns(), CAPTURE_TOPIC_LED_STRIPS, strips, msg.seq, msg.transition_ms)
+
+    def color_callback(msg):
+        rgb = bytes((to_byte(msg.r), to_byte(msg.g), to_byte(msg.b)))
+        writer.write(time.time_ns(), CAPTURE_TOPIC_COLOR, [(0, WS2812, 0, rgb)])
+
+    rclpy.init()
+    node = rclpy.create_node('led_record')
+    if args.led_strips:
+        node.create_subscription(LedStrips, args.led_strips, led_strips_callback, 10)
+    if args.color:
+        node.create_subscription(ColorRGBA, args.color, color_callback, 10)
+    try:
+        rclpy.spin(node)
+    except KeyboardInterrupt:
+        pass
+    node.destroy_node()
+    rclpy.shutdown()
+
+
+def rainbow(pixels, phase):
+    data = bytearray(3 * pixels)
+    for j in range(pixels):
+        r, g, b = colorsys.hsv_to_rgb((j / pixels + phase) % 1.0, 1.0, 1.0)
+        data[3 * j:3 * j + 3] = bytes((to_byte(r), to_byte(g), to_byte(b)))
+    return data
+
+
+def record_synthetic(writer, args):
+    start_ns = time.time_ns()
+    number_of_frames = int(args.duration * args.fps)
+    for i in range(number_of_frames):
+        stamp_ns = start_ns + int(1e9 * i / args.fps)
+        pixels = rainbow(args.pixels, i / args.fps / 4)
+        strips = [(channel, WS2812, 0, pixels) for channel in range(args.strips)]
+        writer.write(stamp_ns, CAPTURE_TOPIC_LED_STRIPS, strips, i + 1, args.transition_ms)
+        if args.late and i >= 2 and i % args.late == 0:
+            # Frame i - 1 again, overtaken by frame i, with other content and fewer strips
+            late = [(channel, WS2812, 0, rainbow(args.pixels, 0.5)) for channel in range(max(1, args.strips - 1))]
+            writer.write(stamp_ns + int(0.5e9 / args.fps), CAPTURE_TOPIC_LED_STRIPS, late, i, args.transition_ms)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('output')
+    parser.add_argument('--led-strips', default='led_strips', help='LedStrips topic')
+    parser.add_argument('--no-led-strips', dest='led_strips', action='store_const', const=None)
+    parser.add_argument('--color', default='color', help='ColorRGBA topic')
+    parser.add_argument('--no-color', dest='color', action='store_const', const=None)
+    parser.add_argument('--strips', type=int, default=8, help='maximal number of strips per frame')
+    parser.add_argument('--pixels', type=int, default=1000, help='maximal number of pixels per strip')
+    parser.add_argument('--synthetic', action='store_true', help='write generated frames instead of recording')
+    parser.add_argument('--fps', type=float, default=60, help='synthetic frame rate')
+    parser.add_argument('--duration', type=float, default=10, help='synthetic duration in seconds')
+    parser.add_argument('--transition-ms', type=int, default=0, help='synthetic keyframe transition')
+    parser.add_argument('--late', type=int, default=0, help='synthetic late frame every N frames')
+    args = parser.parse_args()
+
+    writer = CaptureWriter(args.output, args.strips, args.pixels)
+    if args.synthetic:
+        record_synthetic(writer, args)
+    else:
+        record_ros(writer, args)
+    writer.close()
+    print(f'{writer.records} records of {writer.record_size} bytes written to {args.output}')
+
+
+if __name__ == '__main__':
+    main()
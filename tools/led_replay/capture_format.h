@@ -0,0 +1,59 @@
+// Binary capture of led_strips / color traffic, written by tools/led_record.py.
+//
+// A capture is a header followed by fixed-size records, so that the file can
+// be mapped and the i-th frame read at `header.record_size * i` after the
+// header. All fields are little endian.
+
+#ifndef CAPTURE_FORMAT_H
+#define CAPTURE_FORMAT_H
+
+#include <stdint.h>
+
+#define CAPTURE_MAGIC "LSRC"
+#define CAPTURE_VERSION 1
+
+typedef enum {
+  CAPTURE_TOPIC_LED_STRIPS = 0,
+  // std_msgs/ColorRGBA, recorded as one strip of a single RGB pixel
+  CAPTURE_TOPIC_COLOR = 1
+} capture_topic_t;
+
+typedef struct {
+  char magic[4];
+  uint16_t version;
+  uint16_t max_strips;
+  // multiple of 4
+  uint16_t max_strip_size;
+  uint16_t reserved;
+  uint32_t record_size;
+  // wall time of the first record
+  uint64_t start_time_ns;
+  uint64_t reserved2;
+} capture_header_t;
+
+typedef struct {
+  uint8_t id;
+  uint8_t type;
+  uint8_t color_order;
+  uint8_t reserved;
+  uint16_t size;
+  uint16_t reserved2;
+  // followed by max_strip_size bytes of data
+} capture_strip_t;
+
+typedef struct {
+  // reception time, relative to start_time_ns
+  uint64_t stamp_ns;
+  uint32_t seq;
+  uint8_t topic;
+  uint8_t number_of_strips;
+  // LedStrips.transition_ms, 0 in older captures
+  uint16_t transition_ms;
+  // followed by max_strips strips
+} capture_record_t;
+
+_Static_assert(sizeof(capture_header_t) == 32, "unexpected capture header size");
+_Static_assert(sizeof(capture_strip_t) == 8, "unexpected capture strip size");
+_Static_assert(sizeof(capture_record_t) == 16, "unexpected capture record size");
+
+#endif /* end of include guard: CAPTURE_FORMAT_H */
@@ -0,0 +1,45 @@
+// Host replacement of the ESP-IDF UART driver used by serial_led_driver_pro.c.
+// The bytes written to the UART are counted and optionally copied to a file
+// and passed to a sink (e.g. tools/pb_emulator, one per UART).
+
+#ifndef HOST_DRIVER_UART_H
+#define HOST_DRIVER_UART_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_ERROR_CHECK(x) ((void) (x))
+
+typedef enum { UART_DATA_8_BITS = 3 } uart_word_length_t;
+typedef enum { UART_PARITY_DISABLE = 0 } uart_parity_t;
+typedef enum { UART_STOP_BITS_1 = 1 } uart_stop_bits_t;
+typedef enum { UART_HW_FLOWCTRL_DISABLE = 0 } uart_hw_flowcontrol_t;
+typedef enum { UART_SCLK_APB = 0 } uart_sclk_t;
+
+#define UART_PIN_NO_CHANGE (-1)
+
+typedef struct {
+  int baud_rate;
+  uart_word_length_t data_bits;
+  uart_parity_t parity;
+  uart_stop_bits_t stop_bits;
+  uart_hw_flowcontrol_t flow_ctrl;
+  uart_sclk_t source_clk;
+} uart_config_t;
+
+esp_err_t uart_driver_install(int uart_num, int rx_buffer_size, int tx_buffer_size,
+                              int queue_size, void *uart_queue, int intr_alloc_flags);
+esp_err_t uart_param_config(int uart_num, const uart_config_t *uart_config);
+esp_err_t uart_set_pin(int uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num);
+int uart_write_bytes(int uart_num, const void *src, size_t size);
+
+// Host only
+uint64_t host_uart_bytes_written(void);
+void host_uart_set_output(FILE *output);
+typedef void (*host_uart_sink_t)(int uart_num, const uint8_t *data, size_t size, void *arg);
+void host_uart_set_sink(host_uart_sink_t sink, void *arg);
+
+#endif /* end of include guard: HOST_DRIVER_UART_H */
@@ -0,0 +1,43 @@
+#include "driver/uart.h"
+
+static uint64_t bytes_written = 0;
+static FILE *output = NULL;
+static host_uart_sink_t sink = NULL;
+static void *sink_arg = NULL;
+
+esp_err_t uart_driver_install(int uart_num, int rx_buffer_size, int tx_buffer_size,
+                              int queue_size, void *uart_queue, int intr_alloc_flags) {
+  return ESP_OK;
+}
+
+esp_err_t uart_param_config(int uart_num, const uart_config_t *uart_config) {
+  return ESP_OK;
+}
+
+esp_err_t uart_set_pin(int uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num) {
+  return ESP_OK;
+}
+
+int uart_write_bytes(int uart_num, const void *src, size_t size) {
+  bytes_written += size;
+  if (output) {
+    fwrite(src, 1, size, output);
+  }
+  if (sink) {
+    sink(uart_num, src, size, sink_arg);
+  }
+  return (int) size;
+}
+
+uint64_t host_uart_bytes_written(void) {
+  return bytes_written;
+}
+
+void host_uart_set_output(FILE *file) {
+  output = file;
+}
+
+void host_uart_set_sink(host_uart_sink_t _sink, void *arg) {
+  sink = _sink;
+  sink_arg = arg;
+}
@@ -0,0 +1,598 @@
+// Replays a capture of led_strips / color traffic (see tools/led_record.py)
+// through the frame logic of ros_led_driver built for the host
+// (components/led_frames: sequence check, coalescing, keyframe transitions,
+// deltas, layers and the per channel settings), the frame pacers and the
+// encoding with pb_set_channel / pb_draw, on one or two outputs.
+//
+// A record is received as rclc receives a LedStrips: deserialized into the
+// buffers of the message first, then passed to the subscription callback.
+// Records of more strips than channels do not fit in the message and are lost.
+//
+// The pacer runs on the recorded time (divided by the speed factor), so the
+// numbers of sent, coalesced and dropped frames do not depend on the host.
+// Only the encoding throughput does.
+//
+// With --check, the emulator of every output must show the last accepted
+// record after each frame (out of transitions), and after the last frame is
+// shown again as for a new brightness.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "capture_format.h"
+#include "driver/uart.h"
+#include "frame_pacer.h"
+#include "led_frames.h"
+#include "pb_emulator.h"
+#include "pixel_delta.h"
+#include "serial_led_driver_pro.h"
+
+// As in ros_led_driver/main
+#define DEFAULT_NUMBER_OF_CHANNELS 8
+#define MAX_NUMBER_OF_OUTPUTS 2
+#define DEFAULT_FREQUENCY 1000000
+#define DEFAULT_BRIGHTNESS 31
+#define DEFAULT_TARGET_FPS 60
+#define LAYERS_COUNT 4
+// Feather wing 8x4
+#define DEFAULT_COLOR_PIXELS 32
+// Period of the task loop when the link takes frames at once
+#define MIN_RENDER_PERIOD_US 1000
+// Color of the --layer region
+#define LAYER_COLOR 0x40
+
+typedef struct {
+  double speed;
+  bool wait;
+  bool pace;
+  uint32_t target_fps;
+  uint16_t color_pixels;
+  uint8_t brightness;
+  const char *output;
+  bool emulate;
+  size_t number_of_channels;
+  uint32_t frequency;
+  uint16_t clock_mask;
+  bool keyframes;
+  uint32_t delta_interval;
+  uint16_t layer_pixels;
+  bool check;
+} options_t;
+
+typedef struct {
+  uint32_t records;
+  // too many strips
+  uint32_t lost;
+  uint32_t frames;
+  uint32_t mismatches;
+  uint64_t pixels;
+  uint64_t bytes[MAX_NUMBER_OF_OUTPUTS];
+  double encode_s;
+} replay_stats_t;
+
+static const capture_header_t *header;
+static const uint8_t *records;
+static size_t number_of_records;
+static options_t options;
+static size_t number_of_outputs;
+static size_t max_strip_length;
+static led_frames_t frames;
+static pb_driver_t drivers[MAX_NUMBER_OF_OUTPUTS];
+static frame_pacer_t pacers[MAX_NUMBER_OF_OUTPUTS];
+static pb_emulator_t *emulators[MAX_NUMBER_OF_OUTPUTS];
+static replay_stats_t stats;
+// Time of the task loop, and of the last frame written
+static int64_t clock_us = 0;
+static int64_t last_write_us = -1;
+// The last accepted record, NULL if none or a color
+static const capture_record_t *accepted = NULL;
+// Deltas: the references of the sender, and the encoded strips
+static uint8_t *sender_references;
+static size_t sender_reference_size[LED_FRAMES_MAX_CHANNELS];
+static uint32_t sender_keyframe_seq = 0;
+static uint32_t deltas_since_keyframe = 0;
+static uint8_t *delta_buffers;
+static size_t delta_capacity;
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static const capture_record_t *get_record(size_t index) {
+  return (const capture_record_t *) (records + index * header->record_size);
+}
+
+static const capture_strip_t *get_strip(const capture_record_t *record, size_t index) {
+  const uint8_t *strips = (const uint8_t *) (record + 1);
+  return (const capture_strip_t *) (strips + index * (sizeof(capture_strip_t) + header->max_strip_size));
+}
+
+static size_t number_of_strips(const capture_record_t *record) {
+  return record->number_of_strips < header->max_strips ? record->number_of_strips : header->max_strips;
+}
+
+static size_t strip_size(const capture_strip_t *strip) {
+  return strip->size < 3 * max_strip_length ? strip->size : 3 * max_strip_length;
+}
+
+static int64_t virtual_time_us(const capture_record_t *record) {
+  return (int64_t) (record->stamp_ns / 1000 / options.speed);
+}
+
+static void *allocate(size_t size) {
+  void *buffer = calloc(1, size ? size : 1);
+  if (!buffer) {
+    fprintf(stderr, "Cannot allocate %zu bytes\n", size);
+    exit(1);
+  }
+  return buffer;
+}
+
+static void init_frames(void) {
+  const size_t buffer_size = options.number_of_channels * 3 * max_strip_length;
+  const led_frames_config_t config = {
+    .number_of_channels = options.number_of_channels,
+    .max_strip_length = max_strip_length,
+    .easing = KEYFRAME_LINEAR,
+    .layers_count = options.layer_pixels ? LAYERS_COUNT : 0,
+    .apa102_frequency = options.frequency,
+    .apa102_clock_mask = options.clock_mask,
+  };
+  led_frames_buffers_t buffers = {
+    .frames = allocate(2 * buffer_size),
+  };
+  if (options.keyframes) {
+    buffers.keyframe_output = allocate(buffer_size);
+    buffers.keyframe_from = allocate(buffer_size);
+  }
+  if (options.delta_interval) {
+    buffers.delta_references = allocate(buffer_size);
+    sender_references = allocate(buffer_size);
+    delta_capacity = PIXEL_DELTA_MAX_SIZE(3 * max_strip_length);
+    delta_buffers = allocate(options.number_of_channels * delta_capacity);
+  }
+  if (options.layer_pixels) {
+    buffers.layers = allocate(options.number_of_channels * LAYERS_COUNT * sizeof(layer_t));
+    buffers.layer_buffers = allocate(options.number_of_channels * LAYERS_COUNT * 4 * max_strip_length);
+    buffers.layer_bases = allocate(buffer_size);
+    buffers.layers_output = allocate(buffer_size);
+  }
+  led_frames_init(&frames, &config, &buffers);
+  for (size_t i = 0; i < options.number_of_channels; i++) {
+    frames.brightness[i] = options.brightness;
+  }
+}
+
+// A status indicator over the first pixels of channel 0
+static void set_layer(void) {
+  static uint8_t rgb[3 * UINT16_MAX];
+  memset(rgb, LAYER_COLOR, 3 * options.layer_pixels);
+  const led_frames_layer_strip_t strip = {0, 1, 0, 0, rgb, 3 * options.layer_pixels, NULL, 0};
+  size_t invalid_strips;
+  led_frames_set_layer(&frames, 0, 0, 0, &strip, 1, &invalid_strips);
+}
+
+static int64_t outputs_wait_us(int64_t now_us) {
+  int64_t wait_us = 0;
+  for (size_t i = 0; i < number_of_outputs; i++) {
+    const int64_t output_wait_us = frame_pacer_wait_us(pacers + i, now_us);
+    if (output_wait_us > wait_us) {
+      wait_us = output_wait_us;
+    }
+  }
+  return wait_us;
+}
+
+// As write_frame in ros_led_driver/main/main.c, the outputs one after the other
+static void write_frame(const led_frames_strip_t *strips, size_t count, int64_t now_us) {
+  const double start = now_s();
+  led_frames_begin_write(&frames, strips, count);
+  for (size_t i = 0; i < number_of_outputs; i++) {
+    const size_t size = led_frames_write_output(&frames, i, drivers + i);
+    frame_pacer_sent(pacers + i, size, now_us);
+    stats.bytes[i] += size;
+  }
+  stats.encode_s += now_s() - start;
+  for (size_t i = 0; i < count; i++) {
+    stats.pixels += strips[i].size / 3;
+  }
+  stats.frames++;
+  last_write_us = now_us;
+}
+
+// What channel `id` should show for a strip of the accepted record
+static bool shows(const pb_emulator_channel_t *channel, uint8_t id, const capture_strip_t *strip) {
+  if (options.clock_mask & (1 << id)) {
+    return channel->type == CHANNEL_APA102_CLOCK && channel->frequency == options.frequency;
+  }
+  const channel_type_t type = strip->type == 0 ? CHANNEL_APA102_DATA : CHANNEL_WS2812;
+  const color_orders_t color_orders = strip->color_order == 0 ? RGB : BGR;
+  const size_t stride = type == CHANNEL_APA102_DATA ? 4 : 3;
+  const uint8_t *data = (const uint8_t *) (strip + 1);
+  const size_t pixels = strip_size(strip) / 3;
+  // The layer covers the first pixels of channel 0
+  const size_t layer_pixels = id == 0 ? options.layer_pixels : 0;
+  const size_t expected_pixels = pixels > layer_pixels ? pixels : layer_pixels;
+  if (channel->type != type || channel->pixels != expected_pixels || channel->num_elements != stride ||
+      channel->color_orders != color_orders.color_orders ||
+      (type == CHANNEL_APA102_DATA && channel->frequency != options.frequency)) {
+    return false;
+  }
+  const uint8_t index[3] = {
+    color_orders.components.redi, color_orders.components.greeni, color_orders.components.bluei
+  };
+  for (size_t i = 0; i < expected_pixels; i++) {
+    const uint8_t *out = channel->framebuffer + i * stride;
+    for (size_t j = 0; j < 3; j++) {
+      const uint8_t value = i < layer_pixels ? LAYER_COLOR : data[3 * i + j];
+      if (out[index[j]] != value) {
+        return false;
+      }
+    }
+    if (type == CHANNEL_APA102_DATA && out[3] != (options.brightness & 0x1f)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void check_accepted(void) {
+  if (!options.check || !accepted || frames.transition.active) {
+    return;
+  }
+  for (size_t i = 0; i < number_of_strips(accepted); i++) {
+    const capture_strip_t *strip = get_strip(accepted, i);
+    if (strip->id >= options.number_of_channels) {
+      continue;
+    }
+    const pb_emulator_t *emulator = emulators[strip->id / PB_NUMBER_OF_CHANNELS];
+    if (!shows(pb_emulator_get_channel(emulator, strip->id % PB_NUMBER_OF_CHANNELS), strip->id, strip)) {
+      if (stats.mismatches++ < 5) {
+        fprintf(stderr, "frame %u: channel %u does not show frame %u\n", stats.frames, strip->id, accepted->seq);
+      }
+    }
+  }
+}
+
+// As show_pending_frame in ros_led_driver/main/main.c
+static void show_pending_frame(int64_t now_us) {
+  led_frames_strip_t strips[LED_FRAMES_MAX_CHANNELS];
+  const size_t count = led_frames_render(&frames, now_us, strips);
+  write_frame(strips, count, now_us);
+  check_accepted();
+}
+
+// Mirrors the loop of the micro-ROS task until `until_us`: the pending frame
+// is shown as soon as the pacers allow it, and rendered again until the end
+// of its transition.
+static void run_until(int64_t until_us) {
+  while (frames.pending) {
+    int64_t at_us = clock_us + (options.pace ? outputs_wait_us(clock_us) : 0);
+    if (at_us <= last_write_us) {
+      at_us = last_write_us + MIN_RENDER_PERIOD_US;
+    }
+    if (at_us > until_us) {
+      break;
+    }
+    clock_us = at_us;
+    show_pending_frame(clock_us);
+  }
+  if (until_us > clock_us) {
+    clock_us = until_us;
+  }
+}
+
+// Encodes the strips as a LedStripsDelta against the last keyframe sent,
+// every delta_interval records a keyframe.
+static bool receive_delta(const capture_record_t *record, int64_t now_us) {
+  const size_t count = number_of_strips(record);
+  bool keyframe = !sender_keyframe_seq || deltas_since_keyframe + 1 >= options.delta_interval;
+  for (size_t i = 0; i < count && !keyframe; i++) {
+    const capture_strip_t *strip = get_strip(record, i);
+    keyframe = strip->id < options.number_of_channels && strip_size(strip) != sender_reference_size[strip->id];
+  }
+  if (keyframe) {
+    sender_keyframe_seq = record->seq;
+    deltas_since_keyframe = 0;
+    memset(sender_reference_size, 0, sizeof(sender_reference_size));
+  } else {
+    deltas_since_keyframe++;
+  }
+  led_frames_delta_t strips[LED_FRAMES_MAX_CHANNELS];
+  for (size_t i = 0; i < count; i++) {
+    const capture_strip_t *strip = get_strip(record, i);
+    const size_t size = strip_size(strip);
+    const uint8_t *data = (const uint8_t *) (strip + 1);
+    uint8_t *delta = delta_buffers + i * delta_capacity;
+    size_t delta_size = 0;
+    if (strip->id < options.number_of_channels) {
+      uint8_t *reference = sender_references + strip->id * 3 * max_strip_length;
+      delta_size = pixel_delta_encode(delta, delta_capacity, data, keyframe ? NULL : reference, size);
+      if (keyframe) {
+        memcpy(reference, data, size);
+        sender_reference_size[strip->id] = size;
+      }
+    }
+    strips[i] = (led_frames_delta_t) {strip->id, strip->type, strip->color_order, size, delta, delta_size};
+  }
+  size_t invalid_strips;
+  return led_frames_receive_delta(&frames, record->seq, sender_keyframe_seq, record->transition_ms,
+                                  strips, count, now_us, &invalid_strips);
+}
+
+// As subscription_callback in ros_led_driver/main/main.c, after rclc
+// deserialized the record into the message
+static bool receive(const capture_record_t *record, int64_t now_us) {
+  led_frames_strip_t strips[LED_FRAMES_MAX_CHANNELS];
+  const size_t count = number_of_strips(record);
+  for (size_t i = 0; i < count; i++) {
+    const capture_strip_t *strip = get_strip(record, i);
+    uint8_t *data = led_frames_receive_buffer(&frames, i);
+    size_t size = strip_size(strip);
+    if (record->topic == CAPTURE_TOPIC_COLOR && size >= 3) {
+      // A color sets the whole strip
+      for (size_t j = 1; j < options.color_pixels && j < max_strip_length; j++) {
+        memcpy(data + 3 * j, strip + 1, 3);
+      }
+      memcpy(data, strip + 1, 3);
+      size = 3 * (options.color_pixels < max_strip_length ? options.color_pixels : max_strip_length);
+    } else {
+      memcpy(data, strip + 1, size);
+    }
+    strips[i] = (led_frames_strip_t) {strip->id, strip->type, strip->color_order, data, size};
+  }
+  return led_frames_receive(&frames, record->seq, record->transition_ms, strips, count, now_us);
+}
+
+static void wait_until(double start, const capture_record_t *record) {
+  const double deadline = start + 1e-9 * record->stamp_ns / options.speed;
+  double remaining;
+  while ((remaining = deadline - now_s()) > 0) {
+    struct timespec ts = {
+      .tv_sec = (time_t) remaining,
+      .tv_nsec = (long) ((remaining - (time_t) remaining) * 1e9),
+    };
+    nanosleep(&ts, NULL);
+  }
+}
+
+static void replay(void) {
+  const double start = now_s();
+  if (options.layer_pixels) {
+    set_layer();
+  }
+  for (size_t i = 0; i < number_of_records; i++) {
+    const capture_record_t *record = get_record(i);
+    const int64_t time_us = virtual_time_us(record);
+    if (options.wait) {
+      wait_until(start, record);
+    }
+    stats.records++;
+    run_until(time_us);
+    if (number_of_strips(record) > options.number_of_channels) {
+      stats.lost++;
+      continue;
+    }
+    const bool is_delta = options.delta_interval && record->topic == CAPTURE_TOPIC_LED_STRIPS && record->seq;
+    const bool received = is_delta ? receive_delta(record, time_us) : receive(record, time_us);
+    if (received) {
+      // Colors are checked by the encoder checks only
+      accepted = record->topic == CAPTURE_TOPIC_LED_STRIPS ? record : NULL;
+    }
+    run_until(time_us);
+  }
+  run_until(INT64_MAX);
+  // A new brightness or channel configuration
+  led_frames_show_again(&frames);
+  run_until(INT64_MAX);
+}
+
+static int map_capture(const char *path) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(capture_header_t)) {
+    fprintf(stderr, "%s is not a capture\n", path);
+    close(fd);
+    return -1;
+  }
+  const uint8_t *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "Cannot map %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  header = (const capture_header_t *) data;
+  const size_t min_record_size = sizeof(capture_record_t) +
+      (size_t) header->max_strips * (sizeof(capture_strip_t) + header->max_strip_size);
+  if (memcmp(header->magic, CAPTURE_MAGIC, 4) || header->version != CAPTURE_VERSION ||
+      header->max_strip_size % 4 || header->record_size < min_record_size) {
+    fprintf(stderr, "%s is not a capture of version %d\n", path, CAPTURE_VERSION);
+    return -1;
+  }
+  records = data + sizeof(capture_header_t);
+  number_of_records = (st.st_size - sizeof(capture_header_t)) / header->record_size;
+  return 0;
+}
+
+static void feed_emulator(int uart_num, const uint8_t *data, size_t size, void *arg) {
+  pb_emulator_feed(emulators[uart_num], data, size);
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [options] CAPTURE\n"
+          "  -s, --speed N         replay N times faster than recorded (default 1)\n"
+          "  -m, --max             replay as fast as possible, keeping the recorded timing for the pacer\n"
+          "  -f, --fps N           target frame rate of the pacer, 0 for link limited (default %d)\n"
+          "  -n, --no-pacer        encode every frame\n"
+          "  -p, --color-pixels N  number of pixels set by a color record (default %d)\n"
+          "  -b, --brightness N    APA102 brightness, 0..31 (default %d)\n"
+          "  -c, --channels N      MAX_NUMBER_OF_CHANNELS, 8 per output, at most %d (default %d)\n"
+          "  -F, --frequency HZ    APA102 frequency (default %d)\n"
+          "  -k, --clock MASK      channels outputting the APA102 clock (APA102_CLOCK_CHANNELS)\n"
+          "  -t, --keyframes       blend between frames over their transition_ms (KEYFRAME_ENABLE)\n"
+          "  -d, --delta N         send the frames as deltas, a keyframe every N (DELTA_ENABLE)\n"
+          "  -l, --layer N         an opaque layer over the first N pixels of channel 0 (LAYERS_ENABLE)\n"
+          "  -o, --output FILE     write the bytes sent to the first output to FILE\n"
+          "  -e, --emulate         check the bytes sent with the driver emulator (tools/pb_emulator)\n"
+          "  -C, --check           fail if the emulators do not show the last accepted frame\n",
+          name, DEFAULT_TARGET_FPS, DEFAULT_COLOR_PIXELS, DEFAULT_BRIGHTNESS,
+          LED_FRAMES_MAX_CHANNELS, DEFAULT_NUMBER_OF_CHANNELS, DEFAULT_FREQUENCY);
+}
+
+int main(int argc, char **argv) {
+  options = (options_t) {
+    .speed = 1.0,
+    .wait = true,
+    .pace = true,
+    .target_fps = DEFAULT_TARGET_FPS,
+    .color_pixels = DEFAULT_COLOR_PIXELS,
+    .brightness = DEFAULT_BRIGHTNESS,
+    .output = NULL,
+    .emulate = false,
+    .number_of_channels = DEFAULT_NUMBER_OF_CHANNELS,
+    .frequency = DEFAULT_FREQUENCY,
+  };
+  static const struct option long_options[] = {
+    {"speed", required_argument, NULL, 's'},
+    {"max", no_argument, NULL, 'm'},
+    {"fps", required_argument, NULL, 'f'},
+    {"no-pacer", no_argument, NULL, 'n'},
+    {"color-pixels", required_argument, NULL, 'p'},
+    {"brightness", required_argument, NULL, 'b'},
+    {"channels", required_argument, NULL, 'c'},
+    {"frequency", required_argument, NULL, 'F'},
+    {"clock", required_argument, NULL, 'k'},
+    {"keyframes", no_argument, NULL, 't'},
+    {"delta", required_argument, NULL, 'd'},
+    {"layer", required_argument, NULL, 'l'},
+    {"output", required_argument, NULL, 'o'},
+    {"emulate", no_argument, NULL, 'e'},
+    {"check", no_argument, NULL, 'C'},
+    {NULL, 0, NULL, 0},
+  };
+  int c;
+  while ((c = getopt_long(argc, argv, "s:mf:np:b:c:F:k:td:l:o:eC", long_options, NULL)) != -1) {
+    switch (c) {
+      case 's': options.speed = atof(optarg); break;
+      case 'm': options.wait = false; break;
+      case 'f': options.target_fps = atoi(optarg); break;
+      case 'n': options.pace = false; break;
+      case 'p': options.color_pixels = atoi(optarg); break;
+      case 'b': options.brightness = atoi(optarg); break;
+      case 'c': options.number_of_channels = atoi(optarg); break;
+      case 'F': options.frequency = atol(optarg); break;
+      case 'k': options.clock_mask = strtol(optarg, NULL, 0); break;
+      case 't': options.keyframes = true; break;
+      case 'd': options.delta_interval = atoi(optarg); break;
+      case 'l': options.layer_pixels = atoi(optarg); break;
+      case 'o': options.output = optarg; break;
+      case 'e': options.emulate = true; break;
+      case 'C': options.check = options.emulate = true; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (optind != argc - 1 || options.speed <= 0 || options.brightness > 31 || options.frequency == 0 ||
+      options.number_of_channels < 1 || options.number_of_channels > LED_FRAMES_MAX_CHANNELS ||
+      options.color_pixels > UINT16_MAX / 3) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (map_capture(argv[optind]) < 0) {
+    return 1;
+  }
+  number_of_outputs = (options.number_of_channels + PB_NUMBER_OF_CHANNELS - 1) / PB_NUMBER_OF_CHANNELS;
+  max_strip_length = header->max_strip_size / 3;
+  if (options.color_pixels > max_strip_length) {
+    max_strip_length = options.color_pixels;
+  }
+  if (options.layer_pixels > max_strip_length) {
+    options.layer_pixels = max_strip_length;
+  }
+  FILE *output = NULL;
+  if (options.output) {
+    output = fopen(options.output, "wb");
+    if (!output) {
+      fprintf(stderr, "Cannot open %s: %s\n", options.output, strerror(errno));
+      return 1;
+    }
+    host_uart_set_output(output);
+  }
+  if (options.emulate) {
+    for (size_t i = 0; i < number_of_outputs; i++) {
+      emulators[i] = pb_emulator_new(PB_BAUD_RATE);
+    }
+    host_uart_set_sink(feed_emulator, NULL);
+  }
+
+  init_frames();
+  for (size_t i = 0; i < number_of_outputs; i++) {
+    pb_init(drivers + i, i, 0);
+    frame_pacer_init(pacers + i, PB_BAUD_RATE, options.target_fps, PB_TX_BUFFER_SIZE, 0);
+  }
+  const double start = now_s();
+  replay();
+  const double wall_s = now_s() - start;
+  if (output) {
+    fclose(output);
+  }
+
+  const double duration_s = number_of_records ?
+      1e-9 * get_record(number_of_records - 1)->stamp_ns / options.speed : 0;
+  const uint64_t bytes = host_uart_bytes_written();
+  // The frames go to all the outputs: report the busiest link
+  double utilisation = 0;
+  for (size_t i = 0; i < number_of_outputs; i++) {
+    const double wire_s = 1e-6 * frame_pacer_wire_time_us(pacers + i, stats.bytes[i]);
+    // The last frames may still be on the wire at the end of the capture
+    const double link_s = 1e-6 * pacers[i].link_free_at_us > duration_s ? 1e-6 * pacers[i].link_free_at_us : duration_s;
+    if (link_s > 0 && wire_s / link_s > utilisation) {
+      utilisation = wire_s / link_s;
+    }
+  }
+  printf("records           %u in %.3f s (replayed in %.3f s)\n", stats.records, duration_s, wall_s);
+  printf("frames sent       %u (%.1f fps)\n", stats.frames, duration_s > 0 ? stats.frames / duration_s : 0);
+  printf("dropped or late   %u\n", frames.dropped_frames);
+  if (stats.lost) {
+    printf("too many strips   %u\n", stats.lost);
+  }
+  printf("coalesced         %u\n", frames.coalesced_frames);
+  printf("bytes to driver   %llu on %zu output%s\n", (unsigned long long) bytes, number_of_outputs,
+         number_of_outputs > 1 ? "s" : "");
+  printf("link utilisation  %.1f %%\n", 100 * utilisation);
+  printf("encoding          %.1f frames/s, %.1f Mpixels/s, %.1f MB/s\n",
+         stats.encode_s > 0 ? stats.frames / stats.encode_s : 0,
+         stats.encode_s > 0 ? 1e-6 * stats.pixels / stats.encode_s : 0,
+         stats.encode_s > 0 ? 1e-6 * bytes / stats.encode_s : 0);
+  for (size_t i = 0; i < number_of_outputs && options.emulate; i++) {
+    pb_emulator_stats_t emulated;
+    pb_emulator_get_stats(emulators[i], &emulated);
+    printf("emulator %zu        %u draws, %u crc, %u invalid, %u brightness errors, %u bytes skipped\n",
+           i, emulated.draws, emulated.crc_errors, emulated.invalid_records,
+           emulated.brightness_errors, emulated.skipped_bytes);
+    printf("emulated leds %zu   %.1f fps max\n",
+           i, emulated.led_time_us > 0 ? 1e6 * emulated.draws / emulated.led_time_us : 0);
+    pb_emulator_free(emulators[i]);
+  }
+  if (options.check) {
+    printf("check             %u frames %s\n", stats.frames, stats.mismatches ? "FAILED" : "passed");
+  }
+  return stats.mismatches ? 1 : 0;
+}
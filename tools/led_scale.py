@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+"""
+Scale-out test: N simulated ros_led_driver boards (tools/led_node_sim) against
+one micro-ROS agent over loopback UDP, driven by one shared publisher.
+
+For each number of nodes, the script
+    1. starts the agent and N nodes at once (as after a power cut) and measures
+       the time until every node shows a frame (cold start),
+    2. publishes LedStrips on /led_strips and measures per node the latency
+       from publication to the echo on /led_<i>/shown_frames and the loss,
+       and the CPU used by the agent,
+    3. restarts the agent and measures the time until every node shows frames
+       again (reconnection).
+
+Build led_node_sim in a micro-ROS host workspace (micro_ros_setup, platform
+host) next to led_strip_msgs, with its colcon.meta so that the largest frames
+fit in the reliable input stream, and source it:
+
+    colcon build --metas <this repository>/tools/led_node_sim/colcon.meta
+
+then:
+
+    ./led_scale.py --nodes 1 2 4 8 16 32 --pixels 300 --rate 30
+"""
+
+import argparse
+import os
+import shlex
+import signal
+import statistics
+import subprocess
+import time
+
+
+def percentile(values, p):
+    if not values:
+        return float('nan')
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p * len(values)))]
+
+
+class AgentProcess:
+
+    def __init__(self, command, port):
+        self.command = shlex.split(command.format(port=port))
+        self.process = None
+
+    def start(self):
+        self.process = subprocess.Popen(self.command, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    def stop(self):
+        if self.process:
+            self.process.send_signal(signal.SIGINT)
+            try:
+                self.process.wait(5)
+            except subprocess.TimeoutExpired:
+                self.process.kill()
+                self.process.wait()
+            self.process = None
+
+    def cpu_seconds(self):
+        """user + system time of the agent, from /proc"""
+        with open(f'/proc/{self.process.pid}/stat') as f:
+            fields = f.read().rsplit(')', 1)[1].split()
+        return (int(fields[11]) + int(fields[12])) / os.sysconf('SC_CLK_TCK')
+
+
+class Harness:
+
+    def __init__(self, node, args, number_of_nodes):
+        from led_strip_msgs.msg import LedStrip, LedStrips
+        from rclpy.qos import QoSProfile, ReliabilityPolicy, qos_profile_sensor_data
+        from std_msgs.msg import UInt32
+
+        self.node = node
+        self.args = args
+        self.number_of_nodes = number_of_nodes
+        self.seq = 0
+        self.sent_at = {}
+        self.latencies = [[] for _ in range(number_of_nodes)]
+        self.shown = [0] * number_of_nodes
+        self.last_shown_at = [None] * number_of_nodes
+        self.first_seq = 1
+        self.frame = LedStrips()
+        for i in range(args.strips):
+            strip = LedStrip()
+            strip.id = i
+            strip.type = LedStrip.WS2812
+            strip.data = bytes(3 * args.pixels)
+            self.frame.strips.append(strip)
+        # Reliable, as the nodes: best effort frames larger than the MTU are lost
+        self.publisher = node.create_publisher(
+            LedStrips, '/led_strips', QoSProfile(depth=1, reliability=ReliabilityPolicy.RELIABLE))
+        self.subscriptions = [
+            node.create_subscription(UInt32, f'/led_{i}/shown_frames',
+                                     lambda msg, i=i: self.on_shown(i, msg.data), qos_profile_sensor_data)
+            for i in range(number_of_nodes)]
+
+    def on_shown(self, index, seq):
+        now = time.monotonic()
+        self.last_shown_at[index] = now
+        if seq >= self.first_seq and seq in self.sent_at:
+            self.latencies[index].append(1e3 * (now - self.sent_at[seq]))
+            self.shown[index] += 1
+
+    def publish(self):
+        self.seq += 1
+        self.frame.seq = self.seq
+        self.sent_at[self.seq] = time.monotonic()
+        self.publisher.publish(self.frame)
+
+    def run(self, duration, until=None):
+        """Publishes at the rate for the duration, or until `until()` is true"""
+        import rclpy
+        period = 1.0 / self.args.rate
+        start = time.monotonic()
+        next_at = start
+        while time.monotonic() - start < duration:
+            if until and until():
+                break
+            now = time.monotonic()
+            if now >= next_at:
+                self.publish()
+                next_at += period
+            rclpy.spin_once(self.node, timeout_sec=max(0.0, next_at - time.monotonic()))
+        return time.monotonic() - start
+
+    def drain(self, duration):
+        """Receives the late echoes without publishing"""
+        import rclpy
+        end = time.monotonic() + duration
+        while time.monotonic() < end:
+            rclpy.spin_once(self.node, timeout_sec=end - time.monotonic())
+
+    def time_until_all_shown(self, since, timeout):
+        """Seconds per node from `since` to the first echo after it"""
+        self.last_shown_at = [None] * self.number_of_nodes
+        self.run(timeout, until=lambda: all(t is not None for t in self.last_shown_at))
+        return [t - since if t is not None else float('nan') for t in self.last_shown_at]
+
+    def reset_counters(self):
+        self.latencies = [[] for _ in range(self.number_of_nodes)]
+        self.shown = [0] * self.number_of_nodes
+        self.first_seq = self.seq + 1
+
+
+def start_nodes(args, number_of_nodes):
+    command = shlex.split(args.node_command)
+    options = ['--ip', '127.0.0.1', '--port', str(args.port), '--channels', str(args.strips),
+               '--pixels', str(args.pixels)]
+    return [subprocess.Popen(command + options + ['--index', str(i)],
+                             stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+            for i in range(number_of_nodes)]
+
+
+def stop_nodes(nodes):
+    for node in nodes:
+        node.terminate()
+    for node in nodes:
+        node.wait()
+
+
+def summary(times):
+    valid = [t for t in times if t == t]
+    missing = len(times) - len(valid)
+    text = f'p50 {1e3 * percentile(valid, 0.5):.0f} ms, max {1e3 * max(valid, default=float("nan")):.0f} ms'
+    return text + (f', {missing} never' if missing else '')
+
+
+def measure(node, args, number_of_nodes):
+    agent = AgentProcess(args.agent_command, args.port)
+    harness = Harness(node, args, number_of_nodes)
+    agent.start()
+    power_on = time.monotonic()
+    nodes = start_nodes(args, number_of_nodes)
+    try:
+        cold_start = harness.time_until_all_shown(power_on, args.timeout)
+
+        harness.reset_counters()
+        cpu_start = agent.cpu_seconds()
+        elapsed = harness.run(args.duration)
+        agent_cpu = (agent.cpu_seconds() - cpu_start) / elapsed
+        sent = harness.seq - harness.first_seq + 1
+        harness.drain(args.drain)
+        latencies = harness.latencies
+        shown = harness.shown
+        harness.reset_counters()
+
+        agent.stop()
+        time.sleep(args.outage)
+        agent.start()
+        reconnect = harness.time_until_all_shown(time.monotonic(), args.timeout)
+    finally:
+        stop_nodes(nodes)
+        agent.stop()
+
+    per_node_p50 = [percentile(lat, 0.5) for lat in latencies if lat]
+    all_latencies = [x for lat in latencies for x in lat]
+    loss = [100.0 * (sent - n) / sent for n in shown] if sent else [0]
+    print(f'nodes {number_of_nodes}')
+    print(f'  cold start        {summary(cold_start)}')
+    print(f'  latency           p50 {percentile(all_latencies, 0.5):.1f} ms, '
+          f'p99 {percentile(all_latencies, 0.99):.1f} ms, '
+          f'worst node p50 {max(per_node_p50, default=float("nan")):.1f} ms')
+    print(f'  loss              mean {statistics.mean(loss):.1f} %, worst node {max(loss):.1f} %')
+    print(f'  agent cpu         {100 * agent_cpu:.0f} %')
+    print(f'  reconnect         {summary(reconnect)} (agent down for {args.outage:.1f} s)')
+    return harness
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--nodes', type=int, nargs='+', default=[1, 2, 4, 8, 16])
+    parser.add_argument('--strips', type=int, default=1, help='strips per frame')
+    parser.add_argument('--pixels', type=int, default=100, help='pixels per strip')
+    parser.add_argument('--rate', type=float, default=30, help='frames per second')
+    parser.add_argument('--duration', type=float, default=10, help='measurement per number of nodes, in seconds')
+    parser.add_argument('--drain', type=float, default=1, help='time to wait for late echoes, in seconds')
+    parser.add_argument('--outage', type=float, default=2, help='time the agent is down, in seconds')
+    parser.add_argument('--timeout', type=float, default=30, help='max time to wait for the nodes, in seconds')
+    parser.add_argument('--port', type=int, default=8888)
+    parser.add_argument('--agent-command', default='ros2 run micro_ros_agent micro_ros_agent udp4 --port {port}')
+    parser.add_argument('--node-command', default='ros2 run led_node_sim led_node_sim')
+    args = parser.parse_args()
+    if not 1 <= args.strips <= 16:
+        parser.error('--strips must be between 1 and 16')
+
+    import rclpy
+    rclpy.init()
+    node = rclpy.create_node('led_scale')
+    for number_of_nodes in args.nodes:
+        harness = measure(node, args, number_of_nodes)
+        node.destroy_publisher(harness.publisher)
+        for subscription in harness.subscriptions:
+            node.destroy_subscription(subscription)
+    node.destroy_node()
+    rclpy.shutdown()
+
+
+if __name__ == '__main__':
+    main()
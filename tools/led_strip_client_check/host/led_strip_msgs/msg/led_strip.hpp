@@ -0,0 +1,31 @@
+// Host replacement of the generated led_strip_msgs/msg/LedStrip, for
+// tools/led_strip_client_check: the fields and constants of LedStrip.msg.
+
+#ifndef HOST_LED_STRIP_MSGS__MSG__LED_STRIP_HPP_
+#define HOST_LED_STRIP_MSGS__MSG__LED_STRIP_HPP_
+
+#include <cstdint>
+#include <vector>
+
+namespace led_strip_msgs
+{
+namespace msg
+{
+
+struct LedStrip
+{
+  static constexpr uint8_t RGB = 0;
+  static constexpr uint8_t BGR = 1;
+  static constexpr uint8_t APA102 = 0;
+  static constexpr uint8_t WS2812 = 1;
+
+  uint8_t color_order = 0;
+  uint8_t type = 0;
+  uint8_t id = 0;
+  std::vector<uint8_t> data;
+};
+
+}  // namespace msg
+}  // namespace led_strip_msgs
+
+#endif  // HOST_LED_STRIP_MSGS__MSG__LED_STRIP_HPP_
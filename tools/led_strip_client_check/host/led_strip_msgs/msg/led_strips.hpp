@@ -0,0 +1,27 @@
+// Host replacement of the generated led_strip_msgs/msg/LedStrips, for
+// tools/led_strip_client_check: the fields of LedStrips.msg.
+
+#ifndef HOST_LED_STRIP_MSGS__MSG__LED_STRIPS_HPP_
+#define HOST_LED_STRIP_MSGS__MSG__LED_STRIPS_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "led_strip_msgs/msg/led_strip.hpp"
+
+namespace led_strip_msgs
+{
+namespace msg
+{
+
+struct LedStrips
+{
+  std::vector<LedStrip> strips;
+  uint32_t seq = 0;
+  uint16_t transition_ms = 0;
+};
+
+}  // namespace msg
+}  // namespace led_strip_msgs
+
+#endif  // HOST_LED_STRIP_MSGS__MSG__LED_STRIPS_HPP_
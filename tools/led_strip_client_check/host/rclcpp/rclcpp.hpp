@@ -0,0 +1,119 @@
+// Host replacement of the parts of rclcpp used by led_strip_client, for
+// tools/led_strip_client_check. Nothing is sent: a publisher keeps the last
+// message it was given, and the timers run when the check calls
+// Node::run_timers, as an executor would when they are due.
+
+#ifndef HOST_RCLCPP__RCLCPP_HPP_
+#define HOST_RCLCPP__RCLCPP_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rclcpp
+{
+
+class QoS
+{
+public:
+  explicit QoS(size_t depth)
+  : depth_(depth) {}
+  QoS & reliable() {return *this;}
+  QoS & best_effort() {return *this;}
+  size_t depth() const {return depth_;}
+
+private:
+  size_t depth_;
+};
+
+template<typename MessageT>
+class Publisher
+{
+public:
+  using SharedPtr = std::shared_ptr<Publisher>;
+
+  // Keeps the message, without copying it
+  void publish(const MessageT & message)
+  {
+    last_message = &message;
+    last_seq = message.seq;
+    count++;
+  }
+
+  const MessageT * last_message = nullptr;
+  uint32_t last_seq = 0;
+  size_t count = 0;
+};
+
+class TimerBase
+{
+public:
+  using SharedPtr = std::shared_ptr<TimerBase>;
+
+  TimerBase(std::chrono::nanoseconds period, std::function<void()> callback)
+  : period(period), callback(std::move(callback)) {}
+
+  void cancel() {canceled_ = true;}
+  void reset() {canceled_ = false;}
+  bool is_canceled() const {return canceled_;}
+
+  const std::chrono::nanoseconds period;
+  const std::function<void()> callback;
+
+private:
+  bool canceled_ = false;
+};
+
+class Node
+{
+public:
+  explicit Node(const std::string & name)
+  : name_(name) {}
+
+  template<typename MessageT>
+  typename Publisher<MessageT>::SharedPtr create_publisher(const std::string & topic, const QoS & qos)
+  {
+    (void) topic;
+    (void) qos;
+    auto publisher = std::make_shared<Publisher<MessageT>>();
+    last_publisher = publisher;
+    return publisher;
+  }
+
+  template<typename DurationT, typename CallbackT>
+  TimerBase::SharedPtr create_wall_timer(DurationT period, CallbackT callback)
+  {
+    auto timer = std::make_shared<TimerBase>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(period), callback);
+    timers_.push_back(timer);
+    return timer;
+  }
+
+  // Calls the timers that are not canceled. Returns their number.
+  size_t run_timers()
+  {
+    size_t number = 0;
+    for (auto & timer : timers_) {
+      if (!timer->is_canceled()) {
+        timer->callback();
+        number++;
+      }
+    }
+    return number;
+  }
+
+  // The last publisher created, a Publisher<MessageT>
+  std::shared_ptr<void> last_publisher;
+
+private:
+  std::string name_;
+  std::vector<TimerBase::SharedPtr> timers_;
+};
+
+}  // namespace rclcpp
+
+#endif  // HOST_RCLCPP__RCLCPP_HPP_
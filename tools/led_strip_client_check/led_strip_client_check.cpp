@@ -0,0 +1,181 @@
+// Checks the led_strip_client library against the rclcpp and led_strip_msgs
+// stubs of host/, without ROS 2: the layout of the frames, the change
+// detection, the seq numbering, the rate limit with and without coalescing,
+// and that publishing does not allocate (operator new and malloc counted).
+// The timers run when the check calls them, as an executor would.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "led_strip_msgs/msg/led_strips.hpp"
+#include "led_strip_client/frame.hpp"
+#include "led_strip_client/frame_publisher.hpp"
+
+using led_strip_client::Frame;
+using led_strip_client::FramePublisher;
+using led_strip_client::PublisherOptions;
+using led_strip_client::PublishResult;
+using led_strip_client::Rgb;
+using led_strip_client::StripConfig;
+using LedStripsPublisher = rclcpp::Publisher<led_strip_msgs::msg::LedStrips>;
+
+static std::atomic<size_t> allocations{0};
+
+void * operator new(size_t size)
+{
+  allocations++;
+  void * pointer = malloc(size ? size : 1);
+  if (!pointer) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void * pointer) noexcept
+{
+  free(pointer);
+}
+
+void operator delete(void * pointer, size_t) noexcept
+{
+  free(pointer);
+}
+
+static bool report(const char * name, bool ok)
+{
+  printf("%-18s%s\n", name, ok ? "passed" : "FAILED");
+  return ok;
+}
+
+static const std::vector<StripConfig> strips = {
+  {0, 10},
+  {3, 5, led_strip_msgs::msg::LedStrip::APA102, led_strip_msgs::msg::LedStrip::BGR},
+};
+
+// The pixels land in LedStrip.data, in RGB order, and the strips keep their configuration
+static bool check_layout()
+{
+  Frame frame(strips);
+  bool ok = frame.number_of_strips() == 2 && frame.pixels(0).size() == 10 &&
+    frame.pixels(1).size() == 5 && frame.bytes(1).size() == 15;
+  frame.pixels(1)[2] = Rgb{1, 2, 3};
+  const auto & strip = frame.message().strips[1];
+  ok = ok && strip.id == 3 && strip.type == led_strip_msgs::msg::LedStrip::APA102 &&
+    strip.color_order == led_strip_msgs::msg::LedStrip::BGR &&
+    strip.data[6] == 1 && strip.data[7] == 2 && strip.data[8] == 3;
+  frame.pixels(0).fill(Rgb{9, 9, 9});
+  frame.clear();
+  for (uint8_t byte : frame.bytes(0)) {
+    ok = ok && !byte;
+  }
+  return report("layout", ok);
+}
+
+// Unchanged frames are skipped, the others numbered from 1
+static bool check_changes()
+{
+  rclcpp::Node node("check");
+  FramePublisher publisher(node, "led_strips", rclcpp::QoS(1));
+  auto & sent = *std::static_pointer_cast<LedStripsPublisher>(node.last_publisher);
+  Frame frame(strips);
+  bool ok = publisher.publish(frame) == PublishResult::published && sent.last_seq == 1 &&
+    sent.last_message == &frame.message();
+  ok = ok && publisher.publish(frame) == PublishResult::unchanged;
+  frame.pixels(1)[4].g = 1;
+  ok = ok && publisher.publish(frame) == PublishResult::published && sent.last_seq == 2;
+  frame.set_transition_ms(100);
+  ok = ok && publisher.publish(frame) == PublishResult::published && sent.last_seq == 3;
+  frame.invalidate();
+  ok = ok && publisher.publish(frame) == PublishResult::published && sent.last_seq == 4;
+  ok = ok && publisher.stats().published == 4 && publisher.stats().unchanged == 1 && sent.count == 4;
+  return report("changes", ok);
+}
+
+// A frame held back by the rate limit is published by the timer, replaced by
+// newer ones, or forgotten if the frame goes back to what was published
+static bool check_coalescing()
+{
+  using namespace std::chrono_literals;
+  rclcpp::Node node("check");
+  PublisherOptions options;
+  options.max_rate = 50.0;
+  FramePublisher publisher(node, "led_strips", rclcpp::QoS(1), options);
+  auto & sent = *std::static_pointer_cast<LedStripsPublisher>(node.last_publisher);
+  Frame frame(strips);
+  bool ok = node.run_timers() == 0 && publisher.publish(frame) == PublishResult::published;
+  frame.pixels(0)[0].r = 1;
+  ok = ok && publisher.publish(frame) == PublishResult::coalesced;
+  frame.pixels(0)[0].r = 2;
+  ok = ok && publisher.publish(frame) == PublishResult::coalesced && publisher.stats().coalesced == 1;
+  // Too early: the timer waits
+  ok = ok && node.run_timers() == 1 && sent.count == 1;
+  std::this_thread::sleep_for(25ms);
+  ok = ok && node.run_timers() == 1 && sent.count == 2 && sent.last_seq == 2 &&
+    frame.message().strips[0].data[0] == 2;
+  // The timer is canceled once the frame is published
+  ok = ok && node.run_timers() == 0;
+
+  frame.pixels(0)[0].r = 3;
+  ok = ok && publisher.publish(frame) == PublishResult::coalesced;
+  frame.pixels(0)[0].r = 2;
+  ok = ok && publisher.publish(frame) == PublishResult::unchanged;
+  std::this_thread::sleep_for(25ms);
+  node.run_timers();
+  ok = ok && sent.count == 2 && node.run_timers() == 0;
+  return report("coalescing", ok);
+}
+
+static bool check_dropping()
+{
+  rclcpp::Node node("check");
+  PublisherOptions options;
+  options.max_rate = 50.0;
+  options.coalesce = false;
+  FramePublisher publisher(node, "led_strips", rclcpp::QoS(1), options);
+  Frame frame(strips);
+  bool ok = publisher.publish(frame) == PublishResult::published;
+  frame.pixels(0)[0].b = 1;
+  ok = ok && publisher.publish(frame) == PublishResult::dropped && publisher.stats().dropped == 1 &&
+    node.run_timers() == 0;
+  return report("dropping", ok);
+}
+
+// Rendering and publishing, rate limited or not, once the frame and the
+// publisher exist
+static bool check_allocations()
+{
+  rclcpp::Node node("check");
+  PublisherOptions options;
+  options.max_rate = 1000.0;
+  FramePublisher limited(node, "limited", rclcpp::QoS(1), options);
+  FramePublisher publisher(node, "led_strips", rclcpp::QoS(1));
+  Frame frame(std::vector<StripConfig>(8, StripConfig{0, 1000}));
+  const size_t before = allocations;
+  for (size_t i = 0; i < 1000; i++) {
+    frame.pixels(i % 8)[i].r = static_cast<uint8_t>(i | 1);
+    publisher.publish(frame);
+    limited.publish(frame);
+    node.run_timers();
+  }
+  const size_t count = allocations - before;
+  if (count) {
+    fprintf(stderr, "%zu allocations for 1000 frames\n", count);
+  }
+  return report("allocations", !count && publisher.stats().published == 1000);
+}
+
+int main()
+{
+  bool ok = check_layout();
+  ok = check_changes() && ok;
+  ok = check_coalescing() && ok;
+  ok = check_dropping() && ok;
+  ok = check_allocations() && ok;
+  return ok ? 0 : 1;
+}
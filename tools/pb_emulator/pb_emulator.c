@@ -0,0 +1,289 @@
+#include "pb_emulator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAGIC "UPXL"
+#define HEADER_SIZE 6
+#define CRC_SIZE 4
+#define DRAW_CHANNEL 0xff
+// 8N1
+#define BITS_PER_BYTE 10
+#define WS2812_BIT_RATE 800000
+#define WS2812_RESET_US 300
+// Largest channel struct is pb_apa102_data_channel_t
+#define MAX_STRUCT_SIZE 8
+#define MAX_RECORD_SIZE \
+  (HEADER_SIZE + MAX_STRUCT_SIZE + PB_EMULATOR_MAX_PIXELS * PB_EMULATOR_MAX_ELEMENTS + CRC_SIZE)
+
+typedef struct {
+  pb_emulator_channel_t shown;
+  pb_emulator_channel_t staged;
+  bool has_staged;
+} channel_state_t;
+
+struct pb_emulator_s {
+  uint32_t baud_rate;
+  channel_state_t channels[PB_EMULATOR_CHANNELS];
+  pb_emulator_stats_t stats;
+  // Bytes received but not parsed yet
+  uint8_t buffer[2 * MAX_RECORD_SIZE];
+  size_t buffered;
+};
+
+// Same table as serial_led_driver_pro.c
+static const uint32_t crc_table[16] = {
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+static uint32_t crc32(const uint8_t *data, size_t size) {
+  uint32_t crc = 0xffffffff;
+  while (size--) {
+    crc = crc_table[(crc ^ *data) & 0x0f] ^ (crc >> 4);
+    crc = crc_table[(crc ^ (*data >> 4)) & 0x0f] ^ (crc >> 4);
+    data++;
+  }
+  return crc ^ 0xffffffff;
+}
+
+static uint16_t read_u16(const uint8_t *data) {
+  return data[0] | data[1] << 8;
+}
+
+static uint32_t read_u32(const uint8_t *data) {
+  return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t) data[3] << 24;
+}
+
+// Color order indices must be distinct and point inside a pixel
+static bool valid_color_orders(uint8_t color_orders, uint8_t num_elements) {
+  uint8_t used = 0;
+  const uint8_t colors = num_elements > 3 ? 4 : 3;
+  for (uint8_t i = 0; i < colors; i++) {
+    const uint8_t index = (color_orders >> (2 * i)) & 0x3;
+    if (index >= colors || used & (1 << index)) {
+      return false;
+    }
+    used |= 1 << index;
+  }
+  return true;
+}
+
+// Parses the channel struct following the header into `channel`, returns the
+// size of the struct, or 0 if the struct is invalid. `available` bytes of
+// `data` are valid; -1 if more are needed.
+static int parse_channel_struct(uint8_t type, const uint8_t *data, size_t available,
+                                pb_emulator_channel_t *channel) {
+  static const size_t struct_sizes[] = {
+    [PB_RECORD_WS2812] = 4, [PB_RECORD_DRAW_ALL] = 0,
+    [PB_RECORD_APA102_DATA] = 8, [PB_RECORD_APA102_CLOCK] = 4,
+  };
+  const size_t size = struct_sizes[type];
+  if (available < size) {
+    return -1;
+  }
+  channel->type = type;
+  switch (type) {
+    case PB_RECORD_WS2812:
+      channel->num_elements = data[0];
+      channel->color_orders = data[1];
+      channel->pixels = read_u16(data + 2);
+      channel->frequency = WS2812_BIT_RATE;
+      // 0 elements disables the channel
+      if (channel->num_elements != 0 && channel->num_elements != 3 && channel->num_elements != 4) {
+        return 0;
+      }
+      if (channel->num_elements && !valid_color_orders(channel->color_orders, channel->num_elements)) {
+        return 0;
+      }
+      break;
+    case PB_RECORD_APA102_DATA:
+      // data[5] is padding
+      channel->frequency = read_u32(data);
+      channel->color_orders = data[4];
+      channel->pixels = read_u16(data + 6);
+      // RGB and the brightness byte
+      channel->num_elements = 4;
+      if (!channel->frequency || !valid_color_orders(channel->color_orders, 3)) {
+        return 0;
+      }
+      break;
+    case PB_RECORD_APA102_CLOCK:
+      channel->frequency = read_u32(data);
+      channel->num_elements = 0;
+      channel->pixels = 0;
+      if (!channel->frequency) {
+        return 0;
+      }
+      break;
+  }
+  if (channel->pixels > PB_EMULATOR_MAX_PIXELS) {
+    return 0;
+  }
+  return (int) size;
+}
+
+// Copies the pixels to the framebuffer with the color orders applied
+static void render(pb_emulator_t *emulator, pb_emulator_channel_t *channel, const uint8_t *data) {
+  const uint8_t colors = channel->type == PB_RECORD_APA102_DATA ? 3 : channel->num_elements;
+  uint8_t *out = channel->framebuffer;
+  for (size_t i = 0; i < channel->pixels; i++, data += channel->num_elements, out += channel->num_elements) {
+    for (uint8_t j = 0; j < colors; j++) {
+      out[(channel->color_orders >> (2 * j)) & 0x3] = data[j];
+    }
+    if (channel->type == PB_RECORD_APA102_DATA) {
+      out[3] = data[3];
+      if (data[3] > 0x1f) {
+        emulator->stats.brightness_errors++;
+      }
+    }
+  }
+}
+
+// Time the driver needs to clock the channel out
+static double led_time_us(const pb_emulator_channel_t *channel) {
+  switch (channel->type) {
+    case PB_RECORD_WS2812:
+      return 8e6 * channel->pixels * channel->num_elements / channel->frequency + WS2812_RESET_US;
+    case PB_RECORD_APA102_DATA: {
+      // 32 bits start frame, 32 bits per pixel, half a clock per pixel of end frame
+      const double bits = 32 + 32.0 * channel->pixels + 8 * ((channel->pixels + 15) / 16);
+      return 1e6 * bits / channel->frequency;
+    }
+    default:
+      return 0;
+  }
+}
+
+static void draw(pb_emulator_t *emulator) {
+  double frame_us = 0;
+  for (size_t i = 0; i < PB_EMULATOR_CHANNELS; i++) {
+    channel_state_t *state = &emulator->channels[i];
+    if (state->has_staged) {
+      state->shown = state->staged;
+      state->has_staged = false;
+    }
+    // Channels are driven in parallel
+    const double us = led_time_us(&state->shown);
+    if (us > frame_us) {
+      frame_us = us;
+    }
+  }
+  emulator->stats.led_time_us += frame_us;
+  emulator->stats.draws++;
+}
+
+// Parses one record at the start of `data`, returns the number of bytes
+// consumed, or 0 if more bytes are needed.
+static size_t parse_record(pb_emulator_t *emulator, const uint8_t *data, size_t available) {
+
+  // Resynchronize on the magic
+  size_t skip = 0;
+  while (skip + 4 <= available && memcmp(data + skip, MAGIC, 4)) {
+    skip++;
+  }
+  if (skip) {
+    emulator->stats.skipped_bytes += skip;
+    return skip;
+  }
+  if (available < HEADER_SIZE) {
+    return 0;
+  }
+  const uint8_t channel_id = data[4];
+  const uint8_t type = data[5];
+  if (type < PB_RECORD_WS2812 || type > PB_RECORD_APA102_CLOCK ||
+      (type == PB_RECORD_DRAW_ALL) != (channel_id == DRAW_CHANNEL) ||
+      (type != PB_RECORD_DRAW_ALL && channel_id >= PB_EMULATOR_CHANNELS)) {
+    emulator->stats.invalid_records++;
+    // Look for the next magic
+    return 1;
+  }
+
+  pb_emulator_channel_t *channel = NULL;
+  int struct_size = 0;
+  if (type != PB_RECORD_DRAW_ALL) {
+    channel = &emulator->channels[channel_id].staged;
+    pb_emulator_channel_t parsed = *channel;
+    struct_size = parse_channel_struct(type, data + HEADER_SIZE, available - HEADER_SIZE, &parsed);
+    if (struct_size < 0) {
+      return 0;
+    }
+    if (struct_size == 0) {
+      emulator->stats.invalid_records++;
+      return 1;
+    }
+    const size_t data_size = (size_t) parsed.pixels * parsed.num_elements;
+    const size_t size = HEADER_SIZE + struct_size + data_size + CRC_SIZE;
+    if (available < size) {
+      return 0;
+    }
+    if (crc32(data, size - CRC_SIZE) != read_u32(data + size - CRC_SIZE)) {
+      emulator->stats.crc_errors++;
+      return 1;
+    }
+    // The clock channel keeps no pixels
+    parsed.type = type;
+    *channel = parsed;
+    render(emulator, channel, data + HEADER_SIZE + struct_size);
+    emulator->channels[channel_id].has_staged = true;
+    emulator->stats.records++;
+    return size;
+  }
+
+  const size_t size = HEADER_SIZE + CRC_SIZE;
+  if (available < size) {
+    return 0;
+  }
+  if (crc32(data, HEADER_SIZE) != read_u32(data + HEADER_SIZE)) {
+    emulator->stats.crc_errors++;
+    return 1;
+  }
+  draw(emulator);
+  emulator->stats.records++;
+  return size;
+}
+
+pb_emulator_t *pb_emulator_new(uint32_t baud_rate) {
+  pb_emulator_t *emulator = calloc(1, sizeof(pb_emulator_t));
+  if (emulator) {
+    emulator->baud_rate = baud_rate;
+  }
+  return emulator;
+}
+
+void pb_emulator_free(pb_emulator_t *emulator) {
+  free(emulator);
+}
+
+void pb_emulator_feed(pb_emulator_t *emulator, const uint8_t *data, size_t size) {
+  emulator->stats.bytes += size;
+  emulator->stats.wire_time_us = 1e6 * BITS_PER_BYTE * emulator->stats.bytes / emulator->baud_rate;
+  while (size) {
+    size_t chunk = sizeof(emulator->buffer) - emulator->buffered;
+    if (chunk > size) {
+      chunk = size;
+    }
+    memcpy(emulator->buffer + emulator->buffered, data, chunk);
+    emulator->buffered += chunk;
+    data += chunk;
+    size -= chunk;
+    size_t consumed = 0;
+    size_t n;
+    while ((n = parse_record(emulator, emulator->buffer + consumed, emulator->buffered - consumed)) > 0) {
+      consumed += n;
+    }
+    memmove(emulator->buffer, emulator->buffer + consumed, emulator->buffered - consumed);
+    emulator->buffered -= consumed;
+  }
+}
+
+const pb_emulator_channel_t *pb_emulator_get_channel(const pb_emulator_t *emulator, uint8_t channel) {
+  if (channel >= PB_EMULATOR_CHANNELS) {
+    return NULL;
+  }
+  return &emulator->channels[channel].shown;
+}
+
+void pb_emulator_get_stats(const pb_emulator_t *emulator, pb_emulator_stats_t *stats) {
+  *stats = emulator->stats;
+}
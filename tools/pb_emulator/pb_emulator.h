@@ -0,0 +1,65 @@
+// Host emulator of the Serial LED Driver Pro: consumes the UART byte stream
+// written by pb_set_channel / pb_draw, validates the UPXL records and keeps
+// per channel what the LEDs show.
+//
+// Timing is modelled from the byte count: the wire time at the link baud rate
+// and the time the driver needs to clock the pixels out to the LEDs.
+
+#ifndef PB_EMULATOR_H
+#define PB_EMULATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PB_EMULATOR_CHANNELS 8
+#define PB_EMULATOR_MAX_PIXELS 2048
+// Up to 4 elements (RGBW or RGB + APA102 brightness) per pixel
+#define PB_EMULATOR_MAX_ELEMENTS 4
+
+typedef enum {
+  PB_RECORD_WS2812 = 1,
+  PB_RECORD_DRAW_ALL,
+  PB_RECORD_APA102_DATA,
+  PB_RECORD_APA102_CLOCK
+} pb_record_type_t;
+
+typedef struct {
+  // 0 if never configured
+  uint8_t type;
+  uint8_t num_elements;
+  uint8_t color_orders;
+  uint32_t frequency;
+  uint16_t pixels;
+  // Elements in the order of the wire to the LEDs (color orders applied),
+  // for APA102 the 4th element of a pixel is the 5 bits brightness.
+  uint8_t framebuffer[PB_EMULATOR_MAX_PIXELS * PB_EMULATOR_MAX_ELEMENTS];
+} pb_emulator_channel_t;
+
+typedef struct {
+  uint64_t bytes;
+  uint32_t records;
+  uint32_t draws;
+  // bytes skipped looking for the UPXL magic
+  uint32_t skipped_bytes;
+  uint32_t crc_errors;
+  // unknown record type, channel or invalid channel struct
+  uint32_t invalid_records;
+  // APA102 brightness bytes above 31
+  uint32_t brightness_errors;
+  // time to transmit the bytes at the baud rate
+  double wire_time_us;
+  // time to clock the pixels out to the LEDs, summed over the draws
+  double led_time_us;
+} pb_emulator_stats_t;
+
+typedef struct pb_emulator_s pb_emulator_t;
+
+pb_emulator_t *pb_emulator_new(uint32_t baud_rate);
+void pb_emulator_free(pb_emulator_t *emulator);
+void pb_emulator_feed(pb_emulator_t *emulator, const uint8_t *data, size_t size);
+// What channel `channel` shows since the last draw
+const pb_emulator_channel_t *pb_emulator_get_channel(const pb_emulator_t *emulator, uint8_t channel);
+void pb_emulator_get_stats(const pb_emulator_t *emulator, pb_emulator_stats_t *stats);
+
+#endif /* end of include guard: PB_EMULATOR_H */
@@ -0,0 +1,230 @@
+// Serial LED Driver Pro emulator.
+//
+//   pb_emulator STREAM       parse the bytes sent to the driver (led_replay -o)
+//   pb_emulator --check N    encode N random frames with the host build of
+//                            serial_led_driver_pro.c and compare what the
+//                            emulator shows with the input
+//
+// Both print the records found and the frame rate the link and the LEDs allow.
+// The time to clock APA102 strips out shrinks with their frequency:
+//   pb_emulator --check 100 --apa102 --pixels 144
+//   pb_emulator --check 100 --apa102 --pixels 144 --frequency 8000000 --clock 7
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/uart.h"
+#include "pb_emulator.h"
+#include "serial_led_driver_pro.h"
+
+#define DEFAULT_MAX_PIXELS 1000
+#define DEFAULT_FREQUENCY 1000000
+
+static void feed(int uart_num, const uint8_t *data, size_t size, void *emulator) {
+  pb_emulator_feed(emulator, data, size);
+}
+
+static int parse_stream(pb_emulator_t *emulator, const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  uint8_t buffer[4096];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    pb_emulator_feed(emulator, buffer, size);
+  }
+  fclose(file);
+  return 0;
+}
+
+// What the LEDs of a channel set with pb_set_channel should show
+static bool check_channel(const pb_emulator_channel_t *channel, channel_type_t type,
+                          color_orders_t color_orders, uint16_t pixels,
+                          const uint8_t *data, uint8_t brightness, uint32_t frequency) {
+  if (type == CHANNEL_APA102_CLOCK) {
+    return channel->type == type && channel->pixels == 0 && channel->frequency == frequency;
+  }
+  if (type == CHANNEL_APA102_DATA && channel->frequency != frequency) {
+    return false;
+  }
+  const size_t stride = type == CHANNEL_APA102_DATA ? 4 : 3;
+  if (channel->type != type || channel->pixels != pixels || channel->num_elements != stride ||
+      channel->color_orders != color_orders.color_orders) {
+    return false;
+  }
+  const uint8_t index[3] = {
+    color_orders.components.redi, color_orders.components.greeni, color_orders.components.bluei
+  };
+  for (size_t i = 0; i < pixels; i++) {
+    const uint8_t *out = channel->framebuffer + i * stride;
+    for (size_t j = 0; j < 3; j++) {
+      if (out[index[j]] != data[3 * i + j]) {
+        return false;
+      }
+    }
+    if (type == CHANNEL_APA102_DATA && out[3] != (brightness & 0x1f)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Channels are WS2812 or APA102 at `frequency`, only APA102 with `apa102`;
+// channel `clock` (if < PB_EMULATOR_CHANNELS) outputs their clock.
+static int check(pb_emulator_t *emulator, uint32_t frames, uint16_t max_pixels, uint32_t frequency,
+                 bool apa102, uint8_t clock) {
+  static uint8_t data[PB_EMULATOR_CHANNELS][3 * PB_EMULATOR_MAX_PIXELS];
+  typedef struct {
+    channel_type_t type;
+    color_orders_t color_orders;
+    uint16_t pixels;
+    uint8_t brightness;
+  } expected_t;
+  expected_t expected[PB_EMULATOR_CHANNELS] = {0};
+
+  host_uart_set_sink(feed, emulator);
+  pb_driver_t driver;
+  pb_init(&driver, 0, 0);
+  uint32_t mismatches = 0;
+  uint64_t size = 0;
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    // A random subset of the channels changes in each frame
+    for (uint8_t id = 0; id < PB_EMULATOR_CHANNELS; id++) {
+      if (frame && rand() % 2) {
+        continue;
+      }
+      expected_t *e = &expected[id];
+      if (id == clock) {
+        e->type = CHANNEL_APA102_CLOCK;
+        e->pixels = 0;
+        pb_set_channel(&driver, id, e->type, RGB, 0, NULL, frequency, 0);
+        size += pb_channel_size(e->type, 0);
+        continue;
+      }
+      e->type = apa102 || rand() % 2 ? CHANNEL_APA102_DATA : CHANNEL_WS2812;
+      e->color_orders = rand() % 2 ? RGB : BGR;
+      e->pixels = rand() % (max_pixels + 1);
+      e->brightness = rand() % 256;
+      for (size_t i = 0; i < 3 * e->pixels; i++) {
+        data[id][i] = rand();
+      }
+      pb_set_channel(&driver, id, e->type, e->color_orders, e->pixels, data[id], frequency, e->brightness);
+      size += pb_channel_size(e->type, e->pixels);
+    }
+    pb_draw(&driver);
+    size += pb_draw_size();
+    for (uint8_t id = 0; id < PB_EMULATOR_CHANNELS; id++) {
+      const expected_t *e = &expected[id];
+      if (!check_channel(pb_emulator_get_channel(emulator, id), e->type, e->color_orders,
+                         e->pixels, data[id], e->brightness, frequency)) {
+        fprintf(stderr, "frame %u: channel %u does not show what was set\n", frame, id);
+        mismatches++;
+      }
+    }
+  }
+  if (size != host_uart_bytes_written()) {
+    fprintf(stderr, "pb_channel_size / pb_draw_size count %llu bytes, %llu were written\n",
+            (unsigned long long) size, (unsigned long long) host_uart_bytes_written());
+    mismatches++;
+  }
+  return mismatches ? -1 : 0;
+}
+
+static void print_stats(const pb_emulator_t *emulator) {
+  pb_emulator_stats_t stats;
+  pb_emulator_get_stats(emulator, &stats);
+  printf("bytes             %llu (%.3f s on the wire)\n",
+         (unsigned long long) stats.bytes, 1e-6 * stats.wire_time_us);
+  printf("records           %u, %u draws\n", stats.records, stats.draws);
+  printf("errors            %u crc, %u invalid, %u brightness, %u bytes skipped\n",
+         stats.crc_errors, stats.invalid_records, stats.brightness_errors, stats.skipped_bytes);
+  if (stats.draws) {
+    const double wire_fps = 1e6 * stats.draws / stats.wire_time_us;
+    const double led_fps = stats.led_time_us > 0 ? 1e6 * stats.draws / stats.led_time_us : 0;
+    printf("link              %.1f fps max\n", wire_fps);
+    printf("leds              %.1f fps max, %.0f us per frame\n", led_fps, stats.led_time_us / stats.draws);
+    printf("achievable        %.1f fps\n", led_fps > 0 && led_fps < wire_fps ? led_fps : wire_fps);
+  }
+  for (uint8_t id = 0; id < PB_EMULATOR_CHANNELS; id++) {
+    const pb_emulator_channel_t *channel = pb_emulator_get_channel(emulator, id);
+    if (channel->type) {
+      printf("channel %u         type %u, %u pixels, %u elements, order 0x%02x, %u Hz\n",
+             id, channel->type, channel->pixels, channel->num_elements,
+             channel->color_orders, channel->frequency);
+    }
+  }
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [options] STREAM\n"
+          "       %s [options] --check N\n"
+          "  -c, --check N       encode N random frames and check what the emulator shows\n"
+          "  -p, --pixels N      maximal number of pixels per channel of --check (default %d)\n"
+          "  -r, --seed N        random seed of --check (default 1)\n"
+          "  -f, --frequency HZ  APA102 frequency of --check (default %d)\n"
+          "  -a, --apa102        only APA102 channels in --check\n"
+          "  -k, --clock C       channel C outputs the APA102 clock in --check\n"
+          "  -B, --baud N        link baud rate (default %ld)\n",
+          name, name, DEFAULT_MAX_PIXELS, DEFAULT_FREQUENCY, PB_BAUD_RATE);
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = 0;
+  long max_pixels = DEFAULT_MAX_PIXELS;
+  unsigned seed = 1;
+  long baud_rate = PB_BAUD_RATE;
+  long frequency = DEFAULT_FREQUENCY;
+  bool apa102 = false;
+  long clock = PB_EMULATOR_CHANNELS;
+  static const struct option long_options[] = {
+    {"check", required_argument, NULL, 'c'},
+    {"pixels", required_argument, NULL, 'p'},
+    {"seed", required_argument, NULL, 'r'},
+    {"frequency", required_argument, NULL, 'f'},
+    {"apa102", no_argument, NULL, 'a'},
+    {"clock", required_argument, NULL, 'k'},
+    {"baud", required_argument, NULL, 'B'},
+    {NULL, 0, NULL, 0},
+  };
+  int c;
+  while ((c = getopt_long(argc, argv, "c:p:r:f:ak:B:", long_options, NULL)) != -1) {
+    switch (c) {
+      case 'c': frames = atoi(optarg); break;
+      case 'p': max_pixels = atol(optarg); break;
+      case 'r': seed = atoi(optarg); break;
+      case 'f': frequency = atol(optarg); break;
+      case 'a': apa102 = true; break;
+      case 'k': clock = atol(optarg); break;
+      case 'B': baud_rate = atol(optarg); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if ((frames == 0) == (optind == argc) || (frames && optind != argc) || optind < argc - 1 ||
+      max_pixels < 0 || max_pixels > PB_EMULATOR_MAX_PIXELS || baud_rate <= 0 || frequency <= 0 ||
+      clock < 0 || clock > PB_EMULATOR_CHANNELS) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  pb_emulator_t *emulator = pb_emulator_new(baud_rate);
+  int result;
+  if (frames) {
+    srand(seed);
+    result = check(emulator, frames, max_pixels, frequency, apa102, clock);
+    printf("check             %u frames %s\n", frames, result ? "FAILED" : "passed");
+  } else {
+    result = parse_stream(emulator, argv[optind]);
+  }
+  print_stats(emulator);
+  pb_emulator_free(emulator);
+  return result ? 1 : 0;
+}
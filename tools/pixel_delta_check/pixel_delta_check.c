@@ -0,0 +1,342 @@
+// Checks the pixel delta codec and the LedStripsDelta protocol on the host.
+//
+// 1. encode / decode round trips of random buffers, sizes and changes,
+//    and the rejection of malformed deltas;
+// 2. a stream of typical content sent as keyframes and deltas over a lossy
+//    link, to a receiver that mirrors delta_subscription_callback of
+//    ros_led_driver: every frame it shows has to match the frame sent.
+//    The sender mirrors tools/led_delta_bridge.py: a keyframe every
+//    --keyframe-period frames, or as soon as the acknowledged keyframe
+//    (DriverStats.keyframe_seq, also lossy) lags behind.
+//
+// Reports the bandwidth of the deltas against LedStrips and the decode time.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pixel_delta.h"
+
+#define MAX_STRIPS 8
+#define MAX_PIXELS 1000
+#define MAX_STRIP_SIZE (3 * MAX_PIXELS)
+#define MAX_DELTA_SIZE PIXEL_DELTA_MAX_SIZE(MAX_STRIP_SIZE)
+
+// CDR sizes of the messages, as in ros_led_driver/main/app_config.h
+#define LED_STRIPS_SIZE(data) (14 + 11 * strips + (data))
+#define LED_STRIPS_DELTA_SIZE(data) (18 + 15 * strips + (data))
+
+typedef enum {
+  CONTENT_CHASE,
+  CONTENT_SPARKLE,
+  CONTENT_RAINBOW,
+  NUMBER_OF_CONTENTS
+} content_t;
+
+static const char *content_names[] = {"chase", "sparkle", "rainbow"};
+
+static int strips = MAX_STRIPS;
+static int pixels = 300;
+static uint32_t frames = 3600;
+static uint32_t keyframe_period = 120;
+static uint32_t ack_period = 60;
+static double loss = 0.05;
+
+static uint8_t frame[MAX_STRIPS][MAX_STRIP_SIZE];
+static uint8_t sent_keyframe[MAX_STRIPS][MAX_STRIP_SIZE];
+static uint8_t delta[MAX_STRIPS][MAX_DELTA_SIZE];
+static size_t delta_size[MAX_STRIPS];
+
+// Receiver state
+static uint8_t reference[MAX_STRIPS][MAX_STRIP_SIZE];
+static size_t reference_size[MAX_STRIPS];
+static uint8_t shown[MAX_STRIPS][MAX_STRIP_SIZE];
+static uint32_t held_keyframe_seq;
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static double uniform(void) {
+  return rand() / (RAND_MAX + 1.0);
+}
+
+static uint8_t to_byte(double value) {
+  return value <= 0 ? 0 : value >= 1 ? 255 : (uint8_t) (255 * value);
+}
+
+static void hue_to_rgb(double hue, uint8_t *rgb) {
+  for (int i = 0; i < 3; i++) {
+    const double phase = fmod(hue + 1.0 - i / 3.0, 1.0);
+    rgb[i] = to_byte(1 - fabs(6 * phase - 3) + 1);
+  }
+}
+
+// Frame `n` of some typical content
+static void render(content_t content, uint32_t n) {
+  const size_t size = 3 * pixels;
+  for (int s = 0; s < strips; s++) {
+    uint8_t *data = frame[s];
+    switch (content) {
+      case CONTENT_CHASE: {
+        // a 20 pixel comet with a fading tail on a dark background
+        memset(data, 0, size);
+        const int head = (n + 37 * s) % pixels;
+        for (int i = 0; i < 20; i++) {
+          const int p = (head - i + pixels) % pixels;
+          hue_to_rgb(s / 8.0, data + 3 * p);
+          for (int c = 0; c < 3; c++) {
+            data[3 * p + c] = data[3 * p + c] * (20 - i) / 20;
+          }
+        }
+        break;
+      }
+      case CONTENT_SPARKLE:
+        // 2 % of the pixels light up or go dark per frame
+        if (n == 0) {
+          memset(data, 0, size);
+        }
+        for (int i = 0; i < pixels / 50; i++) {
+          const int p = rand() % pixels;
+          if (data[3 * p]) {
+            memset(data + 3 * p, 0, 3);
+          } else {
+            hue_to_rgb(uniform(), data + 3 * p);
+          }
+        }
+        break;
+      case CONTENT_RAINBOW:
+        // a rainbow scrolling by one pixel every 4 frames
+        for (int p = 0; p < pixels; p++) {
+          hue_to_rgb((double) (p + n / 4) / pixels, data + 3 * p);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// Mirrors delta_subscription_callback: returns true if the frame is shown
+static bool receive(uint32_t seq, uint32_t keyframe_seq, uint8_t (*received_shown)[MAX_STRIP_SIZE]) {
+  const bool is_keyframe = seq == keyframe_seq;
+  if (is_keyframe) {
+    memset(reference_size, 0, sizeof(reference_size));
+    held_keyframe_seq = keyframe_seq;
+  } else if (!held_keyframe_seq || keyframe_seq != held_keyframe_seq) {
+    return false;
+  }
+  for (int s = 0; s < strips; s++) {
+    const size_t size = 3 * pixels;
+    if (!is_keyframe && size != reference_size[s]) {
+      return false;
+    }
+    if (!pixel_delta_decode(received_shown[s], is_keyframe ? NULL : reference[s], size,
+                            delta[s], delta_size[s])) {
+      return false;
+    }
+    if (is_keyframe) {
+      memcpy(reference[s], received_shown[s], size);
+      reference_size[s] = size;
+    }
+  }
+  return true;
+}
+
+// Returns the number of frames shown with the wrong content
+static uint32_t run_stream(content_t content) {
+  const size_t size = 3 * pixels;
+  uint32_t keyframe_seq = 0;
+  uint32_t acknowledged = 0;
+  uint32_t keyframes = 0, lost = 0, shown_frames = 0, skipped = 0, errors = 0;
+  uint64_t raw_bytes = 0, delta_bytes = 0;
+  double decode_s = 0;
+  bool force_keyframe = true;
+  memset(reference_size, 0, sizeof(reference_size));
+  held_keyframe_seq = 0;
+
+  for (uint32_t n = 0; n < frames; n++) {
+    const uint32_t seq = n + 1;
+    render(content, n);
+    // Sender
+    if (force_keyframe || seq - keyframe_seq >= keyframe_period) {
+      keyframe_seq = seq;
+      force_keyframe = false;
+      keyframes++;
+      memcpy(sent_keyframe, frame, sizeof(frame));
+    }
+    size_t data_size = 0;
+    for (int s = 0; s < strips; s++) {
+      delta_size[s] = pixel_delta_encode(delta[s], MAX_DELTA_SIZE, frame[s],
+                                         seq == keyframe_seq ? NULL : sent_keyframe[s], size);
+      data_size += delta_size[s];
+    }
+    raw_bytes += LED_STRIPS_SIZE(strips * size);
+    delta_bytes += LED_STRIPS_DELTA_SIZE(data_size);
+
+    // Link
+    if (uniform() < loss) {
+      lost++;
+    } else {
+      const double start = now_s();
+      const bool is_shown = receive(seq, keyframe_seq, shown);
+      decode_s += now_s() - start;
+      if (is_shown) {
+        shown_frames++;
+        for (int s = 0; s < strips; s++) {
+          if (memcmp(shown[s], frame[s], size)) {
+            if (!errors) {
+              fprintf(stderr, "%s: frame %u strip %d differs\n", content_names[content], seq, s);
+            }
+            errors++;
+            break;
+          }
+        }
+      } else {
+        skipped++;
+      }
+    }
+    // Acknowledgment by DriverStats, lossy as well
+    if (seq % ack_period == 0 && uniform() >= loss) {
+      acknowledged = held_keyframe_seq;
+      // Only once the keyframe had the time to be acknowledged
+      if (acknowledged != keyframe_seq && seq - keyframe_seq >= ack_period) {
+        force_keyframe = true;
+      }
+    }
+  }
+  printf("%-17s %.1fx less data (%.0f vs %.0f bytes per frame), %u keyframes\n",
+         content_names[content], (double) raw_bytes / delta_bytes,
+         (double) delta_bytes / frames, (double) raw_bytes / frames, keyframes);
+  printf("                  %u shown, %u lost, %u without keyframe, %u wrong, "
+         "decode %.1f us per frame\n",
+         shown_frames, lost, skipped, errors,
+         1e6 * decode_s / (shown_frames + skipped ? shown_frames + skipped : 1));
+  return errors;
+}
+
+static int check_round_trips(uint32_t count) {
+  static uint8_t a[MAX_STRIP_SIZE], b[MAX_STRIP_SIZE], out[MAX_STRIP_SIZE];
+  static uint8_t d[MAX_DELTA_SIZE];
+  for (uint32_t n = 0; n < count; n++) {
+    const size_t size = n < 4 ? (size_t[]) {0, 1, 128, MAX_STRIP_SIZE}[n] : (size_t) rand() % (MAX_STRIP_SIZE + 1);
+    for (size_t i = 0; i < size; i++) {
+      a[i] = rand();
+    }
+    memcpy(b, a, size);
+    // From a few sparse changes to a fully different frame
+    const double change = n % 3 == 0 ? 1.0 : n % 3 == 1 ? 0.01 : uniform();
+    for (size_t i = 0; i < size; i++) {
+      if (uniform() < change) {
+        b[i] = rand();
+      }
+    }
+    const bool null_reference = n % 5 == 0;
+    const uint8_t *ref = null_reference ? NULL : a;
+    const size_t delta_size = pixel_delta_encode(d, sizeof(d), b, ref, size);
+    if (delta_size > PIXEL_DELTA_MAX_SIZE(size)) {
+      fprintf(stderr, "delta of %zu bytes for %zu bytes\n", delta_size, size);
+      return 1;
+    }
+    memset(out, 0xAA, sizeof(out));
+    if (!pixel_delta_decode(out, ref, size, d, delta_size) || memcmp(out, b, size)) {
+      fprintf(stderr, "round trip %u of %zu bytes failed\n", n, size);
+      return 1;
+    }
+    // In place
+    if (!null_reference) {
+      memcpy(out, a, size);
+      if (!pixel_delta_decode(out, out, size, d, delta_size) || memcmp(out, b, size)) {
+        fprintf(stderr, "in place round trip %u of %zu bytes failed\n", n, size);
+        return 1;
+      }
+    }
+    if (delta_size > 0) {
+      // Too small for the delta
+      if (pixel_delta_encode(d, delta_size - 1, b, ref, size)) {
+        fprintf(stderr, "delta of %zu bytes encoded in %zu\n", delta_size, delta_size - 1);
+        return 1;
+      }
+      // Too short for the delta
+      if (size > 0 && pixel_delta_decode(out, ref, size - 1, d, delta_size) &&
+          memcmp(out, b, size - 1)) {
+        fprintf(stderr, "delta of %zu bytes decoded in %zu bytes\n", size, size - 1);
+        return 1;
+      }
+    }
+  }
+  // A literal running past the end of the delta
+  const uint8_t truncated[] = {0x83, 1, 2};
+  if (pixel_delta_decode(out, NULL, 16, truncated, sizeof(truncated))) {
+    fprintf(stderr, "truncated delta accepted\n");
+    return 1;
+  }
+  return 0;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -s, --strips N           strips per frame (default %d)\n"
+          "  -p, --pixels N           pixels per strip (default %d)\n"
+          "  -n, --frames N           frames per content (default %u)\n"
+          "  -k, --keyframe-period N  frames between keyframes (default %u)\n"
+          "  -a, --ack-period N       frames between DriverStats (default %u)\n"
+          "  -l, --loss P             probability to lose a message (default %.2f)\n"
+          "  -r, --seed N             random seed (default 1)\n",
+          name, strips, pixels, frames, keyframe_period, ack_period, loss);
+}
+
+int main(int argc, char **argv) {
+  unsigned seed = 1;
+  static const struct option long_options[] = {
+    {"strips", required_argument, NULL, 's'},
+    {"pixels", required_argument, NULL, 'p'},
+    {"frames", required_argument, NULL, 'n'},
+    {"keyframe-period", required_argument, NULL, 'k'},
+    {"ack-period", required_argument, NULL, 'a'},
+    {"loss", required_argument, NULL, 'l'},
+    {"seed", required_argument, NULL, 'r'},
+    {NULL, 0, NULL, 0},
+  };
+  int c;
+  while ((c = getopt_long(argc, argv, "s:p:n:k:a:l:r:", long_options, NULL)) != -1) {
+    switch (c) {
+      case 's': strips = atoi(optarg); break;
+      case 'p': pixels = atoi(optarg); break;
+      case 'n': frames = atoi(optarg); break;
+      case 'k': keyframe_period = atoi(optarg); break;
+      case 'a': ack_period = atoi(optarg); break;
+      case 'l': loss = atof(optarg); break;
+      case 'r': seed = atoi(optarg); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (optind != argc || strips < 1 || strips > MAX_STRIPS || pixels < 1 || pixels > MAX_PIXELS ||
+      !frames || !keyframe_period || !ack_period || loss < 0 || loss >= 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  srand(seed);
+
+  const uint32_t round_trips = 20000;
+  const int result = check_round_trips(round_trips);
+  printf("round trips       %u %s\n", round_trips, result ? "FAILED" : "passed");
+  if (result) {
+    return 1;
+  }
+  uint32_t errors = 0;
+  for (content_t content = 0; content < NUMBER_OF_CONTENTS; content++) {
+    errors += run_stream(content);
+  }
+  printf("stream            %.0f %% loss, %s\n", 100 * loss, errors ? "FAILED" : "passed");
+  return errors ? 1 : 0;
+}
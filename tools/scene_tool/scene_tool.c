@@ -0,0 +1,134 @@
+// Reads and writes scenes in a file laid out as the `scenes` partition, with
+// the host build of the scene_store component. The file can be flashed to the
+// partition (parttool.py write_partition --partition-name scenes) or read
+// from it to inspect the scenes of a board.
+//
+//   scene_tool [-s PARTITION_SIZE] [-m MAX_SCENE_SIZE] FILE list
+//   scene_tool ... FILE store ID CONTENT
+//   scene_tool ... FILE recall ID CONTENT
+//   scene_tool ... FILE erase ID
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scene_store.h"
+#include "scene_store_file.h"
+
+// As ros_led_driver: 8 strips of 1000 pixels
+#define DEFAULT_PARTITION_SIZE 0x60000
+#define DEFAULT_MAX_SCENE_SIZE (8 * (8 + 3000))
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static int list(void) {
+  for (size_t id = 0; id < scene_store_number_of_scenes(); id++) {
+    size_t size;
+    if (scene_store_get(id, &size)) {
+      printf("scene %3zu  %zu bytes\n", id, size);
+    }
+  }
+  printf("%zu slots\n", scene_store_number_of_scenes());
+  return 0;
+}
+
+static int store(uint8_t id, const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  esp_err_t err = scene_store_begin(id);
+  uint8_t buffer[4096];
+  size_t size;
+  while (err == ESP_OK && (size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    err = scene_store_append(buffer, size);
+  }
+  fclose(file);
+  if (err == ESP_OK) {
+    err = scene_store_end();
+  }
+  if (err != ESP_OK) {
+    fprintf(stderr, "Cannot store scene %u: error 0x%x\n", id, err);
+    return 1;
+  }
+  return 0;
+}
+
+static int recall(uint8_t id, const char *path) {
+  const double start = now_s();
+  size_t size;
+  const uint8_t *data = scene_store_get(id, &size);
+  if (!data) {
+    fprintf(stderr, "No scene %u\n", id);
+    return 1;
+  }
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  fwrite(data, 1, size, file);
+  fclose(file);
+  printf("scene %u: %zu bytes in %.3f ms\n", id, size, 1e3 * (now_s() - start));
+  return 0;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [options] FILE list | store ID CONTENT | recall ID CONTENT | erase ID\n"
+          "  -s, --size N        size of the partition (default 0x%x)\n"
+          "  -m, --max-size N    maximal size of a scene (default %d)\n",
+          name, DEFAULT_PARTITION_SIZE, DEFAULT_MAX_SCENE_SIZE);
+}
+
+int main(int argc, char **argv) {
+  size_t partition_size = DEFAULT_PARTITION_SIZE;
+  size_t max_scene_size = DEFAULT_MAX_SCENE_SIZE;
+  static const struct option long_options[] = {
+    {"size", required_argument, NULL, 's'},
+    {"max-size", required_argument, NULL, 'm'},
+    {NULL, 0, NULL, 0},
+  };
+  int c;
+  while ((c = getopt_long(argc, argv, "s:m:", long_options, NULL)) != -1) {
+    switch (c) {
+      case 's': partition_size = strtoul(optarg, NULL, 0); break;
+      case 'm': max_scene_size = strtoul(optarg, NULL, 0); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (argc - optind < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  const char *command = argv[optind + 1];
+  const int arguments = argc - optind - 2;
+  scene_store_file_configure(argv[optind], partition_size);
+  esp_err_t err = scene_store_init(max_scene_size);
+  if (err != ESP_OK) {
+    fprintf(stderr, "Cannot open %s as a scene partition: error 0x%x\n", argv[optind], err);
+    return 1;
+  }
+  const uint8_t id = arguments ? atoi(argv[optind + 2]) : 0;
+  if (!strcmp(command, "list") && arguments == 0) {
+    return list();
+  } else if (!strcmp(command, "store") && arguments == 2) {
+    return store(id, argv[optind + 3]);
+  } else if (!strcmp(command, "recall") && arguments == 2) {
+    return recall(id, argv[optind + 3]);
+  } else if (!strcmp(command, "erase") && arguments == 1) {
+    return scene_store_erase(id) == ESP_OK ? 0 : 1;
+  }
+  usage(argv[0]);
+  return 1;
+}
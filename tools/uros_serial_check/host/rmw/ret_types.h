@@ -0,0 +1,10 @@
+#ifndef HOST_RMW_RET_TYPES_H
+#define HOST_RMW_RET_TYPES_H
+
+#include <stdint.h>
+
+typedef int32_t rmw_ret_t;
+#define RMW_RET_OK 0
+#define RMW_RET_ERROR 1
+
+#endif /* end of include guard: HOST_RMW_RET_TYPES_H */
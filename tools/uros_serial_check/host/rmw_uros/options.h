@@ -0,0 +1,12 @@
+#ifndef HOST_RMW_UROS_OPTIONS_H
+#define HOST_RMW_UROS_OPTIONS_H
+
+#include <rmw/ret_types.h>
+#include <uxr/client/profile/transport/custom/custom_transport.h>
+
+// Fills the transport of the host check
+rmw_ret_t rmw_uros_set_custom_transport(bool framing, void *args, open_custom_func open_cb,
+                                        close_custom_func close_cb, write_custom_func write_cb,
+                                        read_custom_func read_cb);
+
+#endif /* end of include guard: HOST_RMW_UROS_OPTIONS_H */
@@ -0,0 +1,14 @@
+// Defaults of ros_feather_s2/components/uros_serial_transport/Kconfig, UART link
+
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+#define CONFIG_UROS_SERIAL_TRANSPORT_UART 1
+#define CONFIG_UROS_SERIAL_UART_NUM 1
+#define CONFIG_UROS_SERIAL_UART_TX_GPIO 17
+#define CONFIG_UROS_SERIAL_UART_RX_GPIO 18
+#define CONFIG_UROS_SERIAL_UART_BAUD_RATE 2000000
+#define CONFIG_UROS_SERIAL_RX_BUFFER_SIZE 8192
+#define CONFIG_UROS_SERIAL_TX_BATCH_SIZE 1024
+
+#endif /* end of include guard: HOST_SDKCONFIG_H */
@@ -0,0 +1,81 @@
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "driver/uart.h"
+
+static int uart_fd = -1;
+
+void host_uart_set_fd(int fd) {
+  uart_fd = fd;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size,
+                              int queue_size, void *uart_queue, int intr_alloc_flags) {
+  return uart_fd < 0 ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num) {
+  return ESP_OK;
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *uart_config) {
+  return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num) {
+  return ESP_OK;
+}
+
+esp_err_t uart_set_rx_full_threshold(uart_port_t uart_num, int threshold) {
+  return ESP_OK;
+}
+
+esp_err_t uart_set_rx_timeout(uart_port_t uart_num, uint8_t tout_thresh) {
+  return ESP_OK;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size) {
+  size_t written = 0;
+  while (written < size) {
+    const ssize_t n = write(uart_fd, (const uint8_t *) src + written, size - written);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      return -1;
+    }
+    written += n;
+  }
+  return (int) written;
+}
+
+static int64_t now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait) {
+  const int64_t deadline = now_ms() + ticks_to_wait * portTICK_PERIOD_MS;
+  uint32_t read_bytes = 0;
+  while (read_bytes < length) {
+    const int64_t remaining = deadline - now_ms();
+    struct pollfd fd = {uart_fd, POLLIN, 0};
+    const int ready = poll(&fd, 1, remaining > 0 ? (int) remaining : 0);
+    if (ready < 0 && errno != EINTR) {
+      return -1;
+    }
+    if (ready > 0) {
+      const ssize_t n = read(uart_fd, (uint8_t *) buf + read_bytes, length - read_bytes);
+      if (n < 0 && errno != EINTR && errno != EAGAIN) {
+        return -1;
+      }
+      read_bytes += n > 0 ? n : 0;
+    } else if (remaining <= 0) {
+      break;
+    }
+  }
+  return (int) read_bytes;
+}
@@ -0,0 +1,29 @@
+// Host replacement of the custom transport of the Micro XRCE-DDS client: only
+// the callbacks, called by tools/uros_serial_check in place of the client.
+
+#ifndef HOST_UXR_CUSTOM_TRANSPORT_H
+#define HOST_UXR_CUSTOM_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct uxrCustomTransport uxrCustomTransport;
+
+typedef bool (*open_custom_func)(struct uxrCustomTransport *transport);
+typedef bool (*close_custom_func)(struct uxrCustomTransport *transport);
+typedef size_t (*write_custom_func)(struct uxrCustomTransport *transport, const uint8_t *buffer,
+                                    size_t size, uint8_t *error);
+typedef size_t (*read_custom_func)(struct uxrCustomTransport *transport, uint8_t *buffer,
+                                   size_t size, int timeout, uint8_t *error);
+
+struct uxrCustomTransport {
+  bool framing;
+  void *args;
+  open_custom_func open;
+  close_custom_func close;
+  write_custom_func write;
+  read_custom_func read;
+};
+
+#endif /* end of include guard: HOST_UXR_CUSTOM_TRANSPORT_H */
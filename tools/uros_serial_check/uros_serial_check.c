@@ -0,0 +1,255 @@
+// Checks the micro-ROS serial transport (uros_serial_transport.c, UART link)
+// on the host, over a pty: the transport writes to the master side as to the
+// UART, and the check plays the agent on the slave side (the device that
+// `micro_ros_agent serial --dev` opens). The XRCE client is not built here:
+// the check calls the transport callbacks as the client does.
+//
+// 1. writes are batched until the next read, or sent at once when large;
+// 2. reads return the bytes in order, and 0 at the timeout;
+// 3. round trips of messages echoed by the agent side, and their time.
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sdkconfig.h"
+#include "driver/uart.h"
+#include <rmw_uros/options.h>
+#include <uxr/client/profile/transport/custom/custom_transport.h>
+
+#include "uros_serial_transport.h"
+
+#define TX_BATCH_SIZE CONFIG_UROS_SERIAL_TX_BATCH_SIZE
+#define MAX_MESSAGE_SIZE 8192
+#define READ_TIMEOUT_MS 1000
+
+static struct uxrCustomTransport transport;
+static int agent_fd = -1;
+static uint32_t round_trips = 10000;
+static size_t message_size = 512;
+
+rmw_ret_t rmw_uros_set_custom_transport(bool framing, void *args, open_custom_func open_cb,
+                                        close_custom_func close_cb, write_custom_func write_cb,
+                                        read_custom_func read_cb) {
+  transport = (struct uxrCustomTransport) {framing, args, open_cb, close_cb, write_cb, read_cb};
+  return RMW_RET_OK;
+}
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void random_bytes(uint8_t *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    data[i] = rand() & 0xFF;
+  }
+}
+
+static bool report(const char *name, bool ok) {
+  printf("%-18s%s\n", name, ok ? "passed" : "FAILED");
+  return ok;
+}
+
+static bool make_raw(int fd) {
+  struct termios tio;
+  if (tcgetattr(fd, &tio)) {
+    return false;
+  }
+  cfmakeraw(&tio);
+  return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+// Opens a pty: the transport gets the master, the agent side the slave
+static bool open_pty(void) {
+  const int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) || unlockpt(master)) {
+    perror("posix_openpt");
+    return false;
+  }
+  agent_fd = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if (agent_fd < 0 || !make_raw(master) || !make_raw(agent_fd)) {
+    perror(ptsname(master));
+    return false;
+  }
+  host_uart_set_fd(master);
+  return true;
+}
+
+static size_t agent_available(int timeout_ms) {
+  struct pollfd fd = {agent_fd, POLLIN, 0};
+  return poll(&fd, 1, timeout_ms) > 0;
+}
+
+static bool agent_read(uint8_t *buffer, size_t size) {
+  size_t read_bytes = 0;
+  while (read_bytes < size) {
+    if (!agent_available(READ_TIMEOUT_MS)) {
+      fprintf(stderr, "agent: %zu bytes, expected %zu\n", read_bytes, size);
+      return false;
+    }
+    const ssize_t n = read(agent_fd, buffer + read_bytes, size - read_bytes);
+    if (n <= 0) {
+      return false;
+    }
+    read_bytes += n;
+  }
+  return true;
+}
+
+static bool agent_write(const uint8_t *buffer, size_t size) {
+  return write(agent_fd, buffer, size) == (ssize_t) size;
+}
+
+static size_t transport_write(const uint8_t *buffer, size_t size) {
+  uint8_t error = 0;
+  const size_t written = transport.write(&transport, buffer, size, &error);
+  return error ? 0 : written;
+}
+
+static size_t transport_read(uint8_t *buffer, size_t size, int timeout_ms) {
+  uint8_t error = 0;
+  const size_t read_bytes = transport.read(&transport, buffer, size, timeout_ms, &error);
+  return error ? 0 : read_bytes;
+}
+
+// Small writes stay in the batch until the client reads
+static bool check_batching(void) {
+  static uint8_t sent[10 * 100], received[sizeof(sent)];
+  random_bytes(sent, sizeof(sent));
+  uros_serial_transport_stats_t before, after;
+  uros_serial_transport_get_stats(&before);
+  bool ok = true;
+  for (size_t offset = 0; offset < sizeof(sent); offset += 100) {
+    ok = transport_write(sent + offset, 100) == 100 && ok;
+  }
+  if (agent_available(10)) {
+    fprintf(stderr, "batch sent before the read\n");
+    ok = false;
+  }
+  uint8_t byte;
+  transport_read(&byte, 1, 0);
+  ok = agent_read(received, sizeof(received)) && !memcmp(sent, received, sizeof(sent)) && ok;
+  uros_serial_transport_get_stats(&after);
+  if (after.batches - before.batches != 1) {
+    fprintf(stderr, "%u batches, expected 1\n", after.batches - before.batches);
+    ok = false;
+  }
+  return report("batching", ok);
+}
+
+// A write larger than a batch goes to the driver at once, after the batch
+static bool check_large_write(void) {
+  static uint8_t sent[100 + 5 * TX_BATCH_SIZE], received[sizeof(sent)];
+  random_bytes(sent, sizeof(sent));
+  bool ok = transport_write(sent, 100) == 100;
+  ok = transport_write(sent + 100, sizeof(sent) - 100) == sizeof(sent) - 100 && ok;
+  ok = agent_read(received, sizeof(received)) && !memcmp(sent, received, sizeof(sent)) && ok;
+  return report("large write", ok);
+}
+
+static bool check_read(void) {
+  static uint8_t sent[3000], received[sizeof(sent)];
+  random_bytes(sent, sizeof(sent));
+  bool ok = agent_write(sent, sizeof(sent));
+  size_t read_bytes = 0;
+  while (ok && read_bytes < sizeof(received)) {
+    const size_t n = transport_read(received + read_bytes, sizeof(received) - read_bytes, READ_TIMEOUT_MS);
+    ok = n > 0;
+    read_bytes += n;
+  }
+  ok = ok && !memcmp(sent, received, sizeof(sent));
+  return report("read", ok);
+}
+
+static bool check_timeout(void) {
+  uint8_t buffer[100];
+  const double start = now_s();
+  const size_t n = transport_read(buffer, sizeof(buffer), 50);
+  const double elapsed_ms = 1e3 * (now_s() - start);
+  const bool ok = n == 0 && elapsed_ms >= 45 && elapsed_ms < 200;
+  if (!ok) {
+    fprintf(stderr, "read %zu bytes in %.1f ms, expected 0 in 50 ms\n", n, elapsed_ms);
+  }
+  return report("timeout", ok);
+}
+
+static void *echo(void *arg) {
+  static uint8_t buffer[MAX_MESSAGE_SIZE];
+  while (1) {
+    const ssize_t n = read(agent_fd, buffer, sizeof(buffer));
+    if (n <= 0 || !agent_write(buffer, n)) {
+      return NULL;
+    }
+  }
+}
+
+// The client writes a message, then reads the answer
+static bool check_round_trips(void) {
+  static uint8_t sent[MAX_MESSAGE_SIZE], received[MAX_MESSAGE_SIZE];
+  pthread_t thread;
+  pthread_create(&thread, NULL, echo, NULL);
+  bool ok = true;
+  const double start = now_s();
+  for (uint32_t i = 0; ok && i < round_trips; i++) {
+    random_bytes(sent, message_size);
+    ok = transport_write(sent, message_size) == message_size;
+    size_t read_bytes = 0;
+    while (ok && read_bytes < message_size) {
+      const size_t n = transport_read(received + read_bytes, message_size - read_bytes, READ_TIMEOUT_MS);
+      ok = n > 0;
+      read_bytes += n;
+    }
+    ok = ok && !memcmp(sent, received, message_size);
+  }
+  const double elapsed = now_s() - start;
+  pthread_cancel(thread);
+  pthread_join(thread, NULL);
+  printf("round trip        %.1f us (%u x %zu bytes)\n", 1e6 * elapsed / round_trips, round_trips, message_size);
+  return report("round trips", ok);
+}
+
+int main(int argc, char **argv) {
+  static const struct option long_options[] = {
+    {"round-trips", required_argument, NULL, 'n'},
+    {"size", required_argument, NULL, 's'},
+    {NULL, 0, NULL, 0},
+  };
+  int c;
+  while ((c = getopt_long(argc, argv, "n:s:", long_options, NULL)) != -1) {
+    switch (c) {
+      case 'n': round_trips = strtoul(optarg, NULL, 0); break;
+      case 's': message_size = strtoul(optarg, NULL, 0); break;
+      default:
+        message_size = 0;
+        break;
+    }
+  }
+  if (!round_trips || !message_size || message_size > MAX_MESSAGE_SIZE) {
+    fprintf(stderr, "Usage: %s [--round-trips N] [--size 1..%d]\n", argv[0], MAX_MESSAGE_SIZE);
+    return 1;
+  }
+  if (!open_pty() || uros_serial_transport_init() != RMW_RET_OK || !transport.open(&transport)) {
+    return 1;
+  }
+  bool ok = check_batching();
+  ok = check_large_write() && ok;
+  ok = check_read() && ok;
+  ok = check_timeout() && ok;
+  ok = check_round_trips() && ok;
+  transport.close(&transport);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+// Host replacement of the ESP-IDF SPI master driver used by
+// led_strip_spi_ws2812.c. The transactions complete when queued: the host
+// keeps the bytes of every transfer of the last added device since
+// host_spi_clear, and its clock, to rebuild the waveform on MOSI.
+
+#ifndef HOST_DRIVER_SPI_MASTER_H
+#define HOST_DRIVER_SPI_MASTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#define HOST_SPI_MAX_TRANSFERS 64
+#define HOST_SPI_QUEUE_SIZE 8
+
+typedef enum {
+  SPI1_HOST,
+  SPI2_HOST,
+  SPI3_HOST
+} spi_host_device_t;
+
+typedef struct host_spi_device *spi_device_handle_t;
+
+typedef struct {
+  uint8_t mode;
+  int clock_speed_hz;
+  int spics_io_num;
+  uint32_t flags;
+  int queue_size;
+} spi_device_interface_config_t;
+
+typedef struct {
+  uint32_t flags;
+  size_t length;
+  size_t rxlength;
+  void *user;
+  const void *tx_buffer;
+  void *rx_buffer;
+} spi_transaction_t;
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle);
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *transaction, TickType_t ticks_to_wait);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **transaction,
+                                      TickType_t ticks_to_wait);
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *transaction);
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+} host_spi_transfer_t;
+
+// Transfers of the last added device since host_spi_clear, and its clock
+const host_spi_transfer_t *host_spi_transfers(size_t *number, int *clock_speed_hz);
+void host_spi_clear(void);
+
+#endif /* end of include guard: HOST_DRIVER_SPI_MASTER_H */
@@ -0,0 +1,10 @@
+// Host replacement of the ESP-IDF capability allocator: the heap.
+
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+#include <stdlib.h>
+
+#define heap_caps_free free
+
+#endif /* end of include guard: HOST_ESP_HEAP_CAPS_H */
@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/spi_master.h"
+
+struct host_spi_device {
+  spi_device_interface_config_t config;
+  host_spi_transfer_t transfers[HOST_SPI_MAX_TRANSFERS];
+  size_t number_of_transfers;
+  // completed, not returned by spi_device_get_trans_result yet
+  spi_transaction_t *queue[HOST_SPI_QUEUE_SIZE];
+  size_t queued;
+};
+
+static struct host_spi_device *last_device;
+
+static void clear(spi_device_handle_t handle) {
+  for (size_t i = 0; i < handle->number_of_transfers; i++) {
+    free(handle->transfers[i].data);
+  }
+  handle->number_of_transfers = 0;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle) {
+  if (!config || !handle || config->queue_size > HOST_SPI_QUEUE_SIZE) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *handle = calloc(1, sizeof(struct host_spi_device));
+  if (!*handle) {
+    return ESP_ERR_NO_MEM;
+  }
+  (*handle)->config = *config;
+  last_device = *handle;
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle) {
+  clear(handle);
+  if (handle == last_device) {
+    last_device = NULL;
+  }
+  free(handle);
+  return ESP_OK;
+}
+
+static esp_err_t send(spi_device_handle_t handle, const spi_transaction_t *transaction) {
+  if (handle->number_of_transfers == HOST_SPI_MAX_TRANSFERS || transaction->length % 8) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  host_spi_transfer_t *transfer = handle->transfers + handle->number_of_transfers;
+  transfer->size = transaction->length / 8;
+  transfer->data = malloc(transfer->size);
+  if (!transfer->data) {
+    return ESP_ERR_NO_MEM;
+  }
+  memcpy(transfer->data, transaction->tx_buffer, transfer->size);
+  handle->number_of_transfers++;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *transaction, TickType_t ticks_to_wait) {
+  if ((int) handle->queued == handle->config.queue_size) {
+    return ESP_ERR_TIMEOUT;
+  }
+  const esp_err_t err = send(handle, transaction);
+  if (err == ESP_OK) {
+    handle->queue[handle->queued++] = transaction;
+  }
+  return err;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **transaction,
+                                      TickType_t ticks_to_wait) {
+  if (!handle->queued) {
+    return ESP_ERR_TIMEOUT;
+  }
+  *transaction = handle->queue[0];
+  memmove(handle->queue, handle->queue + 1, --handle->queued * sizeof(handle->queue[0]));
+  return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *transaction) {
+  return send(handle, transaction);
+}
+
+const host_spi_transfer_t *host_spi_transfers(size_t *number, int *clock_speed_hz) {
+  *number = last_device ? last_device->number_of_transfers : 0;
+  *clock_speed_hz = last_device ? last_device->config.clock_speed_hz : 0;
+  return last_device ? last_device->transfers : NULL;
+}
+
+void host_spi_clear(void) {
+  if (last_device) {
+    clear(last_device);
+  }
+}
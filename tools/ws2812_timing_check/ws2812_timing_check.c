@@ -0,0 +1,258 @@
+// Checks that both WS2812 drivers of ros_feather_wing (led_strip_rmt_ws2812.c
+// and led_strip_spi_ws2812.c) send what a WS2812 expects. Their host builds
+// write random pixels to the RMT and SPI stubs. The waveform on the data line
+// is then rebuilt from the RMT items or from the SPI bits at the SPI clock, and
+// decoded as the LED does.
+//
+// The limits are those of the WS2812B datasheet: T0H 400 ns and T1H 800 ns
+// within 150 ns, a bit period of 1.25 us within 600 ns, and a reset of
+// 280 us (WS2812B-V5). The shortest low time is the one of T1L, 450 - 150 ns.
+// A high time is read as a 1 above 600 ns, halfway between T0H and T1H.
+// The RMT driver does not send the reset: the caller waits between refreshes.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/rmt.h"
+#include "driver/spi_master.h"
+#include "led_strip.h"
+
+#define T0H_MIN_NS 250
+#define T0H_MAX_NS 550
+#define T1H_MIN_NS 650
+#define T1H_MAX_NS 950
+#define TL_MIN_NS 300
+#define PERIOD_MIN_NS 650
+#define PERIOD_MAX_NS 1850
+#define RESET_MIN_NS 280000
+#define ONE_THRESHOLD_NS 600
+
+// A constant level of the data line
+typedef struct {
+  bool level;
+  double ns;
+} run_t;
+
+typedef struct {
+  run_t *runs;
+  size_t number_of_runs;
+  size_t capacity;
+} waveform_t;
+
+// Extremes of the times of the bits, in ns
+typedef struct {
+  double min;
+  double max;
+} range_t;
+
+typedef struct {
+  range_t t0h, t0l, t1h, t1l;
+  double reset;
+} timings_t;
+
+static uint32_t number_of_leds = 300;
+
+static bool report(const char *name, bool ok) {
+  printf("%-18s%s\n", name, ok ? "passed" : "FAILED");
+  return ok;
+}
+
+static bool append(waveform_t *waveform, bool level, double ns) {
+  if (waveform->number_of_runs && waveform->runs[waveform->number_of_runs - 1].level == level) {
+    waveform->runs[waveform->number_of_runs - 1].ns += ns;
+    return true;
+  }
+  if (waveform->number_of_runs == waveform->capacity) {
+    const size_t capacity = 2 * waveform->capacity + 64;
+    run_t *runs = realloc(waveform->runs, capacity * sizeof(run_t));
+    if (!runs) {
+      return false;
+    }
+    waveform->runs = runs;
+    waveform->capacity = capacity;
+  }
+  waveform->runs[waveform->number_of_runs++] = (run_t) {level, ns};
+  return true;
+}
+
+static bool rmt_waveform(waveform_t *waveform) {
+  size_t number_of_items;
+  const rmt_item32_t *items = host_rmt_items(RMT_CHANNEL_0, &number_of_items);
+  const double tick_ns = 1e9 / RMT_COUNTER_CLOCK_HZ;
+  bool ok = true;
+  for (size_t i = 0; ok && i < number_of_items; i++) {
+    ok = append(waveform, items[i].level0, tick_ns * items[i].duration0) &&
+         append(waveform, items[i].level1, tick_ns * items[i].duration1);
+  }
+  return ok;
+}
+
+// The transfers one after the other: the line idles low between two of them
+static bool spi_waveform(waveform_t *waveform, size_t *number_of_transfers) {
+  int clock_speed_hz;
+  const host_spi_transfer_t *transfers = host_spi_transfers(number_of_transfers, &clock_speed_hz);
+  if (!clock_speed_hz) {
+    return false;
+  }
+  const double bit_ns = 1e9 / clock_speed_hz;
+  bool ok = true;
+  for (size_t i = 0; ok && i < *number_of_transfers; i++) {
+    for (size_t j = 0; ok && j < transfers[i].size; j++) {
+      for (int bit = 7; ok && bit >= 0; bit--) {
+        ok = append(waveform, (transfers[i].data[j] >> bit) & 1, bit_ns);
+      }
+    }
+  }
+  return ok;
+}
+
+static void extend(range_t *range, double ns) {
+  if (ns < range->min) {
+    range->min = ns;
+  }
+  if (ns > range->max) {
+    range->max = ns;
+  }
+}
+
+// Decodes the waveform as the LED does, checks every bit against the limits
+// and the bytes against `expected`
+static bool check_waveform(const waveform_t *waveform, const uint8_t *expected, size_t size,
+                           bool with_reset, timings_t *timings) {
+  const range_t empty = {1e12, 0};
+  *timings = (timings_t) {empty, empty, empty, empty, 0};
+  const run_t *run = waveform->runs;
+  const run_t *end = waveform->runs + waveform->number_of_runs;
+  // Idle before the frame
+  if (run < end && !run->level) {
+    run++;
+  }
+  if (end - run != (ptrdiff_t) (16 * size)) {
+    fprintf(stderr, "%zu levels for %zu bits\n", (size_t) (end - run), 8 * size);
+    return false;
+  }
+  for (size_t i = 0; i < 8 * size; i++, run += 2) {
+    const double high = run[0].ns;
+    const double low = run[1].ns;
+    const bool one = high > ONE_THRESHOLD_NS;
+    const bool last = i == 8 * size - 1;
+    bool ok = one ? high >= T1H_MIN_NS && high <= T1H_MAX_NS : high >= T0H_MIN_NS && high <= T0H_MAX_NS;
+    if (last) {
+      timings->reset = low;
+      ok = ok && (with_reset ? low >= RESET_MIN_NS : low >= TL_MIN_NS);
+    } else {
+      extend(one ? &timings->t1h : &timings->t0h, high);
+      extend(one ? &timings->t1l : &timings->t0l, low);
+      ok = ok && low >= TL_MIN_NS && high + low >= PERIOD_MIN_NS && high + low <= PERIOD_MAX_NS;
+    }
+    if (!ok) {
+      fprintf(stderr, "bit %zu: high %.1f ns, low %.1f ns\n", i, high, low);
+      return false;
+    }
+    if (one != ((expected[i / 8] >> (7 - i % 8)) & 1)) {
+      fprintf(stderr, "byte %zu: bit %zu is %d\n", i / 8, 7 - i % 8, one);
+      return false;
+    }
+  }
+  return true;
+}
+
+static void print_timings(const timings_t *timings, bool with_reset) {
+  printf("  T0H %.0f-%.0f ns, T0L %.0f-%.0f ns, T1H %.0f-%.0f ns, T1L %.0f-%.0f ns",
+         timings->t0h.min, timings->t0h.max, timings->t0l.min, timings->t0l.max,
+         timings->t1h.min, timings->t1h.max, timings->t1l.min, timings->t1l.max);
+  if (with_reset) {
+    printf(", reset %.1f us\n", 1e-3 * timings->reset);
+  } else {
+    printf(", reset by the caller\n");
+  }
+}
+
+// Random pixels, then a refresh. `expected` receives the GRB bytes.
+static bool refresh_random(led_strip_t *strip, uint8_t *expected) {
+  for (uint32_t i = 0; i < number_of_leds; i++) {
+    const uint8_t red = rand(), green = rand(), blue = rand();
+    if (strip->set_pixel(strip, i, red, green, blue) != ESP_OK) {
+      return false;
+    }
+    expected[3 * i] = green;
+    expected[3 * i + 1] = red;
+    expected[3 * i + 2] = blue;
+  }
+  return strip->refresh(strip, 100) == ESP_OK;
+}
+
+static bool check_rmt(uint8_t *expected) {
+  led_strip_config_t config = LED_STRIP_DEFAULT_CONFIG(number_of_leds, (led_strip_dev_t) RMT_CHANNEL_0);
+  led_strip_t *strip = led_strip_new_rmt_ws2812(&config);
+  waveform_t waveform = {0};
+  timings_t timings;
+  const bool ok = strip && refresh_random(strip, expected) && rmt_waveform(&waveform) &&
+                  check_waveform(&waveform, expected, 3 * number_of_leds, false, &timings);
+  report("rmt", ok);
+  if (ok) {
+    print_timings(&timings, false);
+  }
+  free(waveform.runs);
+  if (strip) {
+    strip->del(strip);
+  }
+  return ok;
+}
+
+// One transfer per frame: the line stays low between two transfers, and a gap
+// longer than the reset would latch the LEDs in the middle of the frame
+static bool check_spi(uint8_t *expected) {
+  led_strip_config_t config = LED_STRIP_DEFAULT_CONFIG(number_of_leds, (led_strip_dev_t) SPI2_HOST);
+  led_strip_t *strip = led_strip_new_spi_ws2812(&config);
+  waveform_t waveform = {0};
+  timings_t timings;
+  size_t number_of_transfers = 0;
+  bool ok = strip && refresh_random(strip, expected) && spi_waveform(&waveform, &number_of_transfers) &&
+            check_waveform(&waveform, expected, 3 * number_of_leds, true, &timings);
+  if (ok && number_of_transfers != 1) {
+    fprintf(stderr, "%zu transfers for a frame\n", number_of_transfers);
+    ok = false;
+  }
+  report("spi", ok);
+  if (ok) {
+    print_timings(&timings, true);
+  }
+  free(waveform.runs);
+  if (strip) {
+    strip->del(strip);
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  static const struct option long_options[] = {
+    {"leds", required_argument, NULL, 'n'},
+    {NULL, 0, NULL, 0},
+  };
+  int c;
+  while ((c = getopt_long(argc, argv, "n:", long_options, NULL)) != -1) {
+    switch (c) {
+      case 'n': number_of_leds = strtoul(optarg, NULL, 0); break;
+      default: number_of_leds = 0; break;
+    }
+  }
+  if (!number_of_leds) {
+    fprintf(stderr, "Usage: %s [--leds N]\n", argv[0]);
+    return 1;
+  }
+  uint8_t *expected = malloc(3 * number_of_leds);
+  if (!expected) {
+    return 1;
+  }
+  srand(1);
+  bool ok = check_rmt(expected);
+  ok = check_spi(expected) && ok;
+  free(expected);
+  return ok ? 0 : 1;
+}